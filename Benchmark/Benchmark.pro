@@ -0,0 +1,33 @@
+# End-to-end benchmark of the HTTP server. Starts an in-process HttpListener
+# and drives it with a multithreaded HTTP/1.1 load generator.
+# Linux only, because the load generator uses POSIX sockets and poll().
+
+TARGET = Benchmark
+TEMPLATE = app
+QT = core network
+# C++20 builds the AsyncRequestHandler and the "async" scenario
+CONFIG += console c++2a
+# GCC 10 enables coroutines only with an extra flag
+*-g++*: QMAKE_CXXFLAGS += -fcoroutines
+CONFIG -= app_bundle
+
+HEADERS += \
+           src/benchmarkhandler.h \
+           src/asyncbenchmarkhandler.h \
+           src/scenario.h \
+           src/loadgenerator.h
+
+SOURCES += src/main.cpp \
+           src/benchmarkhandler.cpp \
+           src/asyncbenchmarkhandler.cpp \
+           src/scenario.cpp \
+           src/loadgenerator.cpp
+
+OTHER_FILES += ../readme.txt
+
+#---------------------------------------------------------------------------------------
+# The following lines include the sources of the QtWebAppLib library
+#---------------------------------------------------------------------------------------
+
+include(../QtWebApp/httpserver/httpserver.pri)
+include(../QtWebApp/templateengine/templateengine.pri)
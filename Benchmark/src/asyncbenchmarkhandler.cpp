@@ -0,0 +1,24 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "asyncbenchmarkhandler.h"
+
+#ifdef QTWEBAPP_COROUTINES
+
+AsyncBenchmarkHandler::AsyncBenchmarkHandler(QObject* parent)
+    : AsyncRequestHandler(parent)
+{}
+
+Task<> AsyncBenchmarkHandler::serviceAsync(AsyncContext& context)
+{
+    const QByteArray body=co_await context.body();
+    context.getResponse().setHeader("Content-Type","text/plain");
+    if (co_await context.write("async "))
+    {
+        co_await context.write(QByteArray::number(body.size()),true);
+    }
+}
+
+#endif // QTWEBAPP_COROUTINES
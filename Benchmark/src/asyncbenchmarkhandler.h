@@ -0,0 +1,40 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef ASYNCBENCHMARKHANDLER_H
+#define ASYNCBENCHMARKHANDLER_H
+
+#include "asyncrequesthandler.h"
+
+#ifdef QTWEBAPP_COROUTINES
+
+using namespace stefanfrings;
+
+/**
+  Server side of the "async" scenario. Answers /async with a coroutine that
+  writes the response in two parts, so the benchmark measures the overhead of
+  the AsyncRequestHandler compared to the thread based handlers.
+*/
+
+class AsyncBenchmarkHandler : public AsyncRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(AsyncBenchmarkHandler)
+public:
+
+    /**
+      Constructor.
+      @param parent Parent object
+    */
+    explicit AsyncBenchmarkHandler(QObject* parent=nullptr);
+
+protected:
+
+    /** Generates the response */
+    Task<> serviceAsync(AsyncContext& context) override;
+};
+
+#endif // QTWEBAPP_COROUTINES
+
+#endif // ASYNCBENCHMARKHANDLER_H
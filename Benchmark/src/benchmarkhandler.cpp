@@ -0,0 +1,122 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "benchmarkhandler.h"
+#include "asyncbenchmarkhandler.h"
+#include "httpconnectionhandler.h"
+#include <QTemporaryFile>
+#include <QVariantMap>
+
+BenchmarkHandler::BenchmarkHandler(StaticFileController* staticFiles, StaticFileController* uncachedFiles,
+                                   TemplateCache* templates, HttpSessionStore* sessions, QObject* parent)
+    : HttpRequestHandler(parent)
+{
+    this->staticFiles=staticFiles;
+    this->uncachedFiles=uncachedFiles;
+    this->templates=templates;
+    this->sessions=sessions;
+#ifdef QTWEBAPP_COROUTINES
+    asyncHandler=new AsyncBenchmarkHandler(this);
+    // The connection handlers only listen to this handler
+    connect(asyncHandler,&HttpRequestHandler::responseResultSignal,this,&HttpRequestHandler::responseResultSignal);
+#else
+    asyncHandler=nullptr;
+#endif
+}
+
+void BenchmarkHandler::callService(ServiceParams params)
+{
+    if (asyncHandler && params.request->getPath()=="/async")
+    {
+        asyncHandler->callService(params);
+    }
+    else
+    {
+        HttpRequestHandler::callService(params);
+    }
+}
+
+void BenchmarkHandler::respond(HttpResponse& response, const QByteArray& document, const int status)
+{
+    response.getConnectionHandler().socketSafeExecution([&] {
+        if (status!=200)
+        {
+            response.setStatus(status,"error");
+        }
+        response.setHeader("Content-Type","text/plain");
+        response.write(document,true);
+    });
+}
+
+void BenchmarkHandler::service(ServiceParams params)
+{
+    const HttpRequest& request=*params.request;
+    HttpResponse& response=*params.response;
+    const QByteArray path=request.getPath();
+
+    if (path.startsWith("/static/"))
+    {
+        staticFiles->service(params);
+    }
+    else if (path.startsWith("/nocache/"))
+    {
+        uncachedFiles->service(params);
+    }
+    else if (path=="/template")
+    {
+        Template page=templates->getTemplate("page");
+        page.setVariable("title","Price list <"+request.getParameter("page")+">");
+        QVariantList rows;
+        for (int i=0; i<50; i++)
+        {
+            QVariantMap row;
+            row.insert("id",i);
+            row.insert("name",QString("Article & no. %1").arg(i));
+            row.insert("price",QString::number(i*1.25,'f',2));
+            rows.append(row);
+        }
+        page.loop("row",rows);
+        response.getConnectionHandler().socketSafeExecution([&] {
+            response.setHeader("Content-Type","text/html; charset=UTF-8");
+            response.write(page.toUtf8(),true);
+        });
+    }
+    else if (path=="/form")
+    {
+        qint64 size=0;
+        const QMultiMap<QByteArray,QByteArray>& fields=request.getParameterMap();
+        for (auto i=fields.constBegin(); i!=fields.constEnd(); ++i)
+        {
+            size+=i.key().size()+i.value().size();
+        }
+        respond(response,QByteArray::number(size));
+    }
+    else if (path=="/upload")
+    {
+        QTemporaryFile* file=request.getUploadedFile("file");
+        if (file)
+        {
+            respond(response,QByteArray::number(file->size()));
+        }
+        else
+        {
+            respond(response,"no file",400);
+        }
+    }
+    else if (path=="/session")
+    {
+        HttpSession session=sessions->getSession(request,response,true);
+        session.set("visits",session.get("visits").toInt()+1);
+        if (request.getParameter("end")=="1")
+        {
+            sessions->removeSession(session);
+        }
+        respond(response,session.getId());
+    }
+    else
+    {
+        respond(response,"not found",404);
+    }
+}
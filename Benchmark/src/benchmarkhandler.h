@@ -0,0 +1,66 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef BENCHMARKHANDLER_H
+#define BENCHMARKHANDLER_H
+
+#include "httprequesthandler.h"
+#include "httpsessionstore.h"
+#include "staticfilecontroller.h"
+#include "templatecache.h"
+
+using namespace stefanfrings;
+
+/**
+  Server side of the benchmark. Dispatches the requests of the scenarios:
+
+  - /static/... to a StaticFileController with cache
+  - /nocache/... to a StaticFileController that never caches
+  - /template renders a template with a loop
+  - /form answers the size of the posted form fields
+  - /upload answers the size of the uploaded file
+  - /session creates a session and removes it again if the parameter end=1 is present
+  - /async to an AsyncBenchmarkHandler, if the compiler supports coroutines
+*/
+
+class BenchmarkHandler : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(BenchmarkHandler)
+public:
+
+    /**
+      Constructor.
+      @param staticFiles Controller for cached files
+      @param uncachedFiles Controller for files that are never cached
+      @param templates Cache for the templates
+      @param sessions Session store
+      @param parent Parent object
+    */
+    BenchmarkHandler(StaticFileController* staticFiles, StaticFileController* uncachedFiles,
+                     TemplateCache* templates, HttpSessionStore* sessions, QObject* parent=nullptr);
+
+    /** Passes /async to the coroutine handler, all other requests to service() */
+    void callService(ServiceParams params) override;
+
+protected:
+
+    /** Generates the response */
+    void service(ServiceParams params) override;
+
+private:
+
+    StaticFileController* staticFiles;
+    StaticFileController* uncachedFiles;
+    TemplateCache* templates;
+    HttpSessionStore* sessions;
+
+    /** Handler of the "async" scenario, null without coroutine support */
+    HttpRequestHandler* asyncHandler;
+
+    /** Write a complete response in the thread of the connection handler */
+    void respond(HttpResponse& response, const QByteArray& document, const int status=200);
+};
+
+#endif // BENCHMARKHANDLER_H
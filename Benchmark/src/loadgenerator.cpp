@@ -0,0 +1,333 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "loadgenerator.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Time of the steady clock in nsec */
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** State of one client connection */
+struct Connection {
+    int fd=-1;
+    /** Received data that has not been parsed yet */
+    QByteArray input;
+    /** Requests that have not been sent yet */
+    QByteArray output;
+    /** Number of bytes of output that have already been sent */
+    int sent=0;
+    /** Times when the requests without response have been issued */
+    std::deque<qint64> inFlight;
+    /** Number of issued requests */
+    quint64 sequence=0;
+};
+
+/**
+  Check whether the buffer starts with a complete response.
+  @param data Received data
+  @param status Receives the status code
+  @param close Receives whether the server closes the connection after this response
+  @return Length of the response, 0 if incomplete, -1 if the response ends when the connection closes
+*/
+int parseResponse(const QByteArray& data, int& status, bool& close)
+{
+    int headerEnd=data.indexOf("\r\n\r\n");
+    if (headerEnd<0)
+    {
+        return 0;
+    }
+    status=data.mid(9,3).toInt();
+    close=false;
+    qint64 contentLength=-1;
+    bool chunked=false;
+    int lineStart=data.indexOf("\r\n")+2;
+    while (lineStart<headerEnd)
+    {
+        int lineEnd=data.indexOf("\r\n",lineStart);
+        QByteArray line=data.mid(lineStart,lineEnd-lineStart).toLower();
+        if (line.startsWith("content-length:"))
+        {
+            contentLength=line.mid(15).trimmed().toLongLong();
+        }
+        else if (line.startsWith("transfer-encoding:") && line.contains("chunked"))
+        {
+            chunked=true;
+        }
+        else if (line.startsWith("connection:") && line.contains("close"))
+        {
+            close=true;
+        }
+        lineStart=lineEnd+2;
+    }
+
+    int bodyStart=headerEnd+4;
+    if (contentLength>=0)
+    {
+        return data.size()>=bodyStart+contentLength ? static_cast<int>(bodyStart+contentLength) : 0;
+    }
+    if (!chunked)
+    {
+        return -1;
+    }
+    int pos=bodyStart;
+    while (true)
+    {
+        int lineEnd=data.indexOf("\r\n",pos);
+        if (lineEnd<0)
+        {
+            return 0;
+        }
+        bool ok;
+        int size=data.mid(pos,lineEnd-pos).split(';').first().trimmed().toInt(&ok,16);
+        pos=lineEnd+2;
+        if (size==0)
+        {
+            // No trailers, just the final line break
+            return data.size()>=pos+2 ? pos+2 : 0;
+        }
+        pos+=size+2;
+        if (pos>data.size())
+        {
+            return 0;
+        }
+    }
+}
+
+}
+
+LoadGenerator::LoadGenerator(const quint16 port, const int connections, const int threads, const int pipeline)
+{
+    this->port=port;
+    this->connections=qMax(1,connections);
+    this->threads=qBound(1,threads,this->connections);
+    this->pipeline=qMax(1,pipeline);
+}
+
+int LoadGenerator::connectToServer() const
+{
+    int fd=::socket(AF_INET,SOCK_STREAM,0);
+    if (fd<0)
+    {
+        return -1;
+    }
+    int one=1;
+    ::setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+    sockaddr_in address={};
+    address.sin_family=AF_INET;
+    address.sin_port=htons(port);
+    address.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+    if (::connect(fd,reinterpret_cast<sockaddr*>(&address),sizeof(address))!=0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    ::fcntl(fd,F_SETFL,::fcntl(fd,F_GETFL)|O_NONBLOCK);
+    return fd;
+}
+
+LoadResult LoadGenerator::run(const Scenario& scenario, const double seconds)
+{
+    std::unique_ptr<Histogram> histogram(new Histogram());
+    std::vector<WorkerResult> results(threads);
+    std::vector<std::thread> workers;
+    qint64 start=now();
+    qint64 deadline=start+static_cast<qint64>(seconds*1e9);
+    for (int i=0; i<threads; i++)
+    {
+        // Distribute the connections evenly
+        int count=connections/threads+(i<connections%threads ? 1 : 0);
+        workers.emplace_back(&LoadGenerator::worker,this,std::cref(scenario),count,deadline,
+                             std::ref(*histogram),std::ref(results[i]));
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    LoadResult result;
+    result.scenario=scenario.getName();
+    result.connections=connections;
+    result.threads=threads;
+    result.pipeline=pipeline;
+    result.seconds=(now()-start)/1e9;
+    for (const WorkerResult& r : results)
+    {
+        result.requests+=r.requests;
+        result.httpErrors+=r.httpErrors;
+        result.errors+=r.errors;
+        result.bytes+=r.bytes;
+        result.maxLatency=qMax(result.maxLatency,r.maxLatency);
+    }
+    result.latency=histogram->snapshot();
+    return result;
+}
+
+void LoadGenerator::worker(const Scenario& scenario, const int connectionCount, const qint64 deadline,
+                           Histogram& histogram, WorkerResult& result) const
+{
+    // Requests that are still in flight after this time are counted as errors
+    const qint64 drainDeadline=deadline+5000000000LL;
+    std::vector<Connection> pool(connectionCount);
+    std::vector<pollfd> fds(connectionCount);
+    char buffer[65536];
+
+    auto closeConnection=[&result](Connection& c)
+    {
+        result.errors+=c.inFlight.size();
+        c.inFlight.clear();
+        c.input.clear();
+        c.output.clear();
+        c.sent=0;
+        ::close(c.fd);
+        c.fd=-1;
+    };
+
+    while (true)
+    {
+        qint64 time=now();
+        bool issuing=time<deadline;
+        bool idle=true;
+        for (int i=0; i<connectionCount; i++)
+        {
+            Connection& c=pool[i];
+            if (issuing)
+            {
+                if (c.fd<0 && (c.fd=connectToServer())<0)
+                {
+                    result.errors++;
+                }
+                while (c.fd>=0 && static_cast<int>(c.inFlight.size())<pipeline)
+                {
+                    scenario.appendRequest(c.output,c.sequence++);
+                    c.inFlight.push_back(time);
+                }
+            }
+            if (time>drainDeadline && c.fd>=0)
+            {
+                closeConnection(c);
+            }
+            if (!c.inFlight.empty())
+            {
+                idle=false;
+            }
+
+            // Send as much as possible
+            while (c.fd>=0 && c.sent<c.output.size())
+            {
+                ssize_t n=::send(c.fd,c.output.constData()+c.sent,c.output.size()-c.sent,MSG_NOSIGNAL);
+                if (n<0)
+                {
+                    if (errno!=EAGAIN && errno!=EWOULDBLOCK)
+                    {
+                        closeConnection(c);
+                    }
+                    break;
+                }
+                c.sent+=n;
+            }
+            if (c.sent==c.output.size())
+            {
+                c.output.resize(0);
+                c.sent=0;
+            }
+            fds[i].fd=c.fd;
+            fds[i].events=POLLIN | (c.output.isEmpty() ? 0 : POLLOUT);
+            fds[i].revents=0;
+        }
+        if (!issuing && idle)
+        {
+            break;
+        }
+
+        if (::poll(fds.data(),fds.size(),5)<=0)
+        {
+            continue;
+        }
+        for (int i=0; i<connectionCount; i++)
+        {
+            Connection& c=pool[i];
+            if (c.fd<0 || !(fds[i].revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                continue;
+            }
+            bool closed=false;
+            while (true)
+            {
+                ssize_t n=::recv(c.fd,buffer,sizeof(buffer),0);
+                if (n>0)
+                {
+                    c.input.append(buffer,static_cast<int>(n));
+                    result.bytes+=n;
+                    continue;
+                }
+                closed=(n==0 || (errno!=EAGAIN && errno!=EWOULDBLOCK));
+                break;
+            }
+
+            // Consume the complete responses
+            qint64 received=now();
+            bool serverCloses=false;
+            while (!c.input.isEmpty() && !c.inFlight.empty())
+            {
+                int status=0;
+                int length=parseResponse(c.input,status,serverCloses);
+                if (length<0 && closed)
+                {
+                    // The body ends with the connection
+                    length=c.input.size();
+                    serverCloses=true;
+                }
+                if (length<=0)
+                {
+                    break;
+                }
+                qint64 latency=received-c.inFlight.front();
+                c.inFlight.pop_front();
+                c.input.remove(0,length);
+                histogram.record(latency);
+                result.maxLatency=qMax(result.maxLatency,latency);
+                result.requests++;
+                if (status>=400)
+                {
+                    result.httpErrors++;
+                }
+                if (serverCloses)
+                {
+                    break;
+                }
+            }
+            if (closed || serverCloses)
+            {
+                closeConnection(c);
+            }
+        }
+    }
+
+    for (Connection& c : pool)
+    {
+        if (c.fd>=0)
+        {
+            closeConnection(c);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QByteArray>
+#include <QString>
+#include "metrics.h"
+#include "scenario.h"
+
+using namespace stefanfrings;
+
+/** Result of one benchmark run */
+struct LoadResult {
+    /** Name of the scenario */
+    QString scenario;
+    /** Number of connections */
+    int connections=0;
+    /** Number of client threads */
+    int threads=0;
+    /** Number of requests that are sent ahead on each connection */
+    int pipeline=0;
+    /** Measured time in seconds */
+    double seconds=0;
+    /** Number of received responses */
+    quint64 requests=0;
+    /** Number of responses with status 400 or higher */
+    quint64 httpErrors=0;
+    /** Number of requests without response, because of connection errors */
+    quint64 errors=0;
+    /** Number of received bytes */
+    quint64 bytes=0;
+    /** Highest latency in nsec */
+    qint64 maxLatency=0;
+    /** Latencies in nsec */
+    HistogramSnapshot latency;
+};
+
+/**
+  Multithreaded HTTP/1.1 load generator. Each thread drives its share of the
+  connections with non-blocking sockets and poll(). The connections are kept
+  alive and send up to "pipeline" requests before they wait for the responses.
+  The latency of a request is measured from appending it to the send buffer
+  until its response has been received completely.
+*/
+
+class LoadGenerator {
+public:
+
+    /**
+      Constructor.
+      @param port Port of the server on 127.0.0.1
+      @param connections Number of connections
+      @param threads Number of client threads
+      @param pipeline Number of requests that are sent ahead on each connection
+    */
+    LoadGenerator(const quint16 port, const int connections, const int threads, const int pipeline);
+
+    /**
+      Run a scenario.
+      @param scenario Generates the requests
+      @param seconds Duration of the run
+    */
+    LoadResult run(const Scenario& scenario, const double seconds);
+
+private:
+
+    /** Counters of one thread */
+    struct WorkerResult {
+        quint64 requests=0;
+        quint64 httpErrors=0;
+        quint64 errors=0;
+        quint64 bytes=0;
+        qint64 maxLatency=0;
+    };
+
+    /** Port of the server */
+    quint16 port;
+
+    /** Number of connections */
+    int connections;
+
+    /** Number of client threads */
+    int threads;
+
+    /** Number of requests that are sent ahead on each connection */
+    int pipeline;
+
+    /** Main loop of a client thread */
+    void worker(const Scenario& scenario, const int connectionCount, const qint64 deadline,
+                Histogram& histogram, WorkerResult& result) const;
+
+    /** Open a connection to the server, returns -1 on error */
+    int connectToServer() const;
+};
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,234 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <thread>
+#include "httplistener.h"
+#include "benchmarkhandler.h"
+#include "loadgenerator.h"
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Template of the "template" scenario */
+const char* const pageTemplate=
+        "<html><head><title>{title|html}</title></head><body>\n"
+        "<h1>{title|html}</h1>\n"
+        "<table>\n"
+        "{loop row}<tr><td>{row.id}</td><td>{row.name|html}</td><td>{row.price}</td></tr>\n"
+        "{end row}"
+        "</table>\n"
+        "</body></html>\n";
+
+/** Create the document root, the templates and the configuration file */
+QString createFixtures(const QString& dir, const int fileCount, const int fileSize,
+                       const int connections, const int uploadSize)
+{
+    QDir().mkpath(dir+"/docroot");
+    QDir().mkpath(dir+"/templates");
+    QByteArray content;
+    content.append("<html><body>\n");
+    while (content.size()<fileSize-16)
+    {
+        content.append("QtWebApp benchmark file content.\n");
+    }
+    content.append("</body></html>\n");
+    for (int i=0; i<fileCount; i++)
+    {
+        QFile file(dir+"/docroot/file"+QString::number(i)+".html");
+        file.open(QIODevice::WriteOnly);
+        file.write(content);
+    }
+    QFile page(dir+"/templates/page.tpl");
+    page.open(QIODevice::WriteOnly);
+    page.write(pageTemplate);
+
+    QString configFile=dir+"/Benchmark.ini";
+    QSettings settings(configFile,QSettings::IniFormat);
+    settings.beginGroup("listener");
+    settings.setValue("host","127.0.0.1");
+    settings.setValue("port",0);
+    settings.setValue("minThreads",connections);
+    settings.setValue("maxThreads",connections+16);
+    settings.setValue("cleanupInterval",60000);
+    settings.setValue("readTimeout",60000);
+    settings.setValue("maxRequestSize",65536);
+    settings.setValue("maxMultiPartSize",uploadSize+65536);
+    settings.endGroup();
+    settings.beginGroup("static");
+    settings.setValue("path","docroot");
+    settings.setValue("cacheTime",0);
+    settings.setValue("cacheSize",1000000000);
+    settings.setValue("maxCachedFileSize",1000000);
+    settings.endGroup();
+    settings.beginGroup("nocache");
+    settings.setValue("path","docroot");
+    settings.setValue("maxCachedFileSize",0);
+    settings.endGroup();
+    settings.beginGroup("templates");
+    settings.setValue("path","templates");
+    settings.setValue("suffix",".tpl");
+    settings.setValue("encoding","UTF-8");
+    settings.setValue("cacheTime",3600000);
+    settings.endGroup();
+    settings.beginGroup("sessions");
+    settings.setValue("expirationTime",60000);
+    settings.endGroup();
+    settings.sync();
+    return configFile;
+}
+
+/** Format a latency in nsec as microseconds */
+QString micros(const qint64 nsec)
+{
+    return QString::number(nsec/1000.0,'f',1);
+}
+
+/** Print a result as one JSON object or CSV row */
+void printResult(QTextStream& out, const LoadResult& r, const bool csv)
+{
+    const HistogramSnapshot& l=r.latency;
+    double throughput=r.seconds>0 ? r.requests/r.seconds : 0;
+    double mean=l.count>0 ? static_cast<double>(l.sum)/l.count : 0;
+    if (csv)
+    {
+        out << r.scenario << ',' << r.connections << ',' << r.threads << ',' << r.pipeline << ','
+            << QString::number(r.seconds,'f',3) << ',' << r.requests << ',' << r.httpErrors << ','
+            << r.errors << ',' << r.bytes << ',' << QString::number(throughput,'f',1) << ','
+            << micros(mean) << ',' << micros(l.percentile(50)) << ',' << micros(l.percentile(90)) << ','
+            << micros(l.percentile(99)) << ',' << micros(l.percentile(99.9)) << ',' << micros(r.maxLatency) << '\n';
+    }
+    else
+    {
+        out << "{\"scenario\":\"" << r.scenario << "\",\"connections\":" << r.connections
+            << ",\"threads\":" << r.threads << ",\"pipeline\":" << r.pipeline
+            << ",\"seconds\":" << QString::number(r.seconds,'f',3) << ",\"requests\":" << r.requests
+            << ",\"httpErrors\":" << r.httpErrors << ",\"errors\":" << r.errors << ",\"bytes\":" << r.bytes
+            << ",\"requestsPerSecond\":" << QString::number(throughput,'f',1)
+            << ",\"meanUs\":" << micros(mean) << ",\"p50Us\":" << micros(l.percentile(50))
+            << ",\"p90Us\":" << micros(l.percentile(90)) << ",\"p99Us\":" << micros(l.percentile(99))
+            << ",\"p999Us\":" << micros(l.percentile(99.9)) << ",\"maxUs\":" << micros(r.maxLatency) << "}\n";
+    }
+    out.flush();
+}
+
+}
+
+/**
+  Entry point of the program.
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc,argv);
+    app.setApplicationName("Benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end benchmark of the QtWebApp HTTP server. "
+                                     "Prints one result per scenario to stdout.");
+    parser.addHelpOption();
+    QCommandLineOption scenarioOption("scenario","Comma separated list of scenarios: "+Scenario::allNames().join(',')+" or all.","names","all");
+    QCommandLineOption connectionsOption("connections","Number of client connections.","n","64");
+    QCommandLineOption threadsOption("threads","Number of client threads.","n",QString::number(qMax(1,QThread::idealThreadCount()/2)));
+    QCommandLineOption pipelineOption("pipeline","Number of requests sent ahead on each connection.","n","1");
+    QCommandLineOption durationOption("duration","Measured seconds per scenario.","seconds","10");
+    QCommandLineOption warmupOption("warmup","Seconds of load before each measurement.","seconds","2");
+    QCommandLineOption filesOption("files","Number of static files.","n","100");
+    QCommandLineOption fileSizeOption("file-size","Size of the static files in bytes.","bytes","4096");
+    QCommandLineOption uploadSizeOption("upload-size","Size of the uploaded file in bytes.","bytes","65536");
+    QCommandLineOption formatOption("format","Output format: json or csv.","format","json");
+    parser.addOptions({scenarioOption,connectionsOption,threadsOption,pipelineOption,durationOption,
+                       warmupOption,filesOption,fileSizeOption,uploadSizeOption,formatOption});
+    parser.process(app);
+
+    QList<Scenario::Type> scenarios;
+    QStringList names=parser.value(scenarioOption).split(',',QString::SkipEmptyParts);
+    if (names.contains("all"))
+    {
+        names=Scenario::allNames();
+    }
+    for (const QString& name : names)
+    {
+        Scenario::Type type;
+        if (!Scenario::fromName(name.trimmed(),type))
+        {
+            qCritical("Unknown scenario %s",qPrintable(name));
+            return 1;
+        }
+        scenarios.append(type);
+    }
+    const int connections=qMax(1,parser.value(connectionsOption).toInt());
+    const int threads=qMax(1,parser.value(threadsOption).toInt());
+    const int pipeline=qMax(1,parser.value(pipelineOption).toInt());
+    const double duration=parser.value(durationOption).toDouble();
+    const double warmup=parser.value(warmupOption).toDouble();
+    const int fileCount=qMax(1,parser.value(filesOption).toInt());
+    const int fileSize=parser.value(fileSizeOption).toInt();
+    const int uploadSize=parser.value(uploadSizeOption).toInt();
+    const bool csv=parser.value(formatOption)=="csv";
+
+    // The debug messages of the library would dominate the results
+    QLoggingCategory::setFilterRules("qtwebapp.*.debug=false");
+
+    QTemporaryDir dir;
+    QString configFile=createFixtures(dir.path(),fileCount,fileSize,connections,uploadSize);
+
+    QSettings* staticSettings=new QSettings(configFile,QSettings::IniFormat,&app);
+    staticSettings->beginGroup("static");
+    StaticFileController* staticFiles=new StaticFileController(staticSettings,&app);
+    QSettings* uncachedSettings=new QSettings(configFile,QSettings::IniFormat,&app);
+    uncachedSettings->beginGroup("nocache");
+    StaticFileController* uncachedFiles=new StaticFileController(uncachedSettings,&app);
+    QSettings* templateSettings=new QSettings(configFile,QSettings::IniFormat,&app);
+    templateSettings->beginGroup("templates");
+    TemplateCache* templates=new TemplateCache(templateSettings,&app);
+    QSettings* sessionSettings=new QSettings(configFile,QSettings::IniFormat,&app);
+    sessionSettings->beginGroup("sessions");
+    HttpSessionStore* sessions=new HttpSessionStore(sessionSettings,&app);
+
+    BenchmarkHandler* handler=new BenchmarkHandler(staticFiles,uncachedFiles,templates,sessions,&app);
+    QSettings* listenerSettings=new QSettings(configFile,QSettings::IniFormat,&app);
+    listenerSettings->beginGroup("listener");
+    HttpListener* listener=new HttpListener(listenerSettings,handler,&app);
+    if (!listener->isListening())
+    {
+        return 1;
+    }
+
+    // The listener needs the event loop, so the load runs in another thread
+    QTextStream out(stdout);
+    if (csv)
+    {
+        out << "scenario,connections,threads,pipeline,seconds,requests,httpErrors,errors,bytes,"
+               "requestsPerSecond,meanUs,p50Us,p90Us,p99Us,p999Us,maxUs\n";
+    }
+    const quint16 port=listener->serverPort();
+    std::thread driver([&]
+    {
+        LoadGenerator generator(port,connections,threads,pipeline);
+        for (Scenario::Type type : scenarios)
+        {
+            Scenario scenario(type,fileCount,uploadSize);
+            if (warmup>0)
+            {
+                generator.run(scenario,warmup);
+            }
+            printResult(out,generator.run(scenario,duration),csv);
+        }
+        QMetaObject::invokeMethod(&app,"quit",Qt::QueuedConnection);
+    });
+    app.exec();
+    driver.join();
+    listener->close();
+    return 0;
+}
@@ -0,0 +1,112 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "scenario.h"
+#include "asyncrequesthandler.h"
+#include <QStringList>
+
+namespace {
+
+const char* const names[]={"static-hit","static-miss","template","form","upload","session","async"};
+
+const char* const boundary="----QtWebAppBenchmarkBoundary";
+
+}
+
+Scenario::Scenario(const Type type, const int fileCount, const int uploadSize)
+{
+    this->type=type;
+    this->fileCount=qMax(1,fileCount);
+    if (type==FormPost)
+    {
+        for (int i=0; i<20; i++)
+        {
+            if (i>0)
+            {
+                postBody.append('&');
+            }
+            postBody.append("field").append(QByteArray::number(i)).append("=value+number+").append(QByteArray::number(i)).append("%21");
+        }
+        postHeader="POST /form HTTP/1.1\r\nHost: localhost\r\n"
+                   "Content-Type: application/x-www-form-urlencoded\r\n"
+                   "Content-Length: "+QByteArray::number(postBody.size())+"\r\n\r\n";
+    }
+    else if (type==Upload)
+    {
+        postBody.append("--").append(boundary).append("\r\n");
+        postBody.append("Content-Disposition: form-data; name=\"comment\"\r\n\r\nbenchmark\r\n");
+        postBody.append("--").append(boundary).append("\r\n");
+        postBody.append("Content-Disposition: form-data; name=\"file\"; filename=\"data.bin\"\r\n");
+        postBody.append("Content-Type: application/octet-stream\r\n\r\n");
+        for (int i=0; i<uploadSize; i++)
+        {
+            postBody.append(static_cast<char>('a'+i%26));
+        }
+        postBody.append("\r\n--").append(boundary).append("--\r\n");
+        postHeader="POST /upload HTTP/1.1\r\nHost: localhost\r\n"
+                   "Content-Type: multipart/form-data; boundary="+QByteArray(boundary)+"\r\n"
+                   "Content-Length: "+QByteArray::number(postBody.size())+"\r\n\r\n";
+    }
+}
+
+QString Scenario::getName() const
+{
+    return names[type];
+}
+
+void Scenario::appendRequest(QByteArray& buffer, const quint64 sequence) const
+{
+    switch (type)
+    {
+        case StaticHit:
+        case StaticMiss:
+            buffer.append(type==StaticHit ? "GET /static/file" : "GET /nocache/file");
+            buffer.append(QByteArray::number(sequence % fileCount));
+            buffer.append(".html HTTP/1.1\r\nHost: localhost\r\n\r\n");
+            break;
+        case TemplatePage:
+            buffer.append("GET /template?page=");
+            buffer.append(QByteArray::number(sequence % 100));
+            buffer.append(" HTTP/1.1\r\nHost: localhost\r\nAccept-Language: en\r\n\r\n");
+            break;
+        case FormPost:
+        case Upload:
+            buffer.append(postHeader);
+            buffer.append(postBody);
+            break;
+        case SessionChurn:
+            buffer.append(sequence%2 ? "GET /session?end=1" : "GET /session");
+            buffer.append(" HTTP/1.1\r\nHost: localhost\r\n\r\n");
+            break;
+        case AsyncPage:
+            buffer.append("GET /async HTTP/1.1\r\nHost: localhost\r\n\r\n");
+            break;
+    }
+}
+
+QStringList Scenario::allNames()
+{
+    QStringList list;
+    for (const char* name : names)
+    {
+        list.append(name);
+    }
+#ifndef QTWEBAPP_COROUTINES
+    // The last scenario needs the AsyncRequestHandler
+    list.removeLast();
+#endif
+    return list;
+}
+
+bool Scenario::fromName(const QString& name, Type& type)
+{
+    int index=allNames().indexOf(name);
+    if (index<0)
+    {
+        return false;
+    }
+    type=static_cast<Type>(index);
+    return true;
+}
@@ -0,0 +1,83 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <QByteArray>
+#include <QStringList>
+#include <QString>
+
+/**
+  Generates the HTTP requests of one benchmark scenario.
+  The request bodies are prepared by the constructor, so that generating
+  a request costs only a few appends.
+*/
+
+class Scenario {
+public:
+
+    /** The available scenarios */
+    enum Type {
+        /** GET of small files that are in the cache of the StaticFileController */
+        StaticHit,
+        /** GET of small files that are always read from disk */
+        StaticMiss,
+        /** GET of a page that is rendered from a cached template */
+        TemplatePage,
+        /** POST of an urlencoded form */
+        FormPost,
+        /** POST of a multipart form with one file */
+        Upload,
+        /** GET that creates a new session, every second request removes it again */
+        SessionChurn,
+        /** GET of a small response that is written by a coroutine */
+        AsyncPage
+    };
+
+    /**
+      Constructor.
+      @param type Type of the scenario
+      @param fileCount Number of different static files
+      @param uploadSize Size of the uploaded file in bytes
+    */
+    Scenario(const Type type, const int fileCount, const int uploadSize);
+
+    /** Name of the scenario as used on the command line and in the results */
+    QString getName() const;
+
+    /**
+      Append a request to the buffer.
+      This method is thread safe.
+      @param buffer Receives the request
+      @param sequence Number of the request, selects the file or variant
+    */
+    void appendRequest(QByteArray& buffer, const quint64 sequence) const;
+
+    /** Names of all scenarios, "async" only if the server supports coroutines */
+    static QStringList allNames();
+
+    /**
+      Get the type of a scenario by its name.
+      @return false if there is no such scenario
+    */
+    static bool fromName(const QString& name, Type& type);
+
+private:
+
+    /** Type of the scenario */
+    Type type;
+
+    /** Number of different static files */
+    int fileCount;
+
+    /** Request line and headers of POST requests */
+    QByteArray postHeader;
+
+    /** Body of POST requests */
+    QByteArray postBody;
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,29 @@
+# Component benchmarks of the hot paths of the library: request parser,
+# cookies, url decoding, templates, log messages and the session store.
+# Linux only, because allocations are counted by wrapping the glibc malloc.
+
+TARGET = Microbenchmark
+TEMPLATE = app
+QT = core network
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+HEADERS += \
+           src/allocationcounter.h \
+           src/memorysocket.h \
+           src/microbenchmark.h
+
+SOURCES += src/main.cpp \
+           src/allocationcounter.cpp \
+           src/memorysocket.cpp \
+           src/microbenchmark.cpp
+
+OTHER_FILES += ../readme.txt
+
+#---------------------------------------------------------------------------------------
+# The following lines include the sources of the QtWebAppLib library
+#---------------------------------------------------------------------------------------
+
+include(../QtWebApp/logging/logging.pri)
+include(../QtWebApp/httpserver/httpserver.pri)
+include(../QtWebApp/templateengine/templateengine.pri)
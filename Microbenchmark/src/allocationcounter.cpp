@@ -0,0 +1,73 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "allocationcounter.h"
+#include <cerrno>
+#include <cstddef>
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+/** Allocations of the current thread, initialized statically so that malloc() can use it anytime */
+thread_local quint64 allocations=0;
+
+}
+
+quint64 AllocationCounter::count()
+{
+    return allocations;
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    ++allocations;
+    return __libc_calloc(count,size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    ++allocations;
+    return __libc_realloc(pointer,size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    ++allocations;
+    return __libc_memalign(alignment,size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    ++allocations;
+    return __libc_memalign(alignment,size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    ++allocations;
+    void* result=__libc_memalign(alignment,size);
+    if (!result)
+    {
+        return ENOMEM;
+    }
+    *pointer=result;
+    return 0;
+}
+
+}
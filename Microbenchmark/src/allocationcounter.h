@@ -0,0 +1,25 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+  Counts the memory allocations of the current thread. The program replaces
+  malloc(), calloc(), realloc() and the aligned variants by wrappers around
+  the glibc functions, so allocations of Qt containers are counted as well
+  as those of operator new.
+*/
+
+class AllocationCounter {
+public:
+
+    /** Number of allocations of the current thread since it started */
+    static quint64 count();
+};
+
+#endif // ALLOCATIONCOUNTER_H
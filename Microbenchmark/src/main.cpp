@@ -0,0 +1,236 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QRegularExpression>
+#include <algorithm>
+#include <vector>
+#include "httpcookie.h"
+#include "httprequest.h"
+#include "httpsessionstore.h"
+#include "logmessage.h"
+#include "template.h"
+#include "memorysocket.h"
+#include "microbenchmark.h"
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Typical GET request of a browser */
+const char* const getRequest=
+        "GET /shop/list?category=books&page=2&sort=price%20asc HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:102.0) Gecko/20100101 Firefox/102.0\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: de,en-US;q=0.7,en;q=0.3\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Connection: keep-alive\r\n"
+        "Cookie: sessionid=4f8e2a1b9c3d4e5f6a7b8c9d0e1f2a3b; theme=dark; lang=de\r\n"
+        "\r\n";
+
+/** Session store that allows to insert prepared sessions */
+class BenchmarkSessionStore : public HttpSessionStore {
+public:
+    BenchmarkSessionStore(const QSettings* settings) : HttpSessionStore(settings) {}
+
+    /** Insert a new session and return its ID */
+    QByteArray insert()
+    {
+        HttpSession session(true);
+        sessions.insert(session.getId(),session);
+        return session.getId();
+    }
+};
+
+/** Parse a request from memory, returns the final status */
+HttpRequest::RequestStatus parse(const QSettings* settings, MemorySocket& socket, const QByteArray& data)
+{
+    static const HeadersHandler headersHandler;
+    HttpRequest request(settings,headersHandler);
+    socket.setData(data);
+    while (socket.bytesAvailable()>0 && request.getStatus()!=HttpRequest::complete
+           && request.getStatus()!=HttpRequest::abort && request.getStatus()!=HttpRequest::wrongHeaders)
+    {
+        request.readFromSocket(&socket);
+    }
+    return request.getStatus();
+}
+
+void requestBenchmarks(Microbenchmark& benchmark, const QSettings* settings)
+{
+    MemorySocket socket;
+    const QByteArray get(getRequest);
+    benchmark.run("request/parse-get",[&] { parse(settings,socket,get); });
+
+    QByteArray body;
+    for (int i=0; i<20; i++)
+    {
+        body.append(i>0 ? "&" : "").append("field").append(QByteArray::number(i)).append("=value+number+%C3%A4");
+    }
+    const QByteArray post="POST /form HTTP/1.1\r\nHost: localhost\r\n"
+                          "Content-Type: application/x-www-form-urlencoded\r\n"
+                          "Content-Length: "+QByteArray::number(body.size())+"\r\n\r\n"+body;
+    benchmark.run("request/parse-post-form",[&] { parse(settings,socket,post); });
+
+    const QByteArray encoded("/path/with%20spaces/and+plus/%C3%A4%C3%B6%C3%BC?x=%2F%3F%26");
+    benchmark.run("request/url-decode",[&] { HttpRequest::urlDecode(encoded); });
+    const QByteArray plain("/path/without/any/escaped/characters/index.html");
+    benchmark.run("request/url-decode-plain",[&] { HttpRequest::urlDecode(plain); });
+}
+
+void cookieBenchmarks(Microbenchmark& benchmark)
+{
+    const QByteArray header("sessionid=4f8e2a1b9c3d4e5f; Max-Age=3600; Path=/; Domain=example.com; "
+                            "Comment=\"session, do not share\"; HttpOnly; SameSite=Lax");
+    benchmark.run("cookie/split-csv",[&] { HttpCookie::splitCSV(header); });
+    benchmark.run("cookie/parse",[&] { HttpCookie cookie(header); });
+    const HttpCookie cookie("sessionid","4f8e2a1b9c3d4e5f",3600,"/","session","example.com",false,true);
+    benchmark.run("cookie/to-byte-array",[&] { cookie.toByteArray(); });
+}
+
+void templateBenchmarks(Microbenchmark& benchmark)
+{
+    for (int count : {10,100})
+    {
+        QString source("<html><body>\n");
+        for (int i=0; i<count; i++)
+        {
+            source.append("<p>{var").append(QString::number(i)).append("}</p>\n");
+        }
+        source.append("</body></html>\n");
+        const QString name="template/variables-"+QString::number(count);
+        benchmark.run(name,[&]
+        {
+            Template t(source,"benchmark");
+            for (int i=0; i<count; i++)
+            {
+                t.setVariable("var"+QString::number(i),"value");
+            }
+        });
+    }
+
+    const QString source("<table>\n{loop row}<tr><td>{row.id}</td><td>{row.name}</td><td>{row.price}</td></tr>\n{end row}</table>\n");
+    QVariantList rows;
+    for (int i=0; i<100; i++)
+    {
+        QVariantMap row;
+        row.insert("id",i);
+        row.insert("name","Product "+QString::number(i));
+        row.insert("price",QString::number(i*1.5,'f',2));
+        rows.append(row);
+    }
+    benchmark.run("template/loop-100",[&]
+    {
+        Template t(source,"benchmark");
+        t.loop("row",rows);
+    });
+}
+
+void loggingBenchmarks(Microbenchmark& benchmark)
+{
+    QHash<QString,QString> logVars;
+    logVars.insert("traceId","4bf92f3577b34da6a3ce929d0e0e4736");
+    const QString message("Request GET /shop/list completed with status 200");
+    const QString format("{timestamp} {typeNr} {type} {thread} {msg}\n  in {file} line {line} function {function}");
+    const QString timestampFormat("dd.MM.yyyy hh:mm:ss.zzz");
+    benchmark.run("logging/format",[&]
+    {
+        LogMessage logMessage(QtWarningMsg,message,&logVars,"main.cpp","main",123);
+        logMessage.toString(format,timestampFormat);
+    });
+}
+
+void sessionBenchmarks(Microbenchmark& benchmark, const QSettings* settings)
+{
+    BenchmarkSessionStore store(settings);
+    std::vector<QByteArray> ids;
+    for (int i=0; i<1000; i++)
+    {
+        ids.push_back(store.insert());
+    }
+    QList<int> threadCounts={1,4,QThread::idealThreadCount()};
+    std::sort(threadCounts.begin(),threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(),threadCounts.end()),threadCounts.end());
+    for (int threads : threadCounts)
+    {
+        benchmark.runParallel("sessions/get-set-"+QString::number(threads)+"-threads",threads,[&](int t)
+        {
+            // Each thread walks through all sessions with a different offset
+            static thread_local size_t next=0;
+            size_t i=(next++ + t*131) % ids.size();
+            HttpSession session=store.getSession(ids[i]);
+            session.set("counter",static_cast<qulonglong>(i));
+        });
+    }
+}
+
+}
+
+/**
+  Entry point of the program.
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc,argv);
+    app.setApplicationName("Microbenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Component benchmarks of the QtWebApp library. "
+                                     "Prints the results as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption filterOption("filter","Run only the benchmarks whose names match this regular expression.","regexp",".*");
+    QCommandLineOption minTimeOption("min-time","Minimum measured seconds per benchmark.","seconds","0.5");
+    QCommandLineOption outputOption("output","Write the results into this file instead of stdout.","file");
+    parser.addOptions({filterOption,minTimeOption,outputOption});
+    parser.process(app);
+
+    QRegularExpression filter(parser.value(filterOption));
+    if (!filter.isValid())
+    {
+        qCritical("Invalid filter: %s",qPrintable(filter.errorString()));
+        return 1;
+    }
+
+    // The debug messages of the library would dominate the results
+    QLoggingCategory::setFilterRules("qtwebapp.*.debug=false");
+
+    // All settings have their default values
+    QTemporaryDir dir;
+    QSettings settings(dir.path()+"/Microbenchmark.ini",QSettings::IniFormat);
+
+    Microbenchmark benchmark(filter,parser.value(minTimeOption).toDouble());
+    requestBenchmarks(benchmark,&settings);
+    cookieBenchmarks(benchmark);
+    templateBenchmarks(benchmark);
+    loggingBenchmarks(benchmark);
+    sessionBenchmarks(benchmark,&settings);
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            qCritical("Cannot write %s",qPrintable(file.fileName()));
+            return 1;
+        }
+        file.write(benchmark.toJson());
+    }
+    else
+    {
+        QTextStream out(stdout);
+        out << benchmark.toJson();
+    }
+    return 0;
+}
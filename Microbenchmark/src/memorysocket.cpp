@@ -0,0 +1,53 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "memorysocket.h"
+#include <cstring>
+
+MemorySocket::MemorySocket()
+{
+    position=0;
+    // Unbuffered, so that all reads go through readData() and readLineData()
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+void MemorySocket::setData(const QByteArray& data)
+{
+    buffer=data;
+    position=0;
+}
+
+qint64 MemorySocket::bytesAvailable() const
+{
+    return buffer.size()-position;
+}
+
+qint64 MemorySocket::readData(char* data, qint64 maxSize)
+{
+    qint64 n=qMin(maxSize,buffer.size()-position);
+    memcpy(data,buffer.constData()+position,n);
+    position+=n;
+    return n;
+}
+
+qint64 MemorySocket::readLineData(char* data, qint64 maxSize)
+{
+    qint64 n=qMin(maxSize,buffer.size()-position);
+    const char* start=buffer.constData()+position;
+    const void* lineEnd=memchr(start,'\n',n);
+    if (lineEnd)
+    {
+        n=static_cast<const char*>(lineEnd)-start+1;
+    }
+    memcpy(data,start,n);
+    position+=n;
+    return n;
+}
+
+qint64 MemorySocket::writeData(const char* data, qint64 size)
+{
+    Q_UNUSED(data)
+    return size;
+}
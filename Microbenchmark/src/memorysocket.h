@@ -0,0 +1,51 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef MEMORYSOCKET_H
+#define MEMORYSOCKET_H
+
+#include <QByteArray>
+#include <QTcpSocket>
+
+/**
+  TCP socket that delivers data from memory instead of a network connection,
+  so that the HttpRequest parser can be measured without the network stack.
+  Written data is discarded.
+*/
+
+class MemorySocket : public QTcpSocket {
+    Q_OBJECT
+public:
+
+    /** Constructor */
+    MemorySocket();
+
+    /**
+      Set the data that will be read next.
+      The data is implicitly shared, so this does not copy it.
+    */
+    void setData(const QByteArray& data);
+
+    /** Number of unread bytes */
+    qint64 bytesAvailable() const override;
+
+protected:
+
+    qint64 readData(char* data, qint64 maxSize) override;
+
+    qint64 readLineData(char* data, qint64 maxSize) override;
+
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+
+    /** Data to read */
+    QByteArray buffer;
+
+    /** Read position in the buffer */
+    qint64 position;
+};
+
+#endif // MEMORYSOCKET_H
@@ -0,0 +1,177 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "microbenchmark.h"
+#include "allocationcounter.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Time of the steady clock in nsec */
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Minimum duration of a batch in nsec */
+const qint64 batchTime=10000000;
+
+}
+
+Microbenchmark::Microbenchmark(const QRegularExpression& filter, const double minSeconds)
+{
+    this->filter=filter;
+    this->minTime=static_cast<qint64>(minSeconds*1e9);
+}
+
+quint64 Microbenchmark::calibrate(const std::function<void()>& operation) const
+{
+    quint64 batch=1;
+    while (true)
+    {
+        qint64 start=now();
+        for (quint64 i=0; i<batch; i++)
+        {
+            operation();
+        }
+        if (now()-start>=batchTime || batch>=(Q_UINT64_C(1)<<40))
+        {
+            return batch;
+        }
+        batch*=2;
+    }
+}
+
+void Microbenchmark::run(const QString& name, const std::function<void()>& operation)
+{
+    if (!filter.match(name).hasMatch())
+    {
+        return;
+    }
+    // Calibration also warms up caches and lazily allocated buffers
+    const quint64 batch=calibrate(operation);
+
+    quint64 operations=0;
+    quint64 allocations=AllocationCounter::count();
+    qint64 start=now();
+    qint64 elapsed=0;
+    while (elapsed<minTime)
+    {
+        for (quint64 i=0; i<batch; i++)
+        {
+            operation();
+        }
+        operations+=batch;
+        elapsed=now()-start;
+    }
+    allocations=AllocationCounter::count()-allocations;
+
+    MicrobenchmarkResult result;
+    result.name=name;
+    result.operations=operations;
+    result.nsPerOperation=static_cast<double>(elapsed)/operations;
+    result.operationsPerSecond=operations*1e9/elapsed;
+    result.allocationsPerOperation=static_cast<double>(allocations)/operations;
+    results.append(result);
+}
+
+void Microbenchmark::runParallel(const QString& name, const int threads, const std::function<void(int)>& operation)
+{
+    if (!filter.match(name).hasMatch())
+    {
+        return;
+    }
+    const quint64 batch=calibrate([&operation] { operation(0); });
+
+    // All threads start together and stop after the same time
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+    std::vector<quint64> operations(threads,0);
+    std::vector<quint64> allocations(threads,0);
+    std::vector<std::thread> workers;
+    for (int t=0; t<threads; t++)
+    {
+        workers.emplace_back([&,t]
+        {
+            ready++;
+            while (!go) { std::this_thread::yield(); }
+            quint64 startAllocations=AllocationCounter::count();
+            while (!stop)
+            {
+                for (quint64 i=0; i<batch/threads+1; i++)
+                {
+                    operation(t);
+                }
+                operations[t]+=batch/threads+1;
+            }
+            allocations[t]=AllocationCounter::count()-startAllocations;
+        });
+    }
+    while (ready<threads) { std::this_thread::yield(); }
+    qint64 start=now();
+    go=true;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(minTime));
+    stop=true;
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    qint64 elapsed=now()-start;
+
+    MicrobenchmarkResult result;
+    result.name=name;
+    result.threads=threads;
+    quint64 totalAllocations=0;
+    for (int t=0; t<threads; t++)
+    {
+        result.operations+=operations[t];
+        totalAllocations+=allocations[t];
+    }
+    result.nsPerOperation=static_cast<double>(elapsed)*threads/result.operations;
+    result.operationsPerSecond=result.operations*1e9/elapsed;
+    result.allocationsPerOperation=static_cast<double>(totalAllocations)/result.operations;
+    results.append(result);
+}
+
+const QList<MicrobenchmarkResult>& Microbenchmark::getResults() const
+{
+    return results;
+}
+
+QByteArray Microbenchmark::toJson() const
+{
+    QJsonArray list;
+    for (const MicrobenchmarkResult& result : results)
+    {
+        QJsonObject object;
+        object.insert("name",result.name);
+        object.insert("operations",static_cast<double>(result.operations));
+        object.insert("threads",result.threads);
+        object.insert("nsPerOperation",result.nsPerOperation);
+        object.insert("operationsPerSecond",result.operationsPerSecond);
+        object.insert("allocationsPerOperation",result.allocationsPerOperation);
+        list.append(object);
+    }
+    QJsonObject root;
+    root.insert("qtVersion",QString(qVersion()));
+    root.insert("cpuArchitecture",QSysInfo::currentCpuArchitecture());
+    root.insert("kernel",QSysInfo::kernelVersion());
+#ifdef QT_DEBUG
+    root.insert("build",QString("debug"));
+#else
+    root.insert("build",QString("release"));
+#endif
+    root.insert("benchmarks",list);
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
@@ -0,0 +1,83 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef MICROBENCHMARK_H
+#define MICROBENCHMARK_H
+
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <functional>
+
+/** Result of one benchmark */
+struct MicrobenchmarkResult {
+    /** Name of the benchmark */
+    QString name;
+    /** Number of operations */
+    quint64 operations=0;
+    /** Number of threads that executed the operations */
+    int threads=1;
+    /** Average wall time per operation in nsec */
+    double nsPerOperation=0;
+    /** Operations per second, of all threads together */
+    double operationsPerSecond=0;
+    /** Average number of memory allocations per operation */
+    double allocationsPerOperation=0;
+};
+
+/**
+  Runs component benchmarks and collects their results. The operation of a
+  benchmark is first executed in growing batches until one batch takes at
+  least 10ms, then batches of that size are repeated until the minimum time
+  has elapsed.
+*/
+
+class Microbenchmark {
+public:
+
+    /**
+      Constructor.
+      @param filter Only benchmarks whose names match this expression are executed
+      @param minSeconds Minimum measured time of each benchmark
+    */
+    Microbenchmark(const QRegularExpression& filter, const double minSeconds);
+
+    /**
+      Measure an operation in the current thread.
+      @param name Name of the benchmark
+      @param operation The operation, called repeatedly
+    */
+    void run(const QString& name, const std::function<void()>& operation);
+
+    /**
+      Measure an operation that is executed by several threads simultaneously.
+      @param name Name of the benchmark
+      @param threads Number of threads
+      @param operation The operation, called repeatedly with the number of the thread
+    */
+    void runParallel(const QString& name, const int threads, const std::function<void(int)>& operation);
+
+    /** Results of the executed benchmarks */
+    const QList<MicrobenchmarkResult>& getResults() const;
+
+    /** All results as JSON document */
+    QByteArray toJson() const;
+
+private:
+
+    /** Only benchmarks whose names match this expression are executed */
+    QRegularExpression filter;
+
+    /** Minimum measured time of each benchmark in nsec */
+    qint64 minTime;
+
+    /** Results of the executed benchmarks */
+    QList<MicrobenchmarkResult> results;
+
+    /** Number of operations that take about 10ms */
+    quint64 calibrate(const std::function<void()>& operation) const;
+};
+
+#endif // MICROBENCHMARK_H
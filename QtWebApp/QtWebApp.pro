@@ -29,5 +29,6 @@ OTHER_FILES += ../readme.txt
 
 include(qtservice/qtservice.pri)
 include(logging/logging.pri)
+include(diagnostics/diagnostics.pri)
 include(httpserver/httpserver.pri)
 include(templateengine/templateengine.pri)
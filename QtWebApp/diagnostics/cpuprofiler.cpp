@@ -0,0 +1,229 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "cpuprofiler.h"
+#include <atomic>
+#include <thread>
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+    #define QTWEBAPP_CPU_PROFILER
+    #include <QHash>
+    #include <QMap>
+    #include <cxxabi.h>
+    #include <dlfcn.h>
+    #include <execinfo.h>
+    #include <pthread.h>
+    #include <signal.h>
+    #include <sys/prctl.h>
+    #include <sys/syscall.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <cstdlib>
+    #include <cstring>
+#endif
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Set while a profile runs */
+std::atomic<bool> running{false};
+
+#ifdef QTWEBAPP_CPU_PROFILER
+
+/** Maximum number of frames per sample */
+const int MAX_FRAMES=48;
+
+/** Maximum number of samples per profile */
+const int MAX_SAMPLES=16384;
+
+/** One recorded stack */
+struct Sample {
+    char threadName[16];
+    int count;
+    void* frames[MAX_FRAMES];
+    std::atomic<bool> complete;
+};
+
+/**
+  Storage for the samples. It is allocated once and never released, because
+  a signal that is already pending when the profile ends may still write into it.
+*/
+Sample* samples=nullptr;
+
+/** Index of the next free sample */
+std::atomic<int> nextSample{0};
+
+/** Runs in the interrupted thread and records its stack */
+void sampleHandler(int)
+{
+    int savedErrno=errno;
+    int index=nextSample.fetch_add(1,std::memory_order_relaxed);
+    if (index<MAX_SAMPLES)
+    {
+        Sample& sample=samples[index];
+        prctl(PR_GET_NAME,sample.threadName,0,0,0);
+        sample.count=backtrace(sample.frames,MAX_FRAMES);
+        sample.complete.store(true,std::memory_order_release);
+    }
+    errno=savedErrno;
+}
+
+/** Name of the function that contains an address */
+QByteArray symbolName(void* address)
+{
+    Dl_info info;
+    if (dladdr(address,&info)==0)
+    {
+        return "[unknown]";
+    }
+    if (info.dli_sname)
+    {
+        int status=0;
+        char* demangled=abi::__cxa_demangle(info.dli_sname,nullptr,nullptr,&status);
+        QByteArray name(status==0 && demangled ? demangled : info.dli_sname);
+        free(demangled);
+        return name;
+    }
+    const char* file=info.dli_fname ? strrchr(info.dli_fname,'/') : nullptr;
+    file=file ? file+1 : (info.dli_fname ? info.dli_fname : "?");
+    return QByteArray(file)+"+0x"+QByteArray::number(static_cast<qulonglong>(
+                reinterpret_cast<quintptr>(address)-reinterpret_cast<quintptr>(info.dli_fbase)),16);
+}
+
+#endif
+
+}
+
+bool CpuProfiler::isSupported()
+{
+#ifdef QTWEBAPP_CPU_PROFILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CpuProfiler::profile(const int milliseconds, const int frequency, const QByteArray& threadFilter,
+                          QByteArray& folded, QString& error)
+{
+#ifdef QTWEBAPP_CPU_PROFILER
+    if (frequency<1 || frequency>1000 || milliseconds<1)
+    {
+        error="Invalid duration or frequency";
+        return false;
+    }
+    bool expected=false;
+    if (!running.compare_exchange_strong(expected,true))
+    {
+        error="Another profile is running";
+        return false;
+    }
+    if (!samples)
+    {
+        samples=new Sample[MAX_SAMPLES];
+    }
+    for (int i=0; i<MAX_SAMPLES; i++)
+    {
+        samples[i].complete.store(false,std::memory_order_relaxed);
+    }
+    nextSample.store(0);
+
+    // The first call of backtrace() loads libgcc, which is not allowed in a signal handler
+    void* frames[1];
+    backtrace(frames,1);
+
+    struct sigaction action={};
+    struct sigaction previousAction;
+    action.sa_handler=sampleHandler;
+    action.sa_flags=SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF,&action,&previousAction);
+
+    // 1000000/frequency is a full second for frequency=1, which tv_usec must not hold
+    const long interval=1000000L/frequency;
+    struct itimerval timer={};
+    timer.it_interval.tv_sec=interval/1000000;
+    timer.it_interval.tv_usec=interval%1000000;
+    timer.it_value=timer.it_interval;
+    if (setitimer(ITIMER_PROF,&timer,nullptr)!=0)
+    {
+        error=QString("Cannot start the profiling timer: %1").arg(strerror(errno));
+        sigaction(SIGPROF,&previousAction,nullptr);
+        running.store(false);
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+
+    struct itimerval stop={};
+    setitimer(ITIMER_PROF,&stop,nullptr);
+    // Let handlers that are still running finish
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Discard signals that are still pending before restoring the previous disposition,
+    // because the default action of SIGPROF terminates the process
+    sigset_t profSignal;
+    sigemptyset(&profSignal);
+    sigaddset(&profSignal,SIGPROF);
+    sigset_t previousMask;
+    pthread_sigmask(SIG_BLOCK,&profSignal,&previousMask);
+    const struct timespec noWait={0,0};
+    while (sigtimedwait(&profSignal,nullptr,&noWait)==SIGPROF)
+    {
+    }
+    pthread_sigmask(SIG_SETMASK,&previousMask,nullptr);
+    sigaction(SIGPROF,&previousAction,nullptr);
+
+    // Aggregate the samples
+    const int recorded=qMin(nextSample.load(),MAX_SAMPLES);
+    QHash<void*,QByteArray> symbols;
+    QMap<QByteArray,int> stacks;
+    for (int i=0; i<recorded; i++)
+    {
+        const Sample& sample=samples[i];
+        if (!sample.complete.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+        QByteArray threadName(sample.threadName,static_cast<int>(strnlen(sample.threadName,sizeof(sample.threadName))));
+        if (!threadFilter.isEmpty() && !threadName.contains(threadFilter))
+        {
+            continue;
+        }
+        QByteArray stack=threadName;
+        // Skip the signal handler and the signal trampoline, the outermost frame comes first
+        for (int f=sample.count-1; f>=2; f--)
+        {
+            // Return addresses point behind the call, except for the interrupted instruction
+            void* address=(f==2) ? sample.frames[f] : static_cast<char*>(sample.frames[f])-1;
+            auto it=symbols.find(address);
+            if (it==symbols.end())
+            {
+                it=symbols.insert(address,symbolName(address));
+            }
+            stack.append(';').append(*it);
+        }
+        stacks[stack]++;
+    }
+    folded.clear();
+    for (auto it=stacks.constBegin(); it!=stacks.constEnd(); ++it)
+    {
+        folded.append(it.key()).append(' ').append(QByteArray::number(it.value())).append('\n');
+    }
+    if (nextSample.load()>MAX_SAMPLES)
+    {
+        error=QString("%1 samples have been discarded, reduce the duration or the frequency").arg(nextSample.load()-MAX_SAMPLES);
+    }
+    running.store(false);
+    return true;
+#else
+    Q_UNUSED(milliseconds)
+    Q_UNUSED(frequency)
+    Q_UNUSED(threadFilter)
+    Q_UNUSED(folded)
+    error="CPU profiling is not supported on this platform";
+    return false;
+#endif
+}
@@ -0,0 +1,61 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef CPUPROFILER_H
+#define CPUPROFILER_H
+
+#include <QByteArray>
+#include <QString>
+#include "diagnosticsglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Sampling CPU profiler that works without external tools. While a profile
+  runs, the timer ITIMER_PROF interrupts the thread that consumes CPU time
+  with the signal SIGPROF, and the signal handler records the stack and the
+  name of the thread. The sampling frequency refers to the CPU time of the
+  whole process, so busy threads get more samples than idle ones and
+  sleeping threads get none.
+  <p>
+  The result is a list of folded stacks, one line per distinct stack with the
+  number of samples, for example
+  <code><pre>
+  qwa-worker;start_thread;...;stefanfrings::Template::setVariable(...) 42
+  </pre></code>
+  which flamegraph.pl or speedscope turn into a flame graph. The first
+  element is the name of the thread, see setThreadName().
+  <p>
+  Only available on Linux with glibc. Function names are resolved from the
+  dynamic symbol table, so the program should be linked with -rdynamic;
+  otherwise functions of the executable appear as file name and offset.
+  The application must not use SIGPROF itself while a profile runs.
+  @see ProfilerController which provides profiles by HTTP
+*/
+
+class DECLSPEC CpuProfiler {
+public:
+
+    /** Whether profiling is supported on this platform */
+    static bool isSupported();
+
+    /**
+      Record a profile. Blocks the calling thread for the given duration.
+      Only one profile can run at a time.
+      This method is thread safe.
+      @param milliseconds Duration of the profile
+      @param frequency Samples per second of CPU time, 1-1000
+      @param threadFilter Only threads whose name contains this text are included, empty for all
+      @param folded Receives the folded stacks
+      @param error Receives the reason if the profile failed
+      @return false if the profile failed
+    */
+    static bool profile(const int milliseconds, const int frequency, const QByteArray& threadFilter,
+                        QByteArray& folded, QString& error);
+};
+
+} // end of namespace
+
+#endif // CPUPROFILER_H
@@ -0,0 +1,25 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef DEBUGOUTPUT_H
+#define DEBUGOUTPUT_H
+
+#include <QLoggingCategory>
+
+/**
+  Debug message of the library in a logging category, used like qCDebug().
+  Define QTWEBAPP_NO_DEBUG_OUTPUT to remove these messages completely at
+  compile time. The arguments are still compiled, so they cannot break
+  unnoticed, but never evaluated.
+*/
+#ifndef qwaDebug
+    #ifdef QTWEBAPP_NO_DEBUG_OUTPUT
+        #define qwaDebug(category, ...) while (false) qCDebug(category, __VA_ARGS__)
+    #else
+        #define qwaDebug(category, ...) qCDebug(category, __VA_ARGS__)
+    #endif
+#endif
+
+#endif // DEBUGOUTPUT_H
@@ -0,0 +1,15 @@
+# This module is included by the httpserver, the templateengine and the logging,
+# therefore it must not add its files twice.
+!contains(QTWEBAPP_MODULES, diagnostics) {
+    QTWEBAPP_MODULES += diagnostics
+
+    INCLUDEPATH += $$PWD
+    DEPENDPATH += $$PWD
+
+    HEADERS += $$PWD/diagnosticsglobal.h $$PWD/debugoutput.h $$PWD/metrics.h $$PWD/metricsregistry.h $$PWD/instrumentedmutex.h $$PWD/threadname.h $$PWD/cpuprofiler.h $$PWD/memorybudget.h
+
+    SOURCES += $$PWD/metrics.cpp $$PWD/metricsregistry.cpp $$PWD/instrumentedmutex.cpp $$PWD/threadname.cpp $$PWD/cpuprofiler.cpp $$PWD/memorybudget.cpp
+
+    # The CpuProfiler resolves function names with dladdr()
+    linux: LIBS += -ldl
+}
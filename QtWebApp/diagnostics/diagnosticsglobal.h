@@ -0,0 +1,24 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef DIAGNOSTICSGLOBAL_H
+#define DIAGNOSTICSGLOBAL_H
+
+#include <QtGlobal>
+
+// This is specific to Windows dll's
+#if defined(Q_OS_WIN)
+    #if defined(QTWEBAPPLIB_EXPORT)
+        #define DECLSPEC Q_DECL_EXPORT
+    #elif defined(QTWEBAPPLIB_IMPORT)
+        #define DECLSPEC Q_DECL_IMPORT
+    #endif
+#endif
+#if !defined(DECLSPEC)
+    #define DECLSPEC
+#endif
+
+#endif // DIAGNOSTICSGLOBAL_H
+
@@ -0,0 +1,178 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "instrumentedmutex.h"
+#include "metricsregistry.h"
+#include <chrono>
+#include <map>
+#include <string>
+
+using namespace stefanfrings;
+
+namespace stefanfrings {
+
+/** Statistics of all locks with the same name */
+struct LockStatistics {
+    Counter* acquisitions;
+    Counter* contended;
+    Histogram* waitTime;
+    Histogram* holdTime;
+};
+
+}
+
+namespace {
+
+#ifdef QTWEBAPP_LOCK_STATS
+std::atomic<bool> enabled{true};
+#else
+std::atomic<bool> enabled{qEnvironmentVariableIntValue("QTWEBAPP_LOCK_STATS")!=0};
+#endif
+
+/** Protects the map of statistics */
+std::mutex statisticsMutex;
+
+/** Statistics by name of the lock, never deleted because metrics live until the end of the program */
+std::map<std::string,LockStatistics*>& allStatistics()
+{
+    static std::map<std::string,LockStatistics*>* map=new std::map<std::string,LockStatistics*>();
+    return *map;
+}
+
+/** Time of the steady clock in nsec, never 0 */
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count() | 1;
+}
+
+}
+
+InstrumentedMutex::InstrumentedMutex(const char* name)
+    : lockName(name)
+{}
+
+const char* InstrumentedMutex::name() const
+{
+    return lockName;
+}
+
+LockStatistics* InstrumentedMutex::getStatistics()
+{
+    LockStatistics* result=statistics.load(std::memory_order_acquire);
+    if (result)
+    {
+        return result;
+    }
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        LockStatistics*& entry=allStatistics()[lockName];
+        if (!entry)
+        {
+            MetricsRegistry& registry=MetricsRegistry::instance();
+            QByteArray labels="lock=\""+QByteArray(lockName)+"\"";
+            entry=new LockStatistics();
+            entry->acquisitions=&registry.counter("qtwebapp_lock_acquisitions_total","Number of acquisitions of a lock",labels);
+            entry->contended=&registry.counter("qtwebapp_lock_contended_total","Number of acquisitions of a lock that had to wait",labels);
+            entry->waitTime=&registry.histogram("qtwebapp_lock_wait_seconds","Wait time of contended lock acquisitions",labels,1e-9);
+            entry->holdTime=&registry.histogram("qtwebapp_lock_hold_seconds","Time a lock was held",labels,1e-9);
+        }
+        result=entry;
+    }
+    statistics.store(result,std::memory_order_release);
+    return result;
+}
+
+void InstrumentedMutex::lock()
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        mutex.lock();
+        lockedAt=0;
+        return;
+    }
+    LockStatistics* stats=getStatistics();
+    stats->acquisitions->add();
+    if (!mutex.try_lock())
+    {
+        qint64 start=now();
+        mutex.lock();
+        lockedAt=now();
+        stats->contended->add();
+        stats->waitTime->record(lockedAt-start);
+    }
+    else
+    {
+        lockedAt=now();
+    }
+}
+
+bool InstrumentedMutex::try_lock()
+{
+    if (!mutex.try_lock())
+    {
+        return false;
+    }
+    if (enabled.load(std::memory_order_relaxed))
+    {
+        getStatistics()->acquisitions->add();
+        lockedAt=now();
+    }
+    else
+    {
+        lockedAt=0;
+    }
+    return true;
+}
+
+void InstrumentedMutex::unlock()
+{
+    // Read the time before unlocking, another thread overwrites it afterwards
+    const qint64 since=lockedAt;
+    if (since==0)
+    {
+        mutex.unlock();
+        return;
+    }
+    const qint64 holdTime=now()-since;
+    mutex.unlock();
+    // The statistics exist because the lock was measured
+    statistics.load(std::memory_order_acquire)->holdTime->record(holdTime);
+}
+
+void InstrumentedMutex::setEnabled(const bool enable)
+{
+    enabled.store(enable);
+}
+
+bool InstrumentedMutex::isEnabled()
+{
+    return enabled.load();
+}
+
+QByteArray InstrumentedMutex::report()
+{
+    QByteArray result;
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    for (const auto& item : allStatistics())
+    {
+        const LockStatistics* stats=item.second;
+        const qint64 acquisitions=stats->acquisitions->value();
+        const qint64 contended=stats->contended->value();
+        const HistogramSnapshot wait=stats->waitTime->snapshot();
+        const HistogramSnapshot hold=stats->holdTime->snapshot();
+        result.append(QByteArray(item.first.c_str()).leftJustified(24,' '));
+        result.append(" acquisitions=").append(QByteArray::number(acquisitions));
+        result.append(" contended=").append(QByteArray::number(contended));
+        result.append(" (").append(QByteArray::number(acquisitions>0 ? 100.0*contended/acquisitions : 0.0,'f',2)).append("%)");
+        result.append(" wait_us p50=").append(QByteArray::number(wait.percentile(50)/1000.0,'f',1));
+        result.append(" p99=").append(QByteArray::number(wait.percentile(99)/1000.0,'f',1));
+        result.append(" total=").append(QByteArray::number(wait.sum/1000.0,'f',0));
+        result.append(" hold_us p50=").append(QByteArray::number(hold.percentile(50)/1000.0,'f',1));
+        result.append(" p99=").append(QByteArray::number(hold.percentile(99)/1000.0,'f',1));
+        result.append("\n");
+    }
+    return result;
+}
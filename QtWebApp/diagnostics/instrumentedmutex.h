@@ -0,0 +1,105 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef INSTRUMENTEDMUTEX_H
+#define INSTRUMENTEDMUTEX_H
+
+#include <QByteArray>
+#include <atomic>
+#include <mutex>
+#include "diagnosticsglobal.h"
+
+namespace stefanfrings {
+
+struct LockStatistics;
+
+/**
+  Mutex that measures how it is used. The library uses it for its global
+  locks, so that contention can be found without a profiler.
+  <p>
+  When the statistics are enabled, each lock records the number of
+  acquisitions, the number of acquisitions that had to wait, the wait time
+  of those and the hold time of all acquisitions. Locks with equal names share
+  their statistics. They are published in the MetricsRegistry as
+  <code><pre>
+  qtwebapp_lock_acquisitions_total{lock="session_store"}
+  qtwebapp_lock_contended_total{lock="session_store"}
+  qtwebapp_lock_wait_seconds{lock="session_store"}
+  qtwebapp_lock_hold_seconds{lock="session_store"}
+  </pre></code>
+  and report() returns a human readable summary.
+  <p>
+  The statistics are disabled by default and cost one atomic load per lock
+  operation then. They get enabled by setEnabled(), by the environment
+  variable QTWEBAPP_LOCK_STATS=1 or at build time by defining QTWEBAPP_LOCK_STATS.
+  Measuring costs two reads of the clock per acquisition.
+  <p>
+  The class satisfies the Lockable requirements, so it works with
+  std::lock_guard and std::unique_lock. It is not recursive. QMutexLocker
+  of Qt 5 accepts only a QMutex, use std::lock_guard instead.
+*/
+
+class DECLSPEC InstrumentedMutex {
+    Q_DISABLE_COPY(InstrumentedMutex)
+public:
+
+    /**
+      Constructor.
+      @param name Name of the lock in the statistics, must be a valid Prometheus label value
+    */
+    explicit InstrumentedMutex(const char* name);
+
+    /** Wait until the mutex is available and lock it */
+    void lock();
+
+    /** Lock the mutex if it is available, without waiting */
+    bool try_lock();
+
+    /** Same as try_lock(), for code that was written for QMutex */
+    bool tryLock() { return try_lock(); }
+
+    /** Unlock the mutex */
+    void unlock();
+
+    /** Name of the lock */
+    const char* name() const;
+
+    /**
+      Enable or disable the statistics of all locks.
+      Each acquisition is measured according to the setting at the time it happens.
+    */
+    static void setEnabled(const bool enable);
+
+    /** Whether the statistics are enabled */
+    static bool isEnabled();
+
+    /**
+      Summary of the statistics of all locks, one line per lock with
+      the number of acquisitions, the contended ratio and percentiles of the
+      wait and hold times.
+    */
+    static QByteArray report();
+
+private:
+
+    /** The mutex */
+    std::mutex mutex;
+
+    /** Name of the lock */
+    const char* lockName;
+
+    /** Statistics of the lock, created when the lock is used while enabled */
+    std::atomic<LockStatistics*> statistics{nullptr};
+
+    /** Time when the lock was acquired in nsec, 0 if not measured */
+    qint64 lockedAt=0;
+
+    /** Get or create the statistics */
+    LockStatistics* getStatistics();
+};
+
+} // end of namespace
+
+#endif // INSTRUMENTEDMUTEX_H
@@ -0,0 +1,151 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "memorybudget.h"
+#include "metricsregistry.h"
+#include <chrono>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Smallest factor of the cache sizes */
+const double MIN_CACHE_FACTOR=1.0/16;
+
+/** Minimum time between two adjustments in msec */
+const qint64 ADJUSTMENT_INTERVAL=1000;
+
+/** Time of the steady clock in msec */
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+MemoryBudget& MemoryBudget::instance()
+{
+    // Never deleted, because connections and caches may release memory during shutdown
+    static MemoryBudget* budget=new MemoryBudget();
+    return *budget;
+}
+
+MemoryBudget::MemoryBudget()
+{
+    for (std::atomic<qint64>& value : usage)
+    {
+        value.store(0);
+    }
+    MetricsRegistry& metrics=MetricsRegistry::instance();
+    metrics.addCallback("qtwebapp_memory_budget_bytes","Limit of the memory budget, 0 if unlimited",[this]
+    {
+        return static_cast<double>(getLimit());
+    });
+    const char* const names[CATEGORIES]={"request_bodies","response_output","caches"};
+    for (int i=0; i<CATEGORIES; i++)
+    {
+        metrics.addCallback("qtwebapp_memory_budget_used_bytes","Memory accounted by the memory budget",[this,i]
+        {
+            return static_cast<double>(getUsage(static_cast<Category>(i)));
+        },"category=\""+QByteArray(names[i])+"\"");
+    }
+    metrics.addCallback("qtwebapp_memory_budget_cache_factor","Factor of the configured cache sizes under memory pressure",[this]
+    {
+        return getCacheFactor();
+    });
+}
+
+void MemoryBudget::setLimit(const qint64 bytes)
+{
+    limit.store(qMax(Q_INT64_C(0),bytes));
+}
+
+qint64 MemoryBudget::getLimit() const
+{
+    return limit.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::add(const Category category, const qint64 bytes)
+{
+    usage[category].fetch_add(bytes,std::memory_order_relaxed);
+}
+
+qint64 MemoryBudget::getUsage(const Category category) const
+{
+    return usage[category].load(std::memory_order_relaxed);
+}
+
+qint64 MemoryBudget::getUsage() const
+{
+    qint64 sum=0;
+    for (const std::atomic<qint64>& value : usage)
+    {
+        sum+=value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+bool MemoryBudget::isExceeded() const
+{
+    const qint64 max=getLimit();
+    return max>0 && getUsage()>max;
+}
+
+double MemoryBudget::getCacheFactor() const
+{
+    return cacheFactor.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::adjust()
+{
+    const qint64 max=getLimit();
+    const double factor=getCacheFactor();
+    const qint64 used=getUsage();
+    const bool shrink=max>0 && used>max && factor>MIN_CACHE_FACTOR;
+    const bool grow=factor<1.0 && (max==0 || used<max*3/4);
+    if (!shrink && !grow)
+    {
+        return;
+    }
+    const qint64 time=now();
+    if (time-lastAdjustment.load(std::memory_order_relaxed)<ADJUSTMENT_INTERVAL)
+    {
+        return;
+    }
+    // Another thread is already adjusting
+    std::unique_lock<std::mutex> lock(mutex,std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+    lastAdjustment.store(time);
+    const double newFactor=shrink ? qMax(MIN_CACHE_FACTOR,factor/2) : qMin(1.0,factor*2);
+    cacheFactor.store(newFactor);
+    for (const Cache& cache : caches)
+    {
+        cache.resize(newFactor);
+    }
+}
+
+int MemoryBudget::addCache(std::function<void(double)> resize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    caches.append(Cache{++lastId,std::move(resize)});
+    return lastId;
+}
+
+void MemoryBudget::removeCache(const int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i=0; i<caches.size(); i++)
+    {
+        if (caches[i].id==id)
+        {
+            caches.removeAt(i);
+            return;
+        }
+    }
+}
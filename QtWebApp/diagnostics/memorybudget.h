@@ -0,0 +1,139 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QList>
+#include <QtGlobal>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include "diagnosticsglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Process wide accounting of the memory that the library buffers: request
+  bodies, response data that waits in the socket buffers and the contents of
+  the caches. The total is compared against a configurable limit.
+  <p>
+  While the limit is exceeded, the HTTP server rejects new requests with
+  large bodies with status 503 and a Retry-After header, and the caches
+  shrink: each adjustment halves their maximum size, down to 1/16 of the
+  configured size. When the usage falls below 75% of the limit, the caches
+  grow back step by step. Adjustments happen at most once per second.
+  <p>
+  Accounting is lock-free. The limit is 0 (unlimited) by default, then the
+  usage is still recorded but nothing is rejected or shrunk.
+  The values are published as the metrics qtwebapp_memory_budget_bytes,
+  qtwebapp_memory_budget_used_bytes and qtwebapp_memory_budget_cache_factor.
+  @see HttpMemory for the configuration
+*/
+
+class DECLSPEC MemoryBudget {
+    Q_DISABLE_COPY(MemoryBudget)
+public:
+
+    /** Kinds of accounted memory */
+    enum Category {
+        /** Bodies of requests that are being received or processed */
+        RequestBodies,
+        /** Response data in the socket buffers */
+        ResponseOutput,
+        /** Contents of the caches */
+        Caches,
+        /** Number of categories */
+        CATEGORIES
+    };
+
+    /** Get the process wide instance */
+    static MemoryBudget& instance();
+
+    /** Set the limit in bytes, 0=unlimited. This method is thread safe. */
+    void setLimit(const qint64 bytes);
+
+    /** The limit in bytes, 0=unlimited */
+    qint64 getLimit() const;
+
+    /**
+      Account memory.
+      This method is thread safe and lock-free.
+      @param category Kind of memory
+      @param bytes Number of bytes, negative when memory gets released
+    */
+    void add(const Category category, const qint64 bytes);
+
+    /** Accounted bytes of a category */
+    qint64 getUsage(const Category category) const;
+
+    /** Accounted bytes of all categories */
+    qint64 getUsage() const;
+
+    /** Whether a limit is set and the usage exceeds it */
+    bool isExceeded() const;
+
+    /**
+      Shrink or regrow the caches according to the current usage. Called
+      by the HTTP server for each request, does nothing most of the time.
+      This method is thread safe.
+    */
+    void adjust();
+
+    /**
+      Register a cache that shrinks under memory pressure.
+      This method is thread safe.
+      @param resize Called with a factor between 1/16 and 1, the cache shall limit its
+      size to the configured size multiplied by the factor. May be called from any thread,
+      but never while the caller of add() holds a lock.
+      @return ID for removeCache()
+    */
+    int addCache(std::function<void(double)> resize);
+
+    /**
+      Remove a cache. After return, its function will not be called anymore.
+      This method is thread safe.
+    */
+    void removeCache(const int id);
+
+    /** Current factor of the cache sizes */
+    double getCacheFactor() const;
+
+private:
+
+    /** Constructor */
+    MemoryBudget();
+
+    /** A registered cache */
+    struct Cache {
+        int id;
+        std::function<void(double)> resize;
+    };
+
+    /** Limit in bytes, 0=unlimited */
+    std::atomic<qint64> limit{0};
+
+    /** Usage per category */
+    std::atomic<qint64> usage[CATEGORIES];
+
+    /** Current factor of the cache sizes */
+    std::atomic<double> cacheFactor{1.0};
+
+    /** Time of the last adjustment in msec of the steady clock */
+    std::atomic<qint64> lastAdjustment{0};
+
+    /** Registered caches */
+    QList<Cache> caches;
+
+    /** Last ID of a cache */
+    int lastId=0;
+
+    /** Protects the caches and serializes adjustments */
+    std::mutex mutex;
+};
+
+} // end of namespace
+
+#endif // MEMORYBUDGET_H
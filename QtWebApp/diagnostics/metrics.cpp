@@ -0,0 +1,119 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "metrics.h"
+#include <QtAlgorithms>
+#include <cmath>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Next stripe to assign to a new thread */
+std::atomic<int> nextStripe{0};
+
+/** Stripe of the current thread */
+int currentStripe()
+{
+    static thread_local int stripe=nextStripe.fetch_add(1,std::memory_order_relaxed) % METRICS_STRIPES;
+    return stripe;
+}
+
+}
+
+void Counter::add(const qint64 amount)
+{
+    cells[currentStripe()].value.fetch_add(amount,std::memory_order_relaxed);
+}
+
+qint64 Counter::value() const
+{
+    qint64 sum=0;
+    for (const Cell& cell : cells)
+    {
+        sum+=cell.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Gauge::set(const qint64 value)
+{
+    current.store(value,std::memory_order_relaxed);
+}
+
+void Gauge::add(const qint64 amount)
+{
+    current.fetch_add(amount,std::memory_order_relaxed);
+}
+
+qint64 Gauge::value() const
+{
+    return current.load(std::memory_order_relaxed);
+}
+
+int Histogram::bucketIndex(const qint64 value)
+{
+    if (value<4)
+    {
+        return value<0 ? 0 : static_cast<int>(value);
+    }
+    // Position of the highest bit, followed by the next two bits
+    int msb=63-qCountLeadingZeroBits(static_cast<quint64>(value));
+    int index=4*(msb-1)+static_cast<int>((value>>(msb-2)) & 3);
+    return qMin(index,BUCKETS-1);
+}
+
+qint64 Histogram::bucketUpperBound(const int index)
+{
+    if (index<4)
+    {
+        return index+1;
+    }
+    int msb=index/4+1;
+    return static_cast<qint64>(5+index%4) << (msb-2);
+}
+
+void Histogram::record(const qint64 value)
+{
+    Stripe& stripe=stripes[currentStripe()];
+    stripe.buckets[bucketIndex(value)].fetch_add(1,std::memory_order_relaxed);
+    stripe.sum.fetch_add(qMax(value,Q_INT64_C(0)),std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot result;
+    result.buckets.fill(0,BUCKETS);
+    for (const Stripe& stripe : stripes)
+    {
+        for (int i=0; i<BUCKETS; ++i)
+        {
+            quint64 n=stripe.buckets[i].load(std::memory_order_relaxed);
+            result.buckets[i]+=n;
+            result.count+=n;
+        }
+        result.sum+=stripe.sum.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+qint64 HistogramSnapshot::percentile(const double percent) const
+{
+    if (count==0)
+    {
+        return 0;
+    }
+    quint64 target=qMax(Q_UINT64_C(1),static_cast<quint64>(std::ceil(count*percent/100.0)));
+    quint64 seen=0;
+    for (int i=0; i<buckets.size(); ++i)
+    {
+        seen+=buckets[i];
+        if (seen>=target)
+        {
+            return Histogram::bucketUpperBound(i);
+        }
+    }
+    return Histogram::bucketUpperBound(buckets.size()-1);
+}
@@ -0,0 +1,156 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <atomic>
+#include "diagnosticsglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Number of stripes of the counters and histograms. Each thread is assigned
+  to one stripe, so threads rarely write into the same cache line.
+*/
+#define METRICS_STRIPES 16
+
+/**
+  Counts events, for example the number of requests or bytes written.
+  The value only grows. Recording is lock-free and does not allocate memory,
+  it adds to a cache line that belongs to the current thread.
+  @see MetricsRegistry::counter()
+*/
+
+class DECLSPEC Counter {
+    Q_DISABLE_COPY(Counter)
+public:
+
+    /** Constructor */
+    Counter() = default;
+
+    /**
+      Increment the counter.
+      This method is thread safe.
+      @param amount Value to add, must not be negative
+    */
+    void add(const qint64 amount=1);
+
+    /** Sum of all stripes */
+    qint64 value() const;
+
+private:
+
+    /** One stripe of the counter */
+    struct alignas(64) Cell {
+        std::atomic<qint64> value{0};
+    };
+
+    /** Stripes of the counter */
+    Cell cells[METRICS_STRIPES];
+};
+
+/**
+  Holds a value that can go up and down, for example the number of active requests.
+  @see MetricsRegistry::gauge()
+*/
+
+class DECLSPEC Gauge {
+    Q_DISABLE_COPY(Gauge)
+public:
+
+    /** Constructor */
+    Gauge() = default;
+
+    /** Set the value. This method is thread safe. */
+    void set(const qint64 value);
+
+    /** Add to the value, may be negative. This method is thread safe. */
+    void add(const qint64 amount=1);
+
+    /** Current value */
+    qint64 value() const;
+
+private:
+
+    /** Current value */
+    std::atomic<qint64> current{0};
+};
+
+/** Copy of the counts of a Histogram */
+struct DECLSPEC HistogramSnapshot {
+
+    /** Number of values per bucket */
+    QVector<quint64> buckets;
+
+    /** Number of values */
+    quint64 count=0;
+
+    /** Sum of all values */
+    qint64 sum=0;
+
+    /**
+      Estimate a percentile.
+      @param percent Percentile, for example 99.9
+      @return Upper bound of the bucket that contains the percentile, 0 if empty
+    */
+    qint64 percentile(const double percent) const;
+};
+
+/**
+  Distribution of values, for example latencies in nanoseconds.
+  Like a HDR histogram, the buckets grow exponentially but have a constant
+  relative width: each power of two is split into 4 linear sub-buckets, so the
+  error of any value is below 25%. Values up to 2^40 are resolved, larger
+  values fall into the last bucket.
+  <p>
+  Recording is lock-free and does not allocate memory, it increments a bucket
+  in the stripe of the current thread.
+  @see MetricsRegistry::histogram()
+*/
+
+class DECLSPEC Histogram {
+    Q_DISABLE_COPY(Histogram)
+public:
+
+    /** Number of buckets */
+    static const int BUCKETS=160;
+
+    /** Constructor */
+    Histogram() = default;
+
+    /**
+      Record a value.
+      This method is thread safe.
+      @param value The value, negative values are recorded as 0
+    */
+    void record(const qint64 value);
+
+    /** Copy the current counts */
+    HistogramSnapshot snapshot() const;
+
+    /** Index of the bucket for a value */
+    static int bucketIndex(const qint64 value);
+
+    /** Smallest value that is larger than all values of a bucket */
+    static qint64 bucketUpperBound(const int index);
+
+private:
+
+    /** One stripe of the histogram */
+    struct alignas(64) Stripe {
+        std::atomic<quint64> buckets[BUCKETS]={};
+        std::atomic<qint64> sum{0};
+    };
+
+    /** Stripes of the histogram */
+    Stripe stripes[METRICS_STRIPES];
+};
+
+} // end of namespace
+
+#endif // METRICS_H
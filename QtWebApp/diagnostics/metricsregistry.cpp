@@ -0,0 +1,245 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "metricsregistry.h"
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QVector>
+
+using namespace stefanfrings;
+
+namespace {
+
+Q_LOGGING_CATEGORY(qwaMetrics,"qtwebapp.metrics")
+
+/** Format a floating point value for Prometheus */
+QByteArray formatValue(const double value)
+{
+    return QByteArray::number(value,'g',12);
+}
+
+/** Append the name with optional labels */
+void appendName(QByteArray& output, const QByteArray& name, const QByteArray& labels,
+                const QByteArray& extraLabel=QByteArray())
+{
+    output.append(name);
+    if (!labels.isEmpty() || !extraLabel.isEmpty())
+    {
+        output.append('{').append(labels);
+        if (!labels.isEmpty() && !extraLabel.isEmpty())
+        {
+            output.append(',');
+        }
+        output.append(extraLabel).append('}');
+    }
+    output.append(' ');
+}
+
+/** Escape the help text as required by the text format */
+QByteArray escapeHelp(QByteArray help)
+{
+    return help.replace('\\',"\\\\").replace('\n',"\\n");
+}
+
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    // Never destroyed, because static objects may still record values during shutdown
+    static MetricsRegistry* registry=new MetricsRegistry();
+    return *registry;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find(const Type type, const QByteArray& name,
+                                              const QByteArray& help, const QByteArray& labels)
+{
+    bool conflict=false;
+    for (const std::unique_ptr<Entry>& entry : entries)
+    {
+        if (entry->name!=name)
+        {
+            continue;
+        }
+        // Callbacks are gauges
+        const Type existing=entry->type==CallbackType ? GaugeType : entry->type;
+        if (existing!=type)
+        {
+            conflict=true;
+        }
+        else if (entry->type==type && entry->labels==labels)
+        {
+            return *entry;
+        }
+    }
+    if (conflict)
+    {
+        qCWarning(qwaMetrics,"MetricsRegistry: %s is registered with different types",name.constData());
+    }
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->type=type;
+    entry->name=name;
+    entry->help=help;
+    entry->labels=labels;
+    entries.push_back(std::move(entry));
+    return *entries.back();
+}
+
+Counter& MetricsRegistry::counter(const QByteArray& name, const QByteArray& help, const QByteArray& labels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry=find(CounterType,name,help,labels);
+    if (!entry.counter)
+    {
+        entry.counter.reset(new Counter());
+    }
+    return *entry.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const QByteArray& name, const QByteArray& help, const QByteArray& labels)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry=find(GaugeType,name,help,labels);
+    if (!entry.gauge)
+    {
+        entry.gauge.reset(new Gauge());
+    }
+    return *entry.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const QByteArray& name, const QByteArray& help,
+                                      const QByteArray& labels, const double unit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry=find(HistogramType,name,help,labels);
+    if (!entry.histogram)
+    {
+        entry.histogram.reset(new Histogram());
+        entry.unit=unit;
+    }
+    return *entry.histogram;
+}
+
+int MetricsRegistry::addCallback(const QByteArray& name, const QByteArray& help,
+                                 std::function<double()> function, const QByteArray& labels)
+{
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->type=CallbackType;
+    entry->name=name;
+    entry->help=help;
+    entry->labels=labels;
+    entry->function=std::move(function);
+    std::lock_guard<std::mutex> lock(mutex);
+    entry->id=++lastId;
+    entries.push_back(std::move(entry));
+    return lastId;
+}
+
+void MetricsRegistry::removeCallback(const int id)
+{
+    std::lock_guard<std::mutex> callbackLock(callbackMutex);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto i=entries.begin(); i!=entries.end(); ++i)
+    {
+        if ((*i)->type==CallbackType && (*i)->id==id)
+        {
+            entries.erase(i);
+            return;
+        }
+    }
+}
+
+QByteArray MetricsRegistry::render()
+{
+    // Callbacks may lock other mutexes, so they are called without holding the
+    // main mutex. The callback mutex keeps them alive meanwhile.
+    std::lock_guard<std::mutex> callbackLock(callbackMutex);
+    QVector<QByteArray> names;
+    QHash<QByteArray,QVector<const Entry*>> families;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<Entry>& entry : entries)
+        {
+            QVector<const Entry*>& family=families[entry->name];
+            if (family.isEmpty())
+            {
+                names.append(entry->name);
+            }
+            family.append(entry.get());
+        }
+    }
+
+    QByteArray output;
+    for (const QByteArray& name : names)
+    {
+        const QVector<const Entry*>& family=families[name];
+        // Callbacks are rendered as gauges, so they may share a family with gauges
+        const Type type=family.first()->type==CallbackType ? GaugeType : family.first()->type;
+        output.append("# HELP ").append(name).append(' ').append(escapeHelp(family.first()->help)).append('\n');
+        output.append("# TYPE ").append(name).append(' ');
+        switch (type)
+        {
+            case CounterType:   output.append("counter\n"); break;
+            case HistogramType: output.append("histogram\n"); break;
+            default:            output.append("gauge\n"); break;
+        }
+
+        // Callbacks with equal labels are summed up
+        QMap<QByteArray,double> callbacks;
+        for (const Entry* entry : family)
+        {
+            const Type entryType=entry->type==CallbackType ? GaugeType : entry->type;
+            if (entryType!=type)
+            {
+                // Conflicting type, has been reported during registration
+                continue;
+            }
+            switch (entry->type)
+            {
+                case CounterType:
+                    appendName(output,name,entry->labels);
+                    output.append(QByteArray::number(entry->counter->value())).append('\n');
+                    break;
+                case GaugeType:
+                    appendName(output,name,entry->labels);
+                    output.append(QByteArray::number(entry->gauge->value())).append('\n');
+                    break;
+                case CallbackType:
+                    callbacks[entry->labels]+=entry->function();
+                    break;
+                case HistogramType: {
+                    HistogramSnapshot snapshot=entry->histogram->snapshot();
+                    QByteArray bucketName=name+"_bucket";
+                    quint64 cumulative=0;
+                    // Render the powers of two, the last bucket contains all larger values.
+                    // The values are integers below the upper bound, but le includes its value.
+                    for (int i=0; i<Histogram::BUCKETS-1; ++i)
+                    {
+                        cumulative+=snapshot.buckets[i];
+                        qint64 bound=Histogram::bucketUpperBound(i);
+                        if ((bound & (bound-1))==0)
+                        {
+                            appendName(output,bucketName,entry->labels,"le=\""+formatValue((bound-1)*entry->unit)+"\"");
+                            output.append(QByteArray::number(cumulative)).append('\n');
+                        }
+                    }
+                    appendName(output,bucketName,entry->labels,"le=\"+Inf\"");
+                    output.append(QByteArray::number(snapshot.count)).append('\n');
+                    appendName(output,name+"_sum",entry->labels);
+                    output.append(formatValue(snapshot.sum*entry->unit)).append('\n');
+                    appendName(output,name+"_count",entry->labels);
+                    output.append(QByteArray::number(snapshot.count)).append('\n');
+                    break;
+                }
+            }
+        }
+        for (auto i=callbacks.constBegin(); i!=callbacks.constEnd(); ++i)
+        {
+            appendName(output,name,i.key());
+            output.append(formatValue(i.value())).append('\n');
+        }
+    }
+    return output;
+}
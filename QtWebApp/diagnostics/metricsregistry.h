@@ -0,0 +1,145 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef METRICSREGISTRY_H
+#define METRICSREGISTRY_H
+
+#include <QByteArray>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "diagnosticsglobal.h"
+#include "metrics.h"
+
+namespace stefanfrings {
+
+/**
+  Process wide collection of metrics. The library registers its own metrics
+  here (connection handlers, active requests, cache hits, sessions, errors,
+  bytes written, request durations), the application may add more.
+  <p>
+  Registering a metric locks a mutex and allocates memory, so it should be done
+  once, for example in a function-local static reference. Recording values
+  into the returned objects is lock-free. Registered metrics live until the
+  end of the program.
+  <p>
+  Example:
+  <code><pre>
+  static Counter& orders=MetricsRegistry::instance().counter("shop_orders_total","Number of orders");
+  orders.add();
+  </pre></code>
+  Names and labels follow the rules of Prometheus, for example
+  <code>counter("http_errors_total","Errors","code=\"404\"")</code>.
+  Values that are already known elsewhere can be provided by callback functions
+  that are called when the metrics get rendered.
+  @see MetricsController which delivers the metrics in the Prometheus text format
+*/
+
+class DECLSPEC MetricsRegistry {
+    Q_DISABLE_COPY(MetricsRegistry)
+public:
+
+    /** Get the process wide instance */
+    static MetricsRegistry& instance();
+
+    /**
+      Get or create a counter.
+      This method is thread safe.
+      @param name Name of the metric
+      @param help Description of the metric
+      @param labels Labels in Prometheus syntax without curly braces, may be empty
+    */
+    Counter& counter(const QByteArray& name, const QByteArray& help, const QByteArray& labels=QByteArray());
+
+    /**
+      Get or create a gauge.
+      This method is thread safe.
+      @param name Name of the metric
+      @param help Description of the metric
+      @param labels Labels in Prometheus syntax without curly braces, may be empty
+    */
+    Gauge& gauge(const QByteArray& name, const QByteArray& help, const QByteArray& labels=QByteArray());
+
+    /**
+      Get or create a histogram.
+      This method is thread safe.
+      @param name Name of the metric
+      @param help Description of the metric
+      @param labels Labels in Prometheus syntax without curly braces, may be empty
+      @param unit Factor that converts the recorded values into the unit of the
+      rendered values, for example 1e-9 for values in nsec that are rendered in seconds.
+    */
+    Histogram& histogram(const QByteArray& name, const QByteArray& help,
+                         const QByteArray& labels=QByteArray(), const double unit=1.0);
+
+    /**
+      Add a gauge whose value is provided by a function. Callbacks with equal
+      name and labels are summed up, so multiple instances of a class may
+      register the same metric.
+      This method is thread safe.
+      @param name Name of the metric
+      @param help Description of the metric
+      @param function Is called when the metrics get rendered, from any thread
+      @param labels Labels in Prometheus syntax without curly braces, may be empty
+      @return ID for removeCallback()
+    */
+    int addCallback(const QByteArray& name, const QByteArray& help,
+                    std::function<double()> function, const QByteArray& labels=QByteArray());
+
+    /**
+      Remove a callback. After return, the function will not be called anymore.
+      This method is thread safe.
+      @param id Return value of addCallback()
+    */
+    void removeCallback(const int id);
+
+    /**
+      Render all metrics in the Prometheus text format, version 0.0.4.
+      This method is thread safe.
+    */
+    QByteArray render();
+
+private:
+
+    /** Type of a metric */
+    enum Type {CounterType, GaugeType, HistogramType, CallbackType};
+
+    /** One registered metric */
+    struct Entry {
+        Type type;
+        QByteArray name;
+        QByteArray help;
+        QByteArray labels;
+        double unit=1.0;
+        int id=0;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> function;
+    };
+
+    /** Constructor */
+    MetricsRegistry() = default;
+
+    /** All metrics, ordered by registration */
+    std::vector<std::unique_ptr<Entry>> entries;
+
+    /** Last ID of a callback */
+    int lastId=0;
+
+    /** Protects the list of entries */
+    std::mutex mutex;
+
+    /** Held while callbacks are called, so they cannot be removed meanwhile */
+    std::mutex callbackMutex;
+
+    /** Find or create an entry, the mutex must be locked */
+    Entry& find(const Type type, const QByteArray& name, const QByteArray& help, const QByteArray& labels);
+};
+
+} // end of namespace
+
+#endif // METRICSREGISTRY_H
@@ -0,0 +1,22 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "threadname.h"
+#ifdef Q_OS_LINUX
+    #include <sys/prctl.h>
+    #include <cstring>
+#endif
+
+void stefanfrings::setThreadName(const char* name)
+{
+#ifdef Q_OS_LINUX
+    char truncated[16];
+    strncpy(truncated,name,sizeof(truncated)-1);
+    truncated[sizeof(truncated)-1]='\0';
+    prctl(PR_SET_NAME,truncated,0,0,0);
+#else
+    Q_UNUSED(name)
+#endif
+}
@@ -0,0 +1,28 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef THREADNAME_H
+#define THREADNAME_H
+
+#include "diagnosticsglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Set the name of the current thread as shown by the operating system,
+  for example in top -H, gdb, perf and the stacks of the CpuProfiler.
+  The library names its threads qwa-connection, qwa-worker, qwa-logger,
+  qwa-logsink, qwa-accesslog, qwa-tracer, qwa-watchdog, qwa-memory, qwa-executor,
+  qwa-limiter and qwa-scheduler. The own threads of a priority class of the
+  HttpScheduler carry the name of the class after qwa-.
+  Linux limits names to 15 characters, longer names are truncated.
+  Does nothing on other platforms.
+  @param name Name of the thread
+*/
+DECLSPEC void setThreadName(const char* name);
+
+} // end of namespace
+
+#endif // THREADNAME_H
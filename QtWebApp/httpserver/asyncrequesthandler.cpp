@@ -0,0 +1,248 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "asyncrequesthandler.h"
+
+#ifdef QTWEBAPP_COROUTINES
+
+#include "httpconnectionhandler.h"
+#include "httplogging.h"
+#include "httpmetrics.h"
+#include <algorithm>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Passes the cancellation of the connection to the context, as long as it exists */
+class ContextCanceller : public ICanceller {
+public:
+    explicit ContextCanceller(std::weak_ptr<AsyncContext> context) : context(context) {}
+    void cancel() override
+    {
+        if (std::shared_ptr<AsyncContext> c=context.lock())
+        {
+            c->cancel();
+        }
+    }
+private:
+    std::weak_ptr<AsyncContext> context;
+};
+
+}
+
+AsyncContext::AsyncContext(const ServiceParams& params, HttpExecutor& executor)
+    : params(params), executor(executor)
+{}
+
+const HttpRequest& AsyncContext::getRequest() const
+{
+    return *params.request;
+}
+
+HttpResponse& AsyncContext::getResponse() const
+{
+    return *params.response;
+}
+
+uint64_t AsyncContext::getRequestID() const
+{
+    return params.requestID;
+}
+
+const ServiceParams& AsyncContext::getParams() const
+{
+    return params;
+}
+
+HttpExecutor& AsyncContext::getExecutor() const
+{
+    return executor;
+}
+
+AsyncContext::BodyAwaiter AsyncContext::body() const
+{
+    return BodyAwaiter(params.request->getBody());
+}
+
+AsyncContext::WriteAwaiter AsyncContext::write(const QByteArray& data, const bool lastPart)
+{
+    return WriteAwaiter(*this,data,lastPart);
+}
+
+AsyncContext::SleepAwaiter AsyncContext::sleep(const int msec)
+{
+    return SleepAwaiter(*this,msec);
+}
+
+AsyncContext::CancelAwaiter AsyncContext::cancelled()
+{
+    return CancelAwaiter(*this);
+}
+
+bool AsyncContext::isCancelled() const
+{
+    return cancelledFlag;
+}
+
+void AsyncContext::cancel()
+{
+    std::vector<std::shared_ptr<detail::Wakeup>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cancelledFlag.exchange(true))
+        {
+            return;
+        }
+        cancelled.swap(waiters);
+    }
+    qwaDebug(qwaHttpConnection,"AsyncContext: request %llu cancelled",static_cast<unsigned long long>(params.requestID));
+    for (const std::shared_ptr<detail::Wakeup>& wakeup : cancelled)
+    {
+        wakeup->fire(true);
+    }
+}
+
+void AsyncContext::write(const QByteArray& data, const bool lastPart, bool* result, std::coroutine_handle<> handle)
+{
+    // After the cancellation, the connection handler may already be destroyed
+    if (isCancelled())
+    {
+        *result=false;
+        executor.post([handle] { handle.resume(); });
+        return;
+    }
+    std::shared_ptr<HttpResponse> response=params.response;
+    HttpExecutor* continuation=&executor;
+    // The coroutine may continue and delete this object as soon as the function has been queued
+    response->getConnectionHandler().socketPost(params.requestID,[response,data,lastPart,result,handle,continuation](bool current)
+    {
+        bool connected=false;
+        if (current && response->isConnected())
+        {
+            if (!response->hasSentLastPart())
+            {
+                response->write(data,lastPart);
+            }
+            connected=response->isConnected();
+        }
+        *result=connected;
+        continuation->post([handle] { handle.resume(); });
+    });
+}
+
+void AsyncContext::sleep(const int msec, std::shared_ptr<detail::Wakeup>& wakeup, std::coroutine_handle<> handle)
+{
+    std::shared_ptr<detail::Wakeup> w=std::make_shared<detail::Wakeup>(handle,executor);
+    wakeup=w;
+    HttpExecutor& timerExecutor=executor;
+    bool alreadyCancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        alreadyCancelled=cancelledFlag;
+        if (!alreadyCancelled)
+        {
+            waiters.push_back(w);
+        }
+    }
+    // The coroutine may continue and delete this object as soon as the wakeup is registered
+    if (msec>=0)
+    {
+        timerExecutor.postDelayed(msec,[w] { w->fire(false); });
+    }
+    if (alreadyCancelled)
+    {
+        w->fire(true);
+    }
+}
+
+bool AsyncContext::release(const std::shared_ptr<detail::Wakeup>& wakeup)
+{
+    // Null if the request had been cancelled before the coroutine got suspended
+    if (!wakeup)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    waiters.erase(std::remove(waiters.begin(),waiters.end(),wakeup),waiters.end());
+    return !wakeup->cancelled;
+}
+
+AsyncRequestHandler::AsyncRequestHandler(QObject* parent, HttpExecutor* executor)
+    : HttpRequestHandler(parent)
+{
+    this->executor=executor ? executor : &HttpExecutor::instance();
+}
+
+void AsyncRequestHandler::callService(ServiceParams params)
+{
+    HttpMetrics::instance().queuedRequests.add(1);
+    std::shared_ptr<AsyncContext> context=std::make_shared<AsyncContext>(params,*executor);
+    if (params.cancellerInitialization)
+    {
+        params.cancellerInitialization(std::make_shared<ContextCanceller>(context));
+    }
+    run(std::move(context));
+}
+
+Task<> AsyncRequestHandler::serviceAsync(AsyncContext& context)
+{
+    const HttpRequest& request=context.getRequest();
+    qCCritical(qwaHttpConnection,"AsyncRequestHandler: you need to override the serviceAsync() function");
+    qwaDebug(qwaHttpConnection,"AsyncRequestHandler: request=%s %s %s", request.getMethod().data(), request.getPath().data(), request.getVersion().data());
+    context.getResponse().setStatus(501,"not implemented");
+    co_await context.write("501 not implemented",true);
+}
+
+detail::DetachedTask AsyncRequestHandler::run(std::shared_ptr<AsyncContext> context)
+{
+    // Continue in the executor, the caller is the thread of the connection
+    co_await detail::ScheduleAwaiter{*executor};
+
+    HttpMetrics& metrics=HttpMetrics::instance();
+    const ServiceParams& params=context->getParams();
+    if (params.timings)
+    {
+        params.timings->serviceStarted=RequestTimings::now();
+    }
+    metrics.queuedRequests.add(-1);
+    metrics.activeRequests.add(1);
+    bool failed=false;
+    try
+    {
+        co_await serviceAsync(*context);
+    }
+    catch (const std::exception& ex)
+    {
+        qCCritical(qwaHttpConnection,"AsyncRequestHandler (%p): An uncatched exception occured in the request handler: %s",
+            static_cast<void*>(this), ex.what());
+        failed=true;
+    }
+    catch (...)
+    {
+        qCCritical(qwaHttpConnection,"AsyncRequestHandler (%p): An uncatched exception occured in the request handler",
+            static_cast<void*>(this));
+        failed=true;
+    }
+    metrics.activeRequests.add(-1);
+
+    // The connection completes the response in its own thread
+    std::shared_ptr<HttpResponse> response=params.response;
+    FinalizeFunctor finalizer;
+    if (failed)
+    {
+        finalizer=[response]
+        {
+            if (response->getBytesWritten()==0)
+            {
+                response->setStatus(500,"internal server error");
+                response->write("500 internal server error",true);
+            }
+        };
+    }
+    emit responseResultSignal(ResponseResult{params.requestID,response,finalizer,params.closeSocketAfterResponse,WriteToSocket::YES});
+}
+
+#endif // QTWEBAPP_COROUTINES
@@ -0,0 +1,551 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef ASYNCREQUESTHANDLER_H
+#define ASYNCREQUESTHANDLER_H
+
+#include "httprequesthandler.h"
+#include "httpexecutor.h"
+
+// The coroutine API needs a compiler in C++20 mode, e.g. CONFIG += c++2a.
+// moc gets the same predefined macros from the compiler (moc_predefs.h),
+// but older versions of moc do not understand __has_include.
+#if defined(__cpp_impl_coroutine)
+    #if defined(Q_MOC_RUN)
+        #define QTWEBAPP_COROUTINES
+    #elif __has_include(<coroutine>)
+        #define QTWEBAPP_COROUTINES
+    #endif
+#endif
+
+#ifdef QTWEBAPP_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace stefanfrings {
+
+namespace detail {
+
+/** Common part of the promises of Task */
+struct TaskPromiseBase {
+    /** The coroutine that awaits the task */
+    std::coroutine_handle<> continuation;
+    /** Exception that is thrown to the awaiting coroutine */
+    std::exception_ptr exception;
+
+    /** Continues the awaiting coroutine when the task has finished */
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> next=handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception=std::current_exception(); }
+};
+
+/** Coroutine that starts immediately and frees itself when it has finished */
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+/** Continues the awaiting coroutine in a thread of the executor */
+struct ScheduleAwaiter {
+    HttpExecutor& executor;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        executor.post([handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+};
+
+/**
+  Resumes a suspended coroutine on the executor, either because the awaited
+  event happened or because the request has been cancelled. Only the first
+  call of fire() has an effect.
+*/
+struct Wakeup {
+    Wakeup(std::coroutine_handle<> handle, HttpExecutor& executor) : handle(handle), executor(executor) {}
+    std::coroutine_handle<> handle;
+    HttpExecutor& executor;
+    std::atomic_bool fired{false};
+    /** Whether the cancellation was first, valid after the resumption */
+    bool cancelled=false;
+    void fire(const bool cancel)
+    {
+        if (!fired.exchange(true))
+        {
+            cancelled=cancel;
+            std::coroutine_handle<> h=handle;
+            executor.post([h] { h.resume(); });
+        }
+    }
+};
+
+} // end of namespace detail
+
+/**
+  Result of a coroutine that can be awaited by another coroutine. The coroutine
+  starts when it gets awaited. Exceptions are passed to the awaiting coroutine.
+  <p>
+  Example:
+  <code><pre>
+  Task&lt;int&gt; countRows()
+  {
+      int rows=co_await database.query(...);
+      co_return rows;
+  }
+  </pre></code>
+*/
+
+template<class T=void>
+class Task {
+public:
+
+    struct promise_type : detail::TaskPromiseBase {
+        std::optional<T> value;
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        template<class V>
+        void return_value(V&& v) { value.emplace(std::forward<V>(v)); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle,nullptr)) {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this!=&other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle=std::exchange(other.handle,nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        handle.promise().continuation=caller;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        if (handle.promise().exception)
+        {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return std::move(*handle.promise().value);
+    }
+
+private:
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/** Result of a coroutine without value */
+template<>
+class Task<void> {
+public:
+
+    struct promise_type : detail::TaskPromiseBase {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() const noexcept {}
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle,nullptr)) {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this!=&other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle=std::exchange(other.handle,nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        handle.promise().continuation=caller;
+        return handle;
+    }
+
+    void await_resume()
+    {
+        if (handle.promise().exception)
+        {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+
+private:
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+  A value that is delivered later by another thread, e.g. by the callback of a
+  network client. A coroutine awaits the value without occupying a thread, it
+  continues on the executor when complete() gets called.
+  Copies share the same value, so the callback may keep a copy.
+  <p>
+  Example:
+  <code><pre>
+  Completion&lt;QByteArray&gt; reply;
+  client.get(url,[reply](const QByteArray& data) { reply.complete(data); });
+  QByteArray data=co_await reply;
+  </pre></code>
+  Only one coroutine may await the value.
+*/
+
+template<class T>
+class Completion {
+public:
+
+    /**
+      Constructor.
+      @param executor Executor that continues the awaiting coroutine
+    */
+    explicit Completion(HttpExecutor& executor=HttpExecutor::instance()) : state(std::make_shared<State>(executor)) {}
+
+    /**
+      Deliver the value. Only the first call has an effect.
+      This method is thread safe.
+    */
+    void complete(T value) const
+    {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->completed)
+            {
+                return;
+            }
+            state->completed=true;
+            state->value.emplace(std::move(value));
+            waiter=std::exchange(state->waiter,nullptr);
+        }
+        if (waiter)
+        {
+            state->executor.post([waiter] { waiter.resume(); });
+        }
+    }
+
+    /** Whether complete() has been called */
+    bool isCompleted() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->completed;
+    }
+
+    bool await_ready() const { return isCompleted(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->completed)
+        {
+            return false;
+        }
+        state->waiter=handle;
+        return true;
+    }
+
+    T await_resume() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return std::move(*state->value);
+    }
+
+private:
+
+    struct State {
+        explicit State(HttpExecutor& executor) : executor(executor) {}
+        HttpExecutor& executor;
+        std::mutex mutex;
+        bool completed=false;
+        std::optional<T> value;
+        std::coroutine_handle<> waiter;
+    };
+
+    std::shared_ptr<State> state;
+};
+
+/**
+  A request that is processed by a coroutine of the AsyncRequestHandler.
+  The methods that return awaitables must be called from the coroutine, the
+  coroutine always continues in a thread of the executor.
+*/
+
+class DECLSPEC AsyncContext {
+    Q_DISABLE_COPY(AsyncContext)
+public:
+
+    /** Awaitable that writes to the response */
+    class WriteAwaiter {
+    public:
+        WriteAwaiter(AsyncContext& context, const QByteArray& data, const bool lastPart)
+            : context(context), data(data), lastPart(lastPart) {}
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { context.write(data,lastPart,&result,handle); }
+        /** Returns false if the connection has been closed */
+        bool await_resume() const noexcept { return result; }
+    private:
+        AsyncContext& context;
+        QByteArray data;
+        bool lastPart;
+        bool result=false;
+    };
+
+    /** Awaitable that waits for a time or for the cancellation of the request */
+    class SleepAwaiter {
+    public:
+        SleepAwaiter(AsyncContext& context, const int msec) : context(context), msec(msec) {}
+        bool await_ready() const { return context.isCancelled(); }
+        void await_suspend(std::coroutine_handle<> handle) { context.sleep(msec,wakeup,handle); }
+        /** Returns false if the request has been cancelled */
+        bool await_resume() { return context.release(wakeup); }
+    private:
+        AsyncContext& context;
+        int msec;
+        std::shared_ptr<detail::Wakeup> wakeup;
+    };
+
+    /** Awaitable that waits for the cancellation of the request */
+    class CancelAwaiter {
+    public:
+        explicit CancelAwaiter(AsyncContext& context) : context(context) {}
+        bool await_ready() const { return context.isCancelled(); }
+        void await_suspend(std::coroutine_handle<> handle) { context.sleep(-1,wakeup,handle); }
+        void await_resume() { context.release(wakeup); }
+    private:
+        AsyncContext& context;
+        std::shared_ptr<detail::Wakeup> wakeup;
+    };
+
+    /** Awaitable that provides the body of the request */
+    class BodyAwaiter {
+    public:
+        explicit BodyAwaiter(const QByteArray& body) : body(body) {}
+        bool await_ready() const noexcept { return true; }
+        void await_suspend(std::coroutine_handle<>) const noexcept {}
+        QByteArray await_resume() const { return body; }
+    private:
+        QByteArray body;
+    };
+
+    /**
+      Constructor.
+      @param params The request
+      @param executor Executor that runs the coroutine
+    */
+    AsyncContext(const ServiceParams& params, HttpExecutor& executor);
+
+    /** The request */
+    const HttpRequest& getRequest() const;
+
+    /**
+      The response. Headers and status must be set before the first write(),
+      the body must only be written with write().
+    */
+    HttpResponse& getResponse() const;
+
+    /** ID of the request */
+    uint64_t getRequestID() const;
+
+    /** Parameters of the request as passed to HttpRequestHandler::service() */
+    const ServiceParams& getParams() const;
+
+    /** Executor that runs the coroutine */
+    HttpExecutor& getExecutor() const;
+
+    /**
+      Get the body of the request: <code>QByteArray body=co_await context.body();</code>
+      Completes immediately, because the HttpConnectionHandler receives the whole
+      body before it dispatches the request.
+    */
+    BodyAwaiter body() const;
+
+    /**
+      Write body data in the thread of the connection:
+      <code>bool connected=co_await context.write(data);</code>
+      @param data Data bytes of the body
+      @param lastPart Indicates that this is the last chunk of data
+      @return Awaitable that returns false if the connection has been closed
+      @see HttpResponse::write()
+    */
+    WriteAwaiter write(const QByteArray& data, const bool lastPart=false);
+
+    /**
+      Wait without occupying a thread:
+      <code>bool elapsed=co_await context.sleep(1000);</code>
+      @param msec Time in milliseconds
+      @return Awaitable that returns false if the request has been cancelled before the time elapsed
+    */
+    SleepAwaiter sleep(const int msec);
+
+    /**
+      Wait until the request gets cancelled, because the client has disconnected:
+      <code>co_await context.cancelled();</code>
+    */
+    CancelAwaiter cancelled();
+
+    /** Whether the request has been cancelled */
+    bool isCancelled() const;
+
+    /**
+      Cancel the request and continue all coroutines that wait in sleep() or cancelled().
+      Called by the HttpConnectionHandler when the client disconnects.
+      This method is thread safe.
+    */
+    void cancel();
+
+private:
+
+    /** Parameters of the request */
+    ServiceParams params;
+
+    /** Executor that runs the coroutine */
+    HttpExecutor& executor;
+
+    /** Whether the request has been cancelled */
+    std::atomic_bool cancelledFlag{false};
+
+    /** Coroutines that wait in sleep() or cancelled() */
+    std::vector<std::shared_ptr<detail::Wakeup>> waiters;
+
+    /** Protects the waiters */
+    std::mutex mutex;
+
+    /** Implementation of WriteAwaiter */
+    void write(const QByteArray& data, const bool lastPart, bool* result, std::coroutine_handle<> handle);
+
+    /** Implementation of SleepAwaiter and CancelAwaiter, msec<0 waits for the cancellation only */
+    void sleep(const int msec, std::shared_ptr<detail::Wakeup>& wakeup, std::coroutine_handle<> handle);
+
+    /** Remove a waiter after it has been continued, returns false if it has been cancelled */
+    bool release(const std::shared_ptr<detail::Wakeup>& wakeup);
+};
+
+/**
+  Request handler that processes the requests with C++20 coroutines. Requests
+  that wait for I/O, timers or other services do not occupy a thread, so
+  thousands of them can be in flight with a few threads. The coroutines run
+  on an HttpExecutor.
+  <p>
+  Override serviceAsync() instead of service():
+  <code><pre>
+  Task&lt;&gt; MyController::serviceAsync(AsyncContext& context)
+  {
+      QByteArray body=co_await context.body();
+      context.getResponse().setHeader("Content-Type","text/plain");
+      co_await context.write("Hello ");
+      if (!co_await context.sleep(1000))
+      {
+          co_return; // the client has disconnected
+      }
+      co_await context.write("World",true);
+  }
+  </pre></code>
+  When the coroutine has finished, the response is completed and passed to the
+  connection through responseResultSignal, so the coroutine does not need to
+  emit it. If the coroutine throws an exception before anything has been
+  written, the client receives status 500.
+  <p>
+  If the HttpConnectionHandler gets destroyed while a coroutine waits for
+  write(), the request is cancelled and the write returns false, so the
+  coroutine can finish and free its frame.
+  <p>
+  This class is only available when the library is compiled in C++20 mode.
+*/
+
+class DECLSPEC AsyncRequestHandler : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(AsyncRequestHandler)
+public:
+
+    /**
+      Constructor.
+      @param parent Parent object.
+      @param executor Executor for the coroutines, null uses HttpExecutor::instance().
+      Ownership is not taken.
+    */
+    AsyncRequestHandler(QObject* parent=nullptr, HttpExecutor* executor=nullptr);
+
+    /** Start the coroutine of a request */
+    void callService(ServiceParams params) override;
+
+protected:
+
+    /**
+      Generate a response for an incoming HTTP request.
+      The default implementation returns status 501.
+      @param context The request and the response
+      @warning This method must be thread safe
+    */
+    virtual Task<> serviceAsync(AsyncContext& context);
+
+private:
+
+    /** Executor for the coroutines */
+    HttpExecutor* executor;
+
+    /** Run serviceAsync() and pass the response to the connection */
+    detail::DetachedTask run(std::shared_ptr<AsyncContext> context);
+};
+
+} // end of namespace
+
+#endif // QTWEBAPP_COROUTINES
+
+#endif // ASYNCREQUESTHANDLER_H
@@ -0,0 +1,242 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpaccesslog.h"
+#include "httplogging.h"
+#include "threadname.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Append a string with the escaping of JSON and of the combined log format */
+void appendEscaped(QByteArray& output, const QByteArray& value)
+{
+    static const char hex[]="0123456789abcdef";
+    for (char c : value)
+    {
+        uchar u=static_cast<uchar>(c);
+        if (c=='"' || c=='\\')
+        {
+            output.append('\\').append(c);
+        }
+        else if (u<0x20)
+        {
+            output.append("\\u00").append(hex[u>>4]).append(hex[u & 15]);
+        }
+        else
+        {
+            output.append(c);
+        }
+    }
+}
+
+/** Append a number with at least two digits */
+void appendTwoDigits(QByteArray& output, const int value)
+{
+    output.append(static_cast<char>('0'+value/10)).append(static_cast<char>('0'+value%10));
+}
+
+}
+
+HttpAccessLog::HttpAccessLog(const QSettings* settings)
+{
+    Q_ASSERT(settings!=nullptr);
+    QString fileName=settings->value("fileName","access.log").toString();
+    // Convert relative fileName to absolute, based on the directory of the config file.
+#ifdef Q_OS_WIN32
+    if (QDir::isRelativePath(fileName) && settings->format()!=QSettings::NativeFormat)
+#else
+    if (QDir::isRelativePath(fileName))
+#endif
+    {
+        QFileInfo configFile(settings->fileName());
+        fileName=QFileInfo(configFile.absolutePath(),fileName).absoluteFilePath();
+    }
+    json=settings->value("format","json").toString()!="combined";
+    flushInterval=settings->value("flushInterval",1000).toInt();
+    maxQueue=settings->value("maxQueue",65536).toInt();
+    stopping=false;
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        qCCritical(qwaHttpConnection,"HttpAccessLog: cannot open %s: %s",qPrintable(fileName),qPrintable(file.errorString()));
+    }
+    thread=std::thread(&HttpAccessLog::run,this);
+}
+
+
+HttpAccessLog::~HttpAccessLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+    }
+    condition.notify_one();
+    thread.join();
+    file.close();
+}
+
+
+void HttpAccessLog::log(AccessLogEntry&& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size()>=maxQueue)
+    {
+        droppedEntries.fetch_add(1,std::memory_order_relaxed);
+        return;
+    }
+    queue.append(std::move(entry));
+}
+
+
+quint64 HttpAccessLog::getDroppedEntries() const
+{
+    return droppedEntries.load();
+}
+
+
+void HttpAccessLog::run()
+{
+    setThreadName("qwa-accesslog");
+    QVector<AccessLogEntry> batch;
+    QByteArray output;
+    bool finished=false;
+    while (!finished)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait_for(lock,std::chrono::milliseconds(flushInterval),[this] { return stopping; });
+            finished=stopping;
+            batch.swap(queue);
+        }
+        if (batch.isEmpty())
+        {
+            continue;
+        }
+
+        // Write the whole batch at once
+        output.resize(0);
+        for (const AccessLogEntry& entry : batch)
+        {
+            if (json)
+            {
+                formatJson(entry,output);
+            }
+            else
+            {
+                formatCombined(entry,output);
+            }
+        }
+        batch.resize(0);
+        if (file.isOpen())
+        {
+            file.write(output);
+            file.flush();
+        }
+    }
+}
+
+
+void HttpAccessLog::formatJson(const AccessLogEntry& entry, QByteArray& output) const
+{
+    output.append("{\"time\":");
+    output.append(QByteArray::number(entry.timestamp));
+    output.append(",\"id\":");
+    output.append(QByteArray::number(entry.requestID));
+    output.append(",\"peer\":\"");
+    appendEscaped(output,entry.peerAddress.toLatin1());
+    output.append("\",\"method\":\"");
+    appendEscaped(output,entry.method);
+    output.append("\",\"path\":\"");
+    appendEscaped(output,entry.path);
+    output.append("\",\"version\":\"");
+    appendEscaped(output,entry.version);
+    output.append("\",\"status\":");
+    output.append(QByteArray::number(entry.status));
+    output.append(",\"bytes\":");
+    output.append(QByteArray::number(entry.bytes));
+    output.append(",\"referer\":\"");
+    appendEscaped(output,entry.referer);
+    output.append("\",\"userAgent\":\"");
+    appendEscaped(output,entry.userAgent);
+    output.append("\",\"connectionRequests\":");
+    output.append(QByteArray::number(entry.connectionRequests));
+    output.append(",\"parseNs\":");
+    output.append(QByteArray::number(entry.parseTime));
+    output.append(",\"queueNs\":");
+    output.append(QByteArray::number(entry.queueTime));
+    output.append(",\"serviceNs\":");
+    output.append(QByteArray::number(entry.serviceTime));
+    output.append(",\"writeNs\":");
+    output.append(QByteArray::number(entry.writeTime));
+    output.append("}\n");
+}
+
+
+void HttpAccessLog::formatCombined(const AccessLogEntry& entry, QByteArray& output) const
+{
+    static const char* months[]={"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
+    QDateTime time=QDateTime::fromMSecsSinceEpoch(entry.timestamp);
+    QDate date=time.date();
+    QTime clock=time.time();
+    int offset=time.offsetFromUtc()/60;
+
+    // 127.0.0.1 - - [10/Oct/2000:13:55:36 -0700] "GET /index.html HTTP/1.0" 200 2326 "referer" "agent"
+    output.append(entry.peerAddress.toLatin1());
+    output.append(" - - [");
+    appendTwoDigits(output,date.day());
+    output.append('/').append(months[date.month()-1]).append('/');
+    output.append(QByteArray::number(date.year()));
+    output.append(':');
+    appendTwoDigits(output,clock.hour());
+    output.append(':');
+    appendTwoDigits(output,clock.minute());
+    output.append(':');
+    appendTwoDigits(output,clock.second());
+    output.append(offset<0 ? " -" : " +");
+    appendTwoDigits(output,qAbs(offset)/60);
+    appendTwoDigits(output,qAbs(offset)%60);
+    output.append("] \"");
+    appendEscaped(output,entry.method);
+    output.append(' ');
+    appendEscaped(output,entry.path);
+    output.append(' ');
+    appendEscaped(output,entry.version);
+    output.append("\" ");
+    output.append(QByteArray::number(entry.status));
+    output.append(' ');
+    if (entry.bytes>0)
+    {
+        output.append(QByteArray::number(entry.bytes));
+    }
+    else
+    {
+        output.append('-');
+    }
+    output.append(" \"");
+    if (entry.referer.isEmpty())
+    {
+        output.append('-');
+    }
+    else
+    {
+        appendEscaped(output,entry.referer);
+    }
+    output.append("\" \"");
+    if (entry.userAgent.isEmpty())
+    {
+        output.append('-');
+    }
+    else
+    {
+        appendEscaped(output,entry.userAgent);
+    }
+    output.append("\"\n");
+}
@@ -0,0 +1,146 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPACCESSLOG_H
+#define HTTPACCESSLOG_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSettings>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+/** One line of the access log */
+struct AccessLogEntry {
+    /** Time when the request has been received, msec since the epoch */
+    qint64 timestamp=0;
+    /** ID of the request, see ServiceParams */
+    quint64 requestID=0;
+    /** IP address of the client */
+    QString peerAddress;
+    /** HTTP method */
+    QByteArray method;
+    /** Requested path including the query */
+    QByteArray path;
+    /** HTTP version */
+    QByteArray version;
+    /** Status code of the response */
+    int status=0;
+    /** Number of bytes of the response */
+    qint64 bytes=0;
+    /** Referer header of the request */
+    QByteArray referer;
+    /** User-Agent header of the request */
+    QByteArray userAgent;
+    /** Number of the request on its connection, 1 for the first one */
+    int connectionRequests=0;
+    /** Time for receiving and parsing the request in nsec, -1=unknown */
+    qint64 parseTime=-1;
+    /** Time between parsing and the start of the service in nsec, -1=unknown */
+    qint64 queueTime=-1;
+    /** Time for generating the response in nsec, -1=unknown */
+    qint64 serviceTime=-1;
+    /** Time for writing the response to the socket in nsec, -1=unknown */
+    qint64 writeTime=-1;
+};
+
+/**
+  Writes one line per HTTP request into an access log file, independent of the
+  general purpose logger. The connection handlers only append the entries to a
+  list. A background thread formats them in batches and writes each batch with
+  a single call.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  fileName=logs/access.log
+  format=json
+  flushInterval=1000
+  maxQueue=65536
+  </pre></code>
+
+  - fileName is the name of the log file, relative to the directory of the settings file.
+  - format is either "json" for one JSON object per line, including the timings in nsec,
+    or "combined" for the combined log format of the Apache web server. Default is json.
+  - flushInterval is the maximum time in msec that an entry waits before it gets written. Default is 1000.
+  - maxQueue is the maximum number of waiting entries. More entries are discarded. Default is 65536.
+
+  @see HttpListener::setAccessLog()
+*/
+
+class DECLSPEC HttpAccessLog {
+    Q_DISABLE_COPY(HttpAccessLog)
+public:
+
+    /**
+      Constructor.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+    */
+    HttpAccessLog(const QSettings* settings);
+
+    /** Destructor. Writes the remaining entries and closes the file. */
+    virtual ~HttpAccessLog();
+
+    /**
+      Append an entry.
+      This method is thread safe.
+    */
+    void log(AccessLogEntry&& entry);
+
+    /** Number of entries that have been discarded because the queue was full */
+    quint64 getDroppedEntries() const;
+
+private:
+
+    /** The output file */
+    QFile file;
+
+    /** Whether the file has JSON format instead of the combined log format */
+    bool json;
+
+    /** Maximum time in msec that entries wait for the background thread */
+    int flushInterval;
+
+    /** Maximum number of waiting entries */
+    int maxQueue;
+
+    /** Waiting entries */
+    QVector<AccessLogEntry> queue;
+
+    /** Protects the queue */
+    std::mutex mutex;
+
+    /** Wakes up the background thread */
+    std::condition_variable condition;
+
+    /** Tells the background thread to terminate */
+    bool stopping;
+
+    /** Number of discarded entries */
+    std::atomic<quint64> droppedEntries{0};
+
+    /** Background thread */
+    std::thread thread;
+
+    /** Main loop of the background thread */
+    void run();
+
+    /** Format an entry in JSON format */
+    void formatJson(const AccessLogEntry& entry, QByteArray& output) const;
+
+    /** Format an entry in the combined log format */
+    void formatCombined(const AccessLogEntry& entry, QByteArray& output) const;
+};
+
+} // end of namespace
+
+#endif // HTTPACCESSLOG_H
@@ -0,0 +1,314 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpconcurrencylimiter.h"
+#include "httplogging.h"
+#include "httptimings.h"
+#include "metricsregistry.h"
+#include "threadname.h"
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+using namespace stefanfrings;
+
+namespace {
+
+/**
+  Check whether a path belongs to a route. The prefix must end at a segment
+  boundary, so "/reports" matches "/reports" and "/reports/1" but not "/reportsXYZ".
+*/
+bool matchesPrefix(const QByteArray& path, const QByteArray& prefix)
+{
+    return path.startsWith(prefix) &&
+           (path.size()==prefix.size() || prefix.isEmpty() || prefix.endsWith('/') || path.at(prefix.size())=='/');
+}
+
+}
+
+HttpConcurrencyLimiter::HttpConcurrencyLimiter(const QSettings* settings)
+{
+    Q_ASSERT(settings!=nullptr);
+    algorithm=settings->value("algorithm","gradient").toString()=="aimd" ? Aimd : Gradient;
+    const int initialLimit=qMax(1,settings->value("initialLimit",20).toInt());
+    const int minLimit=qMax(1,settings->value("minLimit",4).toInt());
+    const int maxLimit=qMax(minLimit,settings->value("maxLimit",500).toInt());
+    queueSize=qMax(0,settings->value("queueSize",100).toInt());
+    queueTimeout=qMax(1,settings->value("queueTimeout",1000).toInt())*Q_INT64_C(1000000);
+    tolerance=qMax(1.0,settings->value("tolerance",1.5).toDouble());
+    latencyTarget=qMax(1,settings->value("latencyTarget",100).toInt())*1e6;
+    stopping=false;
+
+    // Each route has a prefix and its maximum limit, separated by a colon
+    QList<QPair<QByteArray,int>> prefixes;
+    foreach (const QString& entry, settings->value("routes").toString().split(',',QString::SkipEmptyParts))
+    {
+        const int colon=entry.lastIndexOf(':');
+        const QByteArray prefix=entry.left(colon).trimmed().toUtf8();
+        const int max=colon>0 ? entry.mid(colon+1).toInt() : 0;
+        if (prefix.isEmpty() || max<1)
+        {
+            qCWarning(qwaHttpConnection,"HttpConcurrencyLimiter: ignoring invalid route %s",qPrintable(entry));
+            continue;
+        }
+        prefixes.append(qMakePair(prefix,max));
+    }
+    std::sort(prefixes.begin(),prefixes.end(),[](const QPair<QByteArray,int>& a, const QPair<QByteArray,int>& b)
+    {
+        return a.first.size()>b.first.size();
+    });
+    prefixes.append(qMakePair(QByteArray(),maxLimit));
+
+    MetricsRegistry& metrics=MetricsRegistry::instance();
+    for (const QPair<QByteArray,int>& prefix : prefixes)
+    {
+        Route route;
+        route.prefix=prefix.first;
+        route.maxLimit=prefix.second;
+        route.minLimit=qMin(minLimit,route.maxLimit);
+        route.limit=qBound(route.minLimit,initialLimit,route.maxLimit);
+        const QByteArray label="route=\""+route.prefix+"\"";
+        route.rejectedFull=&metrics.counter("qtwebapp_limiter_rejected_total","Number of requests that have been rejected by the concurrency limiter",
+                                            label+",reason=\"queue_full\"");
+        route.rejectedTimeout=&metrics.counter("qtwebapp_limiter_rejected_total","Number of requests that have been rejected by the concurrency limiter",
+                                               label+",reason=\"timeout\"");
+        routes.push_back(route);
+    }
+    for (size_t i=0; i<routes.size(); i++)
+    {
+        const QByteArray label="route=\""+routes[i].prefix+"\"";
+        metricIds.append(metrics.addCallback("qtwebapp_limiter_limit","Current limit of concurrent requests",[this,i]
+        {
+            std::lock_guard lock{ mutex };
+            return std::floor(routes[i].limit);
+        },label));
+        metricIds.append(metrics.addCallback("qtwebapp_limiter_in_flight","Number of requests that have been admitted by the concurrency limiter",[this,i]
+        {
+            std::lock_guard lock{ mutex };
+            return static_cast<double>(routes[i].inFlight);
+        },label));
+        metricIds.append(metrics.addCallback("qtwebapp_limiter_queued","Number of requests that wait for admission by the concurrency limiter",[this,i]
+        {
+            std::lock_guard lock{ mutex };
+            return static_cast<double>(routes[i].queue.size());
+        },label));
+    }
+    thread=std::thread(&HttpConcurrencyLimiter::run,this);
+}
+
+
+HttpConcurrencyLimiter::~HttpConcurrencyLimiter()
+{
+    foreach (int id, metricIds)
+    {
+        MetricsRegistry::instance().removeCallback(id);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping=true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+
+HttpConcurrencyLimiter::Admission HttpConcurrencyLimiter::acquire(const QByteArray& path, std::function<void(bool)> callback, quint64& ticket)
+{
+    // The default route has the empty prefix and matches all paths
+    int index=0;
+    while (!matchesPrefix(path,routes[index].prefix))
+    {
+        index++;
+    }
+    std::lock_guard lock{ mutex };
+    Route& route=routes[index];
+    if (route.inFlight<static_cast<int>(route.limit) && route.queue.empty())
+    {
+        ticket=++lastTicket;
+        tickets.insert(ticket,Ticket{index,Running,RequestTimings::now(),nullptr});
+        route.inFlight++;
+        return Admitted;
+    }
+    if (static_cast<int>(route.queue.size())<queueSize)
+    {
+        ticket=++lastTicket;
+        tickets.insert(ticket,Ticket{index,Waiting,RequestTimings::now(),std::move(callback)});
+        route.queue.push_back(ticket);
+        return Queued;
+    }
+    route.rejectedFull->add();
+    ticket=0;
+    qwaDebug(qwaHttpConnection,"HttpConcurrencyLimiter: rejected request for %s, limit %i and queue are full",path.constData(),static_cast<int>(route.limit));
+    return Rejected;
+}
+
+
+void HttpConcurrencyLimiter::release(const quint64 ticket, const bool completed)
+{
+    std::vector<Notification> notifications;
+    {
+        std::lock_guard lock{ mutex };
+        auto it=tickets.find(ticket);
+        if (it==tickets.end())
+        {
+            return;
+        }
+        const Ticket t=it.value();
+        tickets.erase(it);
+        Route& route=routes[t.route];
+        const qint64 now=RequestTimings::now();
+        if (t.state==Waiting)
+        {
+            route.queue.erase(std::find(route.queue.begin(),route.queue.end(),ticket));
+        }
+        else if (t.state==Running)
+        {
+            if (completed)
+            {
+                sample(route,now-t.time,route.inFlight);
+            }
+            route.inFlight--;
+            admit(route,now,notifications);
+        }
+    }
+    // Also waits until another thread has returned from a callback of this ticket
+    notify(notifications);
+}
+
+
+int HttpConcurrencyLimiter::getLimit(const QByteArray& route)
+{
+    std::lock_guard lock{ mutex };
+    for (const Route& r : routes)
+    {
+        if (r.prefix==route)
+        {
+            return static_cast<int>(r.limit);
+        }
+    }
+    return -1;
+}
+
+
+void HttpConcurrencyLimiter::admit(Route& route, const qint64 now, std::vector<Notification>& notifications)
+{
+    while (route.inFlight<static_cast<int>(route.limit) && !route.queue.empty())
+    {
+        const quint64 ticket=route.queue.front();
+        route.queue.pop_front();
+        Ticket& t=tickets[ticket];
+        t.state=Running;
+        t.time=now;
+        route.inFlight++;
+        notifications.push_back(Notification{ticket,t.callback,true});
+    }
+}
+
+
+void HttpConcurrencyLimiter::sample(Route& route, const qint64 duration, const int inFlight)
+{
+    const double rtt=static_cast<double>(qMax(Q_INT64_C(1),duration));
+    if (route.longRtt==0)
+    {
+        route.shortRtt=rtt;
+        route.longRtt=rtt;
+    }
+    // Moving averages over about 10 and 600 requests
+    route.shortRtt+=(rtt-route.shortRtt)/10;
+    route.longRtt+=(rtt-route.longRtt)/600;
+
+    double newLimit;
+    if (algorithm==Aimd)
+    {
+        if (rtt>latencyTarget)
+        {
+            newLimit=route.limit*0.9;
+        }
+        // Grow only if the limit is actually used
+        else if (inFlight*2>=route.limit)
+        {
+            newLimit=route.limit+1.0/route.limit;
+        }
+        else
+        {
+            return;
+        }
+    }
+    else
+    {
+        // Let the long-term average follow quickly when the services became much faster
+        if (route.longRtt>2*route.shortRtt)
+        {
+            route.longRtt*=0.95;
+        }
+        if (inFlight*2<route.limit)
+        {
+            return;
+        }
+        // The queue allowance lets the limit grow while the duration does not increase
+        const double gradient=qBound(0.5,tolerance*route.longRtt/route.shortRtt,1.0);
+        newLimit=route.limit*0.8+(route.limit*gradient+std::sqrt(route.limit))*0.2;
+    }
+    const int previous=static_cast<int>(route.limit);
+    route.limit=qBound(static_cast<double>(route.minLimit),newLimit,static_cast<double>(route.maxLimit));
+    if (static_cast<int>(route.limit)!=previous)
+    {
+        qwaDebug(qwaHttpConnection,"HttpConcurrencyLimiter: limit of route '%s' changed to %i",route.prefix.constData(),static_cast<int>(route.limit));
+    }
+}
+
+
+void HttpConcurrencyLimiter::notify(const std::vector<Notification>& notifications)
+{
+    std::lock_guard<std::mutex> lock(notifyMutex);
+    for (const Notification& notification : notifications)
+    {
+        // Skip tickets that have been released in the meantime, release() waits for the notifyMutex
+        {
+            std::lock_guard lock{ mutex };
+            if (!tickets.contains(notification.ticket))
+            {
+                continue;
+            }
+        }
+        notification.callback(notification.admitted);
+    }
+}
+
+
+void HttpConcurrencyLimiter::run()
+{
+    setThreadName("qwa-limiter");
+    const int interval=qBound(Q_INT64_C(1),queueTimeout/4000000,Q_INT64_C(100));
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex);
+            condition.wait_for(lock,std::chrono::milliseconds(interval),[this] { return stopping; });
+            if (stopping)
+            {
+                return;
+            }
+        }
+        std::vector<Notification> notifications;
+        {
+            std::lock_guard lock{ mutex };
+            const qint64 now=RequestTimings::now();
+            for (Route& route : routes)
+            {
+                while (!route.queue.empty() && now-tickets[route.queue.front()].time>queueTimeout)
+                {
+                    const quint64 ticket=route.queue.front();
+                    route.queue.pop_front();
+                    Ticket& t=tickets[ticket];
+                    t.state=Expired;
+                    route.rejectedTimeout->add();
+                    notifications.push_back(Notification{ticket,t.callback,false});
+                }
+            }
+        }
+        notify(notifications);
+    }
+}
@@ -0,0 +1,227 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPCONCURRENCYLIMITER_H
+#define HTTPCONCURRENCYLIMITER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSettings>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "httpglobal.h"
+#include "instrumentedmutex.h"
+
+namespace stefanfrings {
+
+class Counter;
+
+/**
+  Limits the number of requests that are processed at the same time, before
+  they reach HttpRequestHandler::service(). The limit adapts to the observed
+  duration of the services: it grows while the services are as fast as usual
+  and shrinks when they slow down, which indicates that the server is
+  overloaded. Requests above the limit wait in a queue. When the queue is full
+  or a request has waited too long, the client receives status 503.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  algorithm=gradient
+  initialLimit=20
+  minLimit=4
+  maxLimit=500
+  queueSize=100
+  queueTimeout=1000
+  tolerance=1.5
+  latencyTarget=100
+  routes=/reports:2,/api:100
+  </pre></code>
+
+  - algorithm selects how the limit adapts:
+      - gradient compares the recent service duration with the long-term average
+        and reduces the limit in proportion when it grows by more than the tolerance (default).
+      - aimd increases the limit by one per round of requests while the service duration is
+        below latencyTarget and multiplies it by 0.9 when the duration is above.
+  - initialLimit is the limit at start. Default is 20.
+  - minLimit and maxLimit bound the limit. Defaults are 4 and 500.
+  - queueSize is the number of requests that may wait per route. 0 rejects all requests above the limit. Default is 100.
+  - queueTimeout is the maximum waiting time in msec. Default is 1000.
+  - tolerance is the factor by which the service duration may grow before the gradient
+    algorithm reduces the limit. Default is 1.5.
+  - latencyTarget is the highest service duration in msec that the aimd algorithm accepts. Default is 100.
+  - routes is a comma separated list of path prefixes with their own limit and queue, each
+    followed by its maxLimit. The longest matching prefix is used, all other requests share
+    the default route. A prefix matches only whole path segments, /reports matches
+    /reports/1 but not /reportsXYZ. Default is empty.
+
+  The duration of a request is measured from its admission until its response
+  has been written. The limits, the number of requests in progress and in the
+  queue and the rejected requests are published as the metrics
+  qtwebapp_limiter_limit, qtwebapp_limiter_in_flight, qtwebapp_limiter_queued
+  and qtwebapp_limiter_rejected_total, labelled with the route.
+  @see HttpListener::setConcurrencyLimiter()
+*/
+
+class DECLSPEC HttpConcurrencyLimiter {
+    Q_DISABLE_COPY(HttpConcurrencyLimiter)
+public:
+
+    /** Result of acquire() */
+    enum Admission {
+        /** The request may start now */
+        Admitted,
+        /** The request waits in the queue */
+        Queued,
+        /** The limit and the queue are full */
+        Rejected
+    };
+
+    /**
+      Constructor.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+    */
+    HttpConcurrencyLimiter(const QSettings* settings);
+
+    /** Destructor */
+    virtual ~HttpConcurrencyLimiter();
+
+    /**
+      Ask for permission to start a request.
+      This method is thread safe.
+      @param path Path of the request, selects the route
+      @param callback Called when a queued request may start (true) or has waited too long (false).
+      It may be called from any thread, but never after release() of the ticket has returned.
+      It must return quickly and must not call release().
+      @param ticket Receives the ticket for release(), 0 if the request has been rejected
+      @return Whether the request may start now, has been queued or has been rejected
+    */
+    Admission acquire(const QByteArray& path, std::function<void(bool)> callback, quint64& ticket);
+
+    /**
+      Finish a request. Must be called for each ticket, no matter whether the
+      request has been started, is still queued or has timed out. Further calls
+      with the same ticket have no effect.
+      This method is thread safe.
+      @param ticket Ticket from acquire()
+      @param completed True if the response has been written, then the duration of
+      the request adjusts the limit. False if the request has been abandoned.
+    */
+    void release(const quint64 ticket, const bool completed);
+
+    /**
+      Current limit of a route.
+      This method is thread safe.
+      @param route Prefix of the route as configured, empty for the default route
+      @return The limit, or -1 if there is no such route
+    */
+    int getLimit(const QByteArray& route);
+
+private:
+
+    /** Available algorithms */
+    enum Algorithm { Gradient, Aimd };
+
+    /** State of a ticket */
+    enum TicketState { Waiting, Running, Expired };
+
+    /** Requests that share a limit */
+    struct Route {
+        QByteArray prefix;
+        double limit;
+        int minLimit;
+        int maxLimit;
+        int inFlight=0;
+        /** Tickets of the waiting requests, the oldest first */
+        std::deque<quint64> queue;
+        /** Recent service duration in nsec, moving average */
+        double shortRtt=0;
+        /** Long-term service duration in nsec, moving average */
+        double longRtt=0;
+        Counter* rejectedFull;
+        Counter* rejectedTimeout;
+    };
+
+    /** A request that has been admitted or queued */
+    struct Ticket {
+        int route;
+        TicketState state;
+        /** Time when the request has been queued or started, in nsec of the steady clock */
+        qint64 time;
+        std::function<void(bool)> callback;
+    };
+
+    /** A callback that has to be called */
+    struct Notification {
+        quint64 ticket;
+        std::function<void(bool)> callback;
+        bool admitted;
+    };
+
+    /** Selected algorithm */
+    Algorithm algorithm;
+
+    /** Maximum number of waiting requests per route */
+    int queueSize;
+
+    /** Maximum waiting time in nsec */
+    qint64 queueTimeout;
+
+    /** Tolerated growth of the service duration (gradient) */
+    double tolerance;
+
+    /** Highest accepted service duration in nsec (aimd) */
+    double latencyTarget;
+
+    /** The routes, sorted by descending length of the prefix, the default route is the last one */
+    std::vector<Route> routes;
+
+    /** Admitted and queued requests */
+    QHash<quint64,Ticket> tickets;
+
+    /** Last issued ticket */
+    quint64 lastTicket=0;
+
+    /** Protects the routes and the tickets */
+    InstrumentedMutex mutex{"concurrency_limiter"};
+
+    /** Held while callbacks are called, so release() can wait for them */
+    std::mutex notifyMutex;
+
+    /** IDs of the metric callbacks */
+    QList<int> metricIds;
+
+    /** Protects stopping */
+    std::mutex stopMutex;
+
+    /** Wakes up the background thread */
+    std::condition_variable condition;
+
+    /** Tells the background thread to terminate */
+    bool stopping;
+
+    /** Background thread that expires waiting requests */
+    std::thread thread;
+
+    /** Main loop of the background thread */
+    void run();
+
+    /** Start waiting requests while the route is below its limit, the caller must hold the mutex */
+    void admit(Route& route, const qint64 now, std::vector<Notification>& notifications);
+
+    /** Adjust the limit of a route to the duration of a request, the caller must hold the mutex */
+    void sample(Route& route, const qint64 duration, const int inFlight);
+
+    /** Call the callbacks of tickets that have not been released in the meantime */
+    void notify(const std::vector<Notification>& notifications);
+};
+
+} // end of namespace
+
+#endif // HTTPCONCURRENCYLIMITER_H
@@ -4,7 +4,12 @@
 */
 
 #include "httpconnectionhandler.h"
+#include "httplogging.h"
+#include "httpmetrics.h"
 #include "httpresponse.h"
+#include "memorybudget.h"
+#include "sizeclasspool.h"
+#include <QDateTime>
 #include <future>
 
 using namespace stefanfrings;
@@ -18,11 +23,28 @@ HttpConnectionHandler::HttpConnectionHandler(const QSettings *settings, HttpRequ
     this->requestHandler=requestHandler;
     this->sslConfiguration=sslConfiguration;
     busy=false;
+    currentRequestID=0;
+    currentRequestTime=0;
+    connectionRequests=0;
+    accessLog=nullptr;
+    tracer=nullptr;
+    watchdog=nullptr;
+    currentWatchdog=nullptr;
+    concurrencyLimiter=nullptr;
+    currentLimiter=nullptr;
+    currentTicket=0;
+    connectionAccepted=0;
+    connectionReady=0;
+    accountedBody=0;
+    accountedOutput=0;
+    sheddingMinBodySize=settings->value("sheddingMinBodySize",4096).toLongLong();
+    retryAfter=settings->value("retryAfter",5).toInt();
 
     // execute signals in a new thread
     thread = new QThread();
+    thread->setObjectName("qwa-connection");
     thread->start();
-    qDebug("HttpConnectionHandler (%p): thread started", static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): thread started", static_cast<void*>(this));
     moveToThread(thread);
     readTimer.moveToThread(thread);
     readTimer.setSingleShot(true);
@@ -34,13 +56,14 @@ HttpConnectionHandler::HttpConnectionHandler(const QSettings *settings, HttpRequ
     // Connect signals
     connect(socket, SIGNAL(readyRead()), SLOT(read()));
     connect(socket, SIGNAL(disconnected()), SLOT(disconnected()));
+    connect(socket, &QTcpSocket::bytesWritten, this, &HttpConnectionHandler::accountOutput);
     connect(&readTimer, SIGNAL(timeout()), SLOT(readTimeout()));
     connect(thread, SIGNAL(finished()), this, SLOT(thread_done()));
 
     connect(this, &HttpConnectionHandler::queueFunctionSignal, this, &HttpConnectionHandler::onQueueFunctionSignal, Qt::QueuedConnection);
     connect(requestHandler, &HttpRequestHandler::responseResultSignal, this, &HttpConnectionHandler::onResponseResultSignal, Qt::QueuedConnection);
 
-    qDebug("HttpConnectionHandler (%p): constructed", static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): constructed", static_cast<void*>(this));
 }
 
 
@@ -49,7 +72,7 @@ void HttpConnectionHandler::thread_done()
     readTimer.stop();
     socket->close();
     delete socket;
-    qDebug("HttpConnectionHandler (%p): thread stopped", static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): thread stopped", static_cast<void*>(this));
 }
 
 
@@ -58,7 +81,27 @@ HttpConnectionHandler::~HttpConnectionHandler()
     thread->quit();
     thread->wait();
     thread->deleteLater();
-    qDebug("HttpConnectionHandler (%p): destroyed", static_cast<void*>(this));
+
+    // Stop the running request, so its coroutine does not post anything else
+    CancellerRef canceller;
+    {
+        std::lock_guard lck{ m_cancellerMutex };
+        canceller = m_canceller;
+    }
+    if (canceller)
+        canceller->cancel();
+
+    // The queued calls of socketPost() are discarded with the thread. Call the functions
+    // here, otherwise the coroutines that wait for them would never continue and leak.
+    std::map<quint64, std::function<void(bool)>> posts;
+    {
+        std::lock_guard lock{ postMutex };
+        postsClosed = true;
+        posts.swap(pendingPosts);
+    }
+    for (auto& post : posts)
+        post.second(false);
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): destroyed", static_cast<void*>(this));
 }
 
 
@@ -71,7 +114,7 @@ void HttpConnectionHandler::createSocket()
             QSslSocket* sslSocket=new QSslSocket();
             sslSocket->setSslConfiguration(*sslConfiguration);
             socket=sslSocket;
-            qDebug("HttpConnectionHandler (%p): SSL is enabled", static_cast<void*>(this));
+            qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): SSL is enabled", static_cast<void*>(this));
             return;
         }
     #endif
@@ -82,9 +125,11 @@ void HttpConnectionHandler::createSocket()
 
 void HttpConnectionHandler::handleConnection(const tSocketDescriptor& socketDescriptor)
 {
-    qDebug("HttpConnectionHandler (%p): handle new connection", static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): handle new connection", static_cast<void*>(this));
     setBusy();
+    connectionAccepted = RequestTimings::now();
     currentRequestID = 0;
+    connectionRequests = 0;
     Q_ASSERT(socket->isOpen()==false); // if not, then the handler is already busy
 
     //UGLY workaround - we need to clear writebuffer before reusing this socket
@@ -94,7 +139,7 @@ void HttpConnectionHandler::handleConnection(const tSocketDescriptor& socketDesc
 
     if (!socket->setSocketDescriptor(socketDescriptor))
     {
-        qCritical("HttpConnectionHandler (%p): cannot initialize socket: %s",
+        qCCritical(qwaHttpConnection,"HttpConnectionHandler (%p): cannot initialize socket: %s",
                   static_cast<void*>(this),qPrintable(socket->errorString()));
         return;
     }
@@ -103,7 +148,7 @@ void HttpConnectionHandler::handleConnection(const tSocketDescriptor& socketDesc
         // Switch on encryption, if SSL is configured
         if (sslConfiguration)
         {
-            qDebug("HttpConnectionHandler (%p): Starting encryption", static_cast<void*>(this));
+            qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): Starting encryption", static_cast<void*>(this));
             (static_cast<QSslSocket*>(socket))->startServerEncryption();
         }
     #endif
@@ -112,6 +157,8 @@ void HttpConnectionHandler::handleConnection(const tSocketDescriptor& socketDesc
     startTimer();
     // delete previous request
     resetCurrentRequest();
+    accountOutput();
+    connectionReady = RequestTimings::now();
 }
 
 
@@ -131,6 +178,110 @@ void stefanfrings::HttpConnectionHandler::setHeadersHandler(HeadersHandler heade
     this->headersHandler = headersHandler;
 }
 
+void HttpConnectionHandler::setAccessLog(HttpAccessLog* accessLog)
+{
+    this->accessLog = accessLog;
+}
+
+void HttpConnectionHandler::setTracer(HttpTracer* tracer)
+{
+    this->tracer = tracer;
+}
+
+void HttpConnectionHandler::setWatchdog(HttpWatchdog* watchdog)
+{
+    this->watchdog = watchdog;
+}
+
+void HttpConnectionHandler::setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter)
+{
+    this->concurrencyLimiter = concurrencyLimiter;
+}
+
+void HttpConnectionHandler::releaseLimiter(const bool completed)
+{
+    if (currentLimiter) {
+        currentLimiter->release(currentTicket, completed);
+        currentLimiter = nullptr;
+    }
+}
+
+void HttpConnectionHandler::releaseWatchdog()
+{
+    if (currentWatchdog) {
+        currentWatchdog->finishRequest(currentRequestID);
+        currentWatchdog = nullptr;
+    }
+}
+
+void HttpConnectionHandler::accountBody()
+{
+    const qint64 size = currentRequest ? currentRequest->getBody().size() : 0;
+    if (size != accountedBody) {
+        MemoryBudget::instance().add(MemoryBudget::RequestBodies, size - accountedBody);
+        accountedBody = size;
+    }
+}
+
+void HttpConnectionHandler::accountOutput()
+{
+    const qint64 size = socket->isOpen() ? socket->bytesToWrite() : 0;
+    if (size != accountedOutput) {
+        MemoryBudget::instance().add(MemoryBudget::ResponseOutput, size - accountedOutput);
+        accountedOutput = size;
+    }
+}
+
+bool HttpConnectionHandler::shedRequest()
+{
+    MemoryBudget& budget = MemoryBudget::instance();
+    budget.adjust();
+    if (!budget.isExceeded() || currentRequest->getHeader("Content-Length").toLongLong() < sheddingMinBodySize)
+        return false;
+
+    qCWarning(qwaHttpConnection,"HttpConnectionHandler (%p): memory budget exceeded, rejecting request", static_cast<void*>(this));
+    rejectUnavailable();
+    return true;
+}
+
+void HttpConnectionHandler::rejectUnavailable()
+{
+    const QByteArray response = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: " + QByteArray::number(retryAfter) +
+                                "\r\nConnection: close\r\n\r\n503 Service Unavailable\r\n";
+    socket->write(response);
+    HttpMetrics::instance().rejectedUnavailable.add();
+    logAccess(503, response.size());
+    disconnectFromHost();
+}
+
+void HttpConnectionHandler::logAccess(const int status, const qint64 bytes)
+{
+    HttpAccessLog* log = accessLog.load();
+    if (!log || !currentRequest)
+        return;
+
+    AccessLogEntry entry;
+    entry.timestamp = currentRequestTime;
+    entry.requestID = currentRequestID;
+    entry.peerAddress = socket->peerAddress().toString();
+    entry.method = currentRequest->getMethod();
+    entry.path = currentRequest->getRawPath();
+    entry.version = currentRequest->getVersion();
+    entry.status = status;
+    entry.bytes = bytes;
+    entry.referer = currentRequest->getHeader("Referer");
+    entry.userAgent = currentRequest->getHeader("User-Agent");
+    entry.connectionRequests = connectionRequests;
+    if (currentTimings) {
+        const RequestTimings& t = *currentTimings;
+        entry.parseTime = RequestTimings::duration(t.received, t.parsed);
+        entry.queueTime = RequestTimings::duration(t.parsed, t.serviceStarted);
+        entry.serviceTime = RequestTimings::duration(t.serviceStarted, t.serviceFinished);
+        entry.writeTime = RequestTimings::duration(t.writeStarted, t.written);
+    }
+    log->log(std::move(entry));
+}
+
 void HttpConnectionHandler::disconnectFromHost()
 {
     while (socket->bytesToWrite())
@@ -147,19 +298,26 @@ void HttpConnectionHandler::startTimer()
 
 void stefanfrings::HttpConnectionHandler::resetCurrentRequest()
 {
+    releaseLimiter(false);
+    releaseWatchdog();
     currentRequestID = 0;
     currentRequest.reset();
+    currentTimings.reset();
+    currentTrace.reset();
+    accountBody();
 }
 
 void HttpConnectionHandler::onResponseResultSignal(ResponseResult responseResult)
 {
     auto onException = [this](const char* message) {
-        qWarning() << "Exception:" << message;
+        qCWarning(qwaHttpConnection) << "Exception:" << message;
         if (socket)
             socket->disconnectFromHost();
     };
 
     if (responseResult.requestID == currentRequestID) {
+        if (currentTimings)
+            currentTimings->serviceFinished = RequestTimings::now();
         try {
             if (responseResult.finalizer)
                 responseResult.finalizer();
@@ -196,6 +354,32 @@ void HttpConnectionHandler::socketSafeExecution(QueuedFunction function)
     future.get();
 }
 
+void HttpConnectionHandler::socketPost(const uint64_t requestID, std::function<void(bool)> function)
+{
+    std::unique_lock lock{ postMutex };
+    if (postsClosed) {
+        lock.unlock();
+        function(false);
+        return;
+    }
+    const quint64 number = ++lastPost;
+    pendingPosts.emplace(number, std::move(function));
+    lock.unlock();
+
+    emit queueFunctionSignal([this, requestID, number] {
+        std::function<void(bool)> pending;
+        {
+            std::lock_guard lock{ postMutex };
+            auto it = pendingPosts.find(number);
+            if (it == pendingPosts.end())
+                return;
+            pending = std::move(it->second);
+            pendingPosts.erase(it);
+        }
+        pending(requestID == currentRequestID);
+    });
+}
+
 void HttpConnectionHandler::onQueueFunctionSignal(QueuedFunction function)
 {
     function();
@@ -203,7 +387,7 @@ void HttpConnectionHandler::onQueueFunctionSignal(QueuedFunction function)
 
 void HttpConnectionHandler::readTimeout()
 {
-    qDebug("HttpConnectionHandler (%p): read timeout occured",static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): read timeout occured",static_cast<void*>(this));
 
     //Commented out because QWebView cannot handle this.
     //socket->write("HTTP/1.1 408 request timeout\r\nConnection: close\r\n\r\n408 request timeout\r\n");
@@ -213,9 +397,12 @@ void HttpConnectionHandler::readTimeout()
 
 void HttpConnectionHandler::disconnected()
 {
-    qDebug("HttpConnectionHandler (%p): disconnected", static_cast<void*>(this));
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): disconnected", static_cast<void*>(this));
+    releaseLimiter(false);
+    releaseWatchdog();
     currentRequestID = 0;
     socket->close();
+    accountOutput();
     readTimer.stop();
     setBusy(false);
 
@@ -233,17 +420,24 @@ static std::atomic<uint64_t> reguestID = 1;
 
 void HttpConnectionHandler::read()
 {
+    // The previous request is still being processed, pipelined requests wait in the socket
+    if (currentRequest && currentRequest->getStatus() == HttpRequest::complete)
+        return;
+
     // The loop adds support for HTTP pipelinig
     while (socket->bytesAvailable())
     {
         #ifdef SUPERVERBOSE
-        qDebug("HttpConnectionHandler (%p): read input", static_cast<void*>(this));
+        qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): read input", static_cast<void*>(this));
         #endif
 
         // Create new HttpRequest object if necessary
         if (!currentRequest) {
             std::lock_guard lock{ headersHandlerMutex };
-            currentRequest = std::make_shared<HttpRequest>(settings, headersHandler);
+            currentRequest = std::allocate_shared<HttpRequest>(PoolAllocator<HttpRequest>(), settings, headersHandler);
+            currentTimings = std::allocate_shared<RequestTimings>(PoolAllocator<RequestTimings>());
+            currentTimings->received = RequestTimings::now();
+            currentRequestTime = QDateTime::currentMSecsSinceEpoch();
         }
 
         // Collect data for the request object
@@ -252,14 +446,20 @@ void HttpConnectionHandler::read()
                 currentRequest->getStatus() != HttpRequest::abort &&
                 currentRequest->getStatus() != HttpRequest::wrongHeaders)
         {
+            const HttpRequest::RequestStatus previousStatus=currentRequest->getStatus();
             currentRequest->readFromSocket(socket);
             if (currentRequest->getStatus()==HttpRequest::waitForBody)
             {
+                // Decide before the body gets buffered
+                if (previousStatus!=HttpRequest::waitForBody && shedRequest())
+                    return;
+
                 // Restart timer for read timeout, otherwise it would
                 // expire during large file uploads.
                 startTimer();
             }
         }
+        accountBody();
 
         switch (currentRequest->getStatus()) {
             default: break;
@@ -272,24 +472,44 @@ void HttpConnectionHandler::read()
                                         .arg(statusCode)
                                         .arg(text);
 
-                socket->write(response.toUtf8().constData());
+                const QByteArray data = response.toUtf8();
+                socket->write(data.constData());
+                HttpMetrics::instance().parseErrors.add();
+                logAccess(statusCode, data.size());
                 disconnectFromHost();
                 return;
             }
 
             // If the request is aborted, return error message and close the connection
-            case HttpRequest::abort:
-                socket->write("HTTP/1.1 413 entity too large\r\nConnection: close\r\n\r\n413 Entity too large\r\n");
+            case HttpRequest::abort: {
+                const char* response = "HTTP/1.1 413 entity too large\r\nConnection: close\r\n\r\n413 Entity too large\r\n";
+                socket->write(response);
+                // Without method, the first line of the request was broken
+                if (currentRequest->getMethod().isEmpty())
+                    HttpMetrics::instance().parseErrors.add();
+                else
+                    HttpMetrics::instance().rejectedTooLarge.add();
+                logAccess(413, qstrlen(response));
                 disconnectFromHost();
                 return;
+            }
 
             // If the request is complete, let the request mapper dispatch it
             case HttpRequest::complete: {
                 readTimer.stop();
-                qDebug("HttpConnectionHandler (%p): received request", static_cast<void*>(this));
+                MemoryBudget::instance().adjust();
+                currentTimings->parsed = RequestTimings::now();
+                currentTimings->headersCheckStarted = currentRequest->getHeadersCheckStarted();
+                currentTimings->headersCheckFinished = currentRequest->getHeadersCheckFinished();
+                if (++connectionRequests == 1) {
+                    currentTimings->accepted = connectionAccepted;
+                    currentTimings->connected = connectionReady;
+                }
+                qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): received request", static_cast<void*>(this));
 
                 // Copy the Connection:close header to the response
-                auto response = std::make_shared<HttpResponse>(socket, *this);
+                auto response = std::allocate_shared<HttpResponse>(PoolAllocator<HttpResponse>(), socket, *this);
+                response->setTimings(currentTimings);
                 bool closeConnection=QString::compare(currentRequest->getHeader("Connection"), "close", Qt::CaseInsensitive) == 0;
                 if (!closeConnection)
                     // In case of HTTP 1.0 protocol add the Connection:close header.
@@ -299,43 +519,108 @@ void HttpConnectionHandler::read()
                 if (closeConnection)
                     response->setHeader("Connection", "close");
 
+                // Continue the trace of the caller or start a new one
+                if (HttpTracer* activeTracer = tracer.load()) {
+                    currentTrace = activeTracer->startTrace(currentRequest->getHeader("traceparent"));
+                    if (currentTrace)
+                        response->setHeader("traceparent", currentTrace->toTraceparent());
+                }
+
                 // Call the request mapper
-                auto onInitCanceller = [this](CancellerRef ref) {
-                    std::lock_guard lock{ m_cancellerMutex };
-                    m_canceller = ref;
-                };
                 currentRequestID = reguestID++;
-
-                auto fnSendError = [this](const char * msg) {
-                    qWarning() << "Exception on callService:" << msg;
-                    const auto response = QString("HTTP/1.1 500 error on callService \r\nException: %1").arg(msg);
-                    socket->write(response.toUtf8().constData());
-                    disconnectFromHost();
-                };
-
-                try {
-                    requestHandler->callService(ServiceParams{ currentRequestID, std::make_shared<HttpRequest>(*currentRequest) /*request copy*/, response, closeConnection ? CloseSocket::YES : CloseSocket::NO, onInitCanceller });
-                }
-                catch (const std::exception& e) {
-                    fnSendError(e.what());
-                }
-                catch (...) {
-                    fnSendError("Unknown");
+                currentWatchdog = watchdog.load();
+                if (currentWatchdog)
+                    currentWatchdog->startRequest(currentRequestID, currentTimings, currentRequest->getMethod(), currentRequest->getRawPath(),
+                                                  currentRequest->getVersion(), socket->peerAddress(), connectionRequests, connectionAccepted);
+
+                // Wait for the concurrency limiter, if the request cannot start immediately
+                if (HttpConcurrencyLimiter* limiter = concurrencyLimiter.load()) {
+                    auto onAdmission = [this, requestID = currentRequestID, response, closeConnection](bool admitted) {
+                        emit queueFunctionSignal([this, requestID, response, closeConnection, admitted] {
+                            if (requestID != currentRequestID)
+                                return;
+                            if (admitted) {
+                                dispatch(response, closeConnection);
+                            }
+                            else {
+                                qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): queue timeout of the concurrency limiter", static_cast<void*>(this));
+                                rejectUnavailable();
+                            }
+                        });
+                    };
+                    quint64 ticket;
+                    const HttpConcurrencyLimiter::Admission admission = limiter->acquire(currentRequest->getPath(), onAdmission, ticket);
+                    if (admission == HttpConcurrencyLimiter::Rejected) {
+                        rejectUnavailable();
+                        return;
+                    }
+                    currentLimiter = limiter;
+                    currentTicket = ticket;
+                    if (admission == HttpConcurrencyLimiter::Queued)
+                        return;
                 }
+                dispatch(response, closeConnection);
+
+                // Pipelined requests remain in the socket until this response is finished
+                return;
             }
         }
     }
 }
 
+void HttpConnectionHandler::dispatch(std::shared_ptr<HttpResponse> response, const bool closeConnection)
+{
+    auto onInitCanceller = [this, requestID = currentRequestID, activeWatchdog = currentWatchdog](CancellerRef ref) {
+        {
+            std::lock_guard lock{ m_cancellerMutex };
+            m_canceller = ref;
+        }
+        if (activeWatchdog)
+            activeWatchdog->setCanceller(requestID, ref);
+    };
+
+    auto fnSendError = [this](const char * msg) {
+        qCWarning(qwaHttpConnection) << "Exception on callService:" << msg;
+        const auto response = QString("HTTP/1.1 500 error on callService \r\nException: %1").arg(msg);
+        socket->write(response.toUtf8().constData());
+        disconnectFromHost();
+    };
+
+    try {
+        requestHandler->callService(ServiceParams{ currentRequestID, std::allocate_shared<HttpRequest>(PoolAllocator<HttpRequest>(), *currentRequest) /*request copy*/, response, closeConnection ? CloseSocket::YES : CloseSocket::NO, onInitCanceller, currentTimings, currentTrace });
+    }
+    catch (const std::exception& e) {
+        fnSendError(e.what());
+    }
+    catch (...) {
+        fnSendError("Unknown");
+    }
+}
+
 void HttpConnectionHandler::finalizeResponse(std::shared_ptr<HttpResponse> response, CloseSocket isCloseConnection)
 {
     bool closeConnection = CloseSocket::YES == isCloseConnection;
+    // Normally set by the first write of the response, unless nothing has been written yet
+    if (currentTimings && currentTimings->writeStarted == 0)
+        currentTimings->writeStarted = RequestTimings::now();
 
     // Finalize sending the response if not already done
     if (!response->hasSentLastPart())
         response->write(QByteArray(), true);
 
-    qDebug("HttpConnectionHandler (%p): finished request", static_cast<void*>(this));
+    HttpMetrics& metrics = HttpMetrics::instance();
+    metrics.requests.add();
+    if (currentTimings) {
+        currentTimings->written = RequestTimings::now();
+        metrics.requestDuration.record(RequestTimings::duration(currentTimings->received, currentTimings->written));
+        HttpTracer* activeTracer = tracer.load();
+        if (activeTracer && currentTrace && currentRequest)
+            activeTracer->finishTrace(*currentTrace, *currentTimings, currentRequest->getMethod(), currentRequest->getPath(), response->getStatusCode());
+    }
+    logAccess(response->getStatusCode(), response->getBytesWritten());
+    releaseLimiter(true);
+
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandler (%p): finished request", static_cast<void*>(this));
 
     // Find out whether the connection must be closed
     if (!closeConnection) {
@@ -362,4 +647,8 @@ void HttpConnectionHandler::finalizeResponse(std::shared_ptr<HttpResponse> respo
     }
     
     resetCurrentRequest();
+
+    // Continue with the next pipelined request
+    if (!closeConnection && socket->bytesAvailable())
+        read();
 }
\ No newline at end of file
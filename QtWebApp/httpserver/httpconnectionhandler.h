@@ -17,6 +17,12 @@
 #include "httpheadershandler.h"
 #include "httprequest.h"
 #include "httprequesthandler.h"
+#include "httpaccesslog.h"
+#include "httpconcurrencylimiter.h"
+#include "httptimings.h"
+#include "httptracer.h"
+#include "httpwatchdog.h"
+#include <map>
 #include <mutex>
 
 namespace stefanfrings {
@@ -47,7 +53,11 @@ namespace stefanfrings {
   </pre></code>
   <p>
   The readTimeout value defines the maximum time to wait for a complete HTTP request.
+  <p>
+  While the MemoryBudget is exceeded, requests with large bodies are rejected with
+  status 503 before their body is received.
   @see HttpRequest for description of config settings maxRequestSize and maxMultiPartSize.
+  @see HttpMemory for description of config settings sheddingMinBodySize and retryAfter.
 */
 
 class DECLSPEC HttpConnectionHandler : public QObject {
@@ -76,6 +86,51 @@ public:
 
     void socketSafeExecution(QueuedFunction function);
 
+    /**
+      Execute a function in the thread of this connection without waiting for it.
+      This method is thread safe.
+      @param requestID ID of the request that the function belongs to
+      @param function Receives false if the connection has been closed or proceeded
+      to another request in the meantime, then it must not access the response.
+      If this handler gets destroyed before, the destructor calls the function with false.
+    */
+    void socketPost(const uint64_t requestID, std::function<void(bool)> function);
+
+    /**
+      Set the access log that receives one entry per request.
+      This method is thread safe.
+      @param accessLog The access log, or null. Ownership is not taken.
+    */
+    void setAccessLog(HttpAccessLog* accessLog);
+
+    /**
+      Set the tracer that records spans of sampled requests.
+      This method is thread safe.
+      @param tracer The tracer, or null. Ownership is not taken.
+    */
+    void setTracer(HttpTracer* tracer);
+
+    /**
+      Set the watchdog that looks for slow requests.
+      This method is thread safe.
+      @param watchdog The watchdog, or null. Ownership is not taken.
+    */
+    void setWatchdog(HttpWatchdog* watchdog);
+
+    /**
+      Set the limiter that decides when requests may be passed to the request handler.
+      This method is thread safe.
+      @param concurrencyLimiter The limiter, or null. Ownership is not taken.
+    */
+    void setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter);
+
+    /**
+      Update the amount of response data in the socket buffer that is accounted
+      in the MemoryBudget. Must be called in the thread of this handler after
+      writing to the socket.
+    */
+    void accountOutput();
+
 public slots:
     /**  Set handlers for headers checking **/
     void setHeadersHandler(HeadersHandler headersHandler);
@@ -86,6 +141,34 @@ private:
     void startTimer(); // Start timer for next request
     void disconnectFromHost();
 
+    /** Pass an entry for the current request to the access log, if enabled */
+    void logAccess(const int status, const qint64 bytes);
+
+    /** Remove the current request from the watchdog, if registered */
+    void releaseWatchdog();
+
+    /**
+      Return the ticket of the current request to the concurrency limiter, if it has one.
+      @param completed True if the response has been written
+    */
+    void releaseLimiter(const bool completed);
+
+    /** Pass the current request to the request handler */
+    void dispatch(std::shared_ptr<HttpResponse> response, const bool closeConnection);
+
+    /** Reject the current request with status 503 and close the connection */
+    void rejectUnavailable();
+
+    /** Update the size of the current request body that is accounted in the MemoryBudget */
+    void accountBody();
+
+    /**
+      Reject the current request with status 503, if it has a large body and
+      the memory budget is exceeded.
+      @return true if the request has been rejected and the connection closed
+    */
+    bool shedRequest();
+
     /** Configuration settings */
     const QSettings* settings;
 
@@ -102,6 +185,57 @@ private:
     std::shared_ptr<HttpRequest> currentRequest;
     uint64_t currentRequestID;
 
+    /** Timings of the current request */
+    std::shared_ptr<RequestTimings> currentTimings;
+
+    /** Time when the current request has been received, msec since the epoch */
+    qint64 currentRequestTime;
+
+    /** Number of requests on the current connection */
+    int connectionRequests;
+
+    /** Access log, or null */
+    std::atomic<HttpAccessLog*> accessLog;
+
+    /** Tracer, or null */
+    std::atomic<HttpTracer*> tracer;
+
+    /** Trace of the current request, or null */
+    std::shared_ptr<TraceContext> currentTrace;
+
+    /** Watchdog, or null */
+    std::atomic<HttpWatchdog*> watchdog;
+
+    /** Watchdog where the current request is registered, or null */
+    HttpWatchdog* currentWatchdog;
+
+    /** Concurrency limiter, or null */
+    std::atomic<HttpConcurrencyLimiter*> concurrencyLimiter;
+
+    /** Concurrency limiter that issued the ticket of the current request, or null */
+    HttpConcurrencyLimiter* currentLimiter;
+
+    /** Ticket of the current request */
+    quint64 currentTicket;
+
+    /** Size of the current request body that is accounted in the MemoryBudget */
+    qint64 accountedBody;
+
+    /** Size of the socket output buffer that is accounted in the MemoryBudget */
+    qint64 accountedOutput;
+
+    /** Requests with smaller bodies are never rejected by the memory budget */
+    qint64 sheddingMinBodySize;
+
+    /** Value of the Retry-After header when a request is rejected with status 503 */
+    int retryAfter;
+
+    /** Time when the handler started to set up the current connection */
+    qint64 connectionAccepted;
+
+    /** Time when the socket of the current connection has been set up */
+    qint64 connectionReady;
+
     /** Dispatches received requests to services */
     HttpRequestHandler* requestHandler;
 
@@ -121,6 +255,18 @@ private:
     std::mutex  m_cancellerMutex;
     CancellerRef m_canceller;
 
+    /** Functions of socketPost() that have not been called yet, by their number */
+    std::map<quint64, std::function<void(bool)>> pendingPosts;
+
+    /** Number of the last function of socketPost() */
+    quint64 lastPost = 0;
+
+    /** Set by the destructor, then socketPost() calls the functions immediately with false */
+    bool postsClosed = false;
+
+    /** Protects pendingPosts, lastPost and postsClosed */
+    std::mutex postMutex;
+
 signals:
     void responseResultSocketSignal(ResponseResult);
     void queueFunctionSignal(QueuedFunction);
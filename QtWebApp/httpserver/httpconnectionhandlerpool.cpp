@@ -4,9 +4,11 @@
     #include <QSslCertificate>
     #include <QSslConfiguration>
 #endif
-#include <malloc.h>
 #include <QDir>
 #include "httpconnectionhandlerpool.h"
+#include "httplogging.h"
+#include "httpmemory.h"
+#include "metricsregistry.h"
 
 using namespace stefanfrings;
 
@@ -17,21 +19,43 @@ HttpConnectionHandlerPool::HttpConnectionHandlerPool(const QSettings *settings,
     this->settings=settings;
     this->requestHandler=requestHandler;
     this->sslConfiguration=NULL;
+    this->accessLog=nullptr;
+    this->tracer=nullptr;
+    this->watchdog=nullptr;
+    this->concurrencyLimiter=nullptr;
     loadSslConfig();
+    HttpMemory::configure(settings);
     cleanupTimer.start(settings->value("cleanupInterval",1000).toInt());
     connect(&cleanupTimer, SIGNAL(timeout()), SLOT(cleanup()));
+
+    MetricsRegistry& metrics=MetricsRegistry::instance();
+    handlersMetric=metrics.addCallback("qtwebapp_connection_handlers","Number of connection handlers",[this]
+    {
+        std::lock_guard lock{ mutex };
+        return static_cast<double>(pool.count());
+    });
+    busyHandlersMetric=metrics.addCallback("qtwebapp_connection_handlers_busy","Number of busy connection handlers",[this]
+    {
+        int busy;
+        int total;
+        getOccupancy(busy,total);
+        return static_cast<double>(busy);
+    });
 }
 
 
 HttpConnectionHandlerPool::~HttpConnectionHandlerPool()
 {
+    MetricsRegistry::instance().removeCallback(handlersMetric);
+    MetricsRegistry::instance().removeCallback(busyHandlersMetric);
+    setWatchdog(nullptr);
     // delete all connection handlers and wait until their threads are closed
     foreach(HttpConnectionHandler* handler, pool)
     {
        delete handler;
     }
     delete sslConfiguration;
-    qDebug("HttpConnectionHandlerPool (%p): destroyed", this);
+    qwaDebug(qwaHttpConnection,"HttpConnectionHandlerPool (%p): destroyed", this);
 }
 
 
@@ -57,12 +81,16 @@ HttpConnectionHandler* HttpConnectionHandlerPool::getConnectionHandler()
         if (pool.count()<maxConnectionHandlers)
         {
             freeHandler=new HttpConnectionHandler(settings,requestHandler,sslConfiguration);
+            freeHandler->setAccessLog(accessLog);
+            freeHandler->setTracer(tracer);
+            freeHandler->setWatchdog(watchdog);
+            freeHandler->setConcurrencyLimiter(concurrencyLimiter);
             freeHandler->setBusy();
             pool.append(freeHandler);
         }
         else
         {
-          qWarning("Pool is full: pool - %d, maxConnections - %d", pool.count(), maxConnectionHandlers);
+          qCWarning(qwaHttpConnection,"Pool is full: pool - %d, maxConnections - %d", pool.count(), maxConnectionHandlers);
         }
     }
 
@@ -70,6 +98,81 @@ HttpConnectionHandler* HttpConnectionHandlerPool::getConnectionHandler()
 }
 
 
+void HttpConnectionHandlerPool::setAccessLog(HttpAccessLog* accessLog)
+{
+    std::lock_guard lock{ mutex };
+    this->accessLog=accessLog;
+    foreach(HttpConnectionHandler* handler, pool)
+    {
+        handler->setAccessLog(accessLog);
+    }
+}
+
+
+void HttpConnectionHandlerPool::setTracer(HttpTracer* tracer)
+{
+    std::lock_guard lock{ mutex };
+    this->tracer=tracer;
+    foreach(HttpConnectionHandler* handler, pool)
+    {
+        handler->setTracer(tracer);
+    }
+}
+
+
+void HttpConnectionHandlerPool::setWatchdog(HttpWatchdog* watchdog)
+{
+    HttpWatchdog* previous;
+    {
+        std::lock_guard lock{ mutex };
+        previous=this->watchdog;
+        this->watchdog=watchdog;
+        foreach(HttpConnectionHandler* handler, pool)
+        {
+            handler->setWatchdog(watchdog);
+        }
+    }
+    // The watchdog locks the pool to get the occupancy, so it must not be called while the pool is locked
+    if (previous!=watchdog)
+    {
+        if (previous)
+        {
+            previous->removePool(this);
+        }
+        if (watchdog)
+        {
+            watchdog->addPool(this);
+        }
+    }
+}
+
+
+void HttpConnectionHandlerPool::setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter)
+{
+    std::lock_guard lock{ mutex };
+    this->concurrencyLimiter=concurrencyLimiter;
+    foreach(HttpConnectionHandler* handler, pool)
+    {
+        handler->setConcurrencyLimiter(concurrencyLimiter);
+    }
+}
+
+
+void HttpConnectionHandlerPool::getOccupancy(int& busy, int& total)
+{
+    std::lock_guard lock{ mutex };
+    busy=0;
+    total=pool.count();
+    foreach(HttpConnectionHandler* handler, pool)
+    {
+        if (handler->isBusy())
+        {
+            busy++;
+        }
+    }
+}
+
+
 void HttpConnectionHandlerPool::cleanup()
 {
     int maxIdleHandlers=settings->value("minThreads",1).toInt();
@@ -84,15 +187,11 @@ void HttpConnectionHandlerPool::cleanup()
             {
                 delete handler;
                 pool.removeOne(handler);
-                qDebug("HttpConnectionHandlerPool: Removed connection handler (%p), pool size is now %i",handler,pool.size());
+                qwaDebug(qwaHttpConnection,"HttpConnectionHandlerPool: Removed connection handler (%p), pool size is now %i",handler,pool.size());
                 break; // remove only one handler in each interval
             }
         }
     }
-
-#if defined(__linux__)
-    malloc_trim(0);
-#endif
 }
 
 
@@ -104,7 +203,7 @@ void HttpConnectionHandlerPool::loadSslConfig()
     if (!sslKeyFileName.isEmpty() && !sslCertFileName.isEmpty())
     {
         #ifdef QT_NO_SSL
-            qWarning("HttpConnectionHandlerPool: SSL is not supported");
+            qCWarning(qwaHttpConnection,"HttpConnectionHandlerPool: SSL is not supported");
         #else
             // Convert relative fileNames to absolute, based on the directory of the config file.
             QFileInfo configFile(settings->fileName());
@@ -129,7 +228,7 @@ void HttpConnectionHandlerPool::loadSslConfig()
             QFile certFile(sslCertFileName);
             if (!certFile.open(QIODevice::ReadOnly))
             {
-                qCritical("HttpConnectionHandlerPool: cannot open sslCertFile %s", qPrintable(sslCertFileName));
+                qCCritical(qwaHttpConnection,"HttpConnectionHandlerPool: cannot open sslCertFile %s", qPrintable(sslCertFileName));
                 return;
             }
             QSslCertificate certificate(&certFile, QSsl::Pem);
@@ -139,7 +238,7 @@ void HttpConnectionHandlerPool::loadSslConfig()
             QFile keyFile(sslKeyFileName);
             if (!keyFile.open(QIODevice::ReadOnly))
             {
-                qCritical("HttpConnectionHandlerPool: cannot open sslKeyFile %s", qPrintable(sslKeyFileName));
+                qCCritical(qwaHttpConnection,"HttpConnectionHandlerPool: cannot open sslKeyFile %s", qPrintable(sslKeyFileName));
                 return;
             }
             QSslKey sslKey(&keyFile, QSsl::Rsa, QSsl::Pem);
@@ -152,7 +251,7 @@ void HttpConnectionHandlerPool::loadSslConfig()
             sslConfiguration->setPeerVerifyMode(QSslSocket::VerifyNone);
             sslConfiguration->setProtocol(QSsl::TlsV1SslV3);
 
-            qDebug("HttpConnectionHandlerPool: SSL settings loaded");
+            qwaDebug(qwaHttpConnection,"HttpConnectionHandlerPool: SSL settings loaded");
          #endif
     }
 }
@@ -4,9 +4,10 @@
 #include <QList>
 #include <QTimer>
 #include <QObject>
-#include <QMutex>
 #include "httpglobal.h"
 #include "httpconnectionhandler.h"
+#include "httpwatchdog.h"
+#include "instrumentedmutex.h"
 
 namespace stefanfrings {
 
@@ -24,6 +25,10 @@ namespace stefanfrings {
   ;sslCertFile=ssl/my.cert
   maxRequestSize=16000
   maxMultiPartSize=1000000
+  ;poolAllocations=true
+  ;mallocArenas=0
+  ;trimThreshold=268435456
+  ;trimInterval=10000
   </pre></code>
   After server start, the size of the thread pool is always 0. Threads
   are started on demand when requests come in. The cleanup timer reduces
@@ -43,6 +48,7 @@ namespace stefanfrings {
   one with SLL and one without SSL.
   @see HttpConnectionHandler for description of the readTimeout
   @see HttpRequest for description of config settings maxRequestSize and maxMultiPartSize
+  @see HttpMemory for description of config settings poolAllocations, mallocArenas, trimThreshold and trimInterval
 */
 
 class DECLSPEC HttpConnectionHandlerPool : public QObject {
@@ -64,6 +70,36 @@ public:
     /** Get a free connection handler, or 0 if not available. */
     HttpConnectionHandler* getConnectionHandler();
 
+    /**
+      Set the access log of all connection handlers.
+      @param accessLog The access log, or null. Ownership is not taken.
+    */
+    void setAccessLog(HttpAccessLog* accessLog);
+
+    /**
+      Set the tracer of all connection handlers.
+      @param tracer The tracer, or null. Ownership is not taken.
+    */
+    void setTracer(HttpTracer* tracer);
+
+    /**
+      Set the watchdog of all connection handlers.
+      @param watchdog The watchdog, or null. Ownership is not taken.
+    */
+    void setWatchdog(HttpWatchdog* watchdog);
+
+    /**
+      Set the concurrency limiter of all connection handlers.
+      @param concurrencyLimiter The limiter, or null. Ownership is not taken.
+    */
+    void setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter);
+
+    /**
+      Get the number of busy and of all connection handlers.
+      This method is thread safe.
+    */
+    void getOccupancy(int& busy, int& total);
+
 private:
 
     /** Settings for this pool */
@@ -79,7 +115,25 @@ private:
     QTimer cleanupTimer;
 
     /** Used to synchronize threads */
-    QMutex mutex;
+    InstrumentedMutex mutex{"connection_handler_pool"};
+
+    /** Access log of the connection handlers, or null */
+    HttpAccessLog* accessLog;
+
+    /** Tracer of the connection handlers, or null */
+    HttpTracer* tracer;
+
+    /** Watchdog of the connection handlers, or null */
+    HttpWatchdog* watchdog;
+
+    /** Concurrency limiter of the connection handlers, or null */
+    HttpConcurrencyLimiter* concurrencyLimiter;
+
+    /** ID of the metric callback for the number of handlers */
+    int handlersMetric;
+
+    /** ID of the metric callback for the number of busy handlers */
+    int busyHandlersMetric;
 
     /** The SSL configuration (certificate, key and other settings) */
     QSslConfiguration* sslConfiguration;
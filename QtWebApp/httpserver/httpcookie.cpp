@@ -4,6 +4,7 @@
 */
 
 #include "httpcookie.h"
+#include "httplogging.h"
 
 using namespace stefanfrings;
 
@@ -88,7 +89,7 @@ HttpCookie::HttpCookie(const QByteArray source)
             }
             else
             {
-                qWarning("HttpCookie: Ignoring unknown %s=%s",name.data(),value.data());
+                qCWarning(qwaHttpRequest,"HttpCookie: Ignoring unknown %s=%s",name.data(),value.data());
             }
         }
     }
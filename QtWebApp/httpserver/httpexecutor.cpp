@@ -0,0 +1,136 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpexecutor.h"
+#include "httplogging.h"
+#include "metricsregistry.h"
+#include "threadname.h"
+#include <QThread>
+
+using namespace stefanfrings;
+
+HttpExecutor::HttpExecutor(const QByteArray& name, const int threads)
+{
+    this->name=name;
+    metricId=MetricsRegistry::instance().addCallback("qtwebapp_executor_queued_tasks","Number of functions that wait for a thread of the executor",[this]
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<double>(queue.size());
+    },"executor=\""+name+"\"");
+    for (int i=0; i<qMax(1,threads); i++)
+    {
+        this->threads.emplace_back(&HttpExecutor::run,this);
+    }
+    qwaDebug(qwaHttpConnection,"HttpExecutor: %s started with %i threads",name.constData(),getThreadCount());
+}
+
+
+HttpExecutor::~HttpExecutor()
+{
+    MetricsRegistry::instance().removeCallback(metricId);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+    }
+    condition.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    qwaDebug(qwaHttpConnection,"HttpExecutor: %s stopped",name.constData());
+}
+
+
+HttpExecutor& HttpExecutor::instance()
+{
+    // Never deleted, because coroutines may still be suspended at the end of the program
+    static HttpExecutor* executor=new HttpExecutor("qwa-executor",qMax(2,QThread::idealThreadCount()));
+    return *executor;
+}
+
+
+void HttpExecutor::post(std::function<void()> function)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(function));
+    }
+    condition.notify_one();
+}
+
+
+void HttpExecutor::postDelayed(const int msec, std::function<void()> function)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.push(Timer{Clock::now()+std::chrono::milliseconds(qMax(0,msec)),timerSequence++,std::move(function)});
+    }
+    // The new timer may be the next one, then a sleeping thread must recalculate its wait time
+    condition.notify_one();
+}
+
+
+QByteArray HttpExecutor::getName() const
+{
+    return name;
+}
+
+
+int HttpExecutor::getThreadCount() const
+{
+    return static_cast<int>(threads.size());
+}
+
+
+void HttpExecutor::run()
+{
+    setThreadName(name.constData());
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        // Move the timers that are due into the queue
+        const Clock::time_point now=Clock::now();
+        while (!timers.empty() && timers.top().deadline<=now)
+        {
+            queue.push_back(std::move(const_cast<Timer&>(timers.top()).function));
+            timers.pop();
+        }
+        if (queue.empty())
+        {
+            if (timers.empty())
+            {
+                condition.wait(lock);
+            }
+            else
+            {
+                // Copy, because the timers change while the lock is released
+                const Clock::time_point deadline=timers.top().deadline;
+                condition.wait_until(lock,deadline);
+            }
+            continue;
+        }
+        std::function<void()> function=std::move(queue.front());
+        queue.pop_front();
+        // Another thread takes over the remaining work
+        if (!queue.empty())
+        {
+            condition.notify_one();
+        }
+        lock.unlock();
+        try
+        {
+            function();
+        }
+        catch (const std::exception& ex)
+        {
+            qCCritical(qwaHttpConnection,"HttpExecutor: %s: uncaught exception: %s",name.constData(),ex.what());
+        }
+        catch (...)
+        {
+            qCCritical(qwaHttpConnection,"HttpExecutor: %s: uncaught exception",name.constData());
+        }
+        lock.lock();
+    }
+}
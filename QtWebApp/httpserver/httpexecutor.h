@@ -0,0 +1,125 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPEXECUTOR_H
+#define HTTPEXECUTOR_H
+
+#include <QByteArray>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Fixed number of worker threads that execute short functions and timers.
+  The AsyncRequestHandler resumes its coroutines here, so a request that waits
+  for I/O or a timer does not occupy a thread.
+  <p>
+  Functions must not block for a long time, because they delay all other
+  functions of the same executor. The number of queued functions is published
+  as the metric qtwebapp_executor_queued_tasks.
+*/
+
+class DECLSPEC HttpExecutor {
+    Q_DISABLE_COPY(HttpExecutor)
+public:
+
+    /**
+      Constructor, starts the threads.
+      @param name Name of the executor, used for the threads and the metrics
+      @param threads Number of threads, at least 1
+    */
+    HttpExecutor(const QByteArray& name, const int threads);
+
+    /**
+      Destructor, waits until the running functions have finished.
+      Queued functions and timers are discarded.
+    */
+    ~HttpExecutor();
+
+    /**
+      The shared executor of the library with one thread per CPU core.
+      It is created on first use and never deleted.
+    */
+    static HttpExecutor& instance();
+
+    /**
+      Execute a function in one of the threads.
+      This method is thread safe.
+    */
+    void post(std::function<void()> function);
+
+    /**
+      Execute a function after a delay.
+      This method is thread safe.
+      @param msec Delay in milliseconds
+      @param function Function to execute
+    */
+    void postDelayed(const int msec, std::function<void()> function);
+
+    /** Name of the executor */
+    QByteArray getName() const;
+
+    /** Number of threads */
+    int getThreadCount() const;
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    /** A function that waits for its time */
+    struct Timer {
+        Clock::time_point deadline;
+        /** Keeps timers with the same deadline in order */
+        quint64 sequence;
+        std::function<void()> function;
+        bool operator>(const Timer& other) const
+        {
+            return deadline!=other.deadline ? deadline>other.deadline : sequence>other.sequence;
+        }
+    };
+
+    /** Name of the executor */
+    QByteArray name;
+
+    /** Functions that wait for a thread */
+    std::deque<std::function<void()>> queue;
+
+    /** Timers, the next one first */
+    std::priority_queue<Timer,std::vector<Timer>,std::greater<Timer>> timers;
+
+    /** Number of timers that have been created */
+    quint64 timerSequence=0;
+
+    /** Protects the queue and the timers */
+    std::mutex mutex;
+
+    /** Wakes up the threads */
+    std::condition_variable condition;
+
+    /** Tells the threads to terminate */
+    bool stopping=false;
+
+    /** The worker threads */
+    std::vector<std::thread> threads;
+
+    /** Registration of the metric */
+    int metricId;
+
+    /** Main loop of a worker thread */
+    void run();
+};
+
+} // end of namespace
+
+#endif // HTTPEXECUTOR_H
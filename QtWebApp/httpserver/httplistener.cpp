@@ -4,6 +4,8 @@
 */
 
 #include "httplistener.h"
+#include "httplogging.h"
+#include "httpmetrics.h"
 #include "httpconnectionhandler.h"
 #include "httpconnectionhandlerpool.h"
 #include <QCoreApplication>
@@ -17,6 +19,10 @@ HttpListener::HttpListener(const QSettings* settings, HttpRequestHandler* reques
     Q_ASSERT(settings!=nullptr);
     Q_ASSERT(requestHandler!=nullptr);
     pool=nullptr;
+    accessLog=nullptr;
+    tracer=nullptr;
+    watchdog=nullptr;
+    concurrencyLimiter=nullptr;
     this->settings=settings;
     this->requestHandler=requestHandler;
     // Reqister type of socketDescriptor for signal/slot handling
@@ -29,7 +35,7 @@ HttpListener::HttpListener(const QSettings* settings, HttpRequestHandler* reques
 HttpListener::~HttpListener()
 {
     close();
-    qDebug("HttpListener: destroyed");
+    qwaDebug(qwaHttpConnection,"HttpListener: destroyed");
 }
 
 
@@ -38,6 +44,10 @@ void HttpListener::listen()
     if (!pool)
     {
         pool=new HttpConnectionHandlerPool(settings,requestHandler);
+        pool->setAccessLog(accessLog);
+        pool->setTracer(tracer);
+        pool->setWatchdog(watchdog);
+        pool->setConcurrencyLimiter(concurrencyLimiter);
     }
     QString host = settings->value("host").toString();
     quint16 port=settings->value("port").toUInt() & 0xFFFF;
@@ -45,17 +55,17 @@ void HttpListener::listen()
     setProxy(QNetworkProxy(QNetworkProxy::NoProxy));
     if (!isListening())
     {
-        qCritical("HttpListener: Cannot bind on port %i: %s",port,qPrintable(errorString()));
+        qCCritical(qwaHttpConnection,"HttpListener: Cannot bind on port %i: %s",port,qPrintable(errorString()));
     }
     else {
-        qDebug("HttpListener: Listening on port %i",port);
+        qwaDebug(qwaHttpConnection,"HttpListener: Listening on port %i",port);
     }
 }
 
 
 void HttpListener::close() {
     QTcpServer::close();
-    qDebug("HttpListener: closed");
+    qwaDebug(qwaHttpConnection,"HttpListener: closed");
     if (pool) {
         delete pool;
         pool=nullptr;
@@ -68,9 +78,45 @@ void stefanfrings::HttpListener::setHeadersHandler(const HeadersHandler& headers
   emit newHeadersHandler(headersHandler);
 }
 
+void HttpListener::setAccessLog(HttpAccessLog* accessLog)
+{
+    this->accessLog=accessLog;
+    if (pool)
+    {
+        pool->setAccessLog(accessLog);
+    }
+}
+
+void HttpListener::setTracer(HttpTracer* tracer)
+{
+    this->tracer=tracer;
+    if (pool)
+    {
+        pool->setTracer(tracer);
+    }
+}
+
+void HttpListener::setWatchdog(HttpWatchdog* watchdog)
+{
+    this->watchdog=watchdog;
+    if (pool)
+    {
+        pool->setWatchdog(watchdog);
+    }
+}
+
+void HttpListener::setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter)
+{
+    this->concurrencyLimiter=concurrencyLimiter;
+    if (pool)
+    {
+        pool->setConcurrencyLimiter(concurrencyLimiter);
+    }
+}
+
 void HttpListener::incomingConnection(tSocketDescriptor socketDescriptor) {
 #ifdef SUPERVERBOSE
-    qDebug("HttpListener: New connection");
+    qwaDebug(qwaHttpConnection,"HttpListener: New connection");
 #endif
 
     HttpConnectionHandler* freeHandler=nullptr;
@@ -80,7 +126,7 @@ void HttpListener::incomingConnection(tSocketDescriptor socketDescriptor) {
     }
     else
     {
-        qCritical("Pool is not initialized.");
+        qCCritical(qwaHttpConnection,"Pool is not initialized.");
     }
 
     connect(this, &HttpListener::newHeadersHandler, freeHandler, &HttpConnectionHandler::setHeadersHandler, Qt::UniqueConnection);
@@ -96,10 +142,11 @@ void HttpListener::incomingConnection(tSocketDescriptor socketDescriptor) {
     else
     {
         // Reject the connection
-        qDebug("HttpListener: Too many incoming connections");
+        qwaDebug(qwaHttpConnection,"HttpListener: Too many incoming connections");
         QTcpSocket* socket=new QTcpSocket(this);
         socket->setSocketDescriptor(socketDescriptor);
         connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        HttpMetrics::instance().rejectedUnavailable.add();
         socket->write("HTTP/1.1 503 too many connections\r\nConnection: close\r\n\r\nToo many connections\r\n");
         socket->disconnectFromHost();
     }
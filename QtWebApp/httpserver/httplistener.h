@@ -82,6 +82,35 @@ public:
      */
     void setHeadersHandler(const HeadersHandler &headersHandler);
 
+    /**
+      Enable the access log, which receives one entry per request.
+      @param accessLog The access log, or null to disable it. Ownership is not taken,
+      the access log must exist until the listener has been closed.
+    */
+    void setAccessLog(HttpAccessLog* accessLog);
+
+    /**
+      Enable tracing of requests.
+      @param tracer The tracer, or null to disable tracing. Ownership is not taken,
+      the tracer must exist until the listener has been closed.
+    */
+    void setTracer(HttpTracer* tracer);
+
+    /**
+      Enable the watchdog that reports slow requests.
+      @param watchdog The watchdog, or null to disable it. Ownership is not taken,
+      the watchdog must exist until the listener has been closed.
+    */
+    void setWatchdog(HttpWatchdog* watchdog);
+
+    /**
+      Enable the concurrency limiter, which holds back or rejects requests when the
+      services slow down.
+      @param concurrencyLimiter The limiter, or null to disable it. Ownership is not taken,
+      the limiter must exist until the listener has been closed.
+    */
+    void setConcurrencyLimiter(HttpConcurrencyLimiter* concurrencyLimiter);
+
 protected:
 
     /** Serves new incoming connection requests */
@@ -101,6 +130,18 @@ private:
     /** Handlers for headers checking of incomming connections */
     HeadersHandler headersHandler;
 
+    /** Access log, or null */
+    HttpAccessLog* accessLog;
+
+    /** Tracer, or null */
+    HttpTracer* tracer;
+
+    /** Watchdog, or null */
+    HttpWatchdog* watchdog;
+
+    /** Concurrency limiter, or null */
+    HttpConcurrencyLimiter* concurrencyLimiter;
+
 signals:
     /**
       Sent to the connection handler to process a new incoming connection.
@@ -0,0 +1,12 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httplogging.h"
+
+Q_LOGGING_CATEGORY(qwaHttpConnection,"qtwebapp.http.connection")
+Q_LOGGING_CATEGORY(qwaHttpRequest,"qtwebapp.http.request")
+Q_LOGGING_CATEGORY(qwaHttpSession,"qtwebapp.http.session")
+Q_LOGGING_CATEGORY(qwaHttpStatic,"qtwebapp.http.static")
+Q_LOGGING_CATEGORY(qwaHttpWatchdog,"qtwebapp.http.watchdog")
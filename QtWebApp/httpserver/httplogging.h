@@ -0,0 +1,38 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPLOGGING_H
+#define HTTPLOGGING_H
+
+#include <QLoggingCategory>
+#include "httpglobal.h"
+#include "debugoutput.h"
+
+/**
+  Logging categories of the HTTP server. They can be enabled or disabled
+  at runtime with QLoggingCategory::setFilterRules() or the QT_LOGGING_RULES
+  environment variable, e.g. "qtwebapp.http.request.debug=false".
+  <p>
+  A disabled category costs only a flag check, the arguments of the message
+  are not evaluated. Define QTWEBAPP_NO_DEBUG_OUTPUT to remove the debug
+  messages of the library completely at compile time.
+*/
+
+/** HttpListener, connection handlers and their pool */
+Q_DECLARE_LOGGING_CATEGORY(qwaHttpConnection)
+
+/** Parsing of requests and cookies */
+Q_DECLARE_LOGGING_CATEGORY(qwaHttpRequest)
+
+/** Sessions and the session store */
+Q_DECLARE_LOGGING_CATEGORY(qwaHttpSession)
+
+/** StaticFileController */
+Q_DECLARE_LOGGING_CATEGORY(qwaHttpStatic)
+
+/** Slow requests found by the HttpWatchdog */
+Q_DECLARE_LOGGING_CATEGORY(qwaHttpWatchdog)
+
+#endif // HTTPLOGGING_H
@@ -0,0 +1,117 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpmemory.h"
+#include "httplogging.h"
+#include "httptimings.h"
+#include "memorybudget.h"
+#include "metricsregistry.h"
+#include "sizeclasspool.h"
+#include "threadname.h"
+#include <QFile>
+#include <mutex>
+#include <thread>
+#if defined(__GLIBC__)
+    #include <malloc.h>
+#endif
+#ifdef Q_OS_UNIX
+    #include <unistd.h>
+#endif
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Check the resident size periodically and trim when it is too large */
+void trimLoop(const qint64 threshold, const int interval)
+{
+    setThreadName("qwa-memory");
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        if (HttpMemory::residentBytes()>threshold)
+        {
+            HttpMemory::trim();
+        }
+    }
+}
+
+}
+
+void HttpMemory::configure(const QSettings* settings)
+{
+    static std::once_flag configured;
+    std::call_once(configured,[settings]
+    {
+        SizeClassPool::setEnabled(settings->value("poolAllocations",true).toBool());
+        MemoryBudget::instance().setLimit(settings->value("memoryBudget",0).toLongLong());
+        const int arenas=settings->value("mallocArenas",0).toInt();
+        const qint64 threshold=settings->value("trimThreshold",268435456).toLongLong();
+        const int interval=qMax(100,settings->value("trimInterval",10000).toInt());
+
+        MetricsRegistry& metrics=MetricsRegistry::instance();
+        metrics.addCallback("qtwebapp_resident_memory_bytes","Resident memory size of the process",[]
+        {
+            return static_cast<double>(residentBytes());
+        });
+        metrics.addCallback("qtwebapp_pool_cached_bytes","Free memory in the shared lists of the SizeClassPool",[]
+        {
+            return static_cast<double>(SizeClassPool::cachedBytes());
+        });
+
+#if defined(__GLIBC__)
+        if (arenas>0)
+        {
+            mallopt(M_ARENA_MAX,arenas);
+        }
+        if (threshold>0 && residentBytes()>=0)
+        {
+            // Runs until the end of the program, like the allocator it maintains
+            std::thread(trimLoop,threshold,interval).detach();
+        }
+#else
+        Q_UNUSED(arenas)
+        Q_UNUSED(threshold)
+        Q_UNUSED(interval)
+#endif
+    });
+}
+
+qint64 HttpMemory::residentBytes()
+{
+#ifdef Q_OS_LINUX
+    // The second field is the resident size in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly))
+    {
+        QList<QByteArray> fields=statm.readAll().split(' ');
+        if (fields.size()>1)
+        {
+            return fields[1].toLongLong()*sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+void HttpMemory::trim()
+{
+#if defined(__GLIBC__)
+    static Histogram& duration=MetricsRegistry::instance().histogram("qtwebapp_malloc_trim_seconds","Duration of malloc_trim()",QByteArray(),1e-9);
+    static Counter& released=MetricsRegistry::instance().counter("qtwebapp_malloc_trim_released_bytes_total","Reduction of the resident memory size by malloc_trim()");
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    const qint64 before=residentBytes();
+    const qint64 start=RequestTimings::now();
+    malloc_trim(0);
+    duration.record(RequestTimings::now()-start);
+    const qint64 after=residentBytes();
+    if (before>after)
+    {
+        released.add(before-after);
+    }
+    qwaDebug(qwaHttpConnection,"HttpMemory: trimmed from %lld to %lld bytes",before,after);
+#endif
+}
@@ -0,0 +1,71 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPMEMORY_H
+#define HTTPMEMORY_H
+
+#include <QSettings>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Allocation strategy of the HTTP server. The settings are process wide and
+  are taken from the settings of the first HttpConnectionHandlerPool, that
+  is the first HttpListener.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  poolAllocations=true
+  mallocArenas=0
+  trimThreshold=268435456
+  trimInterval=10000
+  memoryBudget=0
+  sheddingMinBodySize=4096
+  retryAfter=5
+  </pre></code>
+
+  - poolAllocations enables recycling of the per-request objects by the SizeClassPool. Default is true.
+  - mallocArenas limits the number of glibc malloc arenas (M_ARENA_MAX). Fewer arenas reduce the
+    fragmentation caused by many threads, at the cost of more lock contention in malloc.
+    0 keeps the glibc default of 8 per CPU core (default).
+  - trimThreshold is the resident memory size in bytes above which free memory is returned
+    to the operating system with malloc_trim(). 0 disables trimming. Default is 256 MiB.
+  - trimInterval is the time in msec between two checks of the resident memory size. Default is 10000.
+  - memoryBudget limits the memory in bytes that is buffered for request bodies, pending response
+    data and the caches, see MemoryBudget. 0 disables the limit (default).
+  - sheddingMinBodySize is the smallest request body in bytes that is rejected with status 503
+    while the memory budget is exceeded. Default is 4096.
+  - retryAfter is the value of the Retry-After header of those responses in seconds. Default is 5.
+
+  The checks and trims run in a background thread, so they neither block the
+  pool nor the listener. The resident size and the duration of the trims are
+  published as the metrics qtwebapp_resident_memory_bytes and qtwebapp_malloc_trim_seconds.
+  Arenas and trimming are only available with glibc.
+*/
+
+class DECLSPEC HttpMemory {
+public:
+
+    /**
+      Apply the settings. Only the first call has an effect.
+      This method is thread safe.
+      @param settings Configuration settings of the listener
+    */
+    static void configure(const QSettings* settings);
+
+    /** Resident memory size of the process in bytes, or -1 if unknown */
+    static qint64 residentBytes();
+
+    /**
+      Return free memory to the operating system and record the duration.
+      This method is thread safe.
+    */
+    static void trim();
+};
+
+} // end of namespace
+
+#endif // HTTPMEMORY_H
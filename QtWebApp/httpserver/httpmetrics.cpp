@@ -0,0 +1,27 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpmetrics.h"
+
+using namespace stefanfrings;
+
+HttpMetrics& HttpMetrics::instance()
+{
+    static HttpMetrics metrics;
+    return metrics;
+}
+
+HttpMetrics::HttpMetrics()
+    : requests(MetricsRegistry::instance().counter("qtwebapp_requests_total","Number of processed HTTP requests")),
+      requestDuration(MetricsRegistry::instance().histogram("qtwebapp_request_duration_seconds","Time from receiving a request until the response has been written",QByteArray(),1e-9)),
+      bytesWritten(MetricsRegistry::instance().counter("qtwebapp_response_bytes_total","Number of bytes written by HTTP responses")),
+      parseErrors(MetricsRegistry::instance().counter("qtwebapp_parse_errors_total","Number of requests with a broken first line or with rejected headers")),
+      rejectedTooLarge(MetricsRegistry::instance().counter("qtwebapp_rejected_total","Number of rejected requests and connections","code=\"413\"")),
+      rejectedUnavailable(MetricsRegistry::instance().counter("qtwebapp_rejected_total","Number of rejected requests and connections","code=\"503\"")),
+      queuedRequests(MetricsRegistry::instance().gauge("qtwebapp_requests_queued","Number of requests waiting for a worker thread")),
+      activeRequests(MetricsRegistry::instance().gauge("qtwebapp_requests_active","Number of requests executed by a worker thread")),
+      staticCacheHits(MetricsRegistry::instance().counter("qtwebapp_static_cache_requests_total","Requests of the StaticFileController by cache result","result=\"hit\"")),
+      staticCacheMisses(MetricsRegistry::instance().counter("qtwebapp_static_cache_requests_total","Requests of the StaticFileController by cache result","result=\"miss\""))
+{}
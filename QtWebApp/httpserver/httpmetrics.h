@@ -0,0 +1,67 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPMETRICS_H
+#define HTTPMETRICS_H
+
+#include "httpglobal.h"
+#include "metricsregistry.h"
+
+namespace stefanfrings {
+
+/**
+  Metrics that the HTTP server records about itself. They are registered
+  in the MetricsRegistry on first use, afterwards recording is lock-free.
+  The number of connection handlers and sessions are provided by callbacks
+  of HttpConnectionHandlerPool and HttpSessionStore.
+  @see MetricsController
+*/
+
+class DECLSPEC HttpMetrics {
+    Q_DISABLE_COPY(HttpMetrics)
+public:
+
+    /** Get the process wide instance */
+    static HttpMetrics& instance();
+
+    /** Number of processed requests */
+    Counter& requests;
+
+    /** Time from receiving the first byte of a request until the response has been written */
+    Histogram& requestDuration;
+
+    /** Number of bytes that responses have written to the sockets */
+    Counter& bytesWritten;
+
+    /** Number of requests with a broken first line or with rejected headers */
+    Counter& parseErrors;
+
+    /** Number of requests that have been rejected because they were too large (413) */
+    Counter& rejectedTooLarge;
+
+    /** Number of connections and requests that have been rejected because all handlers were busy or the memory budget was exceeded (503) */
+    Counter& rejectedUnavailable;
+
+    /** Number of requests that wait for a worker thread */
+    Gauge& queuedRequests;
+
+    /** Number of requests that are executed by a worker thread */
+    Gauge& activeRequests;
+
+    /** Number of requests that the StaticFileController served from its cache */
+    Counter& staticCacheHits;
+
+    /** Number of requests that the StaticFileController could not serve from its cache */
+    Counter& staticCacheMisses;
+
+private:
+
+    /** Constructor, registers the metrics */
+    HttpMetrics();
+};
+
+} // end of namespace
+
+#endif // HTTPMETRICS_H
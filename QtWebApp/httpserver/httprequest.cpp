@@ -4,6 +4,7 @@
 */
 
 #include "httprequest.h"
+#include "httplogging.h"
 #include <QList>
 #include <QDir>
 #include "httpcookie.h"
@@ -16,6 +17,8 @@ HttpRequest::HttpRequest(const QSettings* settings, const HeadersHandler& header
     expectedBodySize=0;
     maxSize=settings->value("maxRequestSize","16000").toInt();
     maxMultiPartSize=settings->value("maxMultiPartSize","1000000").toLongLong();
+    headersCheckStarted=0;
+    headersCheckFinished=0;
 
     this->headersHandler=headersHandler;
 }
@@ -40,12 +43,14 @@ HttpRequest::HttpRequest(const HttpRequest& other)
     lineBuffer = other.lineBuffer;
     headersHandler = other.headersHandler;
     httpError = other.httpError;
+    headersCheckStarted = other.headersCheckStarted;
+    headersCheckFinished = other.headersCheckFinished;
 }
 
 void HttpRequest::readRequest(QTcpSocket* socket)
 {
     #ifdef SUPERVERBOSE
-        qDebug("HttpRequest: read request");
+        qwaDebug(qwaHttpRequest,"HttpRequest: read request");
     #endif
     int toRead=maxSize-currentSize+1; // allow one byte more to be able to detect overflow
     QByteArray dataRead = socket->readLine(toRead);
@@ -54,7 +59,7 @@ void HttpRequest::readRequest(QTcpSocket* socket)
     if (!lineBuffer.contains("\r\n"))
     {
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: collecting more parts until line break");
+            qwaDebug(qwaHttpRequest,"HttpRequest: collecting more parts until line break");
         #endif
         return;
     }
@@ -62,11 +67,11 @@ void HttpRequest::readRequest(QTcpSocket* socket)
     lineBuffer.clear();
     if (!newData.isEmpty())
     {
-        qDebug("HttpRequest: from %s: %s",qPrintable(socket->peerAddress().toString()),newData.data());
+        qwaDebug(qwaHttpRequest,"HttpRequest: from %s: %s",qPrintable(socket->peerAddress().toString()),newData.data());
         QList<QByteArray> list=newData.split(' ');
         if (list.count()!=3 || !list.at(2).contains("HTTP"))
         {
-            qWarning("HttpRequest: received broken HTTP request, invalid first line");
+            qCWarning(qwaHttpRequest,"HttpRequest: received broken HTTP request, invalid first line");
             status=abort;
         }
         else
@@ -89,7 +94,7 @@ void HttpRequest::readHeader(QTcpSocket* socket)
     if (!lineBuffer.contains("\r\n"))
     {
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: collecting more parts until line break");
+            qwaDebug(qwaHttpRequest,"HttpRequest: collecting more parts until line break");
         #endif
         return;
     }
@@ -103,14 +108,14 @@ void HttpRequest::readHeader(QTcpSocket* socket)
         QByteArray value=newData.mid(colon+1).trimmed();
         headers.insert(currentHeader,value);
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: received header %s: %s",currentHeader.data(),value.data());
+            qwaDebug(qwaHttpRequest,"HttpRequest: received header %s: %s",currentHeader.data(),value.data());
         #endif
     }
     else if (!newData.isEmpty())
     {
         // received another line - belongs to the previous header
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: read additional line of header");
+            qwaDebug(qwaHttpRequest,"HttpRequest: read additional line of header");
         #endif
         // Received additional line of previous header
         if (headers.contains(currentHeader)) {
@@ -121,7 +126,7 @@ void HttpRequest::readHeader(QTcpSocket* socket)
     {
         // received an empty line - end of headers reached
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: headers completed");
+            qwaDebug(qwaHttpRequest,"HttpRequest: headers completed");
         #endif
         // Empty line received, that means all headers have been received
         // Check for multipart/form-data
@@ -145,23 +150,23 @@ void HttpRequest::readHeader(QTcpSocket* socket)
         if (expectedBodySize==0)
         {
             #ifdef SUPERVERBOSE
-                qDebug("HttpRequest: expect no body");
+                qwaDebug(qwaHttpRequest,"HttpRequest: expect no body");
             #endif
             status=complete;
         }
         else if (boundary.isEmpty() && expectedBodySize+currentSize>maxSize)
         {
-            qWarning("HttpRequest: expected body is too large");
+            qCWarning(qwaHttpRequest,"HttpRequest: expected body is too large");
             status=abort;
         }
         else if (!boundary.isEmpty() && expectedBodySize>maxMultiPartSize)
         {
-            qWarning("HttpRequest: expected multipart body is too large");
+            qCWarning(qwaHttpRequest,"HttpRequest: expected multipart body is too large");
             status=abort;
         }
         else {
             #ifdef SUPERVERBOSE
-                qDebug("HttpRequest: expect %lld bytes body",expectedBodySize);
+                qwaDebug(qwaHttpRequest,"HttpRequest: expect %lld bytes body",expectedBodySize);
             #endif
             status=waitForBody;
         }
@@ -175,7 +180,7 @@ void HttpRequest::readBody(QTcpSocket* socket)
     {
         // normal body, no multipart
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: receive body");
+            qwaDebug(qwaHttpRequest,"HttpRequest: receive body");
         #endif
         int toRead=expectedBodySize-bodyData.size();
         QByteArray newData=socket->read(toRead);
@@ -190,7 +195,7 @@ void HttpRequest::readBody(QTcpSocket* socket)
     {
         // multipart body, store into temp file
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: receiving multipart body");
+            qwaDebug(qwaHttpRequest,"HttpRequest: receiving multipart body");
         #endif
         // Create an object for the temporary file, if not already present
         if (!tempFile)
@@ -211,18 +216,18 @@ void HttpRequest::readBody(QTcpSocket* socket)
         fileSize+=tempFile->write(socket->read(toRead));
         if (fileSize>=maxMultiPartSize)
         {
-            qWarning("HttpRequest: received too many multipart bytes");
+            qCWarning(qwaHttpRequest,"HttpRequest: received too many multipart bytes");
             status=abort;
         }
         else if (fileSize>=expectedBodySize)
         {
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: received whole multipart body");
+            qwaDebug(qwaHttpRequest,"HttpRequest: received whole multipart body");
         #endif
             tempFile->flush();
             if (tempFile->error())
             {
-                qCritical("HttpRequest: Error writing temp file for multipart body");
+                qCCritical(qwaHttpRequest,"HttpRequest: Error writing temp file for multipart body");
             }
             parseMultiPartFile();
             tempFile->close();
@@ -235,7 +240,7 @@ void HttpRequest::readBody(QTcpSocket* socket)
 void HttpRequest::decodeRequestParams()
 {
     #ifdef SUPERVERBOSE
-        qDebug("HttpRequest: extract and decode request parameters");
+        qwaDebug(qwaHttpRequest,"HttpRequest: extract and decode request parameters");
     #endif
     // Get URL parameters
     QByteArray rawParameters;
@@ -281,7 +286,7 @@ void HttpRequest::decodeRequestParams()
 void HttpRequest::extractCookies()
 {
     #ifdef SUPERVERBOSE
-        qDebug("HttpRequest: extract cookies");
+        qwaDebug(qwaHttpRequest,"HttpRequest: extract cookies");
     #endif
     foreach(QByteArray cookieStr, headers.values("cookie"))
     {
@@ -289,7 +294,7 @@ void HttpRequest::extractCookies()
         foreach(const QByteArray& part, list)
         {
             #ifdef SUPERVERBOSE
-                qDebug("HttpRequest: found cookie %s",part.data());
+                qwaDebug(qwaHttpRequest,"HttpRequest: found cookie %s",part.data());
             #endif                // Split the part into name and value
             QByteArray name;
             QByteArray value;
@@ -323,11 +328,14 @@ void HttpRequest::readFromSocket(QTcpSocket* socket)
 
         if (status != waitForHeader) {
             auto &[handlers, errorHandler] = headersHandler;
+            if (!handlers.empty())
+                headersCheckStarted = RequestTimings::now();
 
             for (const auto &handler : handlers) {
                 const auto [isOk, previousCheckingInfo, httpError] = handler({method, path, parameters, headers});
 
                 if (!isOk) {
+                    headersCheckFinished = RequestTimings::now();
                     status = wrongHeaders;
                     errorHandler(httpError);
                     this->httpError = errorHandler;
@@ -337,6 +345,9 @@ void HttpRequest::readFromSocket(QTcpSocket* socket)
                 if (previousCheckingInfo.isFinalChecking)
                     break;
             }
+
+            if (headersCheckStarted)
+                headersCheckFinished = RequestTimings::now();
         }
     }
     else if (status==waitForBody)
@@ -348,7 +359,7 @@ void HttpRequest::readFromSocket(QTcpSocket* socket)
     // Comparetion "currentSize>maxMultiPartSize" might work incorrectly when maxMultiPartSize >= MAX_INT
     if ((boundary.isEmpty() && currentSize>maxSize) || (!boundary.isEmpty() && currentSize>maxMultiPartSize))
     {
-        qWarning("HttpRequest: received too many bytes");
+        qCWarning(qwaHttpRequest,"HttpRequest: received too many bytes");
         status=abort;
     }
     if (status==complete)
@@ -448,13 +459,13 @@ QByteArray HttpRequest::urlDecode(const QByteArray& source)
 
 void HttpRequest::parseMultiPartFile()
 {
-    qDebug("HttpRequest: parsing multipart temp file");
+    qwaDebug(qwaHttpRequest,"HttpRequest: parsing multipart temp file");
     tempFile->seek(0);
     bool finished=false;
     while (!tempFile->atEnd() && !finished && !tempFile->error())
     {
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: reading multpart headers");
+            qwaDebug(qwaHttpRequest,"HttpRequest: reading multpart headers");
         #endif
         QByteArray fieldName;
         QByteArray fileName;
@@ -492,12 +503,12 @@ void HttpRequest::parseMultiPartFile()
                         fileName=line.mid(start+10,end-start-10);
                     }
                     #ifdef SUPERVERBOSE
-                        qDebug("HttpRequest: multipart field=%s, filename=%s",fieldName.data(),fileName.data());
+                        qwaDebug(qwaHttpRequest,"HttpRequest: multipart field=%s, filename=%s",fieldName.data(),fileName.data());
                     #endif
                 }
                 else
                 {
-                    qDebug("HttpRequest: ignoring unsupported content part %s",line.data());
+                    qwaDebug(qwaHttpRequest,"HttpRequest: ignoring unsupported content part %s",line.data());
                 }
             }
             else if (line.isEmpty())
@@ -507,7 +518,7 @@ void HttpRequest::parseMultiPartFile()
         }
 
         #ifdef SUPERVERBOSE
-            qDebug("HttpRequest: reading multpart data");
+            qwaDebug(qwaHttpRequest,"HttpRequest: reading multpart data");
         #endif
         std::shared_ptr<QTemporaryFile> uploadedFile;
         QByteArray fieldValue;
@@ -523,7 +534,7 @@ void HttpRequest::parseMultiPartFile()
                     // last field was a form field
                     fieldValue.remove(fieldValue.size()-2,2);
                     parameters.insert(fieldName,fieldValue);
-                    qDebug("HttpRequest: set parameter %s=%s",fieldName.data(),fieldValue.data());
+                    qwaDebug(qwaHttpRequest,"HttpRequest: set parameter %s=%s",fieldName.data(),fieldValue.data());
                 }
                 else if (!fileName.isEmpty() && !fieldName.isEmpty())
                 {
@@ -531,19 +542,19 @@ void HttpRequest::parseMultiPartFile()
                     if (uploadedFile)
                     {
                         #ifdef SUPERVERBOSE
-                            qDebug("HttpRequest: finishing writing to uploaded file");
+                            qwaDebug(qwaHttpRequest,"HttpRequest: finishing writing to uploaded file");
                         #endif
                         uploadedFile->resize(uploadedFile->size()-2);
                         uploadedFile->flush();
                         uploadedFile->seek(0);
                         parameters.insert(fieldName,fileName);
-                        qDebug("HttpRequest: set parameter %s=%s",fieldName.data(),fileName.data());
+                        qwaDebug(qwaHttpRequest,"HttpRequest: set parameter %s=%s",fieldName.data(),fileName.data());
                         uploadedFiles.insert(fieldName,uploadedFile);
-                        qDebug("HttpRequest: uploaded file size is %lli",uploadedFile->size());
+                        qwaDebug(qwaHttpRequest,"HttpRequest: uploaded file size is %lli",uploadedFile->size());
                     }
                     else
                     {
-                        qWarning("HttpRequest: format error, unexpected end of file data");
+                        qCWarning(qwaHttpRequest,"HttpRequest: format error, unexpected end of file data");
                     }
                 }
                 if (line.contains(boundary+"--"))
@@ -571,7 +582,7 @@ void HttpRequest::parseMultiPartFile()
                     uploadedFile->write(line);
                     if (uploadedFile->error())
                     {
-                        qCritical("HttpRequest: error writing temp file, %s",qPrintable(uploadedFile->errorString()));
+                        qCCritical(qwaHttpRequest,"HttpRequest: error writing temp file, %s",qPrintable(uploadedFile->errorString()));
                     }
                 }
             }
@@ -579,10 +590,10 @@ void HttpRequest::parseMultiPartFile()
     }
     if (tempFile->error())
     {
-        qCritical("HttpRequest: cannot read temp file, %s",qPrintable(tempFile->errorString()));
+        qCCritical(qwaHttpRequest,"HttpRequest: cannot read temp file, %s",qPrintable(tempFile->errorString()));
     }
     #ifdef SUPERVERBOSE
-        qDebug("HttpRequest: finished parsing multipart temp file");
+        qwaDebug(qwaHttpRequest,"HttpRequest: finished parsing multipart temp file");
     #endif
 }
 
@@ -620,3 +631,13 @@ const HttpError& stefanfrings::HttpRequest::getHttpError() const
 {
     return httpError;
 }
+
+qint64 HttpRequest::getHeadersCheckStarted() const
+{
+    return headersCheckStarted;
+}
+
+qint64 HttpRequest::getHeadersCheckFinished() const
+{
+    return headersCheckFinished;
+}
@@ -16,6 +16,7 @@
 #include <QTemporaryFile>
 #include "httpglobal.h"
 #include "httpheadershandler.h"
+#include "httptimings.h"
 
 namespace stefanfrings {
 
@@ -157,6 +158,15 @@ public:
     */
     const HttpError& getHttpError() const;
 
+    /**
+      Time when the handlers for headers checking have been called,
+      see RequestTimings::now(). 0 if there are no handlers.
+    */
+    qint64 getHeadersCheckStarted() const;
+
+    /** Time when the handlers for headers checking have finished, 0 if there are no handlers. */
+    qint64 getHeadersCheckFinished() const;
+
 private:
 
     /** Request headers */
@@ -239,6 +249,12 @@ private:
 
     /** Http error of failed headers checking */
     HttpError httpError;
+
+    /** Start of the headers checking */
+    qint64 headersCheckStarted;
+
+    /** End of the headers checking */
+    qint64 headersCheckFinished;
 };
 
 } // end of namespace
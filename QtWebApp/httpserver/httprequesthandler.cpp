@@ -4,14 +4,44 @@
 */
 
 #include "httprequesthandler.h"
+#include "httplogging.h"
+#include "httpmetrics.h"
+#include "threadname.h"
+#ifdef QTWEBAPP_LOGGING
+    #include "logger.h"
+#endif
 #include <QtConcurrent/QtConcurrentRun>
 #include <thread>
+#ifdef Q_OS_LINUX
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
 
 using namespace stefanfrings;
 
 static const auto isRegisteredServiceParams = qRegisterMetaType<ServiceParams>("ServiceParams");
 static const auto isRegisteredResponseResult = qRegisterMetaType<ResponseResult>("ResponseResult");
 
+namespace {
+
+/** Remembers the cancellation of a request that waits for a thread of the scheduler */
+class QueuedCanceller : public ICanceller {
+public:
+    void cancel() override { cancelled = true; }
+    bool isCancelled() const { return cancelled; }
+private:
+    std::atomic_bool cancelled{ false };
+};
+
+#ifdef QTWEBAPP_LOGGING
+/** Clears the log variables and the backtrace buffer of the thread when the service has finished */
+struct ThreadLogScope {
+    ~ThreadLogScope() { Logger::clearThread(); }
+};
+#endif
+
+}
+
 HttpRequestHandler::HttpRequestHandler(QObject* parent)
     : QObject(parent)
 {}
@@ -21,27 +51,100 @@ void HttpRequestHandler::service(ServiceParams params)
     auto& request = params.request;
     auto& response = params.response;
 
-    qCritical("HttpRequestHandler: you need to override the service() function");
-    qDebug("HttpRequestHandler: request=%s %s %s", request->getMethod().data(), request->getPath().data(), request->getVersion().data());
+    qCCritical(qwaHttpConnection,"HttpRequestHandler: you need to override the service() function");
+    qwaDebug(qwaHttpConnection,"HttpRequestHandler: request=%s %s %s", request->getMethod().data(), request->getPath().data(), request->getVersion().data());
     response->setStatus(501,"not implemented");
     response->write("501 not implemented",true);
 }
 
 void HttpRequestHandler::callService(ServiceParams params)
 {
-    std::thread([this, params] {
-        try {
-            service(params);
-        }
-        catch (const std::exception& ex) {
-            qCritical("HttpConnectionHandler (%p): An uncatched exception occured in the request handler: %s",
-                static_cast<void*>(this), ex.what());
-        }
-        catch (...) {
-            qCritical("HttpConnectionHandler (%p): An uncatched exception occured in the request handler",
-                static_cast<void*>(this));
-        }
-    }).detach();
+    HttpMetrics::instance().queuedRequests.add(1);
+    HttpScheduler* activeScheduler = scheduler.load();
+    if (!activeScheduler) {
+        std::thread([this, params] {
+            setThreadName("qwa-worker");
+            runService(params);
+        }).detach();
+        return;
+    }
+
+    // A request that gets cancelled while it waits for a thread is not processed
+    auto canceller = std::make_shared<QueuedCanceller>();
+    if (params.cancellerInitialization)
+        params.cancellerInitialization(canceller);
+    const int retryAfter = activeScheduler->getRetryAfter();
+    const bool queued = activeScheduler->submit(priorityClass(params), [this, params, canceller, retryAfter] {
+        if (canceller->isCancelled())
+            rejectUnavailable(params, retryAfter);
+        else
+            runService(params);
+    }, [this, params, retryAfter] {
+        rejectUnavailable(params, retryAfter);
+    });
+    if (!queued)
+        rejectUnavailable(params, retryAfter);
 }
 
+void HttpRequestHandler::setScheduler(HttpScheduler* scheduler)
+{
+    this->scheduler = scheduler;
+}
 
+QByteArray HttpRequestHandler::priorityClass(const ServiceParams& params) const
+{
+    HttpScheduler* activeScheduler = scheduler.load();
+    return activeScheduler ? activeScheduler->classify(params.request->getPath()) : QByteArray();
+}
+
+void HttpRequestHandler::runService(const ServiceParams& params)
+{
+    HttpMetrics& metrics = HttpMetrics::instance();
+    if (params.timings) {
+        params.timings->serviceStarted = RequestTimings::now();
+#ifdef Q_OS_LINUX
+        params.timings->serviceThread = syscall(SYS_gettid);
+#endif
+    }
+    metrics.queuedRequests.add(-1);
+    metrics.activeRequests.add(1);
+#ifdef QTWEBAPP_LOGGING
+    // The threads of the scheduler serve many requests, which must not see the variables of the previous one
+    ThreadLogScope logScope;
+    // Log messages of the service carry the IDs of the trace
+    if (params.trace) {
+        Logger::set("traceId", QString::fromLatin1(params.trace->traceId));
+        Logger::set("spanId", QString::fromLatin1(params.trace->spanId));
+    }
+#endif
+    try {
+        service(params);
+    }
+    catch (const std::exception& ex) {
+        qCCritical(qwaHttpConnection,"HttpConnectionHandler (%p): An uncatched exception occured in the request handler: %s",
+            static_cast<void*>(this), ex.what());
+    }
+    catch (...) {
+        qCCritical(qwaHttpConnection,"HttpConnectionHandler (%p): An uncatched exception occured in the request handler",
+            static_cast<void*>(this));
+    }
+    if (params.timings)
+        params.timings->serviceThread = 0;
+    metrics.activeRequests.add(-1);
+}
+
+void HttpRequestHandler::rejectUnavailable(const ServiceParams& params, const int retryAfter)
+{
+    HttpMetrics& metrics = HttpMetrics::instance();
+    metrics.queuedRequests.add(-1);
+    metrics.rejectedUnavailable.add();
+    qwaDebug(qwaHttpConnection,"HttpRequestHandler: rejected request %llu", static_cast<unsigned long long>(params.requestID));
+
+    // The connection writes the response in its own thread
+    std::shared_ptr<HttpResponse> response = params.response;
+    emit responseResultSignal(ResponseResult{ params.requestID, response, [response, retryAfter] {
+        response->setStatus(503, "Service Unavailable");
+        response->setHeader("Retry-After", retryAfter);
+        response->write("503 Service Unavailable", true);
+    }, params.closeSocketAfterResponse, WriteToSocket::YES });
+}
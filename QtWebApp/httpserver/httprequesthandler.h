@@ -9,6 +9,10 @@
 #include "httpglobal.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "httpscheduler.h"
+#include "httptimings.h"
+#include "httptracer.h"
+#include <atomic>
 
 namespace stefanfrings {
 
@@ -43,6 +47,10 @@ struct ServiceParams {
     std::shared_ptr<HttpResponse> response;
     CloseSocket closeSocketAfterResponse;
     CancellerInitialization cancellerInitialization;
+    /** Timings of the request, may be null */
+    std::shared_ptr<RequestTimings> timings;
+    /** Trace of the request, null if the request is not traced */
+    std::shared_ptr<const TraceContext> trace;
 };
 
 enum class WriteToSocket : int {
@@ -71,7 +79,22 @@ public:
     HttpRequestHandler(QObject* parent=nullptr);
     ~HttpRequestHandler() = default;
 
-	void callService(ServiceParams params);
+    /**
+      Process a request. The default implementation calls service() in a new thread,
+      or in a thread of the scheduler if one has been set.
+      Called by the HttpConnectionHandler.
+    */
+    virtual void callService(ServiceParams params);
+
+    /**
+      Run service() in the threads of a scheduler, instead of a new thread for
+      each request. Requests are rejected with status 503 when the queue of
+      their priority class is full. The AsyncRequestHandler ignores the scheduler.
+      This method is thread safe.
+      @param scheduler The scheduler, or null. Ownership is not taken,
+      the scheduler must exist until the listener has been closed.
+    */
+    void setScheduler(HttpScheduler* scheduler);
 
 signals:
     void responseResultSignal(ResponseResult);
@@ -84,6 +107,26 @@ protected:
       @warning This method must be thread safe
     */
     virtual void service(ServiceParams params);
+
+    /**
+      Select the priority class of a request, when a scheduler has been set.
+      The default implementation uses the routes of the scheduler. Override it
+      to assign the class by other properties of the request.
+      @param params The request
+      @return Name of the class
+    */
+    virtual QByteArray priorityClass(const ServiceParams& params) const;
+
+private:
+
+    /** Scheduler, or null */
+    std::atomic<HttpScheduler*> scheduler{nullptr};
+
+    /** Call service() and update the timings and metrics */
+    void runService(const ServiceParams& params);
+
+    /** Reject a request with status 503 */
+    void rejectUnavailable(const ServiceParams& params, const int retryAfter);
 };
 
 } // end of namespace
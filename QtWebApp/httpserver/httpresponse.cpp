@@ -4,6 +4,8 @@
 */
 
 #include "httpresponse.h"
+#include "httpconnectionhandler.h"
+#include "httpmetrics.h"
 
 using namespace stefanfrings;
 
@@ -16,6 +18,7 @@ HttpResponse::HttpResponse(QTcpSocket *socket, HttpConnectionHandler& connection
     sentHeaders=false;
     sentLastPart=false;
     chunkedMode=false;
+    bytesWritten=0;
 }
 
 void HttpResponse::setHeader(const QByteArray& name, const QByteArray& value)
@@ -76,6 +79,11 @@ void HttpResponse::writeHeaders()
 
 bool HttpResponse::writeToSocket(const QByteArray& data)
 {
+    // Streamed responses start writing long before the service has finished
+    if (timings && timings->writeStarted==0)
+    {
+        timings->writeStarted=RequestTimings::now();
+    }
     int remaining=data.size();
     const char* ptr=data.constData();
     while (socket->isOpen() && remaining>0)
@@ -93,7 +101,10 @@ bool HttpResponse::writeToSocket(const QByteArray& data)
         }
         ptr+=written;
         remaining-=written;
+        bytesWritten+=written;
+        HttpMetrics::instance().bytesWritten.add(written);
     }
+    connectionHandler.accountOutput();
     return true;
 }
 
@@ -203,3 +214,15 @@ bool HttpResponse::isConnected() const
 {
     return socket->isOpen();
 }
+
+
+qint64 HttpResponse::getBytesWritten() const
+{
+    return bytesWritten;
+}
+
+
+void HttpResponse::setTimings(const std::shared_ptr<RequestTimings>& timings)
+{
+    this->timings=timings;
+}
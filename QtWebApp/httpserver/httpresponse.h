@@ -9,8 +9,10 @@
 #include <QMap>
 #include <QString>
 #include <QTcpSocket>
+#include <memory>
 #include "httpglobal.h"
 #include "httpcookie.h"
+#include "httptimings.h"
 
 class ISocketWriter {
 public:
@@ -130,6 +132,18 @@ public:
      */
     bool isConnected() const;
 
+    /**
+      Number of bytes that have been passed to the socket, including the headers.
+      Data that ISocketWriter instances write directly are not counted.
+    */
+    qint64 getBytesWritten() const;
+
+    /**
+      Set the timings of the request, so the first write to the socket
+      records RequestTimings::writeStarted. Called by the connection handler.
+    */
+    void setTimings(const std::shared_ptr<RequestTimings>& timings);
+
 protected:
     /** Socket for writing output */
     QTcpSocket* socket;
@@ -158,6 +172,12 @@ private:
     /** Cookies */
     QMap<QByteArray,HttpCookie> cookies;
 
+    /** Number of bytes passed to the socket */
+    qint64 bytesWritten;
+
+    /** Timings of the request, or null */
+    std::shared_ptr<RequestTimings> timings;
+
     /** Write raw data to the socket. This method blocks until all bytes have been passed to the TCP buffer */
     bool writeToSocket(const QByteArray& data);
 
@@ -0,0 +1,335 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpscheduler.h"
+#include "httplogging.h"
+#include "metricsregistry.h"
+#include "threadname.h"
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+using namespace stefanfrings;
+
+namespace {
+
+/**
+  Check whether a path belongs to a route. The prefix must end at a segment
+  boundary, so "/reports" matches "/reports" and "/reports/1" but not "/reportsXYZ".
+*/
+bool matchesPrefix(const QByteArray& path, const QByteArray& prefix)
+{
+    return path.startsWith(prefix) &&
+           (path.size()==prefix.size() || prefix.isEmpty() || prefix.endsWith('/') || path.at(prefix.size())=='/');
+}
+
+/** Read a comma separated list of names, each followed by a colon and a value */
+QList<QPair<QByteArray,QByteArray>> readList(const QSettings* settings, const char* key)
+{
+    QList<QPair<QByteArray,QByteArray>> list;
+    foreach (const QString& entry, settings->value(key).toString().split(',',QString::SkipEmptyParts))
+    {
+        const int colon=entry.lastIndexOf(':');
+        const QByteArray name=entry.left(colon).trimmed().toUtf8();
+        const QByteArray value=colon>0 ? entry.mid(colon+1).trimmed().toUtf8() : QByteArray();
+        if (name.isEmpty() || value.isEmpty())
+        {
+            qCWarning(qwaHttpConnection,"HttpScheduler: ignoring invalid entry %s of %s",qPrintable(entry),key);
+            continue;
+        }
+        list.append(qMakePair(name,value));
+    }
+    return list;
+}
+
+}
+
+HttpScheduler::HttpScheduler(const QSettings* settings)
+{
+    Q_ASSERT(settings!=nullptr);
+    strict=settings->value("scheduling","weighted").toString()=="strict";
+    retryAfter=settings->value("retryAfter",5).toInt();
+
+    typedef QPair<QByteArray,QByteArray> Entry;
+    foreach (const Entry& entry, readList(settings,"classes"))
+    {
+        classes.emplace_back();
+        classes.back().name=entry.first;
+        classes.back().weight=qMax(1,entry.second.toInt());
+    }
+    if (classes.empty())
+    {
+        classes.emplace_back();
+        classes.back().name="default";
+        classes.back().weight=1;
+    }
+    defaultClass=indexOf(settings->value("defaultClass").toByteArray());
+    if (defaultClass<0)
+    {
+        defaultClass=static_cast<int>(classes.size())-1;
+    }
+
+    MetricsRegistry& metrics=MetricsRegistry::instance();
+    for (PriorityClass& c : classes)
+    {
+        c.queueSize=100;
+        c.rejected=&metrics.counter("qtwebapp_scheduler_rejected_total","Number of requests that have been rejected because the queue of their class was full",
+                                    "class=\""+c.name+"\"");
+    }
+    foreach (const Entry& entry, readList(settings,"queueSize"))
+    {
+        const int index=indexOf(entry.first);
+        if (index<0)
+        {
+            qCWarning(qwaHttpConnection,"HttpScheduler: unknown class %s in queueSize",entry.first.constData());
+            continue;
+        }
+        classes[index].queueSize=qMax(0,entry.second.toInt());
+    }
+
+    foreach (const Entry& entry, readList(settings,"routes"))
+    {
+        const int index=indexOf(entry.second);
+        if (index<0)
+        {
+            qCWarning(qwaHttpConnection,"HttpScheduler: unknown class %s in routes",entry.second.constData());
+            continue;
+        }
+        routes.append(qMakePair(entry.first,index));
+    }
+    std::sort(routes.begin(),routes.end(),[](const QPair<QByteArray,int>& a, const QPair<QByteArray,int>& b)
+    {
+        return a.first.size()>b.first.size();
+    });
+
+    for (size_t i=0; i<classes.size(); i++)
+    {
+        const QByteArray label="class=\""+classes[i].name+"\"";
+        metricIds.append(metrics.addCallback("qtwebapp_scheduler_queued","Number of requests that wait for a thread of the scheduler",[this,i]
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<double>(classes[i].queue.size());
+        },label));
+        metricIds.append(metrics.addCallback("qtwebapp_scheduler_active","Number of requests that are processed by the threads of the scheduler",[this,i]
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<double>(classes[i].active);
+        },label));
+    }
+
+    // Start the own threads of the classes
+    QVector<int> ownThreads(static_cast<int>(classes.size()),0);
+    foreach (const Entry& entry, readList(settings,"threads"))
+    {
+        const int index=indexOf(entry.first);
+        if (index<0)
+        {
+            qCWarning(qwaHttpConnection,"HttpScheduler: unknown class %s in threads",entry.first.constData());
+            continue;
+        }
+        ownThreads[index]=qMax(0,entry.second.toInt());
+    }
+    for (int i=0; i<ownThreads.size(); i++)
+    {
+        for (int j=0; j<ownThreads[i]; j++)
+        {
+            threads.emplace_back(&HttpScheduler::run,this,i);
+        }
+        qwaDebug(qwaHttpConnection,"HttpScheduler: class %s has weight %i, %i own threads and queue size %i",
+                 classes[i].name.constData(),classes[i].weight,ownThreads[i],classes[i].queueSize);
+    }
+
+    // Without shared threads, a class without own threads would never be served
+    int sharedThreads=qMax(0,settings->value("sharedThreads",QThread::idealThreadCount()).toInt());
+    if (sharedThreads==0 && ownThreads.contains(0))
+    {
+        qCWarning(qwaHttpConnection,"HttpScheduler: a class has no threads, starting one shared thread");
+        sharedThreads=1;
+    }
+    for (int i=0; i<sharedThreads; i++)
+    {
+        threads.emplace_back(&HttpScheduler::run,this,-1);
+    }
+    qwaDebug(qwaHttpConnection,"HttpScheduler: started with %i shared threads",sharedThreads);
+}
+
+
+HttpScheduler::~HttpScheduler()
+{
+    foreach (int id, metricIds)
+    {
+        MetricsRegistry::instance().removeCallback(id);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+        for (PriorityClass& c : classes)
+        {
+            c.condition.notify_all();
+        }
+        condition.notify_all();
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    // The clients of the queued requests get a response, and the metrics of the queue go down
+    int rejected=0;
+    for (PriorityClass& c : classes)
+    {
+        for (Item& item : c.queue)
+        {
+            if (item.reject)
+            {
+                item.reject();
+            }
+            rejected++;
+        }
+        c.queue.clear();
+    }
+    qwaDebug(qwaHttpConnection,"HttpScheduler: stopped, rejected %i queued requests",rejected);
+}
+
+
+QByteArray HttpScheduler::classify(const QByteArray& path) const
+{
+    for (const QPair<QByteArray,int>& route : routes)
+    {
+        if (matchesPrefix(path,route.first))
+        {
+            return classes[route.second].name;
+        }
+    }
+    return classes[defaultClass].name;
+}
+
+
+bool HttpScheduler::submit(const QByteArray& className, std::function<void()> function, std::function<void()> reject)
+{
+    const int index=indexOf(className);
+    std::lock_guard<std::mutex> lock(mutex);
+    PriorityClass& c=classes[index<0 ? defaultClass : index];
+    // Functions that idle threads are going to take over do not wait
+    if (stopping || static_cast<int>(c.queue.size())>=c.queueSize+c.idle+idle)
+    {
+        c.rejected->add();
+        qwaDebug(qwaHttpConnection,"HttpScheduler: queue of class %s is full",c.name.constData());
+        return false;
+    }
+    c.queue.push_back(Item{std::move(function),std::move(reject)});
+    // Prefer the own threads of the class, the shared threads take over what they cannot handle
+    if (c.idle>0)
+    {
+        c.condition.notify_one();
+    }
+    if (idle>0 && static_cast<int>(c.queue.size())>c.idle)
+    {
+        condition.notify_one();
+    }
+    return true;
+}
+
+
+int HttpScheduler::getRetryAfter() const
+{
+    return retryAfter;
+}
+
+
+int HttpScheduler::indexOf(const QByteArray& name) const
+{
+    for (size_t i=0; i<classes.size(); i++)
+    {
+        if (classes[i].name==name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+
+HttpScheduler::PriorityClass* HttpScheduler::next()
+{
+    // Smooth weighted round robin over the classes that have waiting requests
+    PriorityClass* selected=nullptr;
+    int total=0;
+    for (PriorityClass& c : classes)
+    {
+        if (c.queue.empty())
+        {
+            continue;
+        }
+        if (strict)
+        {
+            return &c;
+        }
+        c.current+=c.weight;
+        total+=c.weight;
+        if (!selected || c.current>selected->current)
+        {
+            selected=&c;
+        }
+    }
+    if (selected)
+    {
+        selected->current-=total;
+    }
+    return selected;
+}
+
+
+void HttpScheduler::run(const int own)
+{
+    setThreadName(own<0 ? "qwa-scheduler" : QByteArray("qwa-"+classes[own].name).constData());
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        PriorityClass* c;
+        if (own<0)
+        {
+            c=next();
+        }
+        else
+        {
+            c=classes[own].queue.empty() ? nullptr : &classes[own];
+        }
+        if (!c)
+        {
+            if (own<0)
+            {
+                idle++;
+                condition.wait(lock);
+                idle--;
+            }
+            else
+            {
+                classes[own].idle++;
+                classes[own].condition.wait(lock);
+                classes[own].idle--;
+            }
+            continue;
+        }
+        std::function<void()> function=std::move(c->queue.front().function);
+        c->queue.pop_front();
+        c->active++;
+        lock.unlock();
+        try
+        {
+            function();
+        }
+        catch (const std::exception& ex)
+        {
+            qCCritical(qwaHttpConnection,"HttpScheduler: class %s: uncaught exception: %s",c->name.constData(),ex.what());
+        }
+        catch (...)
+        {
+            qCCritical(qwaHttpConnection,"HttpScheduler: class %s: uncaught exception",c->name.constData());
+        }
+        lock.lock();
+        c->active--;
+    }
+}
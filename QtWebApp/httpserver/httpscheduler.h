@@ -0,0 +1,179 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPSCHEDULER_H
+#define HTTPSCHEDULER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSettings>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+class Counter;
+
+/**
+  Runs the services of the requests in a fixed set of threads, separated
+  into priority classes. Each class has its own queue with a limited size and
+  optionally its own threads, which serve only this class. Shared threads
+  serve all classes, either strictly in the order of their priority or in
+  proportion to their weights. So a slow report cannot occupy the threads
+  that deliver static files and answer health checks.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  classes=critical:8,static:4,dynamic:2,batch:1
+  defaultClass=dynamic
+  routes=/health:critical,/metrics:critical,/static:static,/reports:batch
+  scheduling=weighted
+  sharedThreads=8
+  threads=critical:1,static:2
+  queueSize=batch:10
+  retryAfter=5
+  </pre></code>
+
+  - classes is a comma separated list of the priority classes, the most important
+    first, each followed by its weight. Default is a single class named default.
+  - defaultClass is the class of requests that match no route. Default is the last class.
+  - routes is a comma separated list of path prefixes, each followed by its class.
+    The longest matching prefix is used. A prefix matches only whole path segments,
+    /reports matches /reports/1 but not /reportsXYZ. Default is empty.
+  - scheduling decides which class the shared threads serve next:
+      - strict prefers the class that comes first in the list, as long as it has waiting requests.
+      - weighted serves all classes with waiting requests in proportion to their weights (default).
+  - sharedThreads is the number of threads that serve all classes. Default is the number of CPU cores.
+  - threads is a comma separated list of classes with the number of threads that serve only this class.
+    Default is 0.
+  - queueSize is a comma separated list of classes with the maximum number of waiting requests.
+    Further requests of the class are rejected with status 503. Requests that an idle
+    thread can take over do not count, so 0 rejects only the requests that would have
+    to wait. Default is 100.
+  - retryAfter is the value of the Retry-After header of those responses in seconds. Default is 5.
+
+  The number of waiting and running requests per class is published as the
+  metrics qtwebapp_scheduler_queued and qtwebapp_scheduler_active, the rejected
+  requests as qtwebapp_scheduler_rejected_total.
+  @see HttpRequestHandler::setScheduler()
+*/
+
+class DECLSPEC HttpScheduler {
+    Q_DISABLE_COPY(HttpScheduler)
+public:
+
+    /**
+      Constructor, starts the threads.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+    */
+    HttpScheduler(const QSettings* settings);
+
+    /**
+      Destructor, waits until the running functions have finished.
+      Then it calls the reject functions of the queued requests.
+    */
+    virtual ~HttpScheduler();
+
+    /**
+      Get the class of a request by its path.
+      @param path Path of the request
+      @return Name of the class
+    */
+    QByteArray classify(const QByteArray& path) const;
+
+    /**
+      Execute a function in one of the threads that serve a class.
+      This method is thread safe.
+      @param className Name of the class, unknown names select the default class
+      @param function Function to execute
+      @param reject Called instead of the function, if the scheduler gets destroyed while the function is queued
+      @return false if the queue of the class is full, then the function has not been queued
+    */
+    bool submit(const QByteArray& className, std::function<void()> function, std::function<void()> reject);
+
+    /** Value of the Retry-After header for rejected requests, in seconds */
+    int getRetryAfter() const;
+
+private:
+
+    /** A queued function */
+    struct Item {
+        std::function<void()> function;
+        std::function<void()> reject;
+    };
+
+    /** A priority class */
+    struct PriorityClass {
+        QByteArray name;
+        int weight;
+        int queueSize;
+        /** Functions that wait for a thread */
+        std::deque<Item> queue;
+        /** Wakes up the own threads of this class */
+        std::condition_variable condition;
+        /** Number of own threads that wait for work */
+        int idle=0;
+        /** Number of running functions */
+        int active=0;
+        /** Current value of the weighted round robin */
+        int current=0;
+        Counter* rejected;
+    };
+
+    /** The classes, the most important first */
+    std::deque<PriorityClass> classes;
+
+    /** Index of the default class */
+    int defaultClass;
+
+    /** Path prefixes with the index of their class, the longest prefix first */
+    QList<QPair<QByteArray,int>> routes;
+
+    /** Whether the shared threads serve the classes strictly by priority */
+    bool strict;
+
+    /** Value of the Retry-After header */
+    int retryAfter;
+
+    /** Protects the classes */
+    std::mutex mutex;
+
+    /** Wakes up the shared threads */
+    std::condition_variable condition;
+
+    /** Number of shared threads that wait for work */
+    int idle=0;
+
+    /** Tells the threads to terminate */
+    bool stopping=false;
+
+    /** The shared threads and the own threads of the classes */
+    std::vector<std::thread> threads;
+
+    /** IDs of the metric callbacks */
+    QList<int> metricIds;
+
+    /** Find the class by its name, or return -1 */
+    int indexOf(const QByteArray& name) const;
+
+    /**
+      Main loop of a thread.
+      @param own Index of the class that the thread serves, or -1 for a shared thread
+    */
+    void run(const int own);
+
+    /** Select the class that a shared thread serves next, null if all queues are empty. The caller must hold the mutex */
+    PriorityClass* next();
+};
+
+} // end of namespace
+
+#endif // HTTPSCHEDULER_H
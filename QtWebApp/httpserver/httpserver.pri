@@ -8,6 +8,14 @@ CONFIG(debug, debug|release) {
     DEFINES += SUPERVERBOSE
 }
 
+# Remove the debug messages of the library at compile time
+#DEFINES += QTWEBAPP_NO_DEBUG_OUTPUT
+
+# The AsyncRequestHandler is only compiled in C++20 mode, see Benchmark.pro
+#CONFIG += c++2a
+
+include(../diagnostics/diagnostics.pri)
+
 HEADERS += $$PWD/*.h
 
 SOURCES += $$PWD/*.cpp
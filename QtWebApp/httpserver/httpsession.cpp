@@ -4,6 +4,7 @@
 */
 
 #include "httpsession.h"
+#include "httplogging.h"
 #include <QDateTime>
 #include <QUuid>
 
@@ -18,7 +19,7 @@ HttpSession::HttpSession(bool canStore)
         dataPtr->lastAccess=QDateTime::currentMSecsSinceEpoch();
         dataPtr->id=QUuid::createUuid().toString().toLocal8Bit();
 #ifdef SUPERVERBOSE
-        qDebug("HttpSession: (constructor) new session %s with refCount=1",dataPtr->id.constData());
+        qwaDebug(qwaHttpSession,"HttpSession: (constructor) new session %s with refCount=1",dataPtr->id.constData());
 #endif
     }
     else
@@ -35,7 +36,7 @@ HttpSession::HttpSession(const HttpSession& other)
         dataPtr->lock.lockForWrite();
         dataPtr->refCount++;
 #ifdef SUPERVERBOSE
-        qDebug("HttpSession: (constructor) copy session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
+        qwaDebug(qwaHttpSession,"HttpSession: (constructor) copy session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
 #endif
         dataPtr->lock.unlock();
     }
@@ -50,7 +51,7 @@ HttpSession& HttpSession::operator= (const HttpSession& other)
         dataPtr->lock.lockForWrite();
         dataPtr->refCount++;
 #ifdef SUPERVERBOSE
-        qDebug("HttpSession: (operator=) session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
+        qwaDebug(qwaHttpSession,"HttpSession: (operator=) session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
 #endif
         dataPtr->lastAccess=QDateTime::currentMSecsSinceEpoch();
         dataPtr->lock.unlock();
@@ -61,12 +62,12 @@ HttpSession& HttpSession::operator= (const HttpSession& other)
         oldPtr->lock.lockForWrite();
         refCount=--oldPtr->refCount;
 #ifdef SUPERVERBOSE
-        qDebug("HttpSession: (operator=) session %s refCount=%i",oldPtr->id.constData(),oldPtr->refCount);
+        qwaDebug(qwaHttpSession,"HttpSession: (operator=) session %s refCount=%i",oldPtr->id.constData(),oldPtr->refCount);
 #endif
         oldPtr->lock.unlock();
         if (refCount==0)
         {
-            qDebug("HttpSession: deleting old data");
+            qwaDebug(qwaHttpSession,"HttpSession: deleting old data");
             delete oldPtr;
         }
     }
@@ -80,12 +81,12 @@ HttpSession::~HttpSession()
         dataPtr->lock.lockForWrite();
         refCount=--dataPtr->refCount;
 #ifdef SUPERVERBOSE
-        qDebug("HttpSession: (destructor) session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
+        qwaDebug(qwaHttpSession,"HttpSession: (destructor) session %s refCount=%i",dataPtr->id.constData(),dataPtr->refCount);
 #endif
         dataPtr->lock.unlock();
         if (refCount==0)
         {
-            qDebug("HttpSession: deleting data");
+            qwaDebug(qwaHttpSession,"HttpSession: deleting data");
             delete dataPtr;
         }
     }
@@ -4,6 +4,8 @@
 */
 
 #include "httpsessionstore.h"
+#include "httplogging.h"
+#include "metricsregistry.h"
 #include <QDateTime>
 #include <QUuid>
 #include <mutex>
@@ -18,18 +20,24 @@ HttpSessionStore::HttpSessionStore(const QSettings *settings, QObject* parent)
     cleanupTimer.start(60000);
     cookieName=settings->value("cookieName","sessionid").toByteArray();
     expirationTime=settings->value("expirationTime",3600000).toInt();
-    qDebug("HttpSessionStore: Sessions expire after %i milliseconds",expirationTime);
+    qwaDebug(qwaHttpSession,"HttpSessionStore: Sessions expire after %i milliseconds",expirationTime);
+    sessionsMetric=MetricsRegistry::instance().addCallback("qtwebapp_sessions","Number of HTTP sessions",[this]
+    {
+        std::lock_guard lock{ mutex };
+        return static_cast<double>(sessions.count());
+    });
 }
 
 HttpSessionStore::~HttpSessionStore()
 {
+    MetricsRegistry::instance().removeCallback(sessionsMetric);
     cleanupTimer.stop();
 }
 
 QByteArray HttpSessionStore::getSessionId(const HttpRequest& request, HttpResponse& response)
 {
     // The session ID in the response has priority because this one will be used in the next request.
-    std::lock_guard{mutex};
+    std::lock_guard lock{ mutex };
 
     // Get the session ID from the response cookie
     QByteArray sessionId=response.getCookies().value(cookieName).getValue();
@@ -43,7 +51,7 @@ QByteArray HttpSessionStore::getSessionId(const HttpRequest& request, HttpRespon
     {
         if (!sessions.contains(sessionId))
         {
-            qDebug("HttpSessionStore: received invalid session cookie with ID %s",sessionId.constData());
+            qwaDebug(qwaHttpSession,"HttpSessionStore: received invalid session cookie with ID %s",sessionId.constData());
             sessionId.clear();
         }
     }
@@ -54,14 +62,14 @@ QByteArray HttpSessionStore::getSessionId(const HttpRequest& request, HttpRespon
 HttpSession HttpSessionStore::getSession(const HttpRequest& request, HttpResponse& response, bool allowCreate)
 {
     QByteArray sessionId=getSessionId(request,response);
-    std::lock_guard{ mutex };
+    std::unique_lock lock{ mutex };
 
     if (!sessionId.isEmpty())
     {
         HttpSession session=sessions.value(sessionId);
         if (!session.isNull())
         {
-            mutex.unlock();
+            lock.unlock();
             // Refresh the session cookie
             QByteArray cookieName=settings->value("cookieName","sessionid").toByteArray();
             QByteArray cookiePath=settings->value("cookiePath").toByteArray();
@@ -80,10 +88,10 @@ HttpSession HttpSessionStore::getSession(const HttpRequest& request, HttpRespons
         QByteArray cookieComment=settings->value("cookieComment").toByteArray();
         QByteArray cookieDomain=settings->value("cookieDomain").toByteArray();
         HttpSession session(true);
-        qDebug("HttpSessionStore: create new session with ID %s",session.getId().constData());
+        qwaDebug(qwaHttpSession,"HttpSessionStore: create new session with ID %s",session.getId().constData());
         sessions.insert(session.getId(),session);
         response.setCookie(HttpCookie(cookieName,session.getId(),expirationTime/1000,cookiePath,cookieComment,cookieDomain));
-        mutex.unlock();
+        lock.unlock();
         return session;
     }
 
@@ -95,7 +103,7 @@ HttpSession HttpSessionStore::getSession(const QByteArray& id)
 {
     HttpSession session;
     {
-        std::lock_guard{ mutex };
+        std::lock_guard lock{ mutex };
         session = sessions.value(id);
     }
     session.setLastAccess();
@@ -104,7 +112,7 @@ HttpSession HttpSessionStore::getSession(const QByteArray& id)
 
 void HttpSessionStore::sessionTimerEvent()
 {
-    std::lock_guard{ mutex };
+    std::lock_guard lock{ mutex };
 
     qint64 now=QDateTime::currentMSecsSinceEpoch();
     QMap<QByteArray,HttpSession>::iterator i = sessions.begin();
@@ -116,7 +124,7 @@ void HttpSessionStore::sessionTimerEvent()
         qint64 lastAccess=session.getLastAccess();
         if (now-lastAccess>expirationTime)
         {
-            qDebug("HttpSessionStore: session %s expired",session.getId().constData());
+            qwaDebug(qwaHttpSession,"HttpSessionStore: session %s expired",session.getId().constData());
             sessions.erase(prev);
         }
     }
@@ -126,6 +134,6 @@ void HttpSessionStore::sessionTimerEvent()
 /** Delete a session */
 void HttpSessionStore::removeSession(HttpSession session)
 {
-    std::lock_guard{ mutex };
+    std::lock_guard lock{ mutex };
     sessions.remove(session.getId());
 }
@@ -9,11 +9,11 @@
 #include <QObject>
 #include <QMap>
 #include <QTimer>
-#include <QMutex>
 #include "httpglobal.h"
 #include "httpsession.h"
 #include "httpresponse.h"
 #include "httprequest.h"
+#include "instrumentedmutex.h"
 
 namespace stefanfrings {
 
@@ -106,7 +106,10 @@ private:
     int expirationTime;
 
     /** Used to synchronize threads */
-    QMutex mutex;
+    InstrumentedMutex mutex{"session_store"};
+
+    /** ID of the metric callback for the number of sessions */
+    int sessionsMetric;
 
 private slots:
 
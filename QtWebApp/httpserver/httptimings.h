@@ -0,0 +1,75 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPTIMINGS_H
+#define HTTPTIMINGS_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <chrono>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Points in time of the processing of one HTTP request, in nsec of the monotonic
+  std::chrono::steady_clock. A value of 0 means that the point has not been reached.
+  The HttpConnectionHandler and the HttpRequestHandler fill the values from
+  different threads, therefore they are atomic.
+  @see HttpAccessLog
+*/
+
+struct RequestTimings {
+
+    /** The connection handler started to set up the connection, only for the first request of a connection */
+    std::atomic<qint64> accepted{0};
+
+    /** The socket of the connection has been set up, only for the first request of a connection */
+    std::atomic<qint64> connected{0};
+
+    /** The first bytes of the request have been received */
+    std::atomic<qint64> received{0};
+
+    /** The request has been parsed completely */
+    std::atomic<qint64> parsed{0};
+
+    /** The handlers for headers checking have been called */
+    std::atomic<qint64> headersCheckStarted{0};
+
+    /** The handlers for headers checking have finished */
+    std::atomic<qint64> headersCheckFinished{0};
+
+    /** The worker thread has called HttpRequestHandler::service() */
+    std::atomic<qint64> serviceStarted{0};
+
+    /** The response result has arrived at the connection handler */
+    std::atomic<qint64> serviceFinished{0};
+
+    /** The first bytes of the response have been passed to the socket */
+    std::atomic<qint64> writeStarted{0};
+
+    /** The response has been passed to the socket */
+    std::atomic<qint64> written{0};
+
+    /** Kernel ID of the worker thread while it runs the service, 0 otherwise. Only set on Linux. */
+    std::atomic<qint64> serviceThread{0};
+
+    /** Current time of the steady clock in nsec */
+    static qint64 now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Time between two points in nsec, or -1 if one of them has not been reached */
+    static qint64 duration(const qint64 from, const qint64 to)
+    {
+        return (from>0 && to>=from) ? to-from : -1;
+    }
+};
+
+} // end of namespace
+
+#endif // HTTPTIMINGS_H
@@ -0,0 +1,364 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httptracer.h"
+#include "httplogging.h"
+#include "threadname.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <chrono>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Check that a string consists of lower case hex digits and is not all zero */
+bool isValidId(const QByteArray& id, const int length)
+{
+    if (id.size()!=length)
+    {
+        return false;
+    }
+    bool zero=true;
+    for (char c : id)
+    {
+        if (!((c>='0' && c<='9') || (c>='a' && c<='f')))
+        {
+            return false;
+        }
+        zero=zero && c=='0';
+    }
+    return !zero;
+}
+
+/** Append a string with JSON escaping */
+void appendEscaped(QByteArray& output, const QByteArray& value)
+{
+    static const char hex[]="0123456789abcdef";
+    for (char c : value)
+    {
+        uchar u=static_cast<uchar>(c);
+        if (c=='"' || c=='\\')
+        {
+            output.append('\\').append(c);
+        }
+        else if (u<0x20)
+        {
+            output.append("\\u00").append(hex[u>>4]).append(hex[u & 15]);
+        }
+        else
+        {
+            output.append(c);
+        }
+    }
+}
+
+/** Append a string attribute */
+void appendAttribute(QByteArray& output, const char* key, const QByteArray& value)
+{
+    output.append("{\"key\":\"").append(key).append("\",\"value\":{\"stringValue\":\"");
+    appendEscaped(output,value);
+    output.append("\"}}");
+}
+
+}
+
+bool TraceContext::parse(const QByteArray& traceparent, TraceContext& context)
+{
+    // version-traceid-parentid-flags
+    QList<QByteArray> parts=traceparent.trimmed().split('-');
+    if (parts.size()<4 || parts.at(0).size()!=2 || parts.at(0)=="ff" || parts.at(3).size()!=2)
+    {
+        return false;
+    }
+    if (parts.at(0)=="00" && parts.size()!=4)
+    {
+        return false;
+    }
+    if (!isValidId(parts.at(1),32) || !isValidId(parts.at(2),16))
+    {
+        return false;
+    }
+    bool ok;
+    int flags=parts.at(3).toInt(&ok,16);
+    if (!ok)
+    {
+        return false;
+    }
+    context.traceId=parts.at(1);
+    context.parentSpanId=parts.at(2);
+    context.sampled=(flags & 1)!=0;
+    return true;
+}
+
+QByteArray TraceContext::toTraceparent() const
+{
+    return "00-"+traceId+"-"+spanId+(sampled ? "-01" : "-00");
+}
+
+QByteArray TraceContext::randomId(const int bytes)
+{
+    QByteArray id(bytes,'\0');
+    do
+    {
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32*>(id.data()),bytes/4);
+    }
+    while (id.count('\0')==bytes);
+    return id.toHex();
+}
+
+HttpTracer::HttpTracer(const QSettings* settings)
+{
+    Q_ASSERT(settings!=nullptr);
+    sampleRate=settings->value("sampleRate",0.0).toDouble();
+    serviceName=settings->value("serviceName","QtWebApp").toString().toUtf8();
+    flushInterval=settings->value("flushInterval",1000).toInt();
+    maxQueue=settings->value("maxQueue",4096).toInt();
+    stopping=false;
+
+    QString fileName=settings->value("fileName").toString();
+    if (!fileName.isEmpty())
+    {
+        // Convert relative fileName to absolute, based on the directory of the config file.
+#ifdef Q_OS_WIN32
+        if (QDir::isRelativePath(fileName) && settings->format()!=QSettings::NativeFormat)
+#else
+        if (QDir::isRelativePath(fileName))
+#endif
+        {
+            QFileInfo configFile(settings->fileName());
+            fileName=QFileInfo(configFile.absolutePath(),fileName).absoluteFilePath();
+        }
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        {
+            qCCritical(qwaHttpConnection,"HttpTracer: cannot open %s: %s",qPrintable(fileName),qPrintable(file.errorString()));
+        }
+    }
+
+    QString collector=settings->value("collector").toString();
+    collectorHost=collector.section(':',0,0);
+    collectorPort=collector.section(':',1,1).toUShort();
+    if (collectorPort==0)
+    {
+        collectorPort=4318;
+    }
+    thread=std::thread(&HttpTracer::run,this);
+}
+
+
+HttpTracer::~HttpTracer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+    }
+    condition.notify_one();
+    thread.join();
+    file.close();
+}
+
+
+std::shared_ptr<TraceContext> HttpTracer::startTrace(const QByteArray& traceparent)
+{
+    TraceContext context;
+    if (traceparent.isEmpty() || !TraceContext::parse(traceparent,context))
+    {
+        if (sampleRate<=0 || QRandomGenerator::global()->generateDouble()>=sampleRate)
+        {
+            return nullptr;
+        }
+        context.traceId=TraceContext::randomId(16);
+        context.sampled=true;
+    }
+    context.spanId=TraceContext::randomId(8);
+    return std::make_shared<TraceContext>(std::move(context));
+}
+
+
+void HttpTracer::finishTrace(const TraceContext& context, const RequestTimings& timings,
+                             const QByteArray& method, const QByteArray& path, const int status)
+{
+    if (!context.sampled)
+    {
+        return;
+    }
+    qint64 systemNow=std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    TraceRecord record;
+    record.context=context;
+    record.accepted=timings.accepted;
+    record.connected=timings.connected;
+    record.received=timings.received;
+    record.parsed=timings.parsed;
+    record.headersCheckStarted=timings.headersCheckStarted;
+    record.headersCheckFinished=timings.headersCheckFinished;
+    record.serviceStarted=timings.serviceStarted;
+    record.serviceFinished=timings.serviceFinished;
+    record.writeStarted=timings.writeStarted;
+    record.written=timings.written;
+    record.clockOffset=systemNow-RequestTimings::now();
+    record.method=method;
+    record.path=path;
+    record.status=status;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size()>=maxQueue)
+    {
+        droppedTraces.fetch_add(1,std::memory_order_relaxed);
+        return;
+    }
+    queue.append(std::move(record));
+}
+
+
+quint64 HttpTracer::getDroppedTraces() const
+{
+    return droppedTraces.load();
+}
+
+
+void HttpTracer::run()
+{
+    setThreadName("qwa-tracer");
+    QVector<TraceRecord> batch;
+    QByteArray output;
+    bool finished=false;
+    while (!finished)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait_for(lock,std::chrono::milliseconds(flushInterval),[this] { return stopping; });
+            finished=stopping;
+            batch.swap(queue);
+        }
+        if (batch.isEmpty())
+        {
+            continue;
+        }
+        output.resize(0);
+        formatBatch(batch,output);
+        batch.resize(0);
+        if (file.isOpen())
+        {
+            file.write(output);
+            file.write("\n");
+            file.flush();
+        }
+        if (!collectorHost.isEmpty())
+        {
+            send(output);
+        }
+    }
+}
+
+
+void HttpTracer::formatBatch(const QVector<TraceRecord>& batch, QByteArray& output) const
+{
+    output.append("{\"resourceSpans\":[{\"resource\":{\"attributes\":[");
+    appendAttribute(output,"service.name",serviceName);
+    output.append("]},\"scopeSpans\":[{\"scope\":{\"name\":\"qtwebapp\"},\"spans\":[");
+    bool first=true;
+    for (const TraceRecord& record : batch)
+    {
+        const TraceContext& context=record.context;
+        if (!first)
+        {
+            output.append(',');
+        }
+        first=false;
+
+        // The server span covers the whole request, the first request of a connection includes the accept
+        qint64 start=record.accepted>0 ? record.accepted : record.received;
+        appendSpan(output,record,context.spanId,context.parentSpanId,record.method,2,start,record.written,true);
+
+        struct Phase {
+            const char* name;
+            qint64 start;
+            qint64 end;
+        };
+        const Phase phases[]={
+            {"accept",record.accepted,record.connected},
+            {"parse",record.received,record.parsed},
+            {"headers check",record.headersCheckStarted,record.headersCheckFinished},
+            {"queue",record.parsed,record.serviceStarted},
+            {"service",record.serviceStarted,record.serviceFinished},
+            {"flush",record.writeStarted,record.written}
+        };
+        for (const Phase& phase : phases)
+        {
+            if (RequestTimings::duration(phase.start,phase.end)>=0)
+            {
+                output.append(',');
+                appendSpan(output,record,TraceContext::randomId(8),context.spanId,phase.name,1,phase.start,phase.end,false);
+            }
+        }
+    }
+    output.append("]}]}]}");
+}
+
+
+void HttpTracer::appendSpan(QByteArray& output, const TraceRecord& record, const QByteArray& spanId,
+                            const QByteArray& parentSpanId, const QByteArray& name, const int kind,
+                            const qint64 start, const qint64 end, const bool root) const
+{
+    output.append("{\"traceId\":\"").append(record.context.traceId);
+    output.append("\",\"spanId\":\"").append(spanId);
+    if (!parentSpanId.isEmpty())
+    {
+        output.append("\",\"parentSpanId\":\"").append(parentSpanId);
+    }
+    output.append("\",\"name\":\"");
+    appendEscaped(output,name);
+    output.append("\",\"kind\":").append(QByteArray::number(kind));
+    // 64 bit integers are strings in OTLP/JSON
+    output.append(",\"startTimeUnixNano\":\"").append(QByteArray::number(start+record.clockOffset));
+    output.append("\",\"endTimeUnixNano\":\"").append(QByteArray::number(end+record.clockOffset)).append('"');
+    if (root)
+    {
+        output.append(",\"attributes\":[");
+        appendAttribute(output,"http.request.method",record.method);
+        output.append(',');
+        appendAttribute(output,"url.path",record.path);
+        output.append(",{\"key\":\"http.response.status_code\",\"value\":{\"intValue\":\"");
+        output.append(QByteArray::number(record.status)).append("\"}}]");
+        if (record.status>=500)
+        {
+            output.append(",\"status\":{\"code\":2}");
+        }
+    }
+    output.append('}');
+}
+
+
+void HttpTracer::send(const QByteArray& output)
+{
+    QTcpSocket socket;
+    socket.connectToHost(collectorHost,collectorPort);
+    if (!socket.waitForConnected(1000))
+    {
+        qCWarning(qwaHttpConnection,"HttpTracer: cannot connect to %s:%i: %s",
+                  qPrintable(collectorHost),collectorPort,qPrintable(socket.errorString()));
+        return;
+    }
+    QByteArray header="POST /v1/traces HTTP/1.1\r\nHost: "+collectorHost.toLatin1()+":"+QByteArray::number(collectorPort)
+            +"\r\nContent-Type: application/json\r\nContent-Length: "+QByteArray::number(output.size())
+            +"\r\nConnection: close\r\n\r\n";
+    socket.write(header);
+    socket.write(output);
+    while (socket.bytesToWrite()>0 && socket.waitForBytesWritten(1000)) {}
+
+    // Check the status code of the response
+    while (!socket.canReadLine() && socket.waitForReadyRead(1000)) {}
+    int status=socket.readLine().split(' ').value(1).toInt();
+    if (status<200 || status>=300)
+    {
+        qCWarning(qwaHttpConnection,"HttpTracer: collector %s:%i returned status %i",
+                  qPrintable(collectorHost),collectorPort,status);
+    }
+    socket.disconnectFromHost();
+}
@@ -0,0 +1,206 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPTRACER_H
+#define HTTPTRACER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSettings>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "httpglobal.h"
+#include "httptimings.h"
+
+namespace stefanfrings {
+
+/**
+  Identifies a traced request, following the W3C Trace Context recommendation.
+  The IDs are lower case hex strings.
+*/
+struct DECLSPEC TraceContext {
+
+    /** ID of the whole trace, 32 hex digits */
+    QByteArray traceId;
+
+    /** ID of the span of this server, 16 hex digits */
+    QByteArray spanId;
+
+    /** ID of the span of the caller, empty if the request had no traceparent header */
+    QByteArray parentSpanId;
+
+    /** Whether the trace gets recorded */
+    bool sampled=false;
+
+    /**
+      Parse a traceparent header.
+      @param traceparent Value of the header, e.g. "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+      @param context Receives traceId, parentSpanId and sampled
+      @return false if the header is invalid
+    */
+    static bool parse(const QByteArray& traceparent, TraceContext& context);
+
+    /** Generate the traceparent header for requests or responses of this span */
+    QByteArray toTraceparent() const;
+
+    /** Generate a random ID of the given number of bytes as hex string */
+    static QByteArray randomId(const int bytes);
+};
+
+/**
+  Records the lifecycle of sampled HTTP requests as spans and exports them in
+  batches in the OTLP/JSON format of OpenTelemetry. Each request produces one
+  server span with child spans for accepting the connection (first request
+  only), parsing, headers checking, waiting for a worker thread, the service
+  and writing the response.
+  <p>
+  The connection handlers accept the traceparent header of incoming requests
+  and return a traceparent header with the ID of the server span. Requests
+  with a sampled parent are always traced, other requests are sampled randomly.
+  The IDs are also passed in ServiceParams::trace and, if the logging module is
+  available, as the log variables {traceId} and {spanId} of the service thread.
+  <p>
+  Requests that are not traced cost only a check of the sample rate.
+  Traced requests pass their timings to a list, a background thread converts
+  them to spans and writes or sends them.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  sampleRate=0.01
+  fileName=logs/traces.jsonl
+  ;collector=127.0.0.1:4318
+  serviceName=myapp
+  flushInterval=1000
+  maxQueue=4096
+  </pre></code>
+
+  - sampleRate is the fraction of requests without traceparent that get traced, 0=none (default), 1=all.
+  - fileName is the name of a file that receives one OTLP/JSON export request per line, relative
+    to the directory of the settings file. Empty disables the file (default).
+  - collector is host:port of an OpenTelemetry collector that receives the batches
+    by HTTP POST to /v1/traces. Empty disables sending (default).
+  - serviceName is the value of the service.name resource attribute. Default is QtWebApp.
+  - flushInterval is the maximum time in msec that spans wait before they get exported. Default is 1000.
+  - maxQueue is the maximum number of waiting requests. More are discarded. Default is 4096.
+
+  @see HttpListener::setTracer()
+*/
+
+class DECLSPEC HttpTracer {
+    Q_DISABLE_COPY(HttpTracer)
+public:
+
+    /**
+      Constructor.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+    */
+    HttpTracer(const QSettings* settings);
+
+    /** Destructor. Exports the remaining spans. */
+    virtual ~HttpTracer();
+
+    /**
+      Decide whether a request gets traced.
+      This method is thread safe.
+      @param traceparent Value of the traceparent header of the request, may be empty
+      @return null if the request is neither traced nor part of a foreign trace
+    */
+    std::shared_ptr<TraceContext> startTrace(const QByteArray& traceparent);
+
+    /**
+      Record the spans of a finished request, if it has been sampled.
+      This method is thread safe.
+    */
+    void finishTrace(const TraceContext& context, const RequestTimings& timings,
+                     const QByteArray& method, const QByteArray& path, const int status);
+
+    /** Number of traces that have been discarded because the queue was full */
+    quint64 getDroppedTraces() const;
+
+private:
+
+    /** A finished request, the times are copied from RequestTimings */
+    struct TraceRecord {
+        TraceContext context;
+        qint64 accepted;
+        qint64 connected;
+        qint64 received;
+        qint64 parsed;
+        qint64 headersCheckStarted;
+        qint64 headersCheckFinished;
+        qint64 serviceStarted;
+        qint64 serviceFinished;
+        qint64 writeStarted;
+        qint64 written;
+        /** Difference between the system clock and the steady clock in nsec */
+        qint64 clockOffset;
+        QByteArray method;
+        QByteArray path;
+        int status;
+    };
+
+    /** Fraction of requests that get sampled */
+    double sampleRate;
+
+    /** Output file, not open if disabled */
+    QFile file;
+
+    /** Host of the collector, empty if disabled */
+    QString collectorHost;
+
+    /** Port of the collector */
+    quint16 collectorPort;
+
+    /** Value of the service.name attribute */
+    QByteArray serviceName;
+
+    /** Maximum time in msec that records wait for the background thread */
+    int flushInterval;
+
+    /** Maximum number of waiting records */
+    int maxQueue;
+
+    /** Waiting records */
+    QVector<TraceRecord> queue;
+
+    /** Protects the queue */
+    std::mutex mutex;
+
+    /** Wakes up the background thread */
+    std::condition_variable condition;
+
+    /** Tells the background thread to terminate */
+    bool stopping;
+
+    /** Number of discarded records */
+    std::atomic<quint64> droppedTraces{0};
+
+    /** Background thread */
+    std::thread thread;
+
+    /** Main loop of the background thread */
+    void run();
+
+    /** Convert a batch of records into an OTLP/JSON export request */
+    void formatBatch(const QVector<TraceRecord>& batch, QByteArray& output) const;
+
+    /** Append one span */
+    void appendSpan(QByteArray& output, const TraceRecord& record, const QByteArray& spanId,
+                    const QByteArray& parentSpanId, const QByteArray& name, const int kind,
+                    const qint64 start, const qint64 end, const bool root) const;
+
+    /** Send a batch to the collector */
+    void send(const QByteArray& output);
+};
+
+} // end of namespace
+
+#endif // HTTPTRACER_H
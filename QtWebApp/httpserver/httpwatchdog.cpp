@@ -0,0 +1,435 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpwatchdog.h"
+#include "httpconnectionhandlerpool.h"
+#include "httplogging.h"
+#include "metricsregistry.h"
+#include "threadname.h"
+#include <QVector>
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+    #define QTWEBAPP_STACK_CAPTURE
+    #include <execinfo.h>
+    #include <signal.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <cstdlib>
+#endif
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Format a duration in nsec as msec */
+QByteArray millis(const qint64 nsec)
+{
+    return QByteArray::number(nsec/1000000.0,'f',2)+"ms";
+}
+
+/**
+  Append the duration of a phase to the text.
+  If the phase has started but not finished yet, it is measured until now and marked with "+".
+*/
+void appendPhase(QByteArray& text, const char* name, const qint64 from, const qint64 to, const qint64 now)
+{
+    if (from==0)
+    {
+        return;
+    }
+    if (!text.isEmpty())
+    {
+        text.append(", ");
+    }
+    text.append(name).append(' ');
+    if (to>=from)
+    {
+        text.append(millis(to-from));
+    }
+    else
+    {
+        text.append(millis(now-from)).append('+');
+    }
+}
+
+#ifdef QTWEBAPP_STACK_CAPTURE
+
+/** Maximum number of captured frames */
+const int MAX_FRAMES=64;
+
+/** Frames captured by the signal handler */
+void* capturedFrames[MAX_FRAMES];
+
+/** Number of captured frames */
+std::atomic<int> capturedCount{0};
+
+/**
+  Sequence number of the capture that the handler shall serve, 0=none.
+  The handler takes it by setting it to 0, so a signal that arrives late
+  cannot write into the frames of the next capture.
+*/
+std::atomic<int> requestedCapture{0};
+
+/** Sequence number of the last capture that the handler has finished */
+std::atomic<int> finishedCapture{0};
+
+/** Sequence number of the last signal that sampleStack() has sent */
+std::atomic<int> sentCapture{0};
+
+/** Only one stack can be captured at a time */
+std::mutex captureMutex;
+
+/** Disposition of SIGUSR2 before installCaptureHandler() */
+struct sigaction previousAction;
+
+/** Pass a signal that has not been sent by sampleStack() to the previous handler */
+void chainSignal(int signal, siginfo_t* info, void* context)
+{
+    if (previousAction.sa_flags & SA_SIGINFO)
+    {
+        previousAction.sa_sigaction(signal,info,context);
+    }
+    else if (previousAction.sa_handler==SIG_DFL)
+    {
+        // Terminate the program like the default action, after the handler returned
+        ::signal(signal,SIG_DFL);
+        raise(signal);
+    }
+    else if (previousAction.sa_handler!=SIG_IGN)
+    {
+        previousAction.sa_handler(signal);
+    }
+}
+
+/** Runs in the interrupted thread and records its stack */
+void captureHandler(int signal, siginfo_t* info, void* context)
+{
+    int savedErrno=errno;
+    int sequence=info->si_value.sival_int;
+    if (info->si_code!=SI_QUEUE || info->si_pid!=getpid() || sequence<=0 ||
+        sequence>sentCapture.load(std::memory_order_acquire))
+    {
+        chainSignal(signal,info,context);
+    }
+    // A signal of a capture that has timed out is ignored, the default action would terminate the program
+    else if (requestedCapture.compare_exchange_strong(sequence,0))
+    {
+        capturedCount.store(backtrace(capturedFrames,MAX_FRAMES),std::memory_order_relaxed);
+        finishedCapture.store(sequence,std::memory_order_release);
+    }
+    errno=savedErrno;
+}
+
+/** Install the signal handler, the previous one keeps receiving the signals of other senders */
+void installCaptureHandler()
+{
+    static std::once_flag installed;
+    std::call_once(installed,[]
+    {
+        // The first call of backtrace() loads libgcc, which is not allowed in a signal handler
+        void* frames[1];
+        backtrace(frames,1);
+        struct sigaction action={};
+        action.sa_sigaction=captureHandler;
+        action.sa_flags=SA_RESTART | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR2,&action,&previousAction);
+    });
+}
+
+/**
+  Capture the stack of a thread of this process.
+  @param threadId Kernel ID of the thread
+  @return Function names and addresses, one per line, or empty if the thread did not respond
+*/
+QByteArray sampleStack(const qint64 threadId)
+{
+    std::lock_guard<std::mutex> lock(captureMutex);
+    int sequence=sentCapture.load()+1;
+    if (sequence<=0)
+    {
+        sequence=1;
+    }
+    requestedCapture.store(sequence);
+    sentCapture.store(sequence,std::memory_order_release);
+
+    // The sequence number travels with the signal, so the handler can recognize it
+    siginfo_t info={};
+    info.si_signo=SIGUSR2;
+    info.si_code=SI_QUEUE;
+    info.si_pid=getpid();
+    info.si_uid=getuid();
+    info.si_value.sival_int=sequence;
+    if (syscall(SYS_rt_tgsigqueueinfo,getpid(),static_cast<pid_t>(threadId),SIGUSR2,&info)!=0)
+    {
+        requestedCapture.store(0);
+        return QByteArray();
+    }
+    for (int i=0; i<100 && finishedCapture.load(std::memory_order_acquire)!=sequence; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Withdraw the request. If the handler has already taken it, wait until it has finished.
+    int expected=sequence;
+    if (requestedCapture.compare_exchange_strong(expected,0))
+    {
+        return QByteArray();
+    }
+    while (finishedCapture.load(std::memory_order_acquire)!=sequence)
+    {
+        std::this_thread::yield();
+    }
+    int count=capturedCount.load(std::memory_order_relaxed);
+    QByteArray result;
+    char** symbols=backtrace_symbols(capturedFrames,count);
+    // Skip the signal handler and the signal trampoline
+    for (int i=2; symbols && i<count; i++)
+    {
+        result.append("\n    ").append(symbols[i]);
+    }
+    free(symbols);
+    return result;
+}
+
+#endif
+
+}
+
+HttpWatchdog::HttpWatchdog(const QSettings* settings)
+{
+    Q_ASSERT(settings!=nullptr);
+    threshold=settings->value("threshold",5000).toLongLong()*1000000;
+    checkInterval=qMax(1,settings->value("checkInterval",1000).toInt());
+    captureStack=settings->value("captureStack",false).toBool();
+    cancelTimeout=settings->value("cancelTimeout",0).toLongLong()*1000000;
+    stopping=false;
+#ifdef QTWEBAPP_STACK_CAPTURE
+    if (captureStack)
+    {
+        installCaptureHandler();
+    }
+#else
+    if (captureStack)
+    {
+        qCWarning(qwaHttpWatchdog,"HttpWatchdog: captureStack is not supported on this platform");
+        captureStack=false;
+    }
+#endif
+    thread=std::thread(&HttpWatchdog::run,this);
+}
+
+
+HttpWatchdog::~HttpWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping=true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+
+HttpWatchdog::Shard& HttpWatchdog::shard(const quint64 requestID)
+{
+    return shards[requestID%SHARDS];
+}
+
+
+void HttpWatchdog::startRequest(const quint64 requestID, const std::shared_ptr<RequestTimings>& timings,
+                                const QByteArray& method, const QByteArray& path, const QByteArray& version,
+                                const QHostAddress& peerAddress, const int connectionRequests, const qint64 connectionAccepted)
+{
+    WatchedRequest request;
+    request.timings=timings;
+    request.method=method;
+    request.path=path;
+    request.version=version;
+    request.peerAddress=peerAddress;
+    request.connectionRequests=connectionRequests;
+    request.connectionAccepted=connectionAccepted;
+    Shard& s=shard(requestID);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.requests.insert(requestID,std::move(request));
+}
+
+
+void HttpWatchdog::setCanceller(const quint64 requestID, const CancellerRef& canceller)
+{
+    Shard& s=shard(requestID);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it=s.requests.find(requestID);
+    if (it!=s.requests.end())
+    {
+        it->canceller=canceller;
+    }
+}
+
+
+void HttpWatchdog::finishRequest(const quint64 requestID)
+{
+    Shard& s=shard(requestID);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.requests.remove(requestID);
+}
+
+
+void HttpWatchdog::addPool(HttpConnectionHandlerPool* pool)
+{
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    pools.append(pool);
+}
+
+
+void HttpWatchdog::removePool(HttpConnectionHandlerPool* pool)
+{
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    pools.removeOne(pool);
+}
+
+
+quint64 HttpWatchdog::getSlowRequests() const
+{
+    return slowRequests.load();
+}
+
+
+void HttpWatchdog::run()
+{
+    setThreadName("qwa-watchdog");
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait_for(lock,std::chrono::milliseconds(checkInterval),[this] { return stopping; });
+            if (stopping)
+            {
+                return;
+            }
+        }
+        check();
+    }
+}
+
+
+void HttpWatchdog::check()
+{
+    const qint64 now=RequestTimings::now();
+    QVector<QPair<quint64,WatchedRequest>> slow;
+    QVector<CancellerRef> cancel;
+    for (Shard& s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (auto it=s.requests.begin(); it!=s.requests.end(); ++it)
+        {
+            const qint64 age=now-it->timings->received;
+            if (!it->reported && age>threshold)
+            {
+                it->reported=true;
+                slow.append(qMakePair(it.key(),*it));
+            }
+            if (cancelTimeout>0 && !it->cancelled && it->canceller && age>cancelTimeout)
+            {
+                it->cancelled=true;
+                cancel.append(it->canceller);
+            }
+        }
+    }
+
+    // Log and cancel without holding the locks
+    for (const auto& item : slow)
+    {
+        report(item.first,item.second,now);
+    }
+    for (const CancellerRef& canceller : cancel)
+    {
+        qCWarning(qwaHttpWatchdog,"HttpWatchdog: cancelling a request after %s",millis(cancelTimeout).constData());
+        canceller->cancel();
+    }
+}
+
+
+void HttpWatchdog::report(const quint64 requestID, const WatchedRequest& request, const qint64 now)
+{
+    static Counter& counter=MetricsRegistry::instance().counter("qtwebapp_slow_requests_total","Number of requests that exceeded the threshold of the watchdog");
+    counter.add();
+    slowRequests.fetch_add(1,std::memory_order_relaxed);
+
+    const RequestTimings& t=*request.timings;
+    const qint64 headersCheckStarted=t.headersCheckStarted;
+    const qint64 headersCheckFinished=t.headersCheckFinished;
+    const qint64 serviceStarted=t.serviceStarted;
+    const qint64 serviceFinished=t.serviceFinished;
+    const qint64 writeStarted=t.writeStarted;
+    const qint64 serviceThread=t.serviceThread;
+
+    // The phase that has not been finished yet
+    const char* phase;
+    if (serviceStarted==0)
+    {
+        phase="waiting for a worker thread";
+    }
+    else if (serviceFinished==0)
+    {
+        phase="service";
+    }
+    else if (writeStarted==0)
+    {
+        phase="waiting for the connection thread";
+    }
+    else
+    {
+        phase="writing the response";
+    }
+
+    QByteArray phases;
+    appendPhase(phases,"parse",t.received,t.parsed,now);
+    appendPhase(phases,"headers check",headersCheckStarted,headersCheckFinished,now);
+    appendPhase(phases,"queue",t.parsed,serviceStarted,now);
+    appendPhase(phases,"service",serviceStarted,serviceFinished,now);
+    // Streamed responses start writing during the service, then there is no dispatch phase
+    if (writeStarted==0 || writeStarted>=serviceFinished)
+    {
+        appendPhase(phases,"dispatch",serviceFinished,writeStarted,now);
+    }
+    appendPhase(phases,"write",writeStarted,t.written,now);
+
+    qCWarning(qwaHttpWatchdog,"HttpWatchdog: slow request %llu %s %s %s from %s, running %s in phase %s; %s; "
+              "request %i on connection of age %s; pools %s busy",
+              requestID,request.method.constData(),request.path.constData(),request.version.constData(),
+              qPrintable(request.peerAddress.toString()),millis(now-t.received).constData(),phase,phases.constData(),
+              request.connectionRequests,millis(now-request.connectionAccepted).constData(),poolOccupancy().constData());
+
+#ifdef QTWEBAPP_STACK_CAPTURE
+    if (captureStack && serviceThread!=0 && serviceFinished==0)
+    {
+        QByteArray stack=sampleStack(serviceThread);
+        // The worker may have moved on to another request meanwhile
+        if (!stack.isEmpty() && request.timings->serviceThread==serviceThread)
+        {
+            qCWarning(qwaHttpWatchdog,"HttpWatchdog: stack of request %llu:%s",requestID,stack.constData());
+        }
+    }
+#else
+    Q_UNUSED(serviceThread)
+#endif
+}
+
+
+QByteArray HttpWatchdog::poolOccupancy()
+{
+    int busy=0;
+    int total=0;
+    std::lock_guard<std::mutex> lock(poolsMutex);
+    for (HttpConnectionHandlerPool* pool : pools)
+    {
+        int poolBusy;
+        int poolTotal;
+        pool->getOccupancy(poolBusy,poolTotal);
+        busy+=poolBusy;
+        total+=poolTotal;
+    }
+    return QByteArray::number(busy)+"/"+QByteArray::number(total);
+}
@@ -0,0 +1,197 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPWATCHDOG_H
+#define HTTPWATCHDOG_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QSettings>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "httpglobal.h"
+#include "httprequesthandler.h"
+#include "httptimings.h"
+
+namespace stefanfrings {
+
+class HttpConnectionHandlerPool;
+
+/**
+  Finds requests that take unusually long, without tracing all requests.
+  The connection handlers register each request when it has been received
+  completely and remove it when the response has been written or the
+  connection has been closed. A background thread checks the registered
+  requests periodically and logs each request that exceeds the threshold
+  once, with the phase it is in, the durations of the phases so far, the
+  request line, the peer address, the age of the connection and the
+  occupancy of the connection handler pools. The messages use the logging
+  category qtwebapp.http.watchdog.
+  <p>
+  The phases are recorded in the RequestTimings of the request anyway, so
+  the watchdog only adds one registration per request to a sharded map.
+  <p>
+  Example for the configuration settings:
+  <code><pre>
+  threshold=5000
+  checkInterval=1000
+  captureStack=false
+  cancelTimeout=0
+  </pre></code>
+
+  - threshold is the time in msec after which a request is reported. Default is 5000.
+  - checkInterval is the time in msec between two checks. Default is 1000.
+  - captureStack enables logging the stack of the worker thread of reported requests
+    that are in their service() method. The thread gets interrupted by the signal
+    SIGUSR2. Signals from other senders are passed to the handler that the application
+    had installed before the first capture. Only available on Linux
+    with glibc. Function names are only resolved if the program is linked with -rdynamic.
+  - cancelTimeout is the time in msec after which the canceller of a request gets called,
+    if the service has registered one. 0 disables cancelling (default).
+
+  @see HttpListener::setWatchdog()
+*/
+
+class DECLSPEC HttpWatchdog {
+    Q_DISABLE_COPY(HttpWatchdog)
+public:
+
+    /**
+      Constructor.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+    */
+    HttpWatchdog(const QSettings* settings);
+
+    /** Destructor */
+    virtual ~HttpWatchdog();
+
+    /**
+      Register a request.
+      This method is thread safe.
+      @param requestID ID of the request
+      @param timings Timings of the request
+      @param method HTTP method
+      @param path Path of the request, as received
+      @param version HTTP version
+      @param peerAddress Address of the client
+      @param connectionRequests Number of the request on its connection, starting with 1
+      @param connectionAccepted Time when the connection has been accepted, in nsec of the steady clock
+    */
+    void startRequest(const quint64 requestID, const std::shared_ptr<RequestTimings>& timings,
+                      const QByteArray& method, const QByteArray& path, const QByteArray& version,
+                      const QHostAddress& peerAddress, const int connectionRequests, const qint64 connectionAccepted);
+
+    /**
+      Set the canceller of a registered request.
+      This method is thread safe.
+    */
+    void setCanceller(const quint64 requestID, const CancellerRef& canceller);
+
+    /**
+      Remove a request.
+      This method is thread safe.
+    */
+    void finishRequest(const quint64 requestID);
+
+    /**
+      Include a pool in the reported occupancy. Called by the pool.
+      This method is thread safe.
+    */
+    void addPool(HttpConnectionHandlerPool* pool);
+
+    /**
+      Remove a pool. Called by the pool.
+      This method is thread safe.
+    */
+    void removePool(HttpConnectionHandlerPool* pool);
+
+    /** Number of requests that have been reported */
+    quint64 getSlowRequests() const;
+
+private:
+
+    /** A registered request */
+    struct WatchedRequest {
+        std::shared_ptr<RequestTimings> timings;
+        QByteArray method;
+        QByteArray path;
+        QByteArray version;
+        QHostAddress peerAddress;
+        int connectionRequests;
+        qint64 connectionAccepted;
+        CancellerRef canceller;
+        bool reported=false;
+        bool cancelled=false;
+    };
+
+    /** Number of shards */
+    static const int SHARDS=16;
+
+    /** Part of the registered requests, selected by the request ID */
+    struct Shard {
+        std::mutex mutex;
+        QHash<quint64,WatchedRequest> requests;
+    };
+
+    /** Registered requests */
+    Shard shards[SHARDS];
+
+    /** Time in nsec after which a request is reported */
+    qint64 threshold;
+
+    /** Time in msec between two checks */
+    int checkInterval;
+
+    /** Whether the stack of the worker thread is logged */
+    bool captureStack;
+
+    /** Time in nsec after which a request gets cancelled, 0=never */
+    qint64 cancelTimeout;
+
+    /** Pools that are included in the occupancy */
+    QList<HttpConnectionHandlerPool*> pools;
+
+    /** Protects the list of pools */
+    std::mutex poolsMutex;
+
+    /** Number of reported requests */
+    std::atomic<quint64> slowRequests{0};
+
+    /** Protects stopping */
+    std::mutex mutex;
+
+    /** Wakes up the background thread */
+    std::condition_variable condition;
+
+    /** Tells the background thread to terminate */
+    bool stopping;
+
+    /** Background thread */
+    std::thread thread;
+
+    /** Main loop of the background thread */
+    void run();
+
+    /** Check all registered requests */
+    void check();
+
+    /** Log a slow request */
+    void report(const quint64 requestID, const WatchedRequest& request, const qint64 now);
+
+    /** Occupancy of the pools as text "busy/total" */
+    QByteArray poolOccupancy();
+
+    /** Get the shard of a request */
+    Shard& shard(const quint64 requestID);
+};
+
+} // end of namespace
+
+#endif // HTTPWATCHDOG_H
@@ -0,0 +1,24 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "metricscontroller.h"
+#include "metricsregistry.h"
+#include "httpconnectionhandler.h"
+
+using namespace stefanfrings;
+
+MetricsController::MetricsController(QObject* parent)
+    :HttpRequestHandler(parent)
+{}
+
+void MetricsController::service(ServiceParams params)
+{
+    auto& response = *params.response;
+    const QByteArray document = MetricsRegistry::instance().render();
+    response.getConnectionHandler().socketSafeExecution([&] {
+        response.setHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+        response.write(document, true);
+    });
+}
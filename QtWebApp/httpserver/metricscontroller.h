@@ -0,0 +1,44 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef METRICSCONTROLLER_H
+#define METRICSCONTROLLER_H
+
+#include "httpglobal.h"
+#include "httprequesthandler.h"
+
+namespace stefanfrings {
+
+/**
+  Delivers the metrics of the MetricsRegistry in the text format of Prometheus.
+  It is usually called by the applications main request handler when the
+  caller requests the path "/metrics".
+  <p>
+  The library records the number of connection handlers and busy handlers,
+  waiting and active requests, request durations, bytes written, parse errors,
+  rejected requests (413 and 503), sessions and the hits and misses of the
+  StaticFileController, TemplateCache and TemplateFragmentCache. The hit ratio
+  of a cache is hits/(hits+misses).
+  @see HttpMetrics
+*/
+
+class DECLSPEC MetricsController : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(MetricsController)
+public:
+
+    /**
+      Constructor.
+      @param parent Parent object
+    */
+    MetricsController(QObject* parent=nullptr);
+
+    /** Generates the response */
+    void service(ServiceParams) override;
+};
+
+} // end of namespace
+
+#endif // METRICSCONTROLLER_H
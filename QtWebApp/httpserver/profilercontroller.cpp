@@ -0,0 +1,44 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "profilercontroller.h"
+#include "cpuprofiler.h"
+#include "httpconnectionhandler.h"
+#include "httplogging.h"
+
+using namespace stefanfrings;
+
+ProfilerController::ProfilerController(QObject* parent)
+    :HttpRequestHandler(parent)
+{}
+
+void ProfilerController::service(ServiceParams params)
+{
+    auto& request = *params.request;
+    auto& response = *params.response;
+
+    const QByteArray secondsParameter = request.getParameter("seconds");
+    const QByteArray hzParameter = request.getParameter("hz");
+    const int seconds = secondsParameter.isEmpty() ? 10 : qBound(1, secondsParameter.toInt(), 60);
+    const int frequency = hzParameter.isEmpty() ? 99 : qBound(1, hzParameter.toInt(), 1000);
+
+    QByteArray folded;
+    QString error;
+    const bool ok = CpuProfiler::profile(seconds * 1000, frequency, request.getParameter("thread"), folded, error);
+    if (ok && !error.isEmpty())
+        qCWarning(qwaHttpConnection, "ProfilerController: %s", qPrintable(error));
+
+    response.getConnectionHandler().socketSafeExecution([&] {
+        response.setHeader("Content-Type", "text/plain; charset=utf-8");
+        response.setHeader("Cache-Control", "no-store");
+        if (ok) {
+            response.write(folded, true);
+        }
+        else {
+            response.setStatus(503, "Service Unavailable");
+            response.write(error.toUtf8(), true);
+        }
+    });
+}
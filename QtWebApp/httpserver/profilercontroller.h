@@ -0,0 +1,53 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef PROFILERCONTROLLER_H
+#define PROFILERCONTROLLER_H
+
+#include "httpglobal.h"
+#include "httprequesthandler.h"
+
+namespace stefanfrings {
+
+/**
+  Records a CPU profile of the whole process on request and delivers it as
+  folded stacks, which can be converted into a flame graph. It is usually
+  called by the applications main request handler for a path like
+  "/debug/profile", which should not be reachable from the public network.
+  <p>
+  Request parameters:
+
+  - seconds is the duration of the profile, 1-60. Default is 10.
+  - hz is the sampling frequency per second of CPU time, 1-1000. Default is 99.
+  - thread restricts the profile to threads whose name contains this text,
+    for example "qwa-worker". Default is all threads.
+
+  Example:
+  <code><pre>
+  curl -s "http://localhost:8080/debug/profile?seconds=30" | flamegraph.pl > profile.svg
+  </pre></code>
+  The response is delayed by the duration of the profile. Only one profile
+  can run at a time, concurrent requests get the status 503.
+  @see CpuProfiler
+*/
+
+class DECLSPEC ProfilerController : public HttpRequestHandler {
+    Q_OBJECT
+    Q_DISABLE_COPY(ProfilerController)
+public:
+
+    /**
+      Constructor.
+      @param parent Parent object
+    */
+    ProfilerController(QObject* parent=nullptr);
+
+    /** Generates the response */
+    void service(ServiceParams) override;
+};
+
+} // end of namespace
+
+#endif // PROFILERCONTROLLER_H
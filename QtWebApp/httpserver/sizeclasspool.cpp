@@ -0,0 +1,178 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "sizeclasspool.h"
+#include "metricsregistry.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Number of blocks that each thread caches per size class */
+const int LOCAL_BLOCKS=32;
+
+/** Whether blocks are recycled */
+std::atomic<bool> enabled{true};
+
+/** Maximum number of shared free blocks per size class */
+std::atomic<int> maxCached{1024};
+
+/** Shared free blocks of one size class */
+struct SharedList {
+    std::mutex mutex;
+    std::vector<void*> blocks;
+};
+
+/** Shared free lists, never destroyed because threads may terminate during shutdown */
+SharedList* sharedLists()
+{
+    static SharedList* lists=new SharedList[SizeClassPool::CLASSES];
+    return lists;
+}
+
+/** Size of a class */
+size_t classSize(const int index)
+{
+    return size_t(64)<<index;
+}
+
+/** Index of the smallest class that fits the size, -1 if too large */
+int classIndex(const size_t size)
+{
+    int index=0;
+    while (index<SizeClassPool::CLASSES && classSize(index)<size)
+    {
+        index++;
+    }
+    return index<SizeClassPool::CLASSES ? index : -1;
+}
+
+/** Counts allocations that were served from the pool */
+Counter& hits()
+{
+    static Counter& counter=MetricsRegistry::instance().counter("qtwebapp_pool_allocations_total","Allocations of the SizeClassPool by result","result=\"hit\"");
+    return counter;
+}
+
+/** Counts allocations that needed operator new */
+Counter& misses()
+{
+    static Counter& counter=MetricsRegistry::instance().counter("qtwebapp_pool_allocations_total","Allocations of the SizeClassPool by result","result=\"miss\"");
+    return counter;
+}
+
+/** Set when the cache of the current thread has been destroyed, blocks released later bypass the pool */
+thread_local bool cacheDestroyed=false;
+
+/** Free blocks of the current thread */
+struct ThreadCache {
+    void* blocks[SizeClassPool::CLASSES][LOCAL_BLOCKS];
+    int count[SizeClassPool::CLASSES]={};
+
+    /** Move blocks to the shared list, release those that exceed its capacity */
+    void flush(const int index, const int keep)
+    {
+        SharedList& list=sharedLists()[index];
+        std::lock_guard<std::mutex> lock(list.mutex);
+        const size_t capacity=static_cast<size_t>(qMax(0,maxCached.load(std::memory_order_relaxed)));
+        while (count[index]>keep)
+        {
+            void* block=blocks[index][--count[index]];
+            if (list.blocks.size()<capacity)
+            {
+                list.blocks.push_back(block);
+            }
+            else
+            {
+                ::operator delete(block);
+            }
+        }
+    }
+
+    /** Take blocks from the shared list, returns false if it is empty */
+    bool refill(const int index)
+    {
+        SharedList& list=sharedLists()[index];
+        std::lock_guard<std::mutex> lock(list.mutex);
+        while (count[index]<LOCAL_BLOCKS/2 && !list.blocks.empty())
+        {
+            blocks[index][count[index]++]=list.blocks.back();
+            list.blocks.pop_back();
+        }
+        return count[index]>0;
+    }
+
+    ~ThreadCache()
+    {
+        cacheDestroyed=true;
+        for (int i=0; i<SizeClassPool::CLASSES; i++)
+        {
+            flush(i,0);
+        }
+    }
+};
+
+thread_local ThreadCache cache;
+
+}
+
+void* SizeClassPool::allocate(const size_t size)
+{
+    const int index=classIndex(size);
+    if (index<0)
+    {
+        return ::operator new(size);
+    }
+    if (enabled.load(std::memory_order_relaxed) && !cacheDestroyed)
+    {
+        if (cache.count[index]>0 || cache.refill(index))
+        {
+            hits().add();
+            return cache.blocks[index][--cache.count[index]];
+        }
+        misses().add();
+    }
+    return ::operator new(classSize(index));
+}
+
+void SizeClassPool::deallocate(void* block, const size_t size)
+{
+    const int index=classIndex(size);
+    if (index<0 || !enabled.load(std::memory_order_relaxed) || cacheDestroyed)
+    {
+        ::operator delete(block);
+        return;
+    }
+    if (cache.count[index]==LOCAL_BLOCKS)
+    {
+        cache.flush(index,LOCAL_BLOCKS/2);
+    }
+    cache.blocks[index][cache.count[index]++]=block;
+}
+
+void SizeClassPool::setEnabled(const bool enable)
+{
+    enabled.store(enable);
+}
+
+void SizeClassPool::setMaxCached(const int blocks)
+{
+    maxCached.store(blocks);
+}
+
+qint64 SizeClassPool::cachedBytes()
+{
+    qint64 bytes=0;
+    for (int i=0; i<CLASSES; i++)
+    {
+        SharedList& list=sharedLists()[i];
+        std::lock_guard<std::mutex> lock(list.mutex);
+        bytes+=static_cast<qint64>(list.blocks.size()*classSize(i));
+    }
+    return bytes;
+}
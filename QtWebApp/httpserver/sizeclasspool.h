@@ -0,0 +1,105 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef SIZECLASSPOOL_H
+#define SIZECLASSPOOL_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <new>
+#include "httpglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Recycles memory blocks of a few fixed sizes. The connection handlers use
+  it for the objects that every request needs (HttpRequest, HttpResponse,
+  RequestTimings), which are often allocated by one thread and released by
+  another. Recycling them avoids the lock of the foreign malloc arena and the
+  fragmentation that short-lived worker threads leave behind.
+  <p>
+  Each thread keeps a small cache per size class, which needs no lock.
+  Surplus blocks and the cache of a terminating thread go to a shared list
+  per size class, which holds at most setMaxCached() blocks. Larger requests
+  are passed to operator new.
+  <p>
+  The pool is enabled by default. When disabled, blocks are still rounded up
+  to their size class, so blocks remain interchangeable after switching.
+  @see PoolAllocator
+*/
+
+class DECLSPEC SizeClassPool {
+public:
+
+    /** Number of size classes */
+    static const int CLASSES=7;
+
+    /** Size of the largest class, larger blocks are not pooled */
+    static const size_t MAX_SIZE=4096;
+
+    /**
+      Get a block of at least the given size.
+      This method is thread safe.
+    */
+    static void* allocate(const size_t size);
+
+    /**
+      Return a block.
+      This method is thread safe.
+      @param block The block
+      @param size The same size as passed to allocate()
+    */
+    static void deallocate(void* block, const size_t size);
+
+    /** Enable or disable recycling. This method is thread safe. */
+    static void setEnabled(const bool enable);
+
+    /** Set the maximum number of shared free blocks per size class. This method is thread safe. */
+    static void setMaxCached(const int blocks);
+
+    /** Number of bytes in the shared free lists */
+    static qint64 cachedBytes();
+};
+
+/**
+  Standard allocator that takes its memory from the SizeClassPool.
+  Use it with std::allocate_shared() to put the object and the reference
+  counter of a std::shared_ptr into one recycled block:
+  <code><pre>
+  auto request=std::allocate_shared<HttpRequest>(PoolAllocator<HttpRequest>(),settings,headersHandler);
+  </pre></code>
+*/
+
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(const size_t n)
+    {
+        static_assert(alignof(T)<=__STDCPP_DEFAULT_NEW_ALIGNMENT__,"PoolAllocator does not support over-aligned types");
+        return static_cast<T*>(SizeClassPool::allocate(n*sizeof(T)));
+    }
+
+    void deallocate(T* block, const size_t n)
+    {
+        SizeClassPool::deallocate(block,n*sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+} // end of namespace
+
+#endif // SIZECLASSPOOL_H
@@ -4,6 +4,9 @@
 */
 
 #include "staticfilecontroller.h"
+#include "httplogging.h"
+#include "httpmetrics.h"
+#include "memorybudget.h"
 #include <QFileInfo>
 #include <QDir>
 #include <QDateTime>
@@ -31,11 +34,33 @@ StaticFileController::StaticFileController(const QSettings *settings, QObject* p
             docroot=QFileInfo(configFile.absolutePath(),docroot).absoluteFilePath();
         }
     }
-    qDebug("StaticFileController: docroot=%s, encoding=%s, maxAge=%i",qPrintable(docroot),qPrintable(encoding),maxAge);
+    qwaDebug(qwaHttpStatic,"StaticFileController: docroot=%s, encoding=%s, maxAge=%i",qPrintable(docroot),qPrintable(encoding),maxAge);
     maxCachedFileSize=settings->value("maxCachedFileSize","65536").toInt();
-    cache.setMaxCost(settings->value("cacheSize","1000000").toInt());
+    cacheSize=settings->value("cacheSize","1000000").toInt();
+    cache.setMaxCost(cacheSize);
     cacheTimeout=settings->value("cacheTime","60000").toInt();
-    qDebug("StaticFileController: cache timeout=%i, size=%i",cacheTimeout,cache.maxCost());
+    qwaDebug(qwaHttpStatic,"StaticFileController: cache timeout=%i, size=%i",cacheTimeout,cache.maxCost());
+    budgetId=MemoryBudget::instance().addCache([this](double factor)
+    {
+        std::lock_guard lock{ mutex };
+        cache.setMaxCost(qMax(1,static_cast<int>(cacheSize*factor)));
+        accountCache();
+    });
+}
+
+
+StaticFileController::~StaticFileController()
+{
+    MemoryBudget::instance().removeCache(budgetId);
+    MemoryBudget::instance().add(MemoryBudget::Caches,-accountedCost);
+}
+
+
+void StaticFileController::accountCache()
+{
+    const qint64 cost=cache.totalCost();
+    MemoryBudget::instance().add(MemoryBudget::Caches,cost-accountedCost);
+    accountedCost=cost;
 }
 
 
@@ -60,7 +85,8 @@ void StaticFileController::service(ServiceParams params)
         QByteArray document=entry->document; //copy the cached document, because other threads may destroy the cached entry immediately after mutex unlock.
         QByteArray filename=entry->filename;
         lock.unlock();
-        qDebug("StaticFileController: Cache hit for %s",path.constData());
+        HttpMetrics::instance().staticCacheHits.add();
+        qwaDebug(qwaHttpStatic,"StaticFileController: Cache hit for %s",path.constData());
         setContentType(filename,response);
         response.setHeader("Cache-Control","max-age="+QByteArray::number(maxAge/1000));
         response_write(document);
@@ -69,12 +95,13 @@ void StaticFileController::service(ServiceParams params)
     {
         lock.unlock();
         // The file is not in cache.
-        qDebug("StaticFileController: Cache miss for %s",path.constData());
+        HttpMetrics::instance().staticCacheMisses.add();
+        qwaDebug(qwaHttpStatic,"StaticFileController: Cache miss for %s",path.constData());
         // Forbid access to files outside the docroot directory
         if (path.contains("/..") || path.contains("/\\..") ||
                 QFileInfo(docroot+path).filePath() != QFileInfo(docroot+path).absoluteFilePath())
         {
-            qWarning("StaticFileController: detected forbidden characters in path %s",path.constData());
+            qCWarning(qwaHttpStatic,"StaticFileController: detected forbidden characters in path %s",path.constData());
             response.setStatus(403,"forbidden");
             response_write("403 forbidden",true);
             return;
@@ -86,7 +113,7 @@ void StaticFileController::service(ServiceParams params)
         }
         // Try to open the file
         QFile file(docroot+path);
-        qDebug("StaticFileController: Open file %s", qPrintable(file.fileName()));
+        qwaDebug(qwaHttpStatic,"StaticFileController: Open file %s", qPrintable(file.fileName()));
         if (file.open(QIODevice::ReadOnly))
         {
             setContentType(path, response);
@@ -111,6 +138,7 @@ void StaticFileController::service(ServiceParams params)
 
                 lock.lock();
                 cache.insert(request.getPath(), entryNew, entryNew->document.size());
+                accountCache();
                 lock.unlock();
             }
             file.close();
@@ -118,7 +146,7 @@ void StaticFileController::service(ServiceParams params)
         else {
             if (file.exists())
             {
-                qWarning("StaticFileController: Cannot open existing file %s for reading",qPrintable(file.fileName()));
+                qCWarning(qwaHttpStatic,"StaticFileController: Cannot open existing file %s for reading",qPrintable(file.fileName()));
                 response.setStatus(403,"forbidden");
                 response_write("403 forbidden",true);
             }
@@ -204,6 +232,6 @@ void StaticFileController::setContentType(const QString& fileName, HttpResponse&
     // Todo: add all of your content types
     else
     {
-        qDebug("StaticFileController: unknown MIME type for filename '%s'", qPrintable(fileName));
+        qwaDebug(qwaHttpStatic,"StaticFileController: unknown MIME type for filename '%s'", qPrintable(fileName));
     }
 }
@@ -7,11 +7,11 @@
 #define STATICFILECONTROLLER_H
 
 #include <QCache>
-#include <QMutex>
 #include "httpglobal.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 #include "httprequesthandler.h"
+#include "instrumentedmutex.h"
 
 namespace stefanfrings {
 
@@ -36,6 +36,7 @@ namespace stefanfrings {
   The cache improves performance of small files when loaded from a network
   drive. Large files are not cached. Files are cached as long as possible,
   when cacheTime=0. The maxAge value (in msec!) controls the remote browsers cache.
+  The cache is accounted in the MemoryBudget and shrinks while the budget is exceeded.
   <p>
   Do not instantiate this class in each request, because this would make the file cache
   useless. Better create one instance during start-up and call it when the application
@@ -59,6 +60,9 @@ public:
      */
     StaticFileController(const QSettings* settings, QObject* parent = nullptr);
 
+    /** Destructor */
+    virtual ~StaticFileController();
+
     /** Generates the response */
     void service(ServiceParams) override;
 
@@ -88,8 +92,20 @@ private:
     /** Cache storage */
     QCache<QString,CacheEntry> cache;
 
+    /** Configured size of the cache */
+    int cacheSize;
+
+    /** Size of the cache that is accounted in the MemoryBudget */
+    qint64 accountedCost=0;
+
+    /** Registration of the cache in the MemoryBudget */
+    int budgetId;
+
     /** Used to synchronize cache access for threads */
-    QMutex mutex;
+    InstrumentedMutex mutex{"static_file_cache"};
+
+    /** Update the accounted size of the cache, the caller must hold the mutex */
+    void accountCache();
 
     /** Set a content-type header in the response depending on the ending of the filename */
     void setContentType(const QString& file, HttpResponse& response) const;
@@ -0,0 +1,29 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "consolesink.h"
+#include <stdio.h>
+
+using namespace stefanfrings;
+
+ConsoleSink::ConsoleSink(const QString& msgFormat, const QString& timestampFormat, const QtMsgType minLevel)
+    : LogSink(msgFormat,timestampFormat,minLevel)
+{}
+
+ConsoleSink::~ConsoleSink()
+{
+    stop();
+}
+
+void ConsoleSink::write(const LogMessage& logMessage, const QString& decorated)
+{
+    Q_UNUSED(logMessage)
+    fputs(qPrintable(decorated),stderr);
+}
+
+void ConsoleSink::flush()
+{
+    fflush(stderr);
+}
@@ -0,0 +1,48 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef CONSOLESINK_H
+#define CONSOLESINK_H
+
+#include <QtGlobal>
+#include "logglobal.h"
+#include "logsink.h"
+
+namespace stefanfrings {
+
+/**
+  Sink that writes the decorated messages to stderr.
+  @see SinkLogger
+*/
+
+class DECLSPEC ConsoleSink : public LogSink {
+    Q_DISABLE_COPY(ConsoleSink)
+public:
+
+    /**
+      Constructor.
+      @param msgFormat Format of the decoration, see LogMessage
+      @param timestampFormat Format of timestamps, see QDateTime::toString()
+      @param minLevel Messages with lower level are discarded
+    */
+    ConsoleSink(const QString& msgFormat="{timestamp} {type} {msg}",
+                const QString& timestampFormat="yyyy-MM-dd hh:mm:ss.zzz",
+                const QtMsgType minLevel=QtDebugMsg);
+
+    /** Destructor */
+    virtual ~ConsoleSink();
+
+protected:
+
+    /** Write a message to stderr */
+    virtual void write(const LogMessage& logMessage, const QString& decorated);
+
+    /** Flush stderr */
+    virtual void flush();
+};
+
+} // end of namespace
+
+#endif // CONSOLESINK_H
@@ -20,6 +20,22 @@ void DualFileLogger::log(const QtMsgType type, const QString& message, const QSt
     secondLogger->log(type,message,file,function,line);
 }
 
+void DualFileLogger::flushQueue(const int timeout)
+{
+    firstLogger->flushQueue(timeout);
+    secondLogger->flushQueue(timeout);
+}
+
+bool DualFileLogger::isEnabled(const QtMsgType type) const
+{
+    return firstLogger->isEnabled(type) || secondLogger->isEnabled(type);
+}
+
+bool DualFileLogger::allowMessage(const QtMsgType type, const char* category)
+{
+    return firstLogger->allowMessage(type,category);
+}
+
 void DualFileLogger::clear(const bool buffer, const bool variables)
 {
     firstLogger->clear(buffer,variables);
@@ -22,6 +22,9 @@ namespace stefanfrings {
   - A second "debug" logfile with minLevel=1 or 2 and bufferSize=100. This file is for the developer who may need more details (the debug messages) about the
   situation that leaded to the error.
 
+  Both loggers capture and decorate each message separately. SinkLogger is more
+  efficient if you need several outputs but no file rotation.
+
   @see FileLogger for a description of the two underlying loggers.
 */
 
@@ -67,6 +70,21 @@ public:
     */
     virtual void clear(const bool buffer=true, const bool variables=true);
 
+    /**
+      Waits until both loggers have written their queued messages.
+      @param timeout Maximum time to wait in msec, per logger
+    */
+    virtual void flushQueue(const int timeout=1000);
+
+    /** Whether one of both loggers writes or buffers messages of the given type */
+    virtual bool isEnabled(const QtMsgType type) const;
+
+    /**
+      Applies the rate limit of the first logger, because the messages of
+      both loggers come from the same message handler.
+    */
+    virtual bool allowMessage(const QtMsgType type, const char* category);
+
 private:
 
     /** First logger */
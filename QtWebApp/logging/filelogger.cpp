@@ -12,15 +12,196 @@
 #include <QTimerEvent>
 #include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QRunnable>
 #include <stdio.h>
 
 using namespace stefanfrings;
 
+namespace {
+
+/** Calculate the CRC-32 checksum that gzip needs */
+quint32 crc32(const QByteArray& data)
+{
+    static quint32 table[256];
+    static bool initialized=[] {
+        for (quint32 i=0; i<256; ++i)
+        {
+            quint32 c=i;
+            for (int k=0; k<8; ++k)
+            {
+                c=(c & 1) ? 0xEDB88320u ^ (c>>1) : c>>1;
+            }
+            table[i]=c;
+        }
+        return true;
+    }();
+    Q_UNUSED(initialized)
+    quint32 crc=0xFFFFFFFFu;
+    for (char byte : data)
+    {
+        crc=table[(crc ^ static_cast<uchar>(byte)) & 0xFF] ^ (crc>>8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/** Append a 32 bit number in little endian byte order */
+void appendLittleEndian(QByteArray& buffer, const quint32 value)
+{
+    for (int i=0; i<4; ++i)
+    {
+        buffer.append(static_cast<char>((value>>(8*i)) & 0xFF));
+    }
+}
+
+/** Size of the pieces that gzip() compresses at once */
+const qint64 GZIP_CHUNK=1024*1024;
+
+/**
+  Compress data into a gzip member. qCompress() produces a zlib stream, which
+  contains the same deflate data between a 2 byte header and a 4 byte checksum.
+  @return The member, or an empty array on error
+*/
+QByteArray gzipMember(const QByteArray& data)
+{
+    // qCompress() prepends the uncompressed size with 4 bytes
+    QByteArray compressed=qCompress(data,6);
+    if (compressed.size()<10)
+    {
+        return QByteArray();
+    }
+    QByteArray output;
+    output.reserve(compressed.size()+12);
+    output.append("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff",10);
+    output.append(compressed.constData()+6,compressed.size()-10);
+    appendLittleEndian(output,crc32(data));
+    appendLittleEndian(output,static_cast<quint32>(data.size()));
+    return output;
+}
+
+/**
+  Compress a file into gzip format. Large files are compressed in pieces, each
+  one as a separate gzip member, so the file does not need to fit into memory.
+  gunzip and zcat decompress the members one after the other into a single file.
+*/
+bool gzip(const QString& source, const QString& target)
+{
+    QFile input(source);
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QFile file(target);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    bool success=true;
+    if (input.size()==0)
+    {
+        // A member with an empty deflate block
+        success=file.write("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00",20)==20;
+    }
+    while (success && !input.atEnd())
+    {
+        const QByteArray chunk=input.read(GZIP_CHUNK);
+        const QByteArray member=chunk.isEmpty() ? QByteArray() : gzipMember(chunk);
+        success=!member.isEmpty() && file.write(member)==member.size();
+    }
+    input.close();
+    file.close();
+    if (!success)
+    {
+        QFile::remove(target);
+    }
+    return success;
+}
+
+/**
+  Turns a segment of the log file into a backup: shifts the existing backups,
+  deletes the oldest ones and optionally compresses the new backup.
+*/
+class RotationTask : public QRunnable {
+public:
+
+    RotationTask(const QString& fileName, const QString& segmentName, const int maxBackups, const bool compress)
+        : fileName(fileName), segmentName(segmentName), maxBackups(maxBackups), compress(compress) {}
+
+    void run() override
+    {
+        // count current number of existing backup files
+        int count=0;
+        while (!backupName(count+1).isEmpty())
+        {
+            ++count;
+        }
+
+        // Remove all old backup files that exceed the maximum number
+        while (maxBackups>0 && count>=maxBackups)
+        {
+            QFile::remove(backupName(count));
+            --count;
+        }
+
+        // Rotate backup files
+        for (int i=count; i>0; --i)
+        {
+            QString name=backupName(i);
+            QString suffix=name.endsWith(".gz") ? ".gz" : "";
+            QFile::rename(name,QString("%1.%2%3").arg(fileName).arg(i+1).arg(suffix));
+        }
+
+        // Backup the segment
+        QString backup=fileName+".1";
+        if (!QFile::rename(segmentName,backup))
+        {
+            fprintf(stderr,"Cannot rename %s to %s\n",qPrintable(segmentName),qPrintable(backup));
+            return;
+        }
+        if (compress)
+        {
+            if (gzip(backup,backup+".gz"))
+            {
+                QFile::remove(backup);
+            }
+            else
+            {
+                fprintf(stderr,"Cannot compress %s\n",qPrintable(backup));
+            }
+        }
+    }
+
+private:
+
+    /** Returns the name of an existing backup file, or an empty string */
+    QString backupName(const int number) const
+    {
+        QString name=QString("%1.%2").arg(fileName).arg(number);
+        if (QFile::exists(name))
+        {
+            return name;
+        }
+        if (QFile::exists(name+".gz"))
+        {
+            return name+".gz";
+        }
+        return QString();
+    }
+
+    QString fileName;
+    QString segmentName;
+    int maxBackups;
+    bool compress;
+};
+
+}
+
 void FileLogger::refreshSettings()
 {
     mutex.lock();
     // Save old file name for later comparision with new settings
     QString oldFileName=fileName;
+    bool oldBinary=binary;
 
     // Load new config settings
     settings->sync();
@@ -37,19 +218,37 @@ void FileLogger::refreshSettings()
     }
     maxSize=settings->value("maxSize",0).toLongLong();
     maxBackups=settings->value("maxBackups",0).toInt();
+    rotateInterval=settings->value("rotateInterval",0).toInt();
+    compressBackups=settings->value("compressBackups",false).toBool();
     msgFormat=settings->value("msgFormat","{timestamp} {type} {msg}").toString();
     timestampFormat=settings->value("timestampFormat","yyyy-MM-dd hh:mm:ss.zzz").toString();
     minLevel=static_cast<QtMsgType>(settings->value("minLevel",0).toInt());
     bufferSize=settings->value("bufferSize",0).toInt();
+    binary=settings->value("binary",false).toBool();
+    bool async=settings->value("async",false).toBool();
+    int queueSize=settings->value("queueSize",8192).toInt();
+    OverflowPolicy overflowPolicy=DropMessage;
+    if (settings->value("overflowPolicy","drop").toString()=="block")
+    {
+        overflowPolicy=BlockBriefly;
+    }
+    int blockTimeout=settings->value("blockTimeout",10).toInt();
+    int rateLimit=settings->value("rateLimit",0).toInt();
+    int rateBurst=settings->value("rateBurst",0).toInt();
+    setRateLimit(rateLimit,rateBurst>0 ? rateBurst : rateLimit);
 
-    // Create new file if the filename has been changed
-    if (oldFileName!=fileName)
+    // Create new file if the filename or the file format has been changed
+    if (oldFileName!=fileName || oldBinary!=binary)
     {
         fprintf(stderr,"Logging to %s\n",qPrintable(fileName));
         close();
         open();
     }
     mutex.unlock();
+
+    // The background thread needs the mutex to terminate
+    setAsync(async,queueSize,overflowPolicy,blockTimeout);
+    updateCategoryFilter();
 }
 
 
@@ -60,6 +259,13 @@ FileLogger::FileLogger(QSettings *settings, const int refreshInterval, QObject*
     Q_ASSERT(refreshInterval>=0);
     this->settings=settings;
     file=nullptr;
+    binary=false;
+    rotateInterval=0;
+    currentSize=0;
+    nextRotation=0;
+    rotations=0;
+    // One thread, so the rotations happen in the right order
+    rotationPool.setMaxThreadCount(1);
     if (refreshInterval>0)
     {
         refreshTimer.start(refreshInterval,this);
@@ -71,7 +277,9 @@ FileLogger::FileLogger(QSettings *settings, const int refreshInterval, QObject*
 
 FileLogger::~FileLogger()
 {
+    setAsync(false);
     close();
+    rotationPool.waitForDone();
 }
 
 
@@ -82,7 +290,14 @@ void FileLogger::write(const LogMessage* logMessage)
     {
 
         // Write the message
-        file->write(qPrintable(logMessage->toString(msgFormat,timestampFormat)));
+        if (binary)
+        {
+            currentSize+=file->write(encoder.encode(*logMessage,msgFormat,timestampFormat));
+        }
+        else
+        {
+            currentSize+=file->write(qPrintable(decorate(logMessage)));
+        }
 
         // Flush error messages immediately, to ensure that no important message
         // gets lost when the program terinates abnormally.
@@ -98,6 +313,12 @@ void FileLogger::write(const LogMessage* logMessage)
             close();
         }
 
+        // Start a new file if the current one is too large or too old
+        else if (rotationDue(logMessage->getTimestamp()))
+        {
+            rotate();
+        }
+
     }
 
     // Fall-back to the super class method, if writing failed
@@ -116,11 +337,48 @@ void FileLogger::open()
     }
     else {
         file=new QFile(fileName);
-        if (!file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        QIODevice::OpenMode mode=QIODevice::WriteOnly | QIODevice::Append;
+        if (!binary)
+        {
+            mode|=QIODevice::Text;
+        }
+        if (!file->open(mode))
         {
             qWarning("Cannot open log file %s: %s",qPrintable(fileName),qPrintable(file->errorString()));
             file=nullptr;
         }
+        else
+        {
+            recoverSegments();
+            currentSize=file->size();
+            if (binary)
+            {
+                currentSize+=file->write(encoder.begin(currentSize==0));
+            }
+            nextRotation=0;
+            if (rotateInterval>0)
+            {
+                nextRotation=QDateTime::currentMSecsSinceEpoch()+rotateInterval*qint64(1000);
+            }
+        }
+    }
+}
+
+
+void FileLogger::recoverSegments()
+{
+    if (recoveredFileName==fileName)
+    {
+        return;
+    }
+    recoveredFileName=fileName;
+    // The names contain the time of the rotation, so sorting by name gives the order of creation
+    const QFileInfo info(fileName);
+    QStringList segments=info.dir().entryList(QStringList() << info.fileName()+".segment*",QDir::Files,QDir::Name);
+    foreach (const QString& segment, segments)
+    {
+        fprintf(stderr,"Recovering log file segment %s\n",qPrintable(segment));
+        rotationPool.start(new RotationTask(fileName,info.dir().filePath(segment),maxBackups,compressBackups));
     }
 }
 
@@ -135,36 +393,36 @@ void FileLogger::close()
     }
 }
 
-void FileLogger::rotate() {
-    // count current number of existing backup files
-    int count=0;
-    forever
+bool FileLogger::rotationDue(const qint64 now) const
+{
+    return (maxSize>0 && currentSize>=maxSize) || (nextRotation>0 && now>=nextRotation);
+}
+
+
+void FileLogger::rotate()
+{
+    // Move the current file out of the way, so that new messages go
+    // into a new file. The background thread does the rest.
+    close();
+    // Unique across restarts, so a segment that a crash left behind is never overwritten
+    QString segmentName=QString("%1.segment-%2-%3").arg(fileName)
+            .arg(QDateTime::currentMSecsSinceEpoch(),15,10,QChar('0')).arg(++rotations,6,10,QChar('0'));
+    const bool renamed=QFile::rename(fileName,segmentName);
+    if (renamed)
     {
-        QFile bakFile(QString("%1.%2").arg(fileName).arg(count+1));
-        if (bakFile.exists())
-        {
-            ++count;
-        }
-        else
-        {
-            break;
-        }
+        rotationPool.start(new RotationTask(fileName,segmentName,maxBackups,compressBackups));
     }
-
-    // Remove all old backup files that exceed the maximum number
-    while (maxBackups>0 && count>=maxBackups)
+    else
     {
-        QFile::remove(QString("%1.%2").arg(fileName).arg(count));
-        --count;
+        fprintf(stderr,"Cannot rename %s to %s\n",qPrintable(fileName),qPrintable(segmentName));
     }
-
-    // Rotate backup files
-    for (int i=count; i>0; --i) {
-        QFile::rename(QString("%1.%2").arg(fileName).arg(i),QString("%1.%2").arg(fileName).arg(i+1));
+    open();
+    if (!renamed)
+    {
+        // Keep writing to the same file and try again after another maxSize bytes
+        // or at the next interval, instead of trying again for every message
+        currentSize=0;
     }
-
-    // Backup the current logfile
-    QFile::rename(fileName,fileName+".1");
 }
 
 
@@ -185,12 +443,10 @@ void FileLogger::timerEvent(QTimerEvent* event)
         // Flush the I/O buffer
         file->flush();
 
-        // Rotate the file if it is too large
-        if (maxSize>0 && file->size()>=maxSize)
+        // Rotate the file if it became too old while no messages were written
+        if (rotationDue(QDateTime::currentMSecsSinceEpoch()))
         {
-            close();
             rotate();
-            open();
         }
 
         mutex.unlock();
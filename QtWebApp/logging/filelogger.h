@@ -11,8 +11,10 @@
 #include <QFile>
 #include <QMutex>
 #include <QBasicTimer>
+#include <QThreadPool>
 #include "logglobal.h"
 #include "logger.h"
+#include "logbinary.h"
 
 namespace stefanfrings {
 
@@ -25,10 +27,19 @@ namespace stefanfrings {
   fileName=logs/QtWebApp.log
   maxSize=1000000
   maxBackups=2
+  rotateInterval=0
+  compressBackups=false
   bufferSize=0
   minLevel=0
   msgformat={timestamp} {typeNr} {type} thread={thread}: {msg}
   timestampFormat=dd.MM.yyyy hh:mm:ss.zzz  
+  async=false
+  queueSize=8192
+  overflowPolicy=drop
+  blockTimeout=10
+  binary=false
+  rateLimit=0
+  rateBurst=0
   </pre></code>
 
   - Possible log levels are: 0=DEBUG, 1=WARNING, 2=CRITICAL, 3=FATAL, 4=INFO
@@ -39,6 +50,14 @@ namespace stefanfrings {
     replaced by a new file if it becomes larger than this limit. Please note that
     the actual file size may become a little bit larger than this limit. Default is 0=unlimited.
   - maxBackups defines the number of backup files to keep. Default is 0=unlimited.
+  - rotateInterval is the maximum age of the file in seconds, e.g. 86400 for daily files. Default is 0=unlimited.
+  - compressBackups compresses the backup files with gzip. Their names get the suffix ".gz". Default is false.
+  <p>
+  Both rotation triggers are checked when a message is written. The current file is
+  renamed and a new file is opened immediately. Renaming the older backups, deleting
+  the oldest ones and compressing are done by a background thread, so logging
+  does not wait for them. Segments that a crash left behind are turned into
+  backups when the file is opened the next time.
   - bufferSize defines the size of the ring buffer. Default is 0=disabled.
   - minLevel If bufferSize=0: Messages with lower level are discarded.<br>
              If buffersize>0: Messages with lower level are buffered, messages with equal or higher
@@ -46,6 +65,19 @@ namespace stefanfrings {
              Defaults is 0=debug.
   - msgFormat defines the decoration of log messages, see LogMessage class. Default is "{timestamp} {type} {msg}".
   - timestampFormat defines the format of timestamps, see QDateTime::toString(). Default is "yyyy-MM-dd hh:mm:ss.zzz".
+  - async enables a background thread that writes the messages, see Logger::setAsync(). Default is false.
+  - queueSize is the number of messages that can wait for the background thread. Default is 8192.
+    Changes of this setting take effect after restarting the program.
+  - overflowPolicy defines what happens to new messages while the queue is full: "drop" discards them,
+    "block" lets the caller wait up to blockTimeout msec for free space. Default is "drop".
+  - blockTimeout is the maximum waiting time in msec for overflowPolicy=block. Default is 10.
+  - rateLimit is the maximum number of DEBUG, INFO and WARNING messages per second and
+    logging category, see Logger::setRateLimit(). Default is 0=unlimited.
+  - rateBurst is the number of messages per category that may exceed the rateLimit for a
+    short time. Default is 0, which means the same value as rateLimit.
+  - binary writes compact binary records instead of decorated text, see LogEncoder.
+    The tool QtWebApp/tools/logdecoder converts such files back to text.
+    Use a different fileName than for text output. Default is false.
 
 
   @see set() describes how to set logger variables
@@ -100,6 +132,33 @@ private:
     /** Configured maximum number of backup files, or 0=unlimited */
     int maxBackups;
 
+    /** Configured maximum age of the file in seconds, or 0=unlimited */
+    int rotateInterval;
+
+    /** Configured compression of backup files */
+    bool compressBackups;
+
+    /** Number of bytes in the current file */
+    qint64 currentSize;
+
+    /** Time of the next rotation in msec since the epoch, or 0=none */
+    qint64 nextRotation;
+
+    /** Number of rotations, used to create unique names for the segments */
+    int rotations;
+
+    /** Name of the log file whose left-over segments have already been recovered */
+    QString recoveredFileName;
+
+    /** Renames and compresses the backup files, one after the other */
+    QThreadPool rotationPool;
+
+    /** Whether the file contains binary records instead of text */
+    bool binary;
+
+    /** Encoder of the binary records */
+    LogEncoder encoder;
+
     /** Pointer to the configuration settings */
     QSettings* settings;
 
@@ -112,15 +171,25 @@ private:
     /** Timer for flushing the file I/O buffer */
     QBasicTimer flushTimer;
 
-    /** Open the output file */
+    /** Open the output file, and turn the segments of a previous run into backups */
     void open();
 
+    /** Queue the segments of the log file that a previous run did not turn into backups */
+    void recoverSegments();
+
     /** Close the output file */
     void close();
 
-    /** Rotate files and delete some backups if there are too many */
+    /**
+      Replace the current file by a new one. The old file gets renamed to a
+      temporary segment name, the background thread turns it into a backup.
+      Must be called while the mutex is locked.
+    */
     void rotate();
 
+    /** Returns true if the current file must be rotated */
+    bool rotationDue(const qint64 now) const;
+
     /**
       Refreshes the configuration settings.
       This method is thread-safe.
@@ -0,0 +1,42 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "filesink.h"
+#include <stdio.h>
+
+using namespace stefanfrings;
+
+FileSink::FileSink(const QString& fileName, const QString& msgFormat, const QString& timestampFormat, const QtMsgType minLevel)
+    : LogSink(msgFormat,timestampFormat,minLevel), file(fileName)
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+    {
+        // Do not use qWarning() here, the logger may not be ready yet
+        fprintf(stderr,"Cannot open log file %s: %s\n",qPrintable(fileName),qPrintable(file.errorString()));
+    }
+}
+
+FileSink::~FileSink()
+{
+    stop();
+    file.close();
+}
+
+void FileSink::write(const LogMessage& logMessage, const QString& decorated)
+{
+    Q_UNUSED(logMessage)
+    if (file.isOpen())
+    {
+        file.write(decorated.toLocal8Bit());
+    }
+}
+
+void FileSink::flush()
+{
+    if (file.isOpen())
+    {
+        file.flush();
+    }
+}
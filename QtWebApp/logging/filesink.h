@@ -0,0 +1,63 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef FILESINK_H
+#define FILESINK_H
+
+#include <QtGlobal>
+#include <QFile>
+#include "logglobal.h"
+#include "logsink.h"
+
+namespace stefanfrings {
+
+/**
+  Sink that appends the decorated messages to a text file.
+  The file is flushed whenever the queue of the sink becomes empty.
+  <p>
+  The file grows without limit: it is never rotated, backed up or compressed,
+  and the settings maxSize, maxBackups, rotateInterval and compressBackups of the
+  FileLogger do not exist here. Therefore a SinkLogger with FileSinks replaces a
+  DualFileLogger only if the files are rotated externally, e.g. by logrotate with
+  copytruncate. Otherwise use FileLogger or DualFileLogger.
+  @see SinkLogger
+*/
+
+class DECLSPEC FileSink : public LogSink {
+    Q_DISABLE_COPY(FileSink)
+public:
+
+    /**
+      Constructor.
+      @param fileName Name of the log file
+      @param msgFormat Format of the decoration, see LogMessage
+      @param timestampFormat Format of timestamps, see QDateTime::toString()
+      @param minLevel Messages with lower level are discarded
+    */
+    FileSink(const QString& fileName,
+             const QString& msgFormat="{timestamp} {type} {msg}",
+             const QString& timestampFormat="yyyy-MM-dd hh:mm:ss.zzz",
+             const QtMsgType minLevel=QtDebugMsg);
+
+    /** Destructor. Closes the file. */
+    virtual ~FileSink();
+
+protected:
+
+    /** Write a message into the file */
+    virtual void write(const LogMessage& logMessage, const QString& decorated);
+
+    /** Flush the file buffer */
+    virtual void flush();
+
+private:
+
+    /** The output file */
+    QFile file;
+};
+
+} // end of namespace
+
+#endif // FILESINK_H
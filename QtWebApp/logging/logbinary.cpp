@@ -0,0 +1,419 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "logbinary.h"
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Signature at the beginning of a binary log file */
+const char SIGNATURE[]="QWABLOG1";
+
+/** Record types */
+enum RecordType {FormatRecord=1, ResetRecord=2, StringRecord=3, MessageRecord=4};
+
+/** Replaces the numbers in message texts */
+const ushort PLACEHOLDER=0x1A;
+
+/** The string table gets reset when it reaches this size */
+const int MAX_STRINGS=65536;
+
+/** Numbers with more digits are kept in the text */
+const int MAX_DIGITS=18;
+
+/** Larger records are treated as corrupt by the decoder */
+const quint32 MAX_RECORD_SIZE=64*1024*1024;
+
+void appendVarint(QByteArray& buffer, quint64 value)
+{
+    while (value>=0x80)
+    {
+        buffer.append(static_cast<char>((value & 0x7F) | 0x80));
+        value>>=7;
+    }
+    buffer.append(static_cast<char>(value));
+}
+
+void appendString(QByteArray& buffer, const QString& text)
+{
+    QByteArray utf8=text.toUtf8();
+    appendVarint(buffer,static_cast<quint64>(utf8.size()));
+    buffer.append(utf8);
+}
+
+quint64 zigzag(const qint64 value)
+{
+    return (static_cast<quint64>(value)<<1) ^ static_cast<quint64>(value>>63);
+}
+
+qint64 unzigzag(const quint64 value)
+{
+    return static_cast<qint64>(value>>1) ^ -static_cast<qint64>(value & 1);
+}
+
+bool isLetter(const ushort c)
+{
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+/** Reads the payload of a record */
+class RecordReader {
+public:
+    RecordReader(const QByteArray& data) : data(data), pos(0), failed(false) {}
+
+    quint64 varint()
+    {
+        quint64 value=0;
+        for (int shift=0; shift<64; shift+=7)
+        {
+            if (pos>=data.size())
+            {
+                break;
+            }
+            uchar byte=static_cast<uchar>(data.at(pos++));
+            value|=static_cast<quint64>(byte & 0x7F)<<shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        failed=true;
+        return 0;
+    }
+
+    QString string()
+    {
+        quint64 size=varint();
+        if (failed || size>static_cast<quint64>(data.size()-pos))
+        {
+            failed=true;
+            return QString();
+        }
+        QString text=QString::fromUtf8(data.constData()+pos,static_cast<int>(size));
+        pos+=static_cast<int>(size);
+        return text;
+    }
+
+    const QByteArray& data;
+    int pos;
+    bool failed;
+};
+
+}
+
+LogEncoder::LogEncoder()
+{
+    lastTimestamp=0;
+}
+
+const QByteArray& LogEncoder::begin(const bool emptyFile)
+{
+    buffer.resize(0);
+    if (emptyFile)
+    {
+        buffer.append(SIGNATURE,sizeof(SIGNATURE)-1);
+    }
+    // The decoder of an appended file must not use the old strings
+    reset();
+    return buffer;
+}
+
+void LogEncoder::beginRecord(const int type)
+{
+    record.resize(0);
+    record.append(static_cast<char>(type));
+}
+
+void LogEncoder::endRecord()
+{
+    quint32 size=static_cast<quint32>(record.size());
+    for (int i=0; i<4; ++i)
+    {
+        buffer.append(static_cast<char>((size>>(8*i)) & 0xFF));
+    }
+    buffer.append(record);
+}
+
+void LogEncoder::reset()
+{
+    strings.clear();
+    msgFormat.clear();
+    timestampFormat.clear();
+    lastTimestamp=0;
+    beginRecord(ResetRecord);
+    endRecord();
+}
+
+quint32 LogEncoder::intern(const QString& text)
+{
+    auto it=strings.constFind(text);
+    if (it!=strings.constEnd())
+    {
+        return it.value();
+    }
+    quint32 id=static_cast<quint32>(strings.size());
+    strings.insert(text,id);
+    // The message record is being built in record, so use a separate buffer
+    QByteArray definition;
+    definition.append(static_cast<char>(StringRecord));
+    appendString(definition,text);
+    quint32 size=static_cast<quint32>(definition.size());
+    for (int i=0; i<4; ++i)
+    {
+        buffer.append(static_cast<char>((size>>(8*i)) & 0xFF));
+    }
+    buffer.append(definition);
+    return id;
+}
+
+const QByteArray& LogEncoder::encode(const LogMessage& logMessage, const QString& msgFormat, const QString& timestampFormat)
+{
+    buffer.resize(0);
+    if (strings.size()>=MAX_STRINGS)
+    {
+        reset();
+    }
+    if (msgFormat!=this->msgFormat || timestampFormat!=this->timestampFormat)
+    {
+        this->msgFormat=msgFormat;
+        this->timestampFormat=timestampFormat;
+        beginRecord(FormatRecord);
+        appendString(record,msgFormat);
+        appendString(record,timestampFormat);
+        endRecord();
+    }
+
+    // Replace decimal numbers in the message text by placeholders, so that
+    // similar messages share the same string. Numbers that are part of a word
+    // (e.g. hexadecimal) or have leading zeros stay in the text.
+    const QString& message=logMessage.message;
+    messageTemplate.resize(0);
+    arguments.clear();
+    if (message.contains(QChar(PLACEHOLDER)))
+    {
+        messageTemplate=message;
+    }
+    else
+    {
+        const ushort* data=message.utf16();
+        const int size=message.size();
+        int pos=0;
+        while (pos<size)
+        {
+            int end=pos;
+            while (end<size && data[end]>='0' && data[end]<='9')
+            {
+                ++end;
+            }
+            int digits=end-pos;
+            if (digits>0 && digits<=MAX_DIGITS
+                    && (data[pos]!='0' || digits==1)
+                    && (pos==0 || !isLetter(data[pos-1]))
+                    && (end==size || !isLetter(data[end])))
+            {
+                arguments.append(message.midRef(pos,digits).toULongLong());
+                messageTemplate.append(QChar(PLACEHOLDER));
+                pos=end;
+            }
+            else if (digits>0)
+            {
+                messageTemplate.append(message.midRef(pos,digits));
+                pos=end;
+            }
+            else
+            {
+                messageTemplate.append(message.at(pos));
+                ++pos;
+            }
+        }
+    }
+
+    // Intern the strings first because this emits their definitions
+    quint32 templateId=intern(messageTemplate);
+    quint32 fileId=intern(logMessage.file);
+    quint32 functionId=intern(logMessage.function);
+    QList<quint32> variableIds;
+    for (auto it=logMessage.logVars.constBegin(); it!=logMessage.logVars.constEnd(); ++it)
+    {
+        variableIds.append(intern(it.key()));
+        variableIds.append(intern(it.value()));
+    }
+
+    beginRecord(MessageRecord);
+    appendVarint(record,zigzag(logMessage.timestamp-lastTimestamp));
+    lastTimestamp=logMessage.timestamp;
+    appendVarint(record,static_cast<quint64>(logMessage.type));
+    appendVarint(record,reinterpret_cast<quintptr>(logMessage.threadId));
+    appendVarint(record,templateId);
+    appendVarint(record,static_cast<quint64>(arguments.size()));
+    for (quint64 argument : arguments)
+    {
+        appendVarint(record,argument);
+    }
+    appendVarint(record,fileId);
+    appendVarint(record,functionId);
+    appendVarint(record,zigzag(logMessage.line));
+    appendVarint(record,static_cast<quint64>(variableIds.size()/2));
+    for (quint32 id : variableIds)
+    {
+        appendVarint(record,id);
+    }
+    endRecord();
+    return buffer;
+}
+
+
+LogDecoder::LogDecoder(QIODevice* device)
+{
+    Q_ASSERT(device!=nullptr);
+    this->device=device;
+    started=false;
+    lastTimestamp=0;
+    msgFormat="{timestamp} {type} {msg}";
+    timestampFormat="yyyy-MM-dd hh:mm:ss.zzz";
+}
+
+bool LogDecoder::read(LogMessage& logMessage)
+{
+    if (!started)
+    {
+        if (device->read(sizeof(SIGNATURE)-1)!=QByteArray(SIGNATURE))
+        {
+            errorString="Not a binary log file";
+            return false;
+        }
+        started=true;
+    }
+
+    forever
+    {
+        QByteArray header=device->read(4);
+        if (header.isEmpty())
+        {
+            return false;
+        }
+        if (header.size()<4)
+        {
+            errorString="Truncated record header";
+            return false;
+        }
+        quint32 size=0;
+        for (int i=0; i<4; ++i)
+        {
+            size|=static_cast<quint32>(static_cast<uchar>(header.at(i)))<<(8*i);
+        }
+        // Check the size before reading, because read() allocates it in advance
+        if (size>MAX_RECORD_SIZE)
+        {
+            errorString="Invalid record size";
+            return false;
+        }
+        if (!device->isSequential() && size>device->size()-device->pos())
+        {
+            errorString="Truncated record";
+            return false;
+        }
+        QByteArray data=device->read(size);
+        if (data.size()!=static_cast<int>(size) || size==0)
+        {
+            errorString="Truncated record";
+            return false;
+        }
+
+        RecordReader reader(data);
+        int type=static_cast<uchar>(data.at(0));
+        reader.pos=1;
+        switch (type)
+        {
+            case FormatRecord:
+                msgFormat=reader.string();
+                timestampFormat=reader.string();
+                break;
+            case ResetRecord:
+                strings.clear();
+                lastTimestamp=0;
+                break;
+            case StringRecord:
+                strings.append(reader.string());
+                break;
+            case MessageRecord:
+            {
+                auto lookup=[&](const quint64 id) {
+                    if (id>=static_cast<quint64>(strings.size()))
+                    {
+                        reader.failed=true;
+                        return QString();
+                    }
+                    return strings.at(static_cast<int>(id));
+                };
+                lastTimestamp+=unzigzag(reader.varint());
+                logMessage.timestamp=lastTimestamp;
+                logMessage.type=static_cast<QtMsgType>(reader.varint());
+                logMessage.threadId=reinterpret_cast<Qt::HANDLE>(static_cast<quintptr>(reader.varint()));
+                QString messageTemplate=lookup(reader.varint());
+                quint64 count=reader.varint();
+                QList<quint64> arguments;
+                for (quint64 i=0; i<count && !reader.failed; ++i)
+                {
+                    arguments.append(reader.varint());
+                }
+                // Put the numbers back into the text
+                logMessage.message.resize(0);
+                int next=0;
+                for (QChar c : messageTemplate)
+                {
+                    if (c.unicode()==PLACEHOLDER && next<arguments.size())
+                    {
+                        logMessage.message.append(QString::number(arguments.at(next++)));
+                    }
+                    else
+                    {
+                        logMessage.message.append(c);
+                    }
+                }
+                logMessage.file=lookup(reader.varint());
+                logMessage.function=lookup(reader.varint());
+                logMessage.line=static_cast<int>(unzigzag(reader.varint()));
+                logMessage.logVars.clear();
+                count=reader.varint();
+                for (quint64 i=0; i<count && !reader.failed; ++i)
+                {
+                    QString name=lookup(reader.varint());
+                    logMessage.logVars.insert(name,lookup(reader.varint()));
+                }
+                if (reader.failed)
+                {
+                    errorString="Invalid message record";
+                    return false;
+                }
+                return true;
+            }
+            default:
+                // Skip unknown records of newer versions
+                break;
+        }
+        if (reader.failed)
+        {
+            errorString="Invalid record";
+            return false;
+        }
+    }
+}
+
+const QString& LogDecoder::getMsgFormat() const
+{
+    return msgFormat;
+}
+
+const QString& LogDecoder::getTimestampFormat() const
+{
+    return timestampFormat;
+}
+
+const QString& LogDecoder::getErrorString() const
+{
+    return errorString;
+}
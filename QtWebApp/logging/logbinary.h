@@ -0,0 +1,162 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef LOGBINARY_H
+#define LOGBINARY_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QStringList>
+#include "logglobal.h"
+#include "logmessage.h"
+
+namespace stefanfrings {
+
+/**
+  Encodes log messages into compact binary records, see LogDecoder for the reverse.
+  <p>
+  A binary log file starts with the 8 byte signature "QWABLOG1", followed by
+  records. Each record consists of the length of its payload (32 bit, little endian),
+  a record type and the payload:
+
+  - Format: the msgFormat and timestampFormat that the decoder shall use by default
+  - Reset: clears the string table and the timestamp base of the decoder
+  - String: adds a string to the table, its ID is the number of previously defined strings
+  - Message: timestamp as difference to the previous message, type, thread ID,
+    ID of the message text with all decimal numbers replaced by a placeholder,
+    the numbers, IDs of file and function name, line number and IDs of the
+    names and values of the logger variables
+
+  Integers are stored as variable length numbers, 7 bits per byte. Strings are
+  written only once per file, later messages refer to them by ID. The string table
+  gets reset when it becomes too large.
+  <p>
+  Instances are not thread safe.
+*/
+
+class DECLSPEC LogEncoder {
+    Q_DISABLE_COPY(LogEncoder)
+public:
+
+    /** Constructor */
+    LogEncoder();
+
+    /**
+      Start a new file or continue an existing one.
+      @param emptyFile Whether the file is empty and needs the signature
+      @return The bytes to write into the file
+    */
+    const QByteArray& begin(const bool emptyFile);
+
+    /**
+      Encode a message. Emits the format and string definitions as needed.
+      @param logMessage The message
+      @param msgFormat Format of the decoration, stored for the decoder
+      @param timestampFormat Format of timestamps, stored for the decoder
+      @return The bytes to write into the file, valid until the next call
+    */
+    const QByteArray& encode(const LogMessage& logMessage, const QString& msgFormat, const QString& timestampFormat);
+
+private:
+
+    /** Output buffer, reused for all records */
+    QByteArray buffer;
+
+    /** Payload of the current record */
+    QByteArray record;
+
+    /** Interned strings with their ID */
+    QHash<QString,quint32> strings;
+
+    /** Format of the last Format record */
+    QString msgFormat;
+
+    /** Format of the last Format record */
+    QString timestampFormat;
+
+    /** Timestamp of the previous message */
+    qint64 lastTimestamp;
+
+    /** Numbers of the current message */
+    QList<quint64> arguments;
+
+    /** Message text of the current message with replaced numbers */
+    QString messageTemplate;
+
+    /** Get the ID of a string, emit a definition if it is new */
+    quint32 intern(const QString& text);
+
+    /** Start a new record in the record buffer */
+    void beginRecord(const int type);
+
+    /** Append the record buffer with length prefix to the output buffer */
+    void endRecord();
+
+    /** Emit a Reset record and clear the string table */
+    void reset();
+};
+
+
+/**
+  Decodes a binary log file that has been written by LogEncoder.
+  The decoded messages may be decorated with LogFormat or LogMessage::toString().
+*/
+
+class DECLSPEC LogDecoder {
+    Q_DISABLE_COPY(LogDecoder)
+public:
+
+    /**
+      Constructor.
+      @param device The opened input device, ownership is not taken
+    */
+    LogDecoder(QIODevice* device);
+
+    /**
+      Read the next message. Records larger than 64 MB or larger than the rest
+      of the file are treated as corrupt.
+      @param logMessage Receives the message
+      @return false at the end of the file or in case of an error
+    */
+    bool read(LogMessage& logMessage);
+
+    /** Format of the decoration that was used by the logger */
+    const QString& getMsgFormat() const;
+
+    /** Format of timestamps that was used by the logger */
+    const QString& getTimestampFormat() const;
+
+    /** Description of the last error, or empty */
+    const QString& getErrorString() const;
+
+private:
+
+    /** The input file */
+    QIODevice* device;
+
+    /** Whether the signature has been read */
+    bool started;
+
+    /** String table */
+    QStringList strings;
+
+    /** Format of the last Format record */
+    QString msgFormat;
+
+    /** Format of the last Format record */
+    QString timestampFormat;
+
+    /** Timestamp of the previous message */
+    qint64 lastTimestamp;
+
+    /** Description of the last error */
+    QString errorString;
+};
+
+} // end of namespace
+
+#endif // LOGBINARY_H
@@ -0,0 +1,313 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "logformat.h"
+#include <QDateTime>
+#include <limits>
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Append a number without creating a temporary string */
+void appendNumber(QString& output, quint64 value, const int base)
+{
+    QChar digits[20];
+    int count=0;
+    do
+    {
+        int digit=static_cast<int>(value%base);
+        digits[count++]=QLatin1Char(digit<10 ? '0'+digit : 'a'+digit-10);
+        value/=base;
+    }
+    while (value>0);
+    while (count>0)
+    {
+        output.append(digits[--count]);
+    }
+}
+
+}
+
+LogFormat::LogFormat(const QString& msgFormat, const QString& timestampFormat)
+{
+    setFormat(msgFormat,timestampFormat);
+}
+
+void LogFormat::setFormat(const QString& msgFormat, const QString& timestampFormat)
+{
+    if (!segments.isEmpty() && this->msgFormat==msgFormat && this->timestampFormat==timestampFormat)
+    {
+        return;
+    }
+    this->msgFormat=msgFormat;
+    this->timestampFormat=timestampFormat;
+    segments.clear();
+
+    // Split the format into text and variables
+    QString text;
+    int pos=0;
+    while (pos<msgFormat.size())
+    {
+        int start=msgFormat.indexOf('{',pos);
+        int end=(start<0) ? -1 : msgFormat.indexOf('}',start+1);
+        if (end<0)
+        {
+            text.append(msgFormat.midRef(pos));
+            break;
+        }
+        start=msgFormat.lastIndexOf('{',end);
+        QStringRef name=msgFormat.midRef(start+1,end-start-1);
+        text.append(msgFormat.midRef(pos,start-pos));
+        if (!text.isEmpty())
+        {
+            segments.append({Text,text});
+            text.clear();
+        }
+        Kind kind=kindOf(name);
+        segments.append({kind,kind==Variable ? name.toString() : QString()});
+        pos=end+1;
+    }
+    text.append('\n');
+    segments.append({Text,text});
+
+    parseTimestampFormat();
+}
+
+void LogFormat::parseTimestampFormat()
+{
+    timestampPrefixFormat=timestampFormat;
+    timestampSuffixFormat.clear();
+    millisDigits=0;
+    cachedSecond=std::numeric_limits<qint64>::min();
+
+    // Search milliseconds outside of quoted text
+    bool quoted=false;
+    int pos=0;
+    while (pos<timestampFormat.size())
+    {
+        QChar c=timestampFormat.at(pos);
+        if (c=='\'')
+        {
+            quoted=!quoted;
+        }
+        else if (c=='z' && !quoted)
+        {
+            int length=1;
+            while (pos+length<timestampFormat.size() && timestampFormat.at(pos+length)=='z')
+            {
+                ++length;
+            }
+            if (millisDigits!=0 || (length!=1 && length!=3))
+            {
+                millisDigits=-1;
+                return;
+            }
+            millisDigits=length;
+            timestampPrefixFormat=timestampFormat.left(pos);
+            timestampSuffixFormat=timestampFormat.mid(pos+length);
+            pos+=length;
+            continue;
+        }
+        ++pos;
+    }
+}
+
+void LogFormat::appendTimestamp(const qint64 timestamp, QString& output) const
+{
+    if (millisDigits<0)
+    {
+        output.append(QDateTime::fromMSecsSinceEpoch(timestamp).toString(timestampFormat));
+        return;
+    }
+
+    // Refresh the cached parts once per second
+    qint64 second=timestamp/1000;
+    int millis=static_cast<int>(timestamp%1000);
+    if (millis<0)
+    {
+        --second;
+        millis+=1000;
+    }
+    if (second!=cachedSecond)
+    {
+        QDateTime time=QDateTime::fromMSecsSinceEpoch(second*1000);
+        cachedPrefix=timestampPrefixFormat.isEmpty() ? QString() : time.toString(timestampPrefixFormat);
+        cachedSuffix=timestampSuffixFormat.isEmpty() ? QString() : time.toString(timestampSuffixFormat);
+        cachedSecond=second;
+    }
+
+    output.append(cachedPrefix);
+    if (millisDigits==3)
+    {
+        output.append(QLatin1Char('0'+millis/100));
+        output.append(QLatin1Char('0'+millis/10%10));
+        output.append(QLatin1Char('0'+millis%10));
+    }
+    else if (millisDigits==1)
+    {
+        appendNumber(output,static_cast<quint64>(millis),10);
+    }
+    output.append(cachedSuffix);
+}
+
+const QString& LogFormat::getMsgFormat() const
+{
+    return msgFormat;
+}
+
+const QString& LogFormat::getTimestampFormat() const
+{
+    return timestampFormat;
+}
+
+LogFormat::Kind LogFormat::kindOf(const QStringRef& name)
+{
+    if (name==QLatin1String("msg"))
+    {
+        return Message;
+    }
+    else if (name==QLatin1String("timestamp"))
+    {
+        return Timestamp;
+    }
+    else if (name==QLatin1String("typeNr"))
+    {
+        return TypeNr;
+    }
+    else if (name==QLatin1String("type"))
+    {
+        return Type;
+    }
+    else if (name==QLatin1String("file"))
+    {
+        return File;
+    }
+    else if (name==QLatin1String("function"))
+    {
+        return Function;
+    }
+    else if (name==QLatin1String("line"))
+    {
+        return Line;
+    }
+    else if (name==QLatin1String("thread"))
+    {
+        return Thread;
+    }
+    return Variable;
+}
+
+void LogFormat::format(const LogMessage& logMessage, QString& output) const
+{
+    // Keeps the allocated memory
+    output.resize(0);
+    for (const Segment& segment : segments)
+    {
+        if (segment.kind==Text)
+        {
+            output.append(segment.text);
+        }
+        else if (segment.kind==Message)
+        {
+            appendMessage(logMessage,output);
+        }
+        else if (!appendValue(segment.kind,segment.text,logMessage,output))
+        {
+            // Keep unknown variables as they are
+            output.append('{').append(segment.text).append('}');
+        }
+    }
+}
+
+bool LogFormat::appendValue(const Kind kind, const QString& name, const LogMessage& logMessage, QString& output) const
+{
+    switch (kind)
+    {
+        case Timestamp:
+            appendTimestamp(logMessage.timestamp,output);
+            break;
+        case TypeNr:
+            appendNumber(output,static_cast<quint64>(logMessage.type),10);
+            break;
+        case Type:
+            switch (logMessage.type)
+            {
+                case QtDebugMsg:
+                    output.append(QLatin1String("DEBUG   "));
+                    break;
+                case QtWarningMsg:
+                    output.append(QLatin1String("WARNING "));
+                    break;
+                case QtCriticalMsg:
+                    output.append(QLatin1String("CRITICAL"));
+                    break;
+                case QtFatalMsg:
+                    output.append(QLatin1String("FATAL   "));
+                    break;
+            #if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
+                case QtInfoMsg:
+                    output.append(QLatin1String("INFO    "));
+                    break;
+            #endif
+            }
+            break;
+        case File:
+            output.append(logMessage.file);
+            break;
+        case Function:
+            output.append(logMessage.function);
+            break;
+        case Line:
+            if (logMessage.line<0)
+            {
+                output.append('-');
+            }
+            appendNumber(output,static_cast<quint64>(qAbs(logMessage.line)),10);
+            break;
+        case Thread:
+            output.append(QLatin1String("0x"));
+            appendNumber(output,reinterpret_cast<quintptr>(logMessage.threadId),16);
+            break;
+        case Variable:
+        {
+            auto it=logMessage.logVars.constFind(name);
+            if (it==logMessage.logVars.constEnd())
+            {
+                return false;
+            }
+            output.append(it.value());
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}
+
+void LogFormat::appendMessage(const LogMessage& logMessage, QString& output) const
+{
+    const QString& message=logMessage.message;
+    int pos=0;
+    while (pos<message.size())
+    {
+        int start=message.indexOf('{',pos);
+        int end=(start<0) ? -1 : message.indexOf('}',start+1);
+        if (end<0)
+        {
+            break;
+        }
+        start=message.lastIndexOf('{',end);
+        output.append(message.midRef(pos,start-pos));
+        QStringRef name=message.midRef(start+1,end-start-1);
+        Kind kind=kindOf(name);
+        if (kind==Message || !appendValue(kind,name.toString(),logMessage,output))
+        {
+            output.append(message.midRef(start,end+1-start));
+        }
+        pos=end+1;
+    }
+    output.append(message.midRef(pos));
+}
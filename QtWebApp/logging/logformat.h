@@ -0,0 +1,127 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+#include "logglobal.h"
+#include "logmessage.h"
+
+namespace stefanfrings {
+
+/**
+  Decorates log messages with a precompiled msgFormat.
+  <p>
+  The format string is split once into static text and variables, so decorating
+  a message is a single pass that appends to a buffer. Variables in the message
+  text itself are also replaced, with the exception of {msg}.
+  <p>
+  Timestamps are converted to local time only once per second. The formatted
+  text before and after the milliseconds is cached, so most messages only need
+  to append the milliseconds. If the timestampFormat contains more than one
+  milliseconds token, each timestamp is formatted by QDateTime.
+  <p>
+  Instances are not thread safe. The Logger uses one instance per logger,
+  protected by its mutex.
+  @see LogMessage for a description of the variables.
+*/
+
+class DECLSPEC LogFormat {
+public:
+
+    /**
+      Constructor.
+      @param msgFormat Format of the decoration, e.g. "{timestamp} {type} thread={thread}: {msg}"
+      @param timestampFormat Format of timestamp, e.g. "dd.MM.yyyy hh:mm:ss.zzz"
+    */
+    LogFormat(const QString& msgFormat="{timestamp} {type} {msg}",
+              const QString& timestampFormat="dd.MM.yyyy hh:mm:ss.zzz");
+
+    /**
+      Parse new format strings. Does nothing if they did not change.
+      @param msgFormat Format of the decoration
+      @param timestampFormat Format of timestamp, see QDateTime::toString().
+    */
+    void setFormat(const QString& msgFormat, const QString& timestampFormat);
+
+    /** Get the format of the decoration */
+    const QString& getMsgFormat() const;
+
+    /** Get the format of timestamps */
+    const QString& getTimestampFormat() const;
+
+    /**
+      Decorate a log message, terminated by a line break.
+      @param logMessage The message
+      @param output Receives the decorated message. Its old content is discarded
+             but the allocated memory is reused.
+    */
+    void format(const LogMessage& logMessage, QString& output) const;
+
+private:
+
+    /** Kinds of format segments */
+    enum Kind {Text, Message, Timestamp, TypeNr, Type, File, Function, Line, Thread, Variable};
+
+    /** Part of the parsed msgFormat */
+    struct Segment {
+        /** Kind of the segment */
+        Kind kind;
+        /** Static text, or the name of a logger variable */
+        QString text;
+    };
+
+    /** Format of the decoration */
+    QString msgFormat;
+
+    /** Format of timestamps */
+    QString timestampFormat;
+
+    /** Parsed msgFormat */
+    QVector<Segment> segments;
+
+    /** Part of timestampFormat before the milliseconds */
+    QString timestampPrefixFormat;
+
+    /** Part of timestampFormat after the milliseconds */
+    QString timestampSuffixFormat;
+
+    /** Digits of the milliseconds: 0=none, 1=without leading zeros (z), 3=with leading zeros (zzz), -1=not cacheable */
+    int millisDigits;
+
+    /** Second since the epoch of the cached timestamp parts */
+    mutable qint64 cachedSecond;
+
+    /** Formatted timestampPrefixFormat of cachedSecond */
+    mutable QString cachedPrefix;
+
+    /** Formatted timestampSuffixFormat of cachedSecond */
+    mutable QString cachedSuffix;
+
+    /** Split the timestampFormat at the milliseconds */
+    void parseTimestampFormat();
+
+    /** Append a timestamp, using the cached parts if possible */
+    void appendTimestamp(const qint64 timestamp, QString& output) const;
+
+    /** Get the kind of a variable name */
+    static Kind kindOf(const QStringRef& name);
+
+    /**
+      Append the value of a variable.
+      @return false if it is an unknown logger variable
+    */
+    bool appendValue(const Kind kind, const QString& name, const LogMessage& logMessage, QString& output) const;
+
+    /** Append the message text with replaced variables */
+    void appendMessage(const LogMessage& logMessage, QString& output) const;
+};
+
+} // end of namespace
+
+#endif // LOGFORMAT_H
@@ -4,22 +4,38 @@
 */
 
 #include "logger.h"
+#include "threadname.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <QMutex>
 #include <QDateTime>
 #include <QThread>
 #include <QObject>
+#include <chrono>
 
 using namespace stefanfrings;
 
+namespace {
+
+/** Whether the current thread is the background thread of a logger */
+thread_local bool insideWriter=false;
+
+/** Maximum number of queued messages that are written with a single lock */
+const int WRITER_BATCH=256;
+
+}
+
 Logger* Logger::defaultLogger=nullptr;
 
 
+#if QT_VERSION >= 0x050000
+    std::atomic<QLoggingCategory::CategoryFilter> Logger::previousFilter{nullptr};
+#endif
+
+
 QThreadStorage<QHash<QString,QString>*> Logger::logVars;
 
 
-QMutex Logger::mutex;
+InstrumentedMutex Logger::mutex("logger");
 
 
 Logger::Logger(QObject* parent)
@@ -43,19 +59,18 @@ Logger::Logger(const QString msgFormat, const QString timestampFormat, const QtM
 
 void Logger::msgHandler(const QtMsgType type, const QString &message, const QString &file, const QString &function, const int line)
 {
-    static QMutex recursiveMutex(QMutex::Recursive);
-    static QMutex nonRecursiveMutex(QMutex::NonRecursive);
-
-    // Prevent multiple threads from calling this method simultaneoulsy.
-    // But allow recursive calls, which is required to prevent a deadlock
-    // if the logger itself produces an error message.
-    recursiveMutex.lock();
+    // Detect recursive calls, which happen if the logger itself produces
+    // an error message. Concurrent threads do not need to be serialized
+    // here because log() is thread safe.
+    static thread_local bool active=false;
 
     // Fall back to stderr when this method has been called recursively.
-    if (defaultLogger && nonRecursiveMutex.tryLock())
+    Logger* logger=defaultLogger;
+    if (logger && !active)
     {
-        defaultLogger->log(type, message, file, function, line);
-        nonRecursiveMutex.unlock();
+        active=true;
+        logger->log(type, message, file, function, line);
+        active=false;
     }
     else
     {
@@ -66,19 +81,58 @@ void Logger::msgHandler(const QtMsgType type, const QString &message, const QStr
     // Abort the program after logging a fatal message
     if (type==QtFatalMsg)
     {
+        if (logger)
+        {
+            logger->flushQueue();
+        }
         abort();
     }
-
-    recursiveMutex.unlock();
 }
 
 
 #if QT_VERSION >= 0x050000
     void Logger::msgHandler5(const QtMsgType type, const QMessageLogContext &context, const QString &message)
     {
-      (void)(context); // suppress "unused parameter" warning
+      // Discard the message if the logger would not write it, or if its category logs too much.
+      // Check the level first, so discarded messages do not take tokens from the rate limit.
+      Logger* logger=defaultLogger;
+      if (logger && type!=QtFatalMsg &&
+          (!logger->isEnabled(type) || !logger->allowMessage(type,context.category ? context.category : "default")))
+      {
+          return;
+      }
       msgHandler(type,message,context.file,context.function,context.line);
     }
+
+
+    void Logger::categoryFilter(QLoggingCategory* category)
+    {
+        // Another filter that has been installed later may call this one as its previous filter
+        static thread_local bool active=false;
+        if (active)
+        {
+            return;
+        }
+        active=true;
+        QLoggingCategory::CategoryFilter previous=previousFilter.load();
+        if (previous)
+        {
+            previous(category);
+        }
+        // Only disable types, so the rules of the previous filter stay in effect
+        Logger* logger=defaultLogger;
+        if (logger)
+        {
+            for (QtMsgType type : {QtDebugMsg,QtInfoMsg,QtWarningMsg,QtCriticalMsg})
+            {
+                if (!logger->isEnabled(type))
+                {
+                    category->setEnabled(type,false);
+                }
+            }
+        }
+        active=false;
+    }
 #else
     void Logger::msgHandler4(const QtMsgType type, const char* message)
     {
@@ -89,10 +143,13 @@ void Logger::msgHandler(const QtMsgType type, const QString &message, const QStr
 
 Logger::~Logger()
 {
+    setAsync(false);
+    qDeleteAll(rateBuckets);
     if (defaultLogger==this)
     {
 #if QT_VERSION >= 0x050000
         qInstallMessageHandler(nullptr);
+        QLoggingCategory::installFilter(previousFilter.exchange(nullptr));
 #else
         qInstallMsgHandler(nullptr);
 #endif
@@ -101,9 +158,17 @@ Logger::~Logger()
 }
 
 
+const QString& Logger::decorate(const LogMessage* logMessage)
+{
+    format.setFormat(msgFormat,timestampFormat);
+    format.format(*logMessage,decorated);
+    return decorated;
+}
+
+
 void Logger::write(const LogMessage* logMessage)
 {
-    fputs(qPrintable(logMessage->toString(msgFormat,timestampFormat)),stderr);
+    fputs(qPrintable(decorate(logMessage)),stderr);
     fflush(stderr);
 }
 
@@ -115,74 +180,128 @@ void Logger::installMsgHandler()
     qInstallMessageHandler(msgHandler5);
 #else
     qInstallMsgHandler(msgHandler4);
+#endif
+    updateCategoryFilter();
+}
+
+
+bool Logger::isEnabled(const QtMsgType type) const
+{
+    // With the backtrace buffer, messages of all types are buffered
+    return bufferSize.load(std::memory_order_relaxed)>0 || type>=minLevel.load(std::memory_order_relaxed);
+}
+
+
+void Logger::updateCategoryFilter()
+{
+#if QT_VERSION >= 0x050000
+    if (!defaultLogger)
+    {
+        return;
+    }
+    // Installing the filter applies it to all existing categories
+    QLoggingCategory::CategoryFilter current=QLoggingCategory::installFilter(categoryFilter);
+    if (current!=categoryFilter)
+    {
+        previousFilter.store(current);
+        QLoggingCategory::installFilter(categoryFilter);
+    }
 #endif
 }
 
 
 void Logger::set(const QString& name, const QString& value)
 {
-    mutex.lock();
+    // No lock needed because the variables are thread-local
     if (!logVars.hasLocalData())
     {
         logVars.setLocalData(new QHash<QString,QString>);
     }
     logVars.localData()->insert(name,value);
-    mutex.unlock();
 }
 
 
 void Logger::clear(const bool buffer, const bool variables)
 {
-    mutex.lock();
+    // No lock needed because the buffers and variables are thread-local
     if (buffer && buffers.hasLocalData())
     {
-        QList<LogMessage*>* buffer=buffers.localData();
-        while (buffer && !buffer->isEmpty())
-        {
-            LogMessage* logMessage=buffer->takeLast();
-            delete logMessage;
-        }
+        BacktraceBuffer* backtrace=buffers.localData();
+        backtrace->first=0;
+        backtrace->count=0;
     }
     if (variables && logVars.hasLocalData())
     {
         logVars.localData()->clear();
     }
-    mutex.unlock();
+}
+
+
+void Logger::clearThread()
+{
+    Logger* logger=defaultLogger;
+    if (logger)
+    {
+        logger->clear(true,true);
+    }
+    else if (logVars.hasLocalData())
+    {
+        logVars.localData()->clear();
+    }
 }
 
 
 void Logger::log(const QtMsgType type, const QString& message, const QString &file, const QString &function, const int line)
 {
-    mutex.lock();
+    // The settings may be reloaded concurrently, so use the same values for the whole message
+    const QtMsgType minLevel=this->minLevel.load(std::memory_order_relaxed);
+    const int bufferSize=this->bufferSize.load(std::memory_order_relaxed);
 
     // If the buffer is enabled, write the message into it
     if (bufferSize>0)
     {
-        // Create new thread local buffer, if necessary
-        if (!buffers.hasLocalData())
+        // Create new thread local buffer, if necessary.
+        // The buffer is only used by the current thread, so it needs no lock.
+        BacktraceBuffer* buffer=buffers.localData();
+        if (!buffer || static_cast<int>(buffer->records.size())!=bufferSize)
         {
-            buffers.setLocalData(new QList<LogMessage*>());
+            buffer=new BacktraceBuffer();
+            buffer->records.resize(bufferSize);
+            buffers.setLocalData(buffer);
         }
-        QList<LogMessage*>* buffer=buffers.localData();
-        // Append the decorated log message to the buffer
-        LogMessage* logMessage=new LogMessage(type,message,logVars.localData(),file,function,line);
-        buffer->append(logMessage);
-        // Delete oldest message if the buffer became too large
-        if (buffer->size()>bufferSize)
+        // Overwrite the oldest message if the buffer is full
+        int size=static_cast<int>(buffer->records.size());
+        int index=(buffer->first+buffer->count)%size;
+        if (buffer->count<size)
         {
-            delete buffer->takeFirst();
+            ++buffer->count;
         }
+        else
+        {
+            buffer->first=(buffer->first+1)%size;
+        }
+        buffer->records[index].assign(type,message,logVars.localData(),file,function,line);
         // If the type of the message is high enough, print the whole buffer
         // With one Exception: INFO messages are treated like DEBUG messages here
         QtMsgType level=(type==QtInfoMsg?QtDebugMsg:type);
         if (level>=minLevel)
         {
-            // Print the whole buffer content
-            while (!buffer->isEmpty())
+            // Print the whole buffer content. In asynchronous mode,
+            // only the background thread needs the lock.
+            const bool queued=async.load(std::memory_order_acquire);
+            if (!queued)
             {
-                LogMessage* logMessage=buffer->takeFirst();
-                write(logMessage);
-                delete logMessage;
+                mutex.lock();
+            }
+            while (buffer->count>0)
+            {
+                output(&buffer->records[buffer->first],queued);
+                buffer->first=(buffer->first+1)%size;
+                --buffer->count;
+            }
+            if (!queued)
+            {
+                mutex.unlock();
             }
         }
     }
@@ -193,8 +312,299 @@ void Logger::log(const QtMsgType type, const QString& message, const QString &fi
         if (type>=minLevel)
         {
             LogMessage logMessage(type,message,logVars.localData(),file,function,line);
+            const bool queued=async.load(std::memory_order_acquire);
+            if (!queued)
+            {
+                mutex.lock();
+            }
+            output(&logMessage,queued);
+            if (!queued)
+            {
+                mutex.unlock();
+            }
+        }
+    }
+}
+
+
+void Logger::output(LogMessage* logMessage, const bool queued)
+{
+    if (queued)
+    {
+        enqueue(*logMessage);
+    }
+    else
+    {
+        write(logMessage);
+    }
+}
+
+
+void Logger::enqueue(LogMessage& logMessage)
+{
+    bool pushed=queue->push(logMessage);
+
+    // The background thread must not wait for itself
+    if (!pushed && overflowPolicy.load(std::memory_order_relaxed)==BlockBriefly && !insideWriter)
+    {
+        wakeWriter();
+        auto deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(blockTimeout.load(std::memory_order_relaxed));
+        do
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            pushed=queue->push(logMessage);
+        }
+        while (!pushed && std::chrono::steady_clock::now()<deadline);
+    }
+
+    if (!pushed)
+    {
+        droppedMessages.fetch_add(1,std::memory_order_relaxed);
+    }
+    else if (writerSleeping.load())
+    {
+        wakeWriter();
+    }
+}
+
+
+void Logger::wakeWriter()
+{
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeCondition.notify_one();
+}
+
+
+void Logger::writerLoop()
+{
+    setThreadName("qwa-logger");
+    insideWriter=true;
+    LogMessage logMessage;
+    forever
+    {
+        if (queue->pop(logMessage))
+        {
+            // Write a batch of messages with a single lock
+            mutex.lock();
+            int count=0;
+            do
+            {
+                write(&logMessage);
+            }
+            while (++count<WRITER_BATCH && queue->pop(logMessage));
+
+            // Report discarded messages
+            quint64 dropped=droppedMessages.load(std::memory_order_relaxed);
+            if (dropped!=reportedDrops)
+            {
+                LogMessage warning(QtWarningMsg,QString("Log queue overflow, discarded %1 messages").arg(dropped-reportedDrops),
+                                   nullptr,"","",0);
+                write(&warning);
+                reportedDrops=dropped;
+            }
+            mutex.unlock();
+        }
+        else if (stopWriter.load())
+        {
+            break;
+        }
+        else
+        {
+            // Wait for new messages. The timeout covers a wake-up call that
+            // happens between checking the queue and going to sleep.
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            writerSleeping.store(true);
+            wakeCondition.wait_for(lock,std::chrono::milliseconds(10),[this] {
+                return stopWriter.load() || !queue->isEmpty();
+            });
+            writerSleeping.store(false);
+        }
+    }
+    insideWriter=false;
+}
+
+
+void Logger::setAsync(const bool enable, const int queueSize, const OverflowPolicy overflowPolicy, const int blockTimeout)
+{
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    this->overflowPolicy.store(overflowPolicy);
+    this->blockTimeout.store(blockTimeout);
+    if (enable && !writerThread.joinable())
+    {
+        if (!queue)
+        {
+            queue.reset(new LogQueue(queueSize));
+        }
+        stopWriter.store(false);
+        writerThread=std::thread(&Logger::writerLoop,this);
+        async.store(true,std::memory_order_release);
+    }
+    else if (!enable && writerThread.joinable())
+    {
+        async.store(false,std::memory_order_release);
+        stopWriter.store(true);
+        wakeWriter();
+        writerThread.join();
+
+        // Write the messages that have been queued while the thread terminated
+        LogMessage logMessage;
+        mutex.lock();
+        while (queue->pop(logMessage))
+        {
             write(&logMessage);
         }
+        mutex.unlock();
+    }
+}
+
+
+bool Logger::isAsync() const
+{
+    return async.load();
+}
+
+
+quint64 Logger::getDroppedMessages() const
+{
+    return droppedMessages.load();
+}
+
+
+void Logger::flushQueue(const int timeout)
+{
+    if (!async.load() || insideWriter)
+    {
+        return;
+    }
+    wakeWriter();
+    auto deadline=std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout);
+    while (!queue->isEmpty() && std::chrono::steady_clock::now()<deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    // Wait until the last batch has been written
+    mutex.lock();
     mutex.unlock();
 }
+
+
+void Logger::setRateLimit(const int messagesPerSecond, const int burst)
+{
+    qint64 interval=messagesPerSecond>0 ? 1000000000LL/messagesPerSecond : 0;
+    rateTolerance.store(interval*qMax(burst,1));
+    rateInterval.store(interval);
+}
+
+
+quint64 Logger::getRateLimitedMessages() const
+{
+    return rateLimitedMessages.load();
+}
+
+
+bool Logger::allowMessage(const QtMsgType type, const char* category)
+{
+    const qint64 interval=rateInterval.load(std::memory_order_relaxed);
+    if (interval==0 || type==QtCriticalMsg || type==QtFatalMsg)
+    {
+        return true;
+    }
+
+    RateBucket* bucket=rateBucket(category);
+
+    // Generic cell rate algorithm: each message moves the theoretical arrival
+    // time forward by one interval. It may run ahead of the clock by the burst.
+    const qint64 now=std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    const qint64 tolerance=rateTolerance.load(std::memory_order_relaxed);
+    qint64 arrival=bucket->arrival.load(std::memory_order_relaxed);
+    forever
+    {
+        qint64 next=qMax(arrival,now)+interval;
+        if (next-now>tolerance)
+        {
+            rateLimitedMessages.fetch_add(1,std::memory_order_relaxed);
+            return false;
+        }
+        if (bucket->arrival.compare_exchange_weak(arrival,next,std::memory_order_relaxed))
+        {
+            if (rateLimitedMessages.load(std::memory_order_relaxed)!=reportedRateLimited.load(std::memory_order_relaxed))
+            {
+                reportRateLimited();
+            }
+            return true;
+        }
+    }
+}
+
+
+Logger::RateBucket* Logger::rateBucket(const char* category)
+{
+    // Look up the address of the name in the cache, without lock
+    const quintptr hash=reinterpret_cast<quintptr>(category);
+    const int start=static_cast<int>((hash>>4)^(hash>>12))&(RATE_CACHE_SIZE-1);
+    int free=-1;
+    for (int i=0; i<RATE_CACHE_SIZE; i++)
+    {
+        RateCacheSlot& slot=rateCache[(start+i)&(RATE_CACHE_SIZE-1)];
+        const char* key=slot.category.load(std::memory_order_acquire);
+        if (key==category)
+        {
+            RateBucket* bucket=slot.bucket.load(std::memory_order_acquire);
+            if (bucket)
+            {
+                return bucket;
+            }
+            // Another thread is filling this slot
+            break;
+        }
+        if (!key)
+        {
+            free=(start+i)&(RATE_CACHE_SIZE-1);
+            break;
+        }
+    }
+
+    // First use of this address: find the bucket by the name, and remember it in the cache.
+    // Different categories may have the same name at different addresses.
+    QMutexLocker locker(&rateMutex);
+    const QByteArray name(category);
+    RateBucket* bucket=rateBuckets.value(name);
+    if (!bucket)
+    {
+        bucket=new RateBucket();
+        rateBuckets.insert(name,bucket);
+    }
+    if (free>=0)
+    {
+        const char* expected=nullptr;
+        if (rateCache[free].category.compare_exchange_strong(expected,category,std::memory_order_acq_rel))
+        {
+            rateCache[free].bucket.store(bucket,std::memory_order_release);
+        }
+    }
+    return bucket;
+}
+
+
+void Logger::reportRateLimited()
+{
+    quint64 reported=reportedRateLimited.load(std::memory_order_relaxed);
+    const quint64 limited=rateLimitedMessages.load(std::memory_order_relaxed);
+    // Only one thread reports each number
+    if (limited==reported || !reportedRateLimited.compare_exchange_strong(reported,limited))
+    {
+        return;
+    }
+    LogMessage warning(QtWarningMsg,QString("Rate limit discarded %1 messages").arg(limited-reported),nullptr,"","",0);
+    const bool queued=async.load(std::memory_order_acquire);
+    if (!queued)
+    {
+        mutex.lock();
+    }
+    output(&warning,queued);
+    if (!queued)
+    {
+        mutex.unlock();
+    }
+}
@@ -10,10 +10,23 @@
 #include <QThreadStorage>
 #include <QHash>
 #include <QStringList>
-#include <QMutex>
 #include <QObject>
+#include <QMutex>
+#include <QByteArray>
+#if QT_VERSION >= 0x050000
+    #include <QLoggingCategory>
+#endif
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "logglobal.h"
 #include "logmessage.h"
+#include "logformat.h"
+#include "logqueue.h"
+#include "instrumentedmutex.h"
 
 namespace stefanfrings {
 
@@ -28,7 +41,8 @@ namespace stefanfrings {
   taken from a static thread local dictionary.
   <p>
   The logger can collect a configurable number of messages in thread-local
-  ring buffers. If the buffer is enabled, then a log message with
+  ring buffers. The buffers are preallocated and need no lock, so buffering
+  debug messages is cheap. If the buffer is enabled, then a log message with
   severity >= minLevel flushes the buffer, so the stored messages are
   written out. There is one exception: INFO messages are treated like DEBUG messages
   (level 0).
@@ -43,6 +57,12 @@ namespace stefanfrings {
   <p>
   The logger can be registered to handle messages from
   the static global functions qDebug(), qWarning(), qCritical(), qFatal() and qInfo().
+  Then it also disables the message types that it would discard in all logging
+  categories, so qCDebug() does not even evaluate its arguments.
+  <p>
+  In asynchronous mode (see setAsync()), the calling threads only move the
+  messages into a lock-free queue. A background thread decorates them and
+  calls write(), so slow output media do not block the application.
 
   @see set() describes how to set logger variables
   @see LogMessage for a description of the message decoration.
@@ -55,6 +75,14 @@ class DECLSPEC Logger : public QObject {
     Q_DISABLE_COPY(Logger)
 public:
 
+    /** Behavior in asynchronous mode when the queue is full */
+    enum OverflowPolicy {
+        /** Discard the new message */
+        DropMessage,
+        /** Wait up to blockTimeout for free space, then discard the message */
+        BlockBriefly
+    };
+
     /**
       Constructor.
       Uses the same defaults as the other constructor.
@@ -98,12 +126,22 @@ public:
     /**
       Installs this logger as the default message handler, so it
       can be used through the global static logging functions (e.g. qDebug()).
+      Also installs a filter that disables the message types that the logger
+      would discard in all logging categories, see isEnabled().
     */
     void installMsgHandler();
 
     /**
-      Sets a thread-local variable that may be used to decorate log messages.
+      Whether log() writes or buffers messages of the given type.
       This method is thread safe.
+      @param type Message type (level)
+      @return false if messages of this type are discarded
+    */
+    virtual bool isEnabled(const QtMsgType type) const;
+
+    /**
+      Sets a thread-local variable that may be used to decorate log messages.
+      This method is thread safe and does not lock.
       @param name Name of the variable
       @param value Value of the variable
     */
@@ -117,6 +155,71 @@ public:
     */
     virtual void clear(const bool buffer=true, const bool variables=true);
 
+    /**
+      Clear the log variables and the backtrace buffer of the default logger in
+      the current thread, e.g. before a thread of a pool serves the next request.
+      This method is thread safe.
+    */
+    static void clearThread();
+
+    /**
+      Enables or disables the asynchronous mode. When disabling, the background
+      thread writes out all queued messages before it terminates.
+      Do not call this method while holding the mutex.
+      @param enable Whether messages shall be written by a background thread
+      @param queueSize Number of messages that the queue can hold. Used only when
+             the asynchronous mode is enabled for the first time.
+      @param overflowPolicy What to do with new messages while the queue is full
+      @param blockTimeout Maximum time in msec to wait for free space, if overflowPolicy=BlockBriefly
+    */
+    void setAsync(const bool enable, const int queueSize=8192,
+                  const OverflowPolicy overflowPolicy=DropMessage, const int blockTimeout=10);
+
+    /** Returns true if the asynchronous mode is enabled */
+    bool isAsync() const;
+
+    /**
+      Total number of messages that have been discarded because the queue was full.
+      This method is thread safe.
+    */
+    quint64 getDroppedMessages() const;
+
+    /**
+      Waits until the background thread has written all queued messages.
+      Does nothing in synchronous mode.
+      @param timeout Maximum time to wait in msec
+    */
+    virtual void flushQueue(const int timeout=1000);
+
+    /**
+      Limits the number of DEBUG, INFO and WARNING messages per logging category
+      with a token bucket. CRITICAL and FATAL messages are never discarded.
+      Messages that the logger discards anyway because of their level do not take tokens.
+      The number of discarded messages is reported with a warning before the next message
+      that passes the limit.
+      The limit applies to messages from the global logging functions, e.g. qDebug()
+      and qCDebug(), after the logger has been installed with installMsgHandler().
+      This method is thread safe.
+      @param messagesPerSecond Sustained number of messages per second and category, 0=unlimited
+      @param burst Number of messages that may be logged at once after a quiet period
+    */
+    void setRateLimit(const int messagesPerSecond, const int burst);
+
+    /**
+      Total number of messages that have been discarded by the rate limit.
+      This method is thread safe.
+    */
+    quint64 getRateLimitedMessages() const;
+
+    /**
+      Check the rate limit of a category and take one token from its bucket.
+      This method is thread safe.
+      @param type Message type (level)
+      @param category Name of the logging category, e.g. "qtwebapp.http.request"
+      @return false if the message shall be discarded
+    */
+    virtual bool allowMessage(const QtMsgType type, const char* category);
+
 protected:
 
     /** Format string for message decoration */
@@ -125,18 +228,42 @@ protected:
     /** Format string of timestamps */
     QString timestampFormat;
 
-    /** Minimum level of message types that are written out directly or trigger writing the buffered content. */
-    QtMsgType minLevel;
+    /**
+      Minimum level of message types that are written out directly or trigger writing the buffered content.
+      Atomic because log() reads it without the mutex, while derived classes may reload it.
+    */
+    std::atomic<QtMsgType> minLevel;
+
+    /** Size of backtrace buffer, number of messages per thread. 0=disabled. Atomic like minLevel */
+    std::atomic<int> bufferSize;
+
+    /**
+      Used to synchronize access of concurrent threads.
+      It provides lock(), unlock() and tryLock() like the QMutex of older versions,
+      but derived classes must use std::lock_guard instead of QMutexLocker.
+    */
+    static InstrumentedMutex mutex;
 
-    /** Size of backtrace buffer, number of messages per thread. 0=disabled */
-    int bufferSize;
+    /**
+      Apply the filter of the logging categories again, after minLevel or bufferSize has changed.
+      Does nothing unless a logger has been installed with installMsgHandler().
+    */
+    static void updateCategoryFilter();
 
-    /** Used to synchronize access of concurrent threads */
-    static QMutex mutex;
+    /**
+      Decorate a log message with msgFormat and timestampFormat.
+      Must be called while the mutex is locked.
+      @return Buffer that gets overwritten by the next call
+    */
+    const QString& decorate(const LogMessage* logMessage);
 
     /**
       Decorate and write a log message to stderr. Override this method
       to provide a different output medium.
+      <p>
+      This method is called while the mutex is locked. In asynchronous mode,
+      it is called by the background thread. Derived classes that override it
+      must therefore call setAsync(false) in their destructor.
     */
     virtual void write(const LogMessage* logMessage);
 
@@ -173,6 +300,16 @@ private:
     */
     static void msgHandler5(const QtMsgType type, const QMessageLogContext& context, const QString &message);
 
+    /**
+      Filter of the logging categories. Disables the message types that the
+      default logger discards, after the previous filter applied its rules.
+      @param category The logging category
+    */
+    static void categoryFilter(QLoggingCategory* category);
+
+    /** Filter that was installed before categoryFilter() */
+    static std::atomic<QLoggingCategory::CategoryFilter> previousFilter;
+
 #else
 
     /**
@@ -188,8 +325,117 @@ private:
     /** Thread local variables to be used in log messages */
     static QThreadStorage<QHash<QString,QString>*> logVars;
 
+    /** Parsed msgFormat, used by decorate() */
+    LogFormat format;
+
+    /** Reusable output buffer of decorate() */
+    QString decorated;
+
+    /** Ring of preallocated messages */
+    struct BacktraceBuffer {
+        /** The messages, size is bufferSize */
+        std::vector<LogMessage> records;
+        /** Index of the oldest message */
+        int first=0;
+        /** Number of buffered messages */
+        int count=0;
+    };
+
     /** Thread local backtrace buffers */
-    QThreadStorage<QList<LogMessage*>*> buffers;
+    QThreadStorage<BacktraceBuffer*> buffers;
+
+    /** Queue of the asynchronous mode, created on first use */
+    std::unique_ptr<LogQueue> queue;
+
+    /** Background thread that writes the queued messages */
+    std::thread writerThread;
+
+    /** Serializes calls to setAsync() */
+    std::mutex asyncMutex;
+
+    /** Used to wake up the background thread */
+    std::mutex wakeMutex;
+
+    /** Used to wake up the background thread */
+    std::condition_variable wakeCondition;
+
+    /** Whether messages are passed to the background thread */
+    std::atomic<bool> async{false};
+
+    /** Tells the background thread to terminate */
+    std::atomic<bool> stopWriter{false};
+
+    /** Whether the background thread waits for new messages */
+    std::atomic<bool> writerSleeping{false};
+
+    /** What to do with new messages while the queue is full */
+    std::atomic<int> overflowPolicy{DropMessage};
+
+    /** Maximum time in msec to wait for free space in the queue */
+    std::atomic<int> blockTimeout{10};
+
+    /** Number of discarded messages */
+    std::atomic<quint64> droppedMessages{0};
+
+    /** Number of discarded messages that have already been reported in the log */
+    quint64 reportedDrops=0;
+
+    /** State of the rate limit of one category */
+    struct RateBucket {
+        /** Theoretical arrival time of the next message in nsec, see GCRA */
+        std::atomic<qint64> arrival{0};
+    };
+
+    /** Rate limits by category name, owns the buckets */
+    QHash<QByteArray,RateBucket*> rateBuckets;
+
+    /** Protects rateBuckets, only needed at the first use of a category name */
+    QMutex rateMutex;
+
+    /** Number of slots of the bucket cache, a power of 2 */
+    static const int RATE_CACHE_SIZE=256;
+
+    /**
+      Slot of the bucket cache. The names of the logging categories are static
+      strings, so their address identifies them without comparing the text.
+    */
+    struct RateCacheSlot {
+        std::atomic<const char*> category{nullptr};
+        std::atomic<RateBucket*> bucket{nullptr};
+    };
+
+    /** Open addressing hash table from the address of the category name to its bucket, without lock */
+    RateCacheSlot rateCache[RATE_CACHE_SIZE];
+
+    /** Find the bucket of a category, create it on first use */
+    RateBucket* rateBucket(const char* category);
+
+    /** Minimum distance between messages of a category in nsec, or 0=unlimited */
+    std::atomic<qint64> rateInterval{0};
+
+    /** Maximum advance of a bucket in nsec, burst*rateInterval */
+    std::atomic<qint64> rateTolerance{0};
+
+    /** Number of messages discarded by the rate limit */
+    std::atomic<quint64> rateLimitedMessages{0};
+
+    /** Number of messages discarded by the rate limit that have already been reported in the log */
+    std::atomic<quint64> reportedRateLimited{0};
+
+    /** Write a warning about the messages that the rate limit has discarded since the last report */
+    void reportRateLimited();
+
+    /** Pass the message to write() or to the queue */
+    void output(LogMessage* logMessage, const bool queued);
+
+    /** Move the message into the queue, applying the overflow policy */
+    void enqueue(LogMessage& logMessage);
+
+    /** Wake up the background thread */
+    void wakeWriter();
+
+    /** Main loop of the background thread */
+    void writerLoop();
 
 };
 
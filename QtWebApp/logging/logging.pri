@@ -1,6 +1,11 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
-HEADERS += $$PWD/logglobal.h $$PWD/logmessage.h $$PWD/logger.h $$PWD/filelogger.h $$PWD/dualfilelogger.h
+# Tells the other modules that the logger is available
+DEFINES += QTWEBAPP_LOGGING
 
-SOURCES += $$PWD/logmessage.cpp $$PWD/logger.cpp $$PWD/filelogger.cpp $$PWD/dualfilelogger.cpp
+include(../diagnostics/diagnostics.pri)
+
+HEADERS += $$PWD/logglobal.h $$PWD/logmessage.h $$PWD/logformat.h $$PWD/logbinary.h $$PWD/logqueue.h $$PWD/logger.h $$PWD/filelogger.h $$PWD/dualfilelogger.h $$PWD/logsink.h $$PWD/filesink.h $$PWD/consolesink.h $$PWD/syslogsink.h $$PWD/sinklogger.h
+
+SOURCES += $$PWD/logmessage.cpp $$PWD/logformat.cpp $$PWD/logbinary.cpp $$PWD/logqueue.cpp $$PWD/logger.cpp $$PWD/filelogger.cpp $$PWD/dualfilelogger.cpp $$PWD/logsink.cpp $$PWD/filesink.cpp $$PWD/consolesink.cpp $$PWD/syslogsink.cpp $$PWD/sinklogger.cpp
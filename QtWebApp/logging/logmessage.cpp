@@ -4,18 +4,33 @@
 */
 
 #include "logmessage.h"
+#include "logformat.h"
 #include <QThread>
+#include <QDateTime>
 
 using namespace stefanfrings;
 
+LogMessage::LogMessage()
+{
+    type=QtDebugMsg;
+    timestamp=0;
+    threadId=nullptr;
+    line=0;
+}
+
 LogMessage::LogMessage(const QtMsgType type, const QString& message, const QHash<QString, QString> *logVars, const QString &file, const QString &function, const int line)
+{
+    assign(type,message,logVars,file,function,line);
+}
+
+void LogMessage::assign(const QtMsgType type, const QString& message, const QHash<QString, QString> *logVars, const QString &file, const QString &function, const int line)
 {
     this->type=type;
     this->message=message;
     this->file=file;
     this->function=function;
     this->line=line;
-    timestamp=QDateTime::currentDateTime();
+    timestamp=QDateTime::currentMSecsSinceEpoch();
     threadId=QThread::currentThreadId();
 
     // Copy the logVars if not null,
@@ -24,62 +39,28 @@ LogMessage::LogMessage(const QtMsgType type, const QString& message, const QHash
     {
         this->logVars=*logVars;
     }
-}
-
-QString LogMessage::toString(const QString& msgFormat, const QString& timestampFormat) const
-{
-    QString decorated=msgFormat+"\n";
-    decorated.replace("{msg}",message);
-
-    if (decorated.contains("{timestamp}"))
+    else
     {
-        decorated.replace("{timestamp}",timestamp.toString(timestampFormat));
+        this->logVars.clear();
     }
+}
 
-    QString typeNr;
-    typeNr.setNum(type);
-    decorated.replace("{typeNr}",typeNr);
-
-    switch (type)
-    {
-        case QtDebugMsg:
-            decorated.replace("{type}","DEBUG   ");
-            break;
-        case QtWarningMsg:
-            decorated.replace("{type}","WARNING ");
-            break;
-        case QtCriticalMsg:
-            decorated.replace("{type}","CRITICAL");
-            break;
-        case QtFatalMsg:
-            decorated.replace("{type}","FATAL   ");
-            break;
-    #if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
-        case QtInfoMsg:
-            decorated.replace("{type}","INFO    ");
-            break;
-    #endif
-    }
-
-    decorated.replace("{file}",file);
-    decorated.replace("{function}",function);
-    decorated.replace("{line}",QString::number(line));
-
-    QString threadId;
-    threadId.sprintf("%p", QThread::currentThreadId());
-    //threadId.setNum((uintptr_t)QThread::currentThreadId());
-    decorated.replace("{thread}",threadId);
-
-    // Fill in variables
-    if (decorated.contains("{") && !logVars.isEmpty())
-    {
-        QList<QString> keys=logVars.keys();
-        foreach (QString key, keys)
-        {
-            decorated.replace("{"+key+"}",logVars.value(key));
-        }
-    }
+void LogMessage::copyFrom(const LogMessage& other)
+{
+    logVars=other.logVars;
+    timestamp=other.timestamp;
+    type=other.type;
+    threadId=other.threadId;
+    message=other.message;
+    file=other.file;
+    function=other.function;
+    line=other.line;
+}
 
+QString LogMessage::toString(const QString& msgFormat, const QString& timestampFormat) const
+{
+    QString decorated;
+    LogFormat(msgFormat,timestampFormat).format(*this,decorated);
     return decorated;
 }
 
@@ -87,3 +68,8 @@ QtMsgType LogMessage::getType() const
 {
     return type;
 }
+
+qint64 LogMessage::getTimestamp() const
+{
+    return timestamp;
+}
@@ -36,8 +36,22 @@ namespace stefanfrings {
 class DECLSPEC LogMessage
 {
     Q_DISABLE_COPY(LogMessage)
+    friend class LogFormat;
+    friend class LogEncoder;
+    friend class LogDecoder;
 public:
 
+    /**
+      Constructor of an empty message, used to preallocate slots of the LogQueue.
+    */
+    LogMessage();
+
+    /** Move constructor, takes over the strings without copying them */
+    LogMessage(LogMessage&& other) = default;
+
+    /** Move assignment, takes over the strings without copying them */
+    LogMessage& operator=(LogMessage&& other) = default;
+
     /**
       Constructor. All parameters are copied, so that later changes to them do not
       affect this object.
@@ -51,12 +65,27 @@ public:
     LogMessage(const QtMsgType type, const QString& message, const QHash<QString,QString>* logVars,
                const QString &file, const QString &function, const int line);
 
+    /**
+      Overwrite all fields with new values, which reuses a preallocated message.
+      The parameters are the same as for the constructor.
+    */
+    void assign(const QtMsgType type, const QString& message, const QHash<QString,QString>* logVars,
+                const QString &file, const QString &function, const int line);
+
+    /**
+      Copy all fields of another message. The strings are implicitly shared,
+      so this is cheap.
+      @param other The message to copy
+    */
+    void copyFrom(const LogMessage& other);
+
     /**
       Returns the log message as decorated string.
       @param msgFormat Format of the decoration. May contain variables and static text,
           e.g. "{timestamp} {type} thread={thread}: {msg}".
       @param timestampFormat Format of timestamp, e.g. "dd.MM.yyyy hh:mm:ss.zzz", see QDateTime::toString().
       @see QDatetime for a description of the timestamp format pattern
+      @see LogFormat is faster if many messages are decorated with the same format
     */
     QString toString(const QString& msgFormat, const QString& timestampFormat) const;
 
@@ -65,13 +94,18 @@ public:
     */
     QtMsgType getType() const;
 
+    /**
+      Get the time of creation in msec since 1970-01-01T00:00:00 UTC.
+    */
+    qint64 getTimestamp() const;
+
 private:
 
     /** Logger variables */
     QHash<QString,QString> logVars;
 
-    /** Date and time of creation */
-    QDateTime timestamp;
+    /** Date and time of creation in msec since the epoch, converted to local time only when decorating */
+    qint64 timestamp;
 
     /** Type of the message */
     QtMsgType type;
@@ -0,0 +1,85 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "logqueue.h"
+
+using namespace stefanfrings;
+
+LogQueue::LogQueue(const int capacity)
+{
+    Q_ASSERT(capacity>0);
+    size_t size=2;
+    while (size<static_cast<size_t>(capacity))
+    {
+        size*=2;
+    }
+    slots.reset(new Slot[size]);
+    for (size_t i=0; i<size; ++i)
+    {
+        slots[i].sequence.store(i,std::memory_order_relaxed);
+    }
+    mask=size-1;
+    enqueuePos.store(0,std::memory_order_relaxed);
+    dequeuePos.store(0,std::memory_order_relaxed);
+}
+
+bool LogQueue::push(LogMessage& message)
+{
+    size_t pos=enqueuePos.load(std::memory_order_relaxed);
+    forever
+    {
+        Slot& slot=slots[pos & mask];
+        size_t sequence=slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff=static_cast<intptr_t>(sequence)-static_cast<intptr_t>(pos);
+        if (diff==0)
+        {
+            // The slot is free, try to reserve it
+            if (enqueuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+            {
+                slot.message=std::move(message);
+                slot.sequence.store(pos+1,std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff<0)
+        {
+            // The slot still contains a message of the previous lap
+            return false;
+        }
+        else
+        {
+            // Another producer was faster
+            pos=enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogQueue::pop(LogMessage& message)
+{
+    size_t pos=dequeuePos.load(std::memory_order_relaxed);
+    Slot& slot=slots[pos & mask];
+    size_t sequence=slot.sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(sequence)-static_cast<intptr_t>(pos+1)<0)
+    {
+        return false;
+    }
+    message=std::move(slot.message);
+    dequeuePos.store(pos+1,std::memory_order_relaxed);
+    // Release the slot for the next lap
+    slot.sequence.store(pos+mask+1,std::memory_order_release);
+    return true;
+}
+
+bool LogQueue::isEmpty() const
+{
+    size_t pos=dequeuePos.load(std::memory_order_relaxed);
+    size_t sequence=slots[pos & mask].sequence.load(std::memory_order_acquire);
+    return static_cast<intptr_t>(sequence)-static_cast<intptr_t>(pos+1)<0;
+}
+
+int LogQueue::capacity() const
+{
+    return static_cast<int>(mask+1);
+}
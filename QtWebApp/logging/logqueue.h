@@ -0,0 +1,83 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <QtGlobal>
+#include "logglobal.h"
+#include "logmessage.h"
+
+namespace stefanfrings {
+
+/**
+  Bounded lock-free queue of log messages with multiple producers and a single
+  consumer. The slots are allocated once by the constructor. Messages are moved
+  into and out of the slots, so pushing and popping does not allocate memory.
+  <p>
+  The implementation follows the bounded MPMC queue of Dmitry Vyukov: each slot
+  carries a sequence number that tells producers and the consumer whether the
+  slot is free or filled for the current lap.
+  @see Logger::setAsync()
+*/
+
+class DECLSPEC LogQueue {
+    Q_DISABLE_COPY(LogQueue)
+public:
+
+    /**
+      Constructor.
+      @param capacity Number of slots, rounded up to the next power of two
+    */
+    LogQueue(const int capacity);
+
+    /**
+      Move a message into the queue.
+      This method is thread safe.
+      @param message The message, is left empty on success
+      @return false if the queue is full
+    */
+    bool push(LogMessage& message);
+
+    /**
+      Move the oldest message out of the queue.
+      Must be called by only one thread at a time.
+      @param message Receives the message
+      @return false if the queue is empty
+    */
+    bool pop(LogMessage& message);
+
+    /** Returns true if the queue is empty */
+    bool isEmpty() const;
+
+    /** Number of slots */
+    int capacity() const;
+
+private:
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogMessage message;
+    };
+
+    /** Storage for the messages */
+    std::unique_ptr<Slot[]> slots;
+
+    /** capacity-1, used to map positions to slots */
+    size_t mask;
+
+    /** Next position to write, shared by the producers */
+    alignas(64) std::atomic<size_t> enqueuePos;
+
+    /** Next position to read, used only by the consumer */
+    alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+} // end of namespace
+
+#endif // LOGQUEUE_H
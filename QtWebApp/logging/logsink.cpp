@@ -0,0 +1,144 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "logsink.h"
+#include "threadname.h"
+
+using namespace stefanfrings;
+
+LogRecord::LogRecord(const LogMessage& logMessage, const int formats)
+{
+    message.copyFrom(logMessage);
+    this->formats=formats;
+    decorations.reset(new Decoration[formats]);
+}
+
+const LogMessage& LogRecord::getMessage() const
+{
+    return message;
+}
+
+const QString& LogRecord::decorate(const int index, const LogFormat& format)
+{
+    if (index<0 || index>=formats)
+    {
+        // Should not happen, the SinkLogger adds sinks while no records are created.
+        // But keep it safe: this string is not shared.
+        thread_local QString buffer;
+        format.format(message,buffer);
+        return buffer;
+    }
+    Decoration& decoration=decorations[index];
+    std::call_once(decoration.once,[&] {
+        format.format(message,decoration.text);
+    });
+    return decoration.text;
+}
+
+
+LogSink::LogSink(const QString& msgFormat, const QString& timestampFormat, const QtMsgType minLevel, const int queueSize)
+    : format(msgFormat,timestampFormat)
+{
+    this->formatIndex=-1;
+    this->minLevel=minLevel;
+    this->queueSize=queueSize;
+    stopping=false;
+}
+
+LogSink::~LogSink()
+{
+    stop();
+}
+
+const QString& LogSink::getMsgFormat() const
+{
+    return format.getMsgFormat();
+}
+
+const QString& LogSink::getTimestampFormat() const
+{
+    return format.getTimestampFormat();
+}
+
+QtMsgType LogSink::getMinLevel() const
+{
+    return minLevel;
+}
+
+bool LogSink::accepts(const QtMsgType type) const
+{
+    return type>=minLevel;
+}
+
+quint64 LogSink::getDroppedMessages() const
+{
+    return droppedMessages.load();
+}
+
+void LogSink::submit(const std::shared_ptr<LogRecord>& record)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (static_cast<int>(queue.size())>=queueSize)
+        {
+            droppedMessages.fetch_add(1,std::memory_order_relaxed);
+            return;
+        }
+        queue.push_back(record);
+    }
+    queueCondition.notify_one();
+}
+
+void LogSink::start()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (!thread.joinable())
+    {
+        stopping=false;
+        thread=std::thread(&LogSink::run,this);
+    }
+}
+
+void LogSink::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping=true;
+    }
+    queueCondition.notify_one();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void LogSink::flush()
+{
+}
+
+void LogSink::run()
+{
+    setThreadName("qwa-logsink");
+    std::deque<std::shared_ptr<LogRecord>> batch;
+    forever
+    {
+        // Take all queued messages at once
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock,[this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+            {
+                break;
+            }
+            batch.swap(queue);
+        }
+        for (const std::shared_ptr<LogRecord>& record : batch)
+        {
+            write(record->getMessage(),record->decorate(formatIndex,format));
+        }
+        batch.clear();
+        flush();
+    }
+}
@@ -0,0 +1,176 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QtGlobal>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "logglobal.h"
+#include "logmessage.h"
+#include "logformat.h"
+
+namespace stefanfrings {
+
+/**
+  A log message that is shared by all sinks of a SinkLogger.
+  It is captured once and decorated at most once per distinct format,
+  by the first sink that needs it.
+*/
+
+class DECLSPEC LogRecord {
+    Q_DISABLE_COPY(LogRecord)
+public:
+
+    /**
+      Constructor.
+      @param logMessage The message, gets copied
+      @param formats Number of distinct formats of the sinks
+    */
+    LogRecord(const LogMessage& logMessage, const int formats);
+
+    /** The message */
+    const LogMessage& getMessage() const;
+
+    /**
+      Get the decorated message. This method is thread safe.
+      @param index Index of the format, see LogSink::getFormatIndex()
+      @param format The format, used only by the first caller
+    */
+    const QString& decorate(const int index, const LogFormat& format);
+
+private:
+
+    /** Decorated message of one format */
+    struct Decoration {
+        std::once_flag once;
+        QString text;
+    };
+
+    /** The message */
+    LogMessage message;
+
+    /** Number of decorations */
+    int formats;
+
+    /** Decorations by format index */
+    std::unique_ptr<Decoration[]> decorations;
+};
+
+
+/**
+  Output medium of a SinkLogger, with its own level filter and format.
+  <p>
+  Each sink has a bounded queue and its own thread that calls write(). Therefore
+  a slow sink does not delay the application or the other sinks. When the queue
+  is full, new messages are discarded and counted.
+  <p>
+  Derived classes must call stop() in their destructor.
+  @see SinkLogger
+*/
+
+class DECLSPEC LogSink {
+    Q_DISABLE_COPY(LogSink)
+public:
+
+    /**
+      Constructor.
+      @param msgFormat Format of the decoration, see LogMessage
+      @param timestampFormat Format of timestamps, see QDateTime::toString()
+      @param minLevel Messages with lower level are discarded
+      @param queueSize Maximum number of messages that wait for the thread
+    */
+    LogSink(const QString& msgFormat, const QString& timestampFormat,
+            const QtMsgType minLevel=QtDebugMsg, const int queueSize=8192);
+
+    /** Destructor */
+    virtual ~LogSink();
+
+    /** Get the format of the decoration */
+    const QString& getMsgFormat() const;
+
+    /** Get the format of timestamps */
+    const QString& getTimestampFormat() const;
+
+    /** Get the minimum level */
+    QtMsgType getMinLevel() const;
+
+    /** Returns true if the sink wants messages of this type */
+    bool accepts(const QtMsgType type) const;
+
+    /** Number of discarded messages because the queue was full */
+    quint64 getDroppedMessages() const;
+
+    /**
+      Pass a message to the thread of this sink.
+      This method is thread safe.
+    */
+    void submit(const std::shared_ptr<LogRecord>& record);
+
+    /** Start the thread */
+    void start();
+
+    /** Write the queued messages and stop the thread */
+    void stop();
+
+protected:
+
+    /**
+      Write a message. Called by the thread of the sink.
+      @param logMessage The message
+      @param decorated The message, decorated with msgFormat
+    */
+    virtual void write(const LogMessage& logMessage, const QString& decorated)=0;
+
+    /** Called by the thread of the sink when the queue became empty */
+    virtual void flush();
+
+private:
+
+    friend class SinkLogger;
+
+    /** Format of this sink */
+    LogFormat format;
+
+    /** Index of the format in the LogRecord, assigned by the SinkLogger */
+    int formatIndex;
+
+    /** Minimum level */
+    QtMsgType minLevel;
+
+    /** Maximum number of queued messages */
+    int queueSize;
+
+    /** Queued messages */
+    std::deque<std::shared_ptr<LogRecord>> queue;
+
+    /** Protects the queue */
+    std::mutex queueMutex;
+
+    /** Wakes up the thread */
+    std::condition_variable queueCondition;
+
+    /** Tells the thread to terminate */
+    bool stopping;
+
+    /** The thread */
+    std::thread thread;
+
+    /** Number of discarded messages */
+    std::atomic<quint64> droppedMessages{0};
+
+    /** Main loop of the thread */
+    void run();
+};
+
+} // end of namespace
+
+#endif // LOGSINK_H
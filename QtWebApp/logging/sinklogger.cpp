@@ -0,0 +1,68 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "sinklogger.h"
+
+using namespace stefanfrings;
+
+SinkLogger::SinkLogger(const int bufferSize, QObject* parent)
+    : Logger("{msg}","yyyy-MM-dd hh:mm:ss.zzz",QtFatalMsg,bufferSize,parent)
+{
+    formats=0;
+}
+
+SinkLogger::~SinkLogger()
+{
+    setAsync(false);
+    foreach (LogSink* sink, sinks)
+    {
+        sink->stop();
+        delete sink;
+    }
+}
+
+void SinkLogger::addSink(LogSink* sink)
+{
+    Q_ASSERT(sink!=nullptr);
+    mutex.lock();
+    // Share the decoration with sinks that use the same format
+    foreach (LogSink* other, sinks)
+    {
+        if (other->getMsgFormat()==sink->getMsgFormat() && other->getTimestampFormat()==sink->getTimestampFormat())
+        {
+            sink->formatIndex=other->formatIndex;
+            break;
+        }
+    }
+    if (sink->formatIndex<0)
+    {
+        sink->formatIndex=formats++;
+    }
+    if (sinks.isEmpty() || sink->getMinLevel()<minLevel)
+    {
+        minLevel=sink->getMinLevel();
+    }
+    sinks.append(sink);
+    sink->start();
+    mutex.unlock();
+    updateCategoryFilter();
+}
+
+void SinkLogger::write(const LogMessage* logMessage)
+{
+    std::shared_ptr<LogRecord> record;
+    foreach (LogSink* sink, sinks)
+    {
+        if (sink->accepts(logMessage->getType()))
+        {
+            // Capture the message only once for all sinks
+            if (!record)
+            {
+                record=std::make_shared<LogRecord>(*logMessage,formats);
+            }
+            sink->submit(record);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef SINKLOGGER_H
+#define SINKLOGGER_H
+
+#include <QtGlobal>
+#include <QList>
+#include "logglobal.h"
+#include "logger.h"
+#include "logsink.h"
+
+namespace stefanfrings {
+
+/**
+  Logger that distributes the messages to several sinks, e.g. a FileSink,
+  a ConsoleSink and a SyslogSink, each with its own level filter and format.
+  <p>
+  Each message is captured once into a LogRecord that all sinks share.
+  Sinks with the same msgFormat and timestampFormat share the decorated
+  text, so it is produced at most once per distinct format. Every sink
+  writes in its own thread, so a slow sink does not stall the others.
+  <p>
+  Example:
+  <code><pre>
+  SinkLogger* logger=new SinkLogger(0,app);
+  logger->addSink(new FileSink("logs/debug.log","{timestamp} {type} {thread} {msg}"));
+  logger->addSink(new ConsoleSink("{timestamp} {type} {msg}","hh:mm:ss.zzz",QtWarningMsg));
+  logger->addSink(new SyslogSink("myapp"));
+  logger->installMsgHandler();
+  </pre></code>
+  The minLevel of the logger is the lowest level of its sinks.
+  @see Logger for a description of the buffer.
+*/
+
+class DECLSPEC SinkLogger : public Logger {
+    Q_OBJECT
+    Q_DISABLE_COPY(SinkLogger)
+public:
+
+    /**
+      Constructor.
+      @param bufferSize Size of the backtrace buffer, number of messages per thread. 0=disabled.
+      @param parent Parent object
+    */
+    SinkLogger(const int bufferSize=0, QObject* parent=nullptr);
+
+    /** Destructor. Writes the queued messages and deletes the sinks. */
+    virtual ~SinkLogger();
+
+    /**
+      Add a sink and start its thread.
+      This method is thread safe.
+      @param sink The sink, the logger takes ownership
+    */
+    void addSink(LogSink* sink);
+
+protected:
+
+    /** Pass a message to the sinks that accept its type */
+    virtual void write(const LogMessage* logMessage);
+
+private:
+
+    /** The sinks */
+    QList<LogSink*> sinks;
+
+    /** Number of distinct formats of the sinks */
+    int formats;
+};
+
+} // end of namespace
+
+#endif // SINKLOGGER_H
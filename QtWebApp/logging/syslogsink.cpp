@@ -0,0 +1,146 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "syslogsink.h"
+#ifdef Q_OS_UNIX
+    #include <syslog.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <cstring>
+    #include <ctime>
+    #ifndef SOCK_CLOEXEC
+        #define SOCK_CLOEXEC 0
+    #endif
+    #ifndef MSG_NOSIGNAL
+        #define MSG_NOSIGNAL 0
+    #endif
+#endif
+
+using namespace stefanfrings;
+
+SyslogSink::SyslogSink(const QString& ident, const int facility, const QString& msgFormat, const QtMsgType minLevel)
+    : LogSink(msgFormat,"yyyy-MM-dd hh:mm:ss.zzz",minLevel)
+{
+    this->ident=ident.toLocal8Bit();
+#ifdef Q_OS_UNIX
+    this->facility=facility<0 ? LOG_USER : facility;
+#else
+    this->facility=facility;
+#endif
+    socket=-1;
+    stream=false;
+    connectSocket();
+}
+
+SyslogSink::~SyslogSink()
+{
+    stop();
+    closeSocket();
+}
+
+bool SyslogSink::connectSocket()
+{
+#ifdef Q_OS_UNIX
+    if (socket>=0)
+    {
+        return true;
+    }
+    struct sockaddr_un address={};
+    address.sun_family=AF_UNIX;
+#ifdef Q_OS_MACOS
+    strncpy(address.sun_path,"/var/run/syslog",sizeof(address.sun_path)-1);
+#else
+    strncpy(address.sun_path,"/dev/log",sizeof(address.sun_path)-1);
+#endif
+    // Most daemons listen on a datagram socket, some on a stream socket
+    for (int type : {SOCK_DGRAM,SOCK_STREAM})
+    {
+        socket=::socket(AF_UNIX,type | SOCK_CLOEXEC,0);
+        if (socket<0)
+        {
+            return false;
+        }
+        if (::connect(socket,reinterpret_cast<struct sockaddr*>(&address),sizeof(address))==0)
+        {
+            stream=(type==SOCK_STREAM);
+            return true;
+        }
+        const int error=errno;
+        closeSocket();
+        if (error!=EPROTOTYPE)
+        {
+            break;
+        }
+    }
+#endif
+    return false;
+}
+
+void SyslogSink::closeSocket()
+{
+#ifdef Q_OS_UNIX
+    if (socket>=0)
+    {
+        ::close(socket);
+        socket=-1;
+    }
+#endif
+}
+
+void SyslogSink::write(const LogMessage& logMessage, const QString& decorated)
+{
+#ifdef Q_OS_UNIX
+    int priority;
+    switch (logMessage.getType())
+    {
+        case QtWarningMsg:
+            priority=LOG_WARNING;
+            break;
+        case QtCriticalMsg:
+            priority=LOG_ERR;
+            break;
+        case QtFatalMsg:
+            priority=LOG_CRIT;
+            break;
+    #if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
+        case QtInfoMsg:
+            priority=LOG_INFO;
+            break;
+    #endif
+        default:
+            priority=LOG_DEBUG;
+    }
+    // Same format as syslog(): <priority>timestamp ident[pid]: message
+    char timestamp[32];
+    const time_t now=time(nullptr);
+    struct tm local;
+    localtime_r(&now,&local);
+    strftime(timestamp,sizeof(timestamp),"%b %e %H:%M:%S",&local);
+    QByteArray packet="<"+QByteArray::number(facility | priority)+">"+timestamp+" "+ident
+            +"["+QByteArray::number(static_cast<qint64>(getpid()))+"]: ";
+    // The decorated message ends with a line break, which syslog does not want
+    packet.append(decorated.trimmed().toUtf8());
+    // Connect again, if the daemon has been restarted
+    for (int attempt=0; attempt<2; attempt++)
+    {
+        if (!connectSocket())
+        {
+            return;
+        }
+        // Stream sockets need a terminator
+        const qint64 size=stream ? packet.size()+1 : packet.size();
+        if (::send(socket,packet.constData(),static_cast<size_t>(size),MSG_NOSIGNAL)==size)
+        {
+            return;
+        }
+        closeSocket();
+    }
+#else
+    Q_UNUSED(logMessage)
+    Q_UNUSED(decorated)
+#endif
+}
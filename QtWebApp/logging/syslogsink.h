@@ -0,0 +1,75 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef SYSLOGSINK_H
+#define SYSLOGSINK_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include "logglobal.h"
+#include "logsink.h"
+
+namespace stefanfrings {
+
+/**
+  Sink that sends the messages to the local syslog daemon, which receives
+  them through its socket. The message type is mapped to the syslog priority,
+  so the default msgFormat contains only the message text.
+  <p>
+  Each sink has its own connection to /dev/log instead of using openlog()
+  and syslog(), which share one ident and facility in the whole process.
+  So several sinks with different idents can coexist, and they do not
+  disturb other code of the program that uses syslog().
+  <p>
+  Only available on Unix. On other systems, the messages are discarded.
+  @see SinkLogger
+*/
+
+class DECLSPEC SyslogSink : public LogSink {
+    Q_DISABLE_COPY(SyslogSink)
+public:
+
+    /**
+      Constructor.
+      @param ident Name of the program in the syslog
+      @param facility Syslog facility, e.g. LOG_USER or LOG_DAEMON, see syslog.h. -1=LOG_USER
+      @param msgFormat Format of the decoration, see LogMessage
+      @param minLevel Messages with lower level are discarded
+    */
+    SyslogSink(const QString& ident, const int facility=-1,
+               const QString& msgFormat="{msg}", const QtMsgType minLevel=QtWarningMsg);
+
+    /** Destructor */
+    virtual ~SyslogSink();
+
+protected:
+
+    /** Send a message to the syslog */
+    virtual void write(const LogMessage& logMessage, const QString& decorated);
+
+private:
+
+    /** Name of the program */
+    QByteArray ident;
+
+    /** Syslog facility */
+    int facility;
+
+    /** Socket connected to the syslog daemon, or -1 */
+    int socket;
+
+    /** Whether the socket is a stream socket, then the messages are terminated by a null byte */
+    bool stream;
+
+    /** Connect the socket to the syslog daemon, if not already done */
+    bool connectSocket();
+
+    /** Close the socket */
+    void closeSocket();
+};
+
+} // end of namespace
+
+#endif // SYSLOGSINK_H
@@ -4,10 +4,268 @@
 */
 
 #include "template.h"
+#include "templatelogging.h"
+#include "templatefragmentcache.h"
 #include <QFileInfo>
+#include <QStringList>
+#include <vector>
 
 using namespace stefanfrings;
 
+namespace {
+
+/** Element of a parsed loop body, used by Template::loop(name,rows) */
+struct LoopNode
+{
+    enum Kind {Text, Variable, Condition, Loop};
+
+    Kind kind;
+
+    /** Text: position and length of the text in the source */
+    int start;
+    int length;
+
+    /** Variable, Condition, Loop: full name of the tag, used for warnings */
+    QString name;
+
+    /** Variable, Condition, Loop: index of the loop level that provides the value */
+    int frame;
+
+    /** Variable, Condition, Loop: keys within the row of that loop level */
+    QStringList keys;
+
+    /** Condition: true for {ifnot} */
+    bool negate;
+
+    /** Variable: escaping context */
+    TemplateEscaper::Context context;
+
+    /** Condition: true part, Loop: body */
+    std::vector<LoopNode> body;
+
+    /** Condition: false part, Loop: part for zero repetitions */
+    std::vector<LoopNode> elseBody;
+};
+
+/**
+  Parses a loop body into nodes.
+  Tags that do not belong to one of the loops in loopNames are kept as text.
+  @param source Source text
+  @param pos Start position, will be moved behind the terminating tag
+  @param loopNames Names of the enclosing loops, outermost first
+  @param endName Name of the terminating {else} or {end} tag, or empty to parse until the end of source
+  @param nodes Receives the parsed nodes
+  @return 0 if the end of the source has been reached, 1 if {else endName} terminated, 2 if {end endName} terminated
+*/
+int parseLoopBody(const QString& source, int& pos, QStringList& loopNames, const QString& endName, std::vector<LoopNode>& nodes)
+{
+    int textStart=pos;
+    auto flushText=[&](int end)
+    {
+        if (end>textStart)
+        {
+            LoopNode text;
+            text.kind=LoopNode::Text;
+            text.start=textStart;
+            text.length=end-textStart;
+            nodes.push_back(text);
+        }
+    };
+
+    forever
+    {
+        int open=source.indexOf('{',pos);
+        int close=(open<0) ? -1 : source.indexOf('}',open+1);
+        if (close<0)
+        {
+            pos=source.length();
+            flushText(pos);
+            return 0;
+        }
+        QString tag=source.mid(open+1,close-open-1);
+        QString keyword;
+        QString name=tag;
+        int space=tag.indexOf(' ');
+        if (space>0)
+        {
+            keyword=tag.left(space);
+            name=tag.mid(space+1);
+        }
+
+        // Terminating tag of the current block
+        if (!endName.isEmpty() && name==endName && (keyword=="else" || keyword=="end"))
+        {
+            flushText(open);
+            pos=close+1;
+            return keyword=="else" ? 1 : 2;
+        }
+
+        TemplateEscaper::Context context=TemplateEscaper::None;
+        if (keyword.isEmpty())
+        {
+            int pipe=name.indexOf('|');
+            if (pipe>0)
+            {
+                bool ok;
+                context=TemplateEscaper::context(name.midRef(pipe+1),&ok);
+                name.truncate(pipe);
+                if (!ok)
+                {
+                    // Unknown escaping context, keep the tag as text
+                    name.clear();
+                }
+            }
+        }
+        // Find the innermost loop that the name belongs to
+        int frame=-1;
+        if (keyword.isEmpty() || keyword=="if" || keyword=="ifnot" || keyword=="loop")
+        {
+            for (int i=loopNames.size()-1; i>=0; --i)
+            {
+                const QString& loopName=loopNames.at(i);
+                if (name.length()>loopName.length()+1 && name.startsWith(loopName) && name.at(loopName.length())=='.')
+                {
+                    frame=i;
+                    break;
+                }
+            }
+        }
+        if (frame<0 || name.contains(' '))
+        {
+            // Not our tag, keep it as text
+            pos=open+1;
+            continue;
+        }
+
+        flushText(open);
+        pos=close+1;
+        LoopNode node;
+        node.name=name;
+        node.frame=frame;
+        node.keys=name.mid(loopNames.at(frame).length()+1).split('.');
+        node.negate=(keyword=="ifnot");
+        node.context=context;
+        node.start=0;
+        node.length=0;
+        if (keyword.isEmpty())
+        {
+            node.kind=LoopNode::Variable;
+        }
+        else
+        {
+            node.kind=(keyword=="loop") ? LoopNode::Loop : LoopNode::Condition;
+            if (node.kind==LoopNode::Loop)
+            {
+                loopNames.append(name);
+            }
+            int result=parseLoopBody(source,pos,loopNames,name,node.body);
+            if (result==1)
+            {
+                result=parseLoopBody(source,pos,loopNames,name,node.elseBody);
+            }
+            if (node.kind==LoopNode::Loop)
+            {
+                loopNames.removeLast();
+            }
+            if (result!=2)
+            {
+                qCWarning(qwaTemplate,"Template: missing end {end %s}",qPrintable(name));
+            }
+        }
+        nodes.push_back(node);
+        textStart=pos;
+    }
+}
+
+/** Get the value of a node from the rows of the enclosing loops */
+QVariant loopValue(const LoopNode& node, const std::vector<const QVariantMap*>& rows, bool& found)
+{
+    const QVariantMap* row=rows.at(node.frame);
+    QVariantMap nested;
+    QVariant value;
+    found=false;
+    for (int i=0; i<node.keys.size(); ++i)
+    {
+        QVariantMap::const_iterator it=row->constFind(node.keys.at(i));
+        if (it==row->constEnd())
+        {
+            return QVariant();
+        }
+        value=it.value();
+        if (i<node.keys.size()-1)
+        {
+            if (value.type()!=QVariant::Map)
+            {
+                return QVariant();
+            }
+            nested=value.toMap();
+            row=&nested;
+        }
+    }
+    found=true;
+    return value;
+}
+
+/** Render parsed nodes into the output */
+void renderLoopNodes(const QString& source, const std::vector<LoopNode>& nodes, std::vector<const QVariantMap*>& rows,
+                     QString& output, const bool warnings, const QString& sourceName)
+{
+    for (const LoopNode& node : nodes)
+    {
+        switch (node.kind)
+        {
+            case LoopNode::Text:
+                output.append(source.constData()+node.start,node.length);
+                break;
+
+            case LoopNode::Variable:
+            {
+                bool found;
+                QVariant value=loopValue(node,rows,found);
+                if (found)
+                {
+                    TemplateEscaper::append(output,value.toString(),node.context);
+                }
+                else if (warnings)
+                {
+                    qCWarning(qwaTemplate,"Template: missing value for {%s} in %s",qPrintable(node.name),qPrintable(sourceName));
+                }
+                break;
+            }
+
+            case LoopNode::Condition:
+            {
+                bool found;
+                bool value=loopValue(node,rows,found).toBool();
+                renderLoopNodes(source,(value!=node.negate) ? node.body : node.elseBody,rows,output,warnings,sourceName);
+                break;
+            }
+
+            case LoopNode::Loop:
+            {
+                bool found;
+                const QVariantList list=loopValue(node,rows,found).toList();
+                if (list.isEmpty())
+                {
+                    renderLoopNodes(source,node.elseBody,rows,output,warnings,sourceName);
+                    break;
+                }
+                rows.push_back(nullptr);
+                for (const QVariant& element : list)
+                {
+                    const QVariantMap row=element.toMap();
+                    rows.back()=&row;
+                    renderLoopNodes(source,node.body,rows,output,warnings,sourceName);
+                }
+                rows.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+} // end of anonymous namespace
+
 Template::Template(const QString source, const QString sourceName)
     : QString(source)
 {
@@ -27,7 +285,7 @@ Template::Template(QFile& file, const QTextCodec* textCodec)
     file.close();
     if (data.size()==0 || file.error())
     {
-        qCritical("Template: cannot read from %s, %s",qPrintable(sourceName),qPrintable(file.errorString()));
+        qCCritical(qwaTemplate,"Template: cannot read from %s, %s",qPrintable(sourceName),qPrintable(file.errorString()));
     }
     else
     {
@@ -39,17 +297,55 @@ Template::Template(QFile& file, const QTextCodec* textCodec)
 int Template::setVariable(const QString name, const QString value)
 {
     int count=0;
-    QString variable="{"+name+"}";
+    QString variable="{"+name;
     int start=indexOf(variable);
-    while (start>=0)
+    if (start>=0)
     {
-        replace(start, variable.length(), value);
-        count++;
-        start=indexOf(variable,start+value.length());
+        // Build the new document in one pass instead of replacing each tag in place
+        QString document;
+        document.reserve(length()+value.length());
+        int copied=0;
+        while (start>=0)
+        {
+            int tagEnd=start+variable.length();
+            bool match=false;
+            TemplateEscaper::Context context=TemplateEscaper::None;
+            if (tagEnd<length() && at(tagEnd)=='}')
+            {
+                match=true;
+                tagEnd+=1;
+            }
+            else if (tagEnd<length() && at(tagEnd)=='|')
+            {
+                int close=indexOf('}',tagEnd);
+                if (close>0)
+                {
+                    context=TemplateEscaper::context(midRef(tagEnd+1,close-tagEnd-1),&match);
+                    tagEnd=close+1;
+                }
+            }
+            if (match)
+            {
+                document.append(constData()+copied,start-copied);
+                TemplateEscaper::append(document,value,context);
+                copied=tagEnd;
+                count++;
+                start=indexOf(variable,tagEnd);
+            }
+            else
+            {
+                start=indexOf(variable,start+1);
+            }
+        }
+        if (count>0)
+        {
+            document.append(constData()+copied,length()-copied);
+            swap(document);
+        }
     }
     if (count==0 && warnings)
     {
-        qWarning("Template: missing variable %s in %s",qPrintable(variable),qPrintable(sourceName));
+        qCWarning(qwaTemplate,"Template: missing variable {%s} in %s",qPrintable(name),qPrintable(sourceName));
     }
     return count;
 }
@@ -99,7 +395,7 @@ int Template::setCondition(const QString name, const bool value)
         }
         else
         {
-            qWarning("Template: missing condition end %s in %s",qPrintable(endTag),qPrintable(sourceName));
+            qCWarning(qwaTemplate,"Template: missing condition end %s in %s",qPrintable(endTag),qPrintable(sourceName));
         }
     }
     // search for ifnot-else-end
@@ -142,12 +438,12 @@ int Template::setCondition(const QString name, const bool value)
         }
         else
         {
-            qWarning("Template: missing condition end %s in %s",qPrintable(endTag),qPrintable(sourceName));
+            qCWarning(qwaTemplate,"Template: missing condition end %s in %s",qPrintable(endTag),qPrintable(sourceName));
         }
     }
     if (count==0 && warnings)
     {
-        qWarning("Template: missing condition %s or %s in %s",qPrintable(startTag),qPrintable(startTag2),qPrintable(sourceName));
+        qCWarning(qwaTemplate,"Template: missing condition %s or %s in %s",qPrintable(startTag),qPrintable(startTag2),qPrintable(sourceName));
     }
     return count;
 }
@@ -226,12 +522,12 @@ int Template::loop(const QString name, const int repetitions)
         }
         else
         {
-            qWarning("Template: missing loop end %s in %s",qPrintable(endTag),qPrintable(sourceName));
+            qCWarning(qwaTemplate,"Template: missing loop end %s in %s",qPrintable(endTag),qPrintable(sourceName));
         }
     }
     if (count==0 && warnings)
     {
-        qWarning("Template: missing loop %s in %s",qPrintable(startTag),qPrintable(sourceName));
+        qCWarning(qwaTemplate,"Template: missing loop %s in %s",qPrintable(startTag),qPrintable(sourceName));
     }
     return count;
 }
@@ -241,3 +537,133 @@ void Template::enableWarnings(const bool enable)
     warnings=enable;
 }
 
+int Template::loop(const QString name, const QVariantList& rows)
+{
+    int count=0;
+    QString startTag="{loop "+name+"}";
+    QString elseTag="{else "+name+"}";
+    QString endTag="{end "+name+"}";
+    int start=indexOf(startTag);
+    while (start>=0)
+    {
+        int end=indexOf(endTag,start+startTag.length());
+        if (end<0)
+        {
+            qCWarning(qwaTemplate,"Template: missing loop end %s in %s",qPrintable(endTag),qPrintable(sourceName));
+            break;
+        }
+        count++;
+        int ellse=indexOf(elseTag,start+startTag.length());
+        bool hasElse=(ellse>start && ellse<end);
+        QString insertMe;
+        if (!rows.isEmpty())
+        {
+            // Parse the loop body once, then render it for each row
+            QString loopPart=mid(start+startTag.length(), (hasElse ? ellse : end)-start-startTag.length());
+            QStringList loopNames(name);
+            std::vector<LoopNode> nodes;
+            int pos=0;
+            parseLoopBody(loopPart,pos,loopNames,QString(),nodes);
+            insertMe.reserve(loopPart.length()*rows.size());
+            std::vector<const QVariantMap*> frames(1,nullptr);
+            for (const QVariant& element : rows)
+            {
+                const QVariantMap row=element.toMap();
+                frames[0]=&row;
+                renderLoopNodes(loopPart,nodes,frames,insertMe,warnings,sourceName);
+            }
+        }
+        else if (hasElse)
+        {
+            insertMe=mid(ellse+elseTag.length(), end-ellse-elseTag.length());
+        }
+        replace(start, end-start+endTag.length(), insertMe);
+        start=indexOf(startTag,start+insertMe.length());
+    }
+    if (count==0 && warnings)
+    {
+        qCWarning(qwaTemplate,"Template: missing loop %s in %s",qPrintable(startTag),qPrintable(sourceName));
+    }
+    return count;
+}
+
+int Template::cachedFragment(TemplateFragmentCache* cache, const QString name, const QHash<QString,QString>& keys,
+                             const std::function<void(Template& fragment)>& render)
+{
+    int count=0;
+    QString startTag="{cache "+name;
+    QString endTag="{end "+name+"}";
+    int start=indexOf(startTag);
+    while (start>=0)
+    {
+        // The name must be followed by the end of the tag or by the declarations
+        int afterName=start+startTag.length();
+        if (afterName>=length() || (at(afterName)!='}' && at(afterName)!=' '))
+        {
+            start=indexOf(startTag,afterName);
+            continue;
+        }
+        int close=indexOf('}',afterName);
+        int end=(close<0) ? -1 : indexOf(endTag,close+1);
+        if (end<0)
+        {
+            qCWarning(qwaTemplate,"Template: missing fragment end %s in %s",qPrintable(endTag),qPrintable(sourceName));
+            break;
+        }
+        count++;
+
+        // Build the cache key from the declarations. Names and values are prefixed
+        // with their length, so different values can never produce the same key.
+        int ttl=-1;
+        bool cacheable=(cache!=nullptr);
+        QString key=sourceName+'\n'+name;
+        const QStringList declarations=mid(afterName,close-afterName).split(' ',QString::SkipEmptyParts);
+        foreach (const QString& declaration, declarations)
+        {
+            if (declaration.startsWith("ttl="))
+            {
+                bool ok;
+                ttl=declaration.mid(4).toInt(&ok);
+                if (!ok || ttl<0)
+                {
+                    qCWarning(qwaTemplate,"Template: invalid %s of fragment %s in %s, using the default",qPrintable(declaration),qPrintable(name),qPrintable(sourceName));
+                    ttl=-1;
+                }
+            }
+            else if (keys.contains(declaration))
+            {
+                const QString value=keys.value(declaration);
+                key.append('\n').append(QString::number(declaration.length())).append(':').append(declaration)
+                   .append(QString::number(value.length())).append(':').append(value);
+            }
+            else
+            {
+                qCWarning(qwaTemplate,"Template: missing key %s of fragment %s in %s",qPrintable(declaration),qPrintable(name),qPrintable(sourceName));
+                cacheable=false;
+            }
+        }
+
+        QString document;
+        if (!cacheable || !cache->find(key,document))
+        {
+            Template fragment(mid(close+1,end-close-1),sourceName);
+            fragment.enableWarnings(warnings);
+            if (render)
+            {
+                render(fragment);
+            }
+            document=fragment;
+            if (cacheable)
+            {
+                cache->insert(key,document,ttl);
+            }
+        }
+        replace(start, end-start+endTag.length(), document);
+        start=indexOf(startTag,start+document.length());
+    }
+    if (count==0 && warnings)
+    {
+        qCWarning(qwaTemplate,"Template: missing fragment %s} in %s",qPrintable(startTag),qPrintable(sourceName));
+    }
+    return count;
+}
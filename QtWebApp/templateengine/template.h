@@ -12,10 +12,16 @@
 #include <QTextCodec>
 #include <QFile>
 #include <QString>
+#include <QVariant>
+#include <QHash>
+#include <functional>
 #include "templateglobal.h"
+#include "templateescaper.h"
 
 namespace stefanfrings {
 
+class TemplateFragmentCache;
+
 /**
  Enhanced version of QString for template processing. Templates
  are usually loaded from files, but may also be loaded from
@@ -49,6 +55,11 @@ namespace stefanfrings {
  t.setVariable("user1.time","8:45");
  </pre></code></p>
  <p>
+ Variables can be escaped while they are inserted, by appending the escaping
+ context to the name: {username|html}, {username|attr}, {username|url} or
+ {username|js}. The same value is then inserted escaped or unescaped,
+ depending on the tag. See TemplateEscaper for the details.
+ <p>
  The code example above shows how variable within loops are numbered.
  Counting starts with 0. Loops can be nested, for example:
  <p><code><pre>
@@ -85,6 +96,30 @@ namespace stefanfrings {
  t.setVariable("row2.column2.value","k");
  t.setVariable("row2.column3.value","l");
  </pre></code></p>
+ <p>
+ Numbering the variables gets expensive for large loops, because every
+ repetition is renamed textually and every setVariable() call searches
+ the whole (already expanded) document. Therefore loops can also be
+ rendered directly from a list of rows. Each row is a QVariantMap that
+ contains the values of the variables and conditions without the loop
+ name as prefix. A nested loop is a QVariantList of rows in its parent row:
+ <p><code><pre>
+ QVariantList rows;
+ for (int r=0; r<3; ++r)
+ {
+     QVariantList columns;
+     for (int c=0; c<4; ++c)
+     {
+         QVariantMap column;
+         column.insert("value",data[r][c]);
+         columns.append(column);
+     }
+     QVariantMap row;
+     row.insert("column",columns);
+     rows.append(row);
+ }
+ t.loop("row",rows);
+ </pre></code></p>
  @see TemplateLoader
  @see TemplateCache
 */
@@ -115,6 +150,7 @@ public:
       Affects tags with the syntax
 
       - {name}
+      - {name|html}, {name|attr}, {name|url}, {name|js}, which insert the escaped value
 
       After settings the
       value of a variable, the variable does not exist anymore,
@@ -152,6 +188,59 @@ public:
     */
     int loop(QString name, const int repetitions);
 
+    /**
+     Render a loop from a list of rows.
+     This affects tags with the syntax
+
+     - {loop name}...{end name}
+     - {loop name}...{else name}...{end name}
+
+     Within the loop, the tags {name.xxx}, {if name.xxx} and {ifnot name.xxx}
+     take their values from the key "xxx" of the current row, and
+     {loop name.xxx} renders the QVariantList stored under the key "xxx"
+     as nested loop. Dotted keys like {name.xxx.yyy} address nested QVariantMaps.
+     Other tags are left untouched, so they can still be filled by setVariable().
+     <p>
+     The loop body is parsed only once and rendered directly into the output,
+     so the costs grow linearly with the size of the generated text.
+
+     @param name Name of the loop
+     @param rows List of QVariantMap, one for each repetition
+     @return The number of loops that have been processed
+    */
+    int loop(const QString name, const QVariantList& rows);
+
+    /**
+     Insert a cached fragment, or render and cache it.
+     This affects tags with the syntax
+
+     - {cache name}...{end name}
+     - {cache name ttl=60000 key1 key2}...{end name}
+
+     The optional ttl declares how long the rendered fragment stays valid in milliseconds,
+     otherwise the default time of the cache applies. The other words declare the
+     variables that the fragment depends on. Their values are part of the cache key,
+     together with the name of the template and the name of the fragment.
+     <p>
+     If the fragment is in the cache, it gets inserted without calling render.
+     Otherwise render is called with a Template that contains only the body
+     of the fragment, so the handler computes and sets the variables of the
+     fragment only when necessary:
+     <p><code><pre>
+     t.cachedFragment(fragmentCache, "navigation", {{"user",userName}}, [&](Template& fragment) {
+         fragment.setVariable("user",userName);
+         fragment.loop("menu",loadMenu(userName));
+     });
+     </pre></code></p>
+     @param cache Storage for the rendered fragments, nullptr disables caching
+     @param name Name of the fragment
+     @param keys Values of the variables that the fragment depends on
+     @param render Renders the fragment if it is not cached
+     @return The number of fragments that have been processed
+    */
+    int cachedFragment(TemplateFragmentCache* cache, const QString name, const QHash<QString,QString>& keys,
+                       const std::function<void(Template& fragment)>& render);
+
     /**
      Enable warnings for missing tags
      @param enable Warnings are enabled, if true
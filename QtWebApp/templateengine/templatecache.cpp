@@ -1,38 +1,73 @@
 #include "templatecache.h"
+#include "templatelogging.h"
+#include "memorybudget.h"
+#include "metricsregistry.h"
 #include <QDateTime>
 #include <QStringList>
 #include <QSet>
+#include <mutex>
 
 using namespace stefanfrings;
 
 TemplateCache::TemplateCache(const QSettings* settings, QObject* parent)
     :TemplateLoader(settings,parent)
 {
-    cache.setMaxCost(settings->value("cacheSize","1000000").toInt());
+    cacheSize=settings->value("cacheSize","1000000").toInt();
+    cache.setMaxCost(cacheSize);
     cacheTimeout=settings->value("cacheTime","60000").toInt();
-    qDebug("TemplateCache: timeout=%i, size=%i",cacheTimeout,cache.maxCost());
+    qwaDebug(qwaTemplate,"TemplateCache: timeout=%i, size=%i",cacheTimeout,cache.maxCost());
+    budgetId=MemoryBudget::instance().addCache([this](double factor)
+    {
+        std::lock_guard lock{ mutex };
+        cache.setMaxCost(qMax(1,static_cast<int>(cacheSize*factor)));
+        accountCache();
+    });
+}
+
+TemplateCache::~TemplateCache()
+{
+    MemoryBudget::instance().removeCache(budgetId);
+    MemoryBudget::instance().add(MemoryBudget::Caches,-accountedBytes);
+}
+
+void TemplateCache::accountCache()
+{
+    // The cost is the number of characters
+    const qint64 bytes=cache.totalCost()*static_cast<qint64>(sizeof(QChar));
+    MemoryBudget::instance().add(MemoryBudget::Caches,bytes-accountedBytes);
+    accountedBytes=bytes;
 }
 
 QString TemplateCache::tryFile(const QString localizedName)
 {
+    static Counter& hits=MetricsRegistry::instance().counter("qtwebapp_template_cache_requests_total","Requests of the TemplateCache by cache result","result=\"hit\"");
+    static Counter& misses=MetricsRegistry::instance().counter("qtwebapp_template_cache_requests_total","Requests of the TemplateCache by cache result","result=\"miss\"");
     qint64 now=QDateTime::currentMSecsSinceEpoch();
     mutex.lock();
     // search in cache
-    qDebug("TemplateCache: trying cached %s",qPrintable(localizedName));
+    qwaDebug(qwaTemplate,"TemplateCache: trying cached %s",qPrintable(localizedName));
     CacheEntry* entry=cache.object(localizedName);
     if (entry && (cacheTimeout==0 || entry->created>now-cacheTimeout))
     {
+        QString document=entry->document;
         mutex.unlock();
-        return entry->document;
+        hits.add();
+        return document;
     }
+    misses.add();
     // search on filesystem
-    entry=new CacheEntry();
-    entry->created=now;
-    entry->document=TemplateLoader::tryFile(localizedName);
+    QString document=TemplateLoader::tryFile(localizedName);
     // Store in cache even when the file did not exist, to remember that there is no such file
     if (cacheTimeout != 0)
+    {
+        // QCache deletes the entry immediately if it is larger than the whole cache
+        entry=new CacheEntry();
+        entry->created=now;
+        entry->document=document;
         cache.insert(localizedName,entry,entry->document.size());
+        accountCache();
+    }
     mutex.unlock();
-    return entry->document;
+    return document;
 }
 
@@ -4,6 +4,7 @@
 #include <QCache>
 #include "templateglobal.h"
 #include "templateloader.h"
+#include "instrumentedmutex.h"
 
 namespace stefanfrings {
 
@@ -38,6 +39,7 @@ namespace stefanfrings {
   settings are in the registry, the path is relative to the current working directory.
   <p>
   Files are cached as long as possible, when cacheTime=0.
+  The cache is accounted in the MemoryBudget and shrinks while the budget is exceeded.
   @see TemplateLoader
 */
 
@@ -58,6 +60,9 @@ public:
     */
     TemplateCache(const QSettings* settings, QObject* parent=nullptr);
 
+    /** Destructor */
+    virtual ~TemplateCache();
+
 protected:
 
     /**
@@ -80,8 +85,20 @@ private:
     /** Cache storage */
     QCache<QString,CacheEntry> cache;
 
+    /** Configured size of the cache */
+    int cacheSize;
+
+    /** Size of the cache in bytes that is accounted in the MemoryBudget */
+    qint64 accountedBytes=0;
+
+    /** Registration of the cache in the MemoryBudget */
+    int budgetId;
+
     /** Used to synchronize threads */
-    QMutex mutex;
+    InstrumentedMutex mutex{"template_cache"};
+
+    /** Update the accounted size of the cache, the caller must hold the mutex */
+    void accountCache();
 };
 
 } // end of namespace
@@ -1,11 +1,24 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
+# Remove the debug messages of the library at compile time
+#DEFINES += QTWEBAPP_NO_DEBUG_OUTPUT
+
+include(../diagnostics/diagnostics.pri)
+
 HEADERS += $$PWD/templateglobal.h
 HEADERS += $$PWD/template.h 
 HEADERS += $$PWD/templateloader.h 
 HEADERS += $$PWD/templatecache.h
+HEADERS += $$PWD/templateregistry.h
+HEADERS += $$PWD/templateescaper.h
+HEADERS += $$PWD/templatefragmentcache.h
+HEADERS += $$PWD/templatelogging.h
 
 SOURCES += $$PWD/template.cpp 
 SOURCES += $$PWD/templateloader.cpp 
 SOURCES += $$PWD/templatecache.cpp
+SOURCES += $$PWD/templateregistry.cpp
+SOURCES += $$PWD/templateescaper.cpp
+SOURCES += $$PWD/templatefragmentcache.cpp
+SOURCES += $$PWD/templatelogging.cpp
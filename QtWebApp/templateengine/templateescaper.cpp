@@ -0,0 +1,283 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "templateescaper.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #include <emmintrin.h>
+    #define TEMPLATEESCAPER_SSE2
+#endif
+
+using namespace stefanfrings;
+
+namespace {
+
+/** Scalar version of the character classification */
+inline bool isSpecial(const ushort c, const TemplateEscaper::Context context)
+{
+    switch (context)
+    {
+        case TemplateEscaper::Html:
+            return c=='&' || c=='<' || c=='>' || c=='"' || c=='\'';
+        case TemplateEscaper::Attribute:
+            return c=='&' || c=='<' || c=='>' || c=='"' || c=='\'' || c=='`' || c=='=';
+        case TemplateEscaper::Url:
+            return !((c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='-' || c=='_' || c=='.' || c=='~');
+        case TemplateEscaper::JavaScript:
+            return c<0x20 || c=='\\' || c=='"' || c=='\'' || c=='`' || c=='<' || c=='>' || c=='&' || c=='/' || c==0x2028 || c==0x2029;
+        default:
+            return false;
+    }
+}
+
+#ifdef TEMPLATEESCAPER_SSE2
+
+/** Compare 8 characters with a constant */
+inline __m128i equals(const __m128i chars, const ushort c)
+{
+    return _mm_cmpeq_epi16(chars,_mm_set1_epi16(static_cast<short>(c)));
+}
+
+/** Check 8 characters for the range from..to, both ends included, only for from>=0 and to<0x8000 */
+inline __m128i inRange(const __m128i chars, const ushort from, const ushort to)
+{
+    return _mm_andnot_si128(_mm_cmplt_epi16(chars,_mm_set1_epi16(static_cast<short>(from))),
+                            _mm_cmplt_epi16(chars,_mm_set1_epi16(static_cast<short>(to+1))));
+}
+
+/** Vector version of isSpecial(), sets all bits of the characters that need escaping */
+inline __m128i specialMask(const __m128i chars, const TemplateEscaper::Context context)
+{
+    switch (context)
+    {
+        case TemplateEscaper::Html:
+            return _mm_or_si128(_mm_or_si128(equals(chars,'&'),equals(chars,'<')),
+                                _mm_or_si128(_mm_or_si128(equals(chars,'>'),equals(chars,'"')),equals(chars,'\'')));
+        case TemplateEscaper::Attribute:
+            return _mm_or_si128(_mm_or_si128(_mm_or_si128(equals(chars,'&'),equals(chars,'<')),
+                                             _mm_or_si128(equals(chars,'>'),equals(chars,'"'))),
+                                _mm_or_si128(equals(chars,'\''),_mm_or_si128(equals(chars,'`'),equals(chars,'='))));
+        case TemplateEscaper::Url:
+        {
+            // Characters >=0x8000 are negative as signed numbers, so they are never in range
+            __m128i safe=_mm_or_si128(_mm_or_si128(inRange(chars,'a','z'),inRange(chars,'A','Z')),
+                                      _mm_or_si128(inRange(chars,'0','9'),
+                                                   _mm_or_si128(_mm_or_si128(equals(chars,'-'),equals(chars,'_')),
+                                                                _mm_or_si128(equals(chars,'.'),equals(chars,'~')))));
+            return _mm_xor_si128(safe,_mm_set1_epi16(-1));
+        }
+        case TemplateEscaper::JavaScript:
+        {
+            // Unsigned compare c<0x20 by flipping the sign bit of both sides
+            __m128i control=_mm_cmplt_epi16(_mm_xor_si128(chars,_mm_set1_epi16(static_cast<short>(0x8000))),
+                                            _mm_set1_epi16(static_cast<short>(0x8020)));
+            __m128i quotes=_mm_or_si128(_mm_or_si128(equals(chars,'\\'),equals(chars,'"')),
+                                        _mm_or_si128(equals(chars,'\''),equals(chars,'`')));
+            __m128i markup=_mm_or_si128(_mm_or_si128(equals(chars,'<'),equals(chars,'>')),
+                                        _mm_or_si128(equals(chars,'&'),equals(chars,'/')));
+            __m128i separators=_mm_or_si128(equals(chars,0x2028),equals(chars,0x2029));
+            return _mm_or_si128(_mm_or_si128(control,quotes),_mm_or_si128(markup,separators));
+        }
+        default:
+            return _mm_setzero_si128();
+    }
+}
+
+/** Get the index of the lowest character in a 16 bit mask created by _mm_movemask_epi8 */
+inline int firstIndex(const int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index,static_cast<unsigned long>(mask));
+    return static_cast<int>(index)/2;
+#else
+    return __builtin_ctz(static_cast<unsigned>(mask))/2;
+#endif
+}
+
+#endif // TEMPLATEESCAPER_SSE2
+
+const char hexDigits[]="0123456789ABCDEF";
+
+/** Append a percent encoded byte */
+inline void appendPercent(QString& output, const uint byte)
+{
+    output.append(QLatin1Char('%'));
+    output.append(QLatin1Char(hexDigits[(byte>>4)&0xF]));
+    output.append(QLatin1Char(hexDigits[byte&0xF]));
+}
+
+/** Append a JavaScript \\uXXXX escape */
+inline void appendUnicodeEscape(QString& output, const ushort c)
+{
+    output.append(QLatin1String("\\u"));
+    output.append(QLatin1Char(hexDigits[(c>>12)&0xF]));
+    output.append(QLatin1Char(hexDigits[(c>>8)&0xF]));
+    output.append(QLatin1Char(hexDigits[(c>>4)&0xF]));
+    output.append(QLatin1Char(hexDigits[c&0xF]));
+}
+
+/**
+  Append the escape sequence of a single special character.
+  @return Number of characters consumed, 2 for surrogate pairs in URLs, otherwise 1
+*/
+int appendEscaped(QString& output, const ushort* data, const int remaining, const TemplateEscaper::Context context)
+{
+    const ushort c=data[0];
+    switch (context)
+    {
+        case TemplateEscaper::Html:
+        case TemplateEscaper::Attribute:
+            switch (c)
+            {
+                case '&':  output.append(QLatin1String("&amp;")); break;
+                case '<':  output.append(QLatin1String("&lt;")); break;
+                case '>':  output.append(QLatin1String("&gt;")); break;
+                case '"':  output.append(QLatin1String("&quot;")); break;
+                case '\'': output.append(QLatin1String("&#39;")); break;
+                case '`':  output.append(QLatin1String("&#96;")); break;
+                case '=':  output.append(QLatin1String("&#61;")); break;
+                default:   output.append(QChar(c)); break;
+            }
+            return 1;
+
+        case TemplateEscaper::Url:
+        {
+            // Encode the code point as UTF-8
+            uint codePoint=c;
+            int consumed=1;
+            if (QChar::isHighSurrogate(c) && remaining>1 && QChar::isLowSurrogate(data[1]))
+            {
+                codePoint=QChar::surrogateToUcs4(c,data[1]);
+                consumed=2;
+            }
+            else if (QChar::isSurrogate(c))
+            {
+                codePoint=QChar::ReplacementCharacter;
+            }
+            if (codePoint<0x80)
+            {
+                appendPercent(output,codePoint);
+            }
+            else if (codePoint<0x800)
+            {
+                appendPercent(output,0xC0|(codePoint>>6));
+                appendPercent(output,0x80|(codePoint&0x3F));
+            }
+            else if (codePoint<0x10000)
+            {
+                appendPercent(output,0xE0|(codePoint>>12));
+                appendPercent(output,0x80|((codePoint>>6)&0x3F));
+                appendPercent(output,0x80|(codePoint&0x3F));
+            }
+            else
+            {
+                appendPercent(output,0xF0|(codePoint>>18));
+                appendPercent(output,0x80|((codePoint>>12)&0x3F));
+                appendPercent(output,0x80|((codePoint>>6)&0x3F));
+                appendPercent(output,0x80|(codePoint&0x3F));
+            }
+            return consumed;
+        }
+
+        case TemplateEscaper::JavaScript:
+            switch (c)
+            {
+                case '\\': output.append(QLatin1String("\\\\")); break;
+                case '"':  output.append(QLatin1String("\\\"")); break;
+                case '\'': output.append(QLatin1String("\\'")); break;
+                case '/':  output.append(QLatin1String("\\/")); break;
+                case '\n': output.append(QLatin1String("\\n")); break;
+                case '\r': output.append(QLatin1String("\\r")); break;
+                case '\t': output.append(QLatin1String("\\t")); break;
+                default:   appendUnicodeEscape(output,c); break;
+            }
+            return 1;
+
+        default:
+            output.append(QChar(c));
+            return 1;
+    }
+}
+
+} // end of anonymous namespace
+
+TemplateEscaper::Context TemplateEscaper::context(const QStringRef& name, bool* ok)
+{
+    if (ok)
+    {
+        *ok=true;
+    }
+    if (name==QLatin1String("html"))
+    {
+        return Html;
+    }
+    else if (name==QLatin1String("attr"))
+    {
+        return Attribute;
+    }
+    else if (name==QLatin1String("url"))
+    {
+        return Url;
+    }
+    else if (name==QLatin1String("js"))
+    {
+        return JavaScript;
+    }
+    if (ok)
+    {
+        *ok=false;
+    }
+    return None;
+}
+
+int TemplateEscaper::findSpecial(const ushort* data, const int size, const Context context)
+{
+    if (context==None)
+    {
+        return size;
+    }
+    int i=0;
+#ifdef TEMPLATEESCAPER_SSE2
+    for (; i+8<=size; i+=8)
+    {
+        __m128i chars=_mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+        int mask=_mm_movemask_epi8(specialMask(chars,context));
+        if (mask)
+        {
+            return i+firstIndex(mask);
+        }
+    }
+#endif
+    for (; i<size; ++i)
+    {
+        if (isSpecial(data[i],context))
+        {
+            return i;
+        }
+    }
+    return size;
+}
+
+void TemplateEscaper::append(QString& output, const QString& value, const Context context)
+{
+    const ushort* data=value.utf16();
+    const int size=value.size();
+    int pos=findSpecial(data,size,context);
+    if (pos==size)
+    {
+        // Nothing to escape
+        output.append(value);
+        return;
+    }
+    int done=0;
+    while (pos<size)
+    {
+        output.append(reinterpret_cast<const QChar*>(data+done),pos-done);
+        done=pos+appendEscaped(output,data+pos,size-pos,context);
+        pos=done+findSpecial(data+done,size-done,context);
+    }
+    output.append(reinterpret_cast<const QChar*>(data+done),size-done);
+}
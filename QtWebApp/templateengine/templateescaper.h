@@ -0,0 +1,64 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef TEMPLATEESCAPER_H
+#define TEMPLATEESCAPER_H
+
+#include <QString>
+#include <QStringRef>
+#include "templateglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Escapes values while they are inserted into a template, so handlers do not
+  need to call QString::toHtmlEscaped() or similar on each value.
+  The escaping context is selected in the template by a suffix of the
+  variable name:
+
+  - {name|html} for HTML text: &amp; &lt; &gt; &quot; and &#39;
+  - {name|attr} for HTML attribute values: like html, plus ` and =
+  - {name|url}  for URL components: percent-encoding of the UTF-8 bytes, except A-Z a-z 0-9 - _ . ~
+  - {name|js}   for JavaScript string literals: backslash escapes and \\uXXXX for characters that could end the string or the script
+
+  The values are scanned with SSE2 instructions where available, so strings
+  that need no escaping are detected quickly and copied unchanged.
+  @see Template
+*/
+
+class DECLSPEC TemplateEscaper {
+public:
+
+    /** Escaping contexts */
+    enum Context {None, Html, Attribute, Url, JavaScript};
+
+    /**
+      Get the escaping context by its name as used in templates.
+      @param name Name of the context, e.g. "html"
+      @param ok Set to false if the name is unknown
+    */
+    static Context context(const QStringRef& name, bool* ok=nullptr);
+
+    /**
+      Escape the value and append it to the output.
+      @param output Receives the escaped value
+      @param value Value to escape
+      @param context Escaping context
+    */
+    static void append(QString& output, const QString& value, const Context context);
+
+    /**
+      Get the position of the first character that needs escaping.
+      @param data UTF-16 characters
+      @param size Number of characters
+      @param context Escaping context
+      @return Position of the character, or size if none needs escaping
+    */
+    static int findSpecial(const ushort* data, const int size, const Context context);
+};
+
+} // end of namespace
+
+#endif // TEMPLATEESCAPER_H
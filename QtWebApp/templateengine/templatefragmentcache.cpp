@@ -0,0 +1,79 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "templatefragmentcache.h"
+#include "templatelogging.h"
+#include "memorybudget.h"
+#include "metricsregistry.h"
+#include <QDateTime>
+#include <mutex>
+
+using namespace stefanfrings;
+
+TemplateFragmentCache::TemplateFragmentCache(const QSettings* settings, QObject* parent)
+    : QObject(parent)
+{
+    Q_ASSERT(settings!=nullptr);
+    cacheSize=settings->value("fragmentCacheSize","1000000").toInt();
+    cache.setMaxCost(cacheSize);
+    defaultTtl=settings->value("fragmentCacheTime","60000").toInt();
+    qwaDebug(qwaTemplate,"TemplateFragmentCache: timeout=%i, size=%i",defaultTtl,cache.maxCost());
+    budgetId=MemoryBudget::instance().addCache([this](double factor)
+    {
+        std::lock_guard lock{ mutex };
+        cache.setMaxCost(qMax(1,static_cast<int>(cacheSize*factor)));
+        accountCache();
+    });
+}
+
+TemplateFragmentCache::~TemplateFragmentCache()
+{
+    MemoryBudget::instance().removeCache(budgetId);
+    MemoryBudget::instance().add(MemoryBudget::Caches,-accountedBytes);
+}
+
+void TemplateFragmentCache::accountCache()
+{
+    // The cost is the number of characters
+    const qint64 bytes=cache.totalCost()*static_cast<qint64>(sizeof(QChar));
+    MemoryBudget::instance().add(MemoryBudget::Caches,bytes-accountedBytes);
+    accountedBytes=bytes;
+}
+
+bool TemplateFragmentCache::find(const QString& key, QString& document)
+{
+    static Counter& hits=MetricsRegistry::instance().counter("qtwebapp_fragment_cache_requests_total","Requests of the TemplateFragmentCache by cache result","result=\"hit\"");
+    static Counter& misses=MetricsRegistry::instance().counter("qtwebapp_fragment_cache_requests_total","Requests of the TemplateFragmentCache by cache result","result=\"miss\"");
+    qint64 now=QDateTime::currentMSecsSinceEpoch();
+    std::lock_guard lock{ mutex };
+    CacheEntry* entry=cache.object(key);
+    if (entry && (entry->expires==0 || entry->expires>now))
+    {
+        document=entry->document;
+        hits.add();
+        return true;
+    }
+    misses.add();
+    return false;
+}
+
+void TemplateFragmentCache::insert(const QString& key, const QString& document, const int ttl)
+{
+    int timeout=(ttl<0) ? defaultTtl : ttl;
+    CacheEntry* entry=new CacheEntry();
+    entry->document=document;
+    entry->expires=(timeout==0) ? 0 : QDateTime::currentMSecsSinceEpoch()+timeout;
+    std::lock_guard lock{ mutex };
+    // QCache deletes the entry immediately if it is larger than the whole cache
+    cache.insert(key,entry,qMax(1,document.size()));
+    accountCache();
+}
+
+void TemplateFragmentCache::clear()
+{
+    std::lock_guard lock{ mutex };
+    cache.clear();
+    accountCache();
+}
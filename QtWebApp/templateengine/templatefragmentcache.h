@@ -0,0 +1,108 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef TEMPLATEFRAGMENTCACHE_H
+#define TEMPLATEFRAGMENTCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QSettings>
+#include <QString>
+#include "templateglobal.h"
+#include "instrumentedmutex.h"
+
+namespace stefanfrings {
+
+/**
+  Cache for rendered template fragments, e.g. navigation bars and footers that
+  are identical for many requests. The cache has a limited size, it prefers to
+  keep the last recently used fragments. Each fragment expires after the time
+  that is declared in the template, or after the default time.
+  <p>
+  The following settings are used, usually in the same group as the templates:
+  <code><pre>
+  fragmentCacheSize=1000000
+  fragmentCacheTime=60000
+  </pre></code>
+  The size is the total number of characters of all cached fragments. The
+  time in milliseconds is used for fragments that do not declare their own ttl.
+  Fragments are cached as long as possible, when the time is 0.
+  The cache is accounted in the MemoryBudget and shrinks while the budget is exceeded.
+  @see Template::cachedFragment()
+*/
+
+class DECLSPEC TemplateFragmentCache : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY(TemplateFragmentCache)
+public:
+
+    /**
+      Constructor.
+      @param settings Configuration settings, usually stored in an INI file. Must not be 0.
+      Settings are read from the current group, so the caller must have called settings->beginGroup().
+      The TemplateFragmentCache does not take over ownership of the QSettings instance.
+      @param parent Parent object
+    */
+    TemplateFragmentCache(const QSettings* settings, QObject* parent=nullptr);
+
+    /** Destructor */
+    virtual ~TemplateFragmentCache();
+
+    /**
+      Get a cached fragment.
+      This method is thread safe.
+      @param key Key of the fragment
+      @param document Receives the rendered fragment
+      @return true if the fragment was found and has not expired
+    */
+    bool find(const QString& key, QString& document);
+
+    /**
+      Store a rendered fragment.
+      This method is thread safe.
+      @param key Key of the fragment
+      @param document Rendered fragment
+      @param ttl Time to live in milliseconds, -1=default time, 0=unlimited
+    */
+    void insert(const QString& key, const QString& document, const int ttl=-1);
+
+    /**
+      Remove all fragments, e.g. after the underlying data has changed.
+      This method is thread safe.
+    */
+    void clear();
+
+private:
+
+    struct CacheEntry {
+        QString document;
+        qint64 expires;
+    };
+
+    /** Default time to live of fragments in milliseconds, 0=unlimited */
+    int defaultTtl;
+
+    /** Cache storage */
+    QCache<QString,CacheEntry> cache;
+
+    /** Configured size of the cache */
+    int cacheSize;
+
+    /** Size of the cache in bytes that is accounted in the MemoryBudget */
+    qint64 accountedBytes=0;
+
+    /** Registration of the cache in the MemoryBudget */
+    int budgetId;
+
+    /** Used to synchronize threads */
+    InstrumentedMutex mutex{"template_fragment_cache"};
+
+    /** Update the accounted size of the cache, the caller must hold the mutex */
+    void accountCache();
+};
+
+} // end of namespace
+
+#endif // TEMPLATEFRAGMENTCACHE_H
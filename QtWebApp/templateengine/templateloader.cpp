@@ -4,6 +4,8 @@
 */
 
 #include "templateloader.h"
+#include "templatelogging.h"
+#include "templateregistry.h"
 #include <QFile>
 #include <QFileInfo>
 #include <QStringList>
@@ -27,6 +29,7 @@ TemplateLoader::TemplateLoader(const QSettings *settings, QObject *parent)
         templatePath=QFileInfo(configFile.absolutePath(),templatePath).absoluteFilePath();
     }
     fileNameSuffix=settings->value("suffix",".tpl").toString();
+    useCompiled=settings->value("useCompiled",true).toBool();
     QString encoding=settings->value("encoding").toString();
     if (encoding.isEmpty())
     {
@@ -36,7 +39,7 @@ TemplateLoader::TemplateLoader(const QSettings *settings, QObject *parent)
     {
        textCodec=QTextCodec::codecForName(encoding.toLocal8Bit());
    }
-   qDebug("TemplateLoader: path=%s, codec=%s",qPrintable(templatePath),textCodec->name().data());
+   qwaDebug(qwaTemplate,"TemplateLoader: path=%s, codec=%s",qPrintable(templatePath),textCodec->name().data());
 }
 
 TemplateLoader::~TemplateLoader()
@@ -45,7 +48,7 @@ TemplateLoader::~TemplateLoader()
 QString TemplateLoader::tryFile(QString localizedName)
 {
     QString fileName=templatePath+"/"+localizedName+fileNameSuffix;
-    qDebug("TemplateCache: trying file %s",qPrintable(fileName));
+    qwaDebug(qwaTemplate,"TemplateCache: trying file %s",qPrintable(fileName));
     QFile file(fileName);
     if (file.exists()) {
         file.open(QIODevice::ReadOnly);
@@ -53,7 +56,7 @@ QString TemplateLoader::tryFile(QString localizedName)
         file.close();
         if (file.error())
         {
-            qCritical("TemplateLoader: cannot load file %s, %s",qPrintable(fileName),qPrintable(file.errorString()));
+            qCCritical(qwaTemplate,"TemplateLoader: cannot load file %s, %s",qPrintable(fileName),qPrintable(file.errorString()));
             return "";
         }
         else
@@ -64,6 +67,19 @@ QString TemplateLoader::tryFile(QString localizedName)
     return "";
 }
 
+QString TemplateLoader::tryCompiledOrFile(const QString localizedName)
+{
+    if (useCompiled)
+    {
+        QString document=TemplateRegistry::find(localizedName);
+        if (!document.isEmpty())
+        {
+            return document;
+        }
+    }
+    return tryFile(localizedName);
+}
+
 Template TemplateLoader::getTemplate(QString templateName, QString locales)
 {
     QSet<QString> tried; // used to suppress duplicate attempts
@@ -77,7 +93,7 @@ Template TemplateLoader::getTemplate(QString templateName, QString locales)
         QString localizedName=templateName+"-"+loc.trimmed();
         if (!tried.contains(localizedName))
         {
-            QString document=tryFile(localizedName);
+            QString document=tryCompiledOrFile(localizedName);
             if (!document.isEmpty()) {
                 return Template(document,localizedName);
             }
@@ -92,7 +108,7 @@ Template TemplateLoader::getTemplate(QString templateName, QString locales)
         QString localizedName=templateName+"-"+loc.trimmed();
         if (!tried.contains(localizedName))
         {
-            QString document=tryFile(localizedName);
+            QString document=tryCompiledOrFile(localizedName);
             if (!document.isEmpty())
             {
                 return Template(document,localizedName);
@@ -102,12 +118,12 @@ Template TemplateLoader::getTemplate(QString templateName, QString locales)
     }
 
     // Search for default file
-    QString document=tryFile(templateName);
+    QString document=tryCompiledOrFile(templateName);
     if (!document.isEmpty())
     {
         return Template(document,templateName);
     }
 
-    qCritical("TemplateCache: cannot find template %s",qPrintable(templateName));
+    qCCritical(qwaTemplate,"TemplateCache: cannot find template %s",qPrintable(templateName));
     return Template("",templateName);
 }
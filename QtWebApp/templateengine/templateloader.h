@@ -34,7 +34,12 @@ namespace stefanfrings {
   </pre></code>
   The path is relative to the directory of the config file. In case of windows, if the
   settings are in the registry, the path is relative to the current working directory.
+  <p>
+  Templates that have been compiled into the program (see TemplateRegistry) are
+  preferred over files. Set the optional setting useCompiled=false to load
+  the files instead, e.g. while editing the templates during development.
   @see TemplateCache
+  @see TemplateRegistry
 */
 
 class DECLSPEC TemplateLoader : public QObject {
@@ -72,6 +77,16 @@ protected:
     */
     virtual QString tryFile(const QString localizedName);
 
+    /**
+      Try to get a compiled template, then fall back to tryFile().
+      @param localizedName Name of the template with locale to find
+      @return The template document, or empty string if not found
+    */
+    QString tryCompiledOrFile(const QString localizedName);
+
+    /** Whether compiled templates are preferred over files */
+    bool useCompiled;
+
     /** Directory where the templates are searched */
     QString templatePath;
 
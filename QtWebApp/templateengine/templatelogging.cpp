@@ -0,0 +1,8 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "templatelogging.h"
+
+Q_LOGGING_CATEGORY(qwaTemplate,"qtwebapp.template")
@@ -0,0 +1,20 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef TEMPLATELOGGING_H
+#define TEMPLATELOGGING_H
+
+#include <QLoggingCategory>
+#include "templateglobal.h"
+#include "debugoutput.h"
+
+/**
+  Logging category of the template engine, "qtwebapp.template".
+  Define QTWEBAPP_NO_DEBUG_OUTPUT to remove its debug messages at compile time.
+  @see httplogging.h
+*/
+Q_DECLARE_LOGGING_CATEGORY(qwaTemplate)
+
+#endif // TEMPLATELOGGING_H
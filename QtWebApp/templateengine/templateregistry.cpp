@@ -0,0 +1,55 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "templateregistry.h"
+#include <QHash>
+#include <QReadWriteLock>
+
+using namespace stefanfrings;
+
+namespace {
+
+struct CompiledTemplate {
+    const char16_t* data;
+    int size;
+};
+
+/** Storage of the registry, constructed on first use because registration happens during static initialization */
+QHash<QString,CompiledTemplate>& compiledTemplates()
+{
+    static QHash<QString,CompiledTemplate> templates;
+    return templates;
+}
+
+QReadWriteLock& registryLock()
+{
+    static QReadWriteLock lock;
+    return lock;
+}
+
+}
+
+void TemplateRegistry::registerTemplate(const QString& name, const char16_t* data, const int size)
+{
+    QWriteLocker locker(&registryLock());
+    compiledTemplates().insert(name,CompiledTemplate{data,size});
+}
+
+QString TemplateRegistry::find(const QString& name)
+{
+    QReadLocker locker(&registryLock());
+    QHash<QString,CompiledTemplate>::const_iterator it=compiledTemplates().constFind(name);
+    if (it==compiledTemplates().constEnd())
+    {
+        return QString();
+    }
+    // Refer to the compiled data without copying it
+    return QString::fromRawData(reinterpret_cast<const QChar*>(it->data),it->size);
+}
+
+TemplateRegistration::TemplateRegistration(const char* name, const char16_t* data, const int size)
+{
+    TemplateRegistry::registerTemplate(QString::fromUtf8(name),data,size);
+}
@@ -0,0 +1,67 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef TEMPLATEREGISTRY_H
+#define TEMPLATEREGISTRY_H
+
+#include <QString>
+#include "templateglobal.h"
+
+namespace stefanfrings {
+
+/**
+  Registry of templates that have been compiled into the program by the
+  templatecompiler tool. The TemplateLoader and the TemplateCache look
+  into this registry before they touch the filesystem, so compiled
+  templates need neither file I/O nor decoding at runtime.
+  <p>
+  Templates are registered by their localized name without suffix,
+  e.g. "index" or "index-de". The generated sources register themselves
+  during static initialization by defining a TemplateRegistration:
+  <code><pre>
+  static constexpr char16_t source[] = { ... };
+  static const stefanfrings::TemplateRegistration registration("index", source, sizeof(source)/sizeof(char16_t)-1);
+  </pre></code>
+  Add the template files to COMPILED_TEMPLATES in your project file and include
+  tools/templatecompiler/templatecompiler.pri to generate these sources.
+  @see TemplateLoader
+*/
+
+class DECLSPEC TemplateRegistry {
+public:
+
+    /**
+      Register a compiled template. The data is not copied, so it must stay
+      valid as long as the program runs.
+      This method is thread safe.
+      @param name Localized name of the template without suffix
+      @param data UTF-16 text of the template
+      @param size Number of characters in data
+    */
+    static void registerTemplate(const QString& name, const char16_t* data, const int size);
+
+    /**
+      Get a compiled template.
+      This method is thread safe.
+      @param name Localized name of the template without suffix
+      @return The template document that refers to the compiled data, or a null string if there is no such template
+    */
+    static QString find(const QString& name);
+};
+
+/**
+  Helper that registers a compiled template when it gets constructed.
+  Used by the sources generated by the templatecompiler tool.
+*/
+
+struct DECLSPEC TemplateRegistration {
+
+    /** Constructor, calls TemplateRegistry::registerTemplate() */
+    TemplateRegistration(const char* name, const char16_t* data, const int size);
+};
+
+} // end of namespace
+
+#endif // TEMPLATEREGISTRY_H
@@ -0,0 +1,12 @@
+# Command line tool that converts binary log files into text.
+# See the "binary" setting of the FileLogger.
+
+TARGET = logdecoder
+TEMPLATE = app
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+include(../../logging/logging.pri)
@@ -0,0 +1,88 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <stdio.h>
+#include "logbinary.h"
+#include "logformat.h"
+
+using namespace stefanfrings;
+
+/**
+  Converts a binary log file that has been written by the FileLogger into text.
+  The messages are decorated with the msgFormat and timestampFormat of the
+  logger, unless other formats are given on the command line.
+  <p>
+  Usage: logdecoder [-f msgFormat] [-t timestampFormat] input.log [output.txt]
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc,argv);
+    app.setApplicationName("logdecoder");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts a binary QtWebApp log file into text.");
+    parser.addHelpOption();
+    QCommandLineOption formatOption(QStringList() << "f" << "format","Format of the decoration, default is the msgFormat of the logger.","msgFormat");
+    QCommandLineOption timestampOption(QStringList() << "t" << "timestamp","Format of timestamps, default is the timestampFormat of the logger.","timestampFormat");
+    parser.addOption(formatOption);
+    parser.addOption(timestampOption);
+    parser.addPositionalArgument("input","Binary log file");
+    parser.addPositionalArgument("output","Text file, default is stdout","[output]");
+    parser.process(app);
+
+    const QStringList arguments=parser.positionalArguments();
+    if (arguments.size()<1 || arguments.size()>2)
+    {
+        parser.showHelp(1);
+    }
+
+    QFile input(arguments.at(0));
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        fprintf(stderr,"logdecoder: cannot read %s, %s\n",qPrintable(input.fileName()),qPrintable(input.errorString()));
+        return 1;
+    }
+
+    QFile output;
+    bool opened;
+    if (arguments.size()==2)
+    {
+        output.setFileName(arguments.at(1));
+        opened=output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+    }
+    else
+    {
+        opened=output.open(stdout,QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!opened)
+    {
+        fprintf(stderr,"logdecoder: cannot write %s, %s\n",qPrintable(output.fileName()),qPrintable(output.errorString()));
+        return 1;
+    }
+
+    LogDecoder decoder(&input);
+    LogFormat format;
+    LogMessage logMessage;
+    QString decorated;
+    while (decoder.read(logMessage))
+    {
+        // The logger may have changed its format while the file was written
+        format.setFormat(parser.isSet(formatOption) ? parser.value(formatOption) : decoder.getMsgFormat(),
+                         parser.isSet(timestampOption) ? parser.value(timestampOption) : decoder.getTimestampFormat());
+        format.format(logMessage,decorated);
+        output.write(decorated.toLocal8Bit());
+    }
+    output.close();
+
+    if (!decoder.getErrorString().isEmpty())
+    {
+        fprintf(stderr,"logdecoder: %s in %s\n",qPrintable(decoder.getErrorString()),qPrintable(input.fileName()));
+        return 1;
+    }
+    return 0;
+}
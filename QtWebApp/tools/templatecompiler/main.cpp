@@ -0,0 +1,121 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextCodec>
+#include <QTextStream>
+#include <stdio.h>
+
+/**
+  Compiles a template file into a C++ source file. The generated source
+  contains the decoded template text as constexpr UTF-16 array and registers
+  it in the TemplateRegistry under the path of the file relative to the
+  template root, without suffix. That is the name which the TemplateLoader
+  looks up, for example mail/welcome for templates/mail/welcome.tpl.
+  <p>
+  Usage: templatecompiler [-e encoding] [-r root] input.tpl output.cpp
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc,argv);
+    app.setApplicationName("templatecompiler");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compiles a QtWebApp template file into a C++ source file.");
+    parser.addHelpOption();
+    QCommandLineOption encodingOption(QStringList() << "e" << "encoding","Encoding of the template file, default is UTF-8.","encoding","UTF-8");
+    QCommandLineOption nameOption(QStringList() << "n" << "name","Registered name of the template, default is the path relative to the root without suffix.","name");
+    QCommandLineOption rootOption(QStringList() << "r" << "root","Directory of the templates, same as the path setting of the TemplateLoader. Default is the directory of the input file.","root");
+    parser.addOption(encodingOption);
+    parser.addOption(nameOption);
+    parser.addOption(rootOption);
+    parser.addPositionalArgument("input","Template file");
+    parser.addPositionalArgument("output","Generated C++ source file");
+    parser.process(app);
+
+    const QStringList arguments=parser.positionalArguments();
+    if (arguments.size()!=2)
+    {
+        parser.showHelp(1);
+    }
+    const QString inputName=arguments.at(0);
+    const QString outputName=arguments.at(1);
+
+    QTextCodec* textCodec=QTextCodec::codecForName(parser.value(encodingOption).toLocal8Bit());
+    if (!textCodec)
+    {
+        fprintf(stderr,"templatecompiler: unknown encoding %s\n",qPrintable(parser.value(encodingOption)));
+        return 1;
+    }
+
+    QFile input(inputName);
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        fprintf(stderr,"templatecompiler: cannot read %s, %s\n",qPrintable(inputName),qPrintable(input.errorString()));
+        return 1;
+    }
+    // Decode exactly like TemplateLoader::tryFile() does
+    const QString document=textCodec->toUnicode(input.readAll());
+    input.close();
+
+    QString name=parser.value(nameOption);
+    if (name.isEmpty())
+    {
+        const QFileInfo inputInfo(inputName);
+        const QString root=parser.isSet(rootOption) ? parser.value(rootOption) : inputInfo.absolutePath();
+        const QString relativePath=QDir(root).relativeFilePath(inputInfo.absoluteFilePath());
+        if (relativePath.startsWith("../"))
+        {
+            fprintf(stderr,"templatecompiler: %s is not below the root %s\n",qPrintable(inputName),qPrintable(root));
+            return 1;
+        }
+        // Keep the directories, remove only the suffix
+        const QString directory=QFileInfo(relativePath).path();
+        name=QFileInfo(relativePath).completeBaseName();
+        if (directory!=".")
+        {
+            name=directory+"/"+name;
+        }
+    }
+
+    QFile output(outputName);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        fprintf(stderr,"templatecompiler: cannot write %s, %s\n",qPrintable(outputName),qPrintable(output.errorString()));
+        return 1;
+    }
+    QTextStream out(&output);
+    out.setCodec("UTF-8");
+    out << "// Generated by templatecompiler from " << QFileInfo(inputName).fileName() << ", do not edit.\n\n";
+    out << "#include \"templateregistry.h\"\n\n";
+    out << "namespace {\n\n";
+    out << "constexpr char16_t source[] = {";
+    // Write the text as numbers because some compilers limit the length of string literals
+    for (int i=0; i<document.size(); ++i)
+    {
+        if (i%16==0)
+        {
+            out << "\n    ";
+        }
+        out << "0x" << QString::number(document.at(i).unicode(),16).rightJustified(4,'0') << ",";
+    }
+    out << "\n    0\n};\n\n";
+    QByteArray escapedName=name.toUtf8();
+    escapedName.replace('\\',"\\\\").replace('"',"\\\"");
+    out << "const stefanfrings::TemplateRegistration registration(\"" << escapedName
+        << "\", source, sizeof(source)/sizeof(char16_t)-1);\n\n";
+    out << "} // end of anonymous namespace\n";
+    out.flush();
+    if (output.error()!=QFile::NoError)
+    {
+        fprintf(stderr,"templatecompiler: cannot write %s, %s\n",qPrintable(outputName),qPrintable(output.errorString()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+# Compiles the template files listed in COMPILED_TEMPLATES into C++ sources
+# which register themselves in the TemplateRegistry. The TemplateLoader
+# and TemplateCache then use the compiled version instead of the file.
+#
+# Example:
+#   COMPILED_TEMPLATES += etc/templates/*.tpl etc/templates/mail/*.tpl
+#   TEMPLATE_ROOT = $$PWD/etc/templates
+#   TEMPLATE_COMPILER = $$PWD/../build-templatecompiler/templatecompiler
+#   TEMPLATE_ENCODING = UTF-8
+#   include(../QtWebApp/tools/templatecompiler/templatecompiler.pri)
+#
+# The templates are registered under their path relative to TEMPLATE_ROOT
+# without suffix, for example mail/welcome. So TEMPLATE_ROOT must match the
+# path setting of the TemplateLoader. It defaults to the project directory.
+# TEMPLATE_COMPILER defaults to "templatecompiler" from the search path,
+# TEMPLATE_ENCODING defaults to UTF-8 and must match the encoding setting
+# of the TemplateLoader.
+
+isEmpty(TEMPLATE_COMPILER): TEMPLATE_COMPILER = templatecompiler
+isEmpty(TEMPLATE_ENCODING): TEMPLATE_ENCODING = UTF-8
+isEmpty(TEMPLATE_ROOT): TEMPLATE_ROOT = $$_PRO_FILE_PWD_
+TEMPLATE_ROOT = $$absolute_path($$TEMPLATE_ROOT, $$_PRO_FILE_PWD_)
+
+# One target per template, because the name of the generated source must contain
+# the directories, otherwise templates with the same file name would collide
+for(pattern, COMPILED_TEMPLATES) {
+    for(template, $$list($$files($$absolute_path($$pattern, $$_PRO_FILE_PWD_)))) {
+        relativePath = $$relative_path($$template, $$TEMPLATE_ROOT)
+        baseName = $$replace(relativePath, \\.[^./]*$, )
+        targetName = tpl_$$replace(baseName, [^A-Za-z0-9], _)_$$num_add($$size(TEMPLATE_SOURCES), 1)
+        $${targetName}.target = $${targetName}.cpp
+        $${targetName}.commands = $$TEMPLATE_COMPILER -e $$TEMPLATE_ENCODING -r $$shell_quote($$TEMPLATE_ROOT) $$shell_quote($$template) $${targetName}.cpp
+        $${targetName}.depends = $$template
+        QMAKE_EXTRA_TARGETS += $$targetName
+        TEMPLATE_SOURCES += $${targetName}.cpp
+    }
+}
+GENERATED_SOURCES += $$TEMPLATE_SOURCES
+PRE_TARGETDEPS += $$TEMPLATE_SOURCES
+QMAKE_CLEAN += $$TEMPLATE_SOURCES
@@ -0,0 +1,12 @@
+# Command line tool that compiles template files into C++ sources.
+# Build it once for the host, then use templatecompiler.pri in your project.
+
+TARGET = templatecompiler
+TEMPLATE = app
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
+
+OTHER_FILES += templatecompiler.pri